@@ -25,6 +25,7 @@
 #include <memory>
 #include <optional>
 #include <unordered_set>
+#include <vector>
 
 C4_ASSUME_NONNULL_BEGIN
 
@@ -159,6 +160,15 @@ struct C4BlobStore : C4Base {
     void copyBlobsTo(C4BlobStore&);
     void replaceWith(C4BlobStore&);
 
+    /// Deletes a blob, unless it's pending: installed (created) by any BlobStore in this process
+    /// and not referenced by any document committed since. The BlobCollector uses this to avoid
+    /// deleting a blob that a document about to be saved probably refers to, whether it was
+    /// written before or after the blob became unreferenced. Returns true if it deleted the blob.
+    bool deleteBlobUnlessPending(C4BlobKey);
+
+    /// Tells BlobStores that committed documents reference these blobs, so they're not pending.
+    static void blobsReferenced(const std::vector<C4BlobKey>&);
+
 // rarely used / for testing only:
     C4BlobStore(slice dirPath,
                 C4DatabaseFlags,
@@ -171,6 +181,12 @@ protected:
     C4BlobStore(const C4BlobStore&) = delete;
     litecore::FilePath dir() const;
     litecore::FilePath pathForKey(C4BlobKey) const;
+    std::vector<litecore::FilePath> blobDirs() const;
+    void forEachBlobIn(const litecore::FilePath &dir,
+                       fleece::function_ref<void(const litecore::FilePath&, C4BlobKey)>) const;
+    void migrateToShards();
+    int readLayoutVersion() const;
+    void writeLayoutVersion();
     std::unique_ptr<litecore::SeekableReadStream> getReadStream(C4BlobKey) const;
     std::unique_ptr<litecore::BlobWriteStream> getWriteStream();
     C4BlobKey install(litecore::BlobWriteStream*, const C4BlobKey* C4NULLABLE expectedKey);
@@ -179,6 +195,7 @@ private:
     std::string const   _dirPath;
     C4DatabaseFlags     _flags;
     C4EncryptionKey     _encryptionKey;
+    bool                _hasFlatBlobs {false};  // Read-only store still has unsharded blobs
 };
 
 
@@ -27,6 +27,7 @@
 #include <functional>
 #include <memory>
 #include <unordered_set>
+#include <vector>
 
 C4_ASSUME_NONNULL_BEGIN
 
@@ -67,6 +68,15 @@ struct C4Collection : public fleece::InstanceCountedIn<C4Collection>, C4Base {
                                              size_t* C4NULLABLE outCommonAncestorIndex,
                                              C4Error *outError) =0;
 
+    /// Puts many documents, as though by calling \ref putDocument on each request in order,
+    /// except that new documents are written to storage in batches. Must be in a transaction.
+    /// (One exception to the ordering: if a request to create a document finds that it already
+    /// exists, that document is saved after the rest of its batch, so it gets a later sequence.)
+    /// Returns the documents in the same order; a null document marks a failure, whose
+    /// error is stored in the same position of `outErrors`.
+    virtual std::vector<Retained<C4Document>> putDocuments(const std::vector<C4DocPutRequest> &rqs,
+                                                           std::vector<C4Error> &outErrors) =0;
+
     virtual Retained<C4Document> createDocument(slice docID,
                                                 slice revBody,
                                                 C4RevisionFlags revFlags,
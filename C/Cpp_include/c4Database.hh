@@ -128,6 +128,8 @@ public:
     Retained<C4Document> putDocument(const C4DocPutRequest &rq,
                                      size_t* C4NULLABLE outCommonAncestorIndex,
                                      C4Error *outError);
+    std::vector<Retained<C4Document>> putDocuments(const std::vector<C4DocPutRequest> &rqs,
+                                                   std::vector<C4Error> &outErrors);
     bool purgeDocument(slice docID);
     C4Timestamp getExpiration(slice docID) const;
     bool setExpiration(slice docID, C4Timestamp timestamp);
@@ -59,6 +59,8 @@ struct C4Replicator : public fleece::RefCounted,
     alloc_slice pendingDocIDs() const;
     bool isDocumentPending(slice docID) const;
 
+    alloc_slice getStats() const;
+
 #ifdef COUCHBASE_ENTERPRISE
     C4Cert* C4NULLABLE getPeerTLSCertificate() const;
 #endif
@@ -148,7 +148,8 @@ C4LogCallback c4log_getCallback() noexcept {
 bool c4log_writeToBinaryFile(C4LogFileOptions options, C4Error *outError) noexcept {
     return tryCatch(outError, [=] {
         LogFileOptions lfOptions { slice(options.base_path).asString(), (LogLevel)options.log_level, 
-            options.max_size_bytes, options.max_rotate_count, options.use_plaintext };
+            options.max_size_bytes, options.max_rotate_count, options.use_plaintext,
+            options.use_buffering };
 
         const string header = options.header.buf != nullptr ? slice(options.header).asString() :
             string("Generated by LiteCore ") + getBuildInfo();
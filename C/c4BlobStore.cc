@@ -29,6 +29,13 @@
 #include "FilePath.hh"
 #include "StringUtil.hh"
 #include "fleece/Fleece.hh"
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 using namespace std;
 using namespace fleece;
@@ -99,6 +106,33 @@ static string BlobKeyToFilename(const C4BlobKey &key) {
 }
 
 
+// Blob files are spread across subdirectories ("shards") named by the first byte of the digest
+// in hex, so no single directory grows huge. Older versions put every blob in the top-level
+// directory; those are moved into shards when the store is opened.
+static constexpr size_t kShardNameLength = 2;
+
+// The layout version is stored as a decimal number in a file at the top level of the store:
+//   1: (no layout file) Every blob is in the top-level directory.
+//   2: Blobs are in shard subdirectories.
+// A store with a newer layout than this code knows about is refused. Versions of LiteCore
+// older than layout 2 don't check this file and can't find sharded blobs, so moving a database
+// back to one of them requires first moving the blob files up into the top-level directory.
+static constexpr const char* kLayoutFileName = "layout";
+static constexpr int kLayoutVersion = 2;
+
+
+static string ShardName(const C4BlobKey &key) {
+    return stringprintf("%02x", key.bytes[0]);
+}
+
+
+static bool IsShardDir(const FilePath &path) {
+    string name = path.fileOrDirName();
+    return path.isDir() && name.size() == kShardNameLength
+        && isxdigit((unsigned char)name[0]) && isxdigit((unsigned char)name[1]);
+}
+
+
 static optional<C4BlobKey> BlobKeyFromFilename(slice filename) {
     if (filename.size != kBlobFilenameLength || !filename.hasSuffix(kBlobFilenameSuffix))
         return nullopt;
@@ -123,14 +157,72 @@ C4BlobStore::C4BlobStore(slice dirPath,
     FilePath dir(_dirPath, "");
     if (dir.exists()) {
         dir.mustExistAsDir();
+        int layout = readLayoutVersion();
+        if (layout > kLayoutVersion)
+            error::_throw(error::DatabaseTooNew,
+                          "Blob store layout %d is newer than this version supports (%d)",
+                          layout, kLayoutVersion);
+        // (Always check for flat blobs: an older LiteCore may have added some since.)
+        migrateToShards();
+        if (layout < kLayoutVersion && !(_flags & kC4DB_ReadOnly))
+            writeLayoutVersion();
     } else {
         if (!(flags & kC4DB_Create))
             error::_throw(error::NotFound);
         dir.mkdir();
+        writeLayoutVersion();
     }
 }
 
 
+// Returns the layout version recorded in the store, or 1 if there's no layout file.
+int C4BlobStore::readLayoutVersion() const {
+    ifstream in(dir().fileNamed(kLayoutFileName).path());
+    if (!in)
+        return 1;
+    int version = 0;
+    if (!(in >> version) || version < 1)
+        error::_throw(error::CorruptData, "Invalid blob store layout file");
+    return version;
+}
+
+
+void C4BlobStore::writeLayoutVersion() {
+    FilePath path = dir().fileNamed(kLayoutFileName);
+    ofstream out(path.path(), ios::trunc);
+    out << kLayoutVersion << '\n';
+    out.close();
+    if (!out)
+        error::_throw(error::IOError, "Couldn't write %s", path.path().c_str());
+}
+
+
+// One-time upgrade of a store with the older flat layout: moves top-level blobs into shards.
+void C4BlobStore::migrateToShards() {
+    unsigned numMoved = 0;
+    dir().forEachFile([&](const FilePath &path) {
+        if (auto key = BlobKeyFromFilename(path.fileName()); key) {
+            if (_flags & kC4DB_ReadOnly) {
+                _hasFlatBlobs = true;       // Can't move it; pathForKey will look for it here
+                return;
+            }
+            FilePath dst = pathForKey(*key);
+            dst.dir().mkdir();
+            try {
+                path.moveTo(dst);
+                ++numMoved;
+            } catch (const error&) {
+                // Another C4BlobStore on the same directory may have just moved it:
+                if (!dst.exists())
+                    throw;
+            }
+        }
+    });
+    if (numMoved > 0)
+        LogTo(DBLog, "Moved %u blobs in %s into subdirectories", numMoved, _dirPath.c_str());
+}
+
+
 C4BlobStore::~C4BlobStore() = default;
 
 
@@ -144,7 +236,14 @@ FilePath C4BlobStore::dir() const {
 }
 
 FilePath C4BlobStore::pathForKey(C4BlobKey key) const {
-    return FilePath(_dirPath, BlobKeyToFilename(key));
+    string filename = BlobKeyToFilename(key);
+    FilePath path = dir().subdirectoryNamed(ShardName(key)).fileNamed(filename);
+    if (_usuallyFalse(_hasFlatBlobs) && !path.exists()) {
+        // In a read-only store that couldn't be migrated, the blob may be at the top level:
+        if (FilePath flatPath(_dirPath, filename); flatPath.exists())
+            return flatPath;
+    }
+    return path;
 }
 
 
@@ -222,12 +321,59 @@ unique_ptr<BlobWriteStream> C4BlobStore::getWriteStream() {
 }
 
 
+// Blobs installed by any C4BlobStore in this process that no committed document has referenced
+// since, with the time they were installed; see deleteBlobUnlessPending. Entries older than
+// kPendingBlobLifetime are pruned, in case the document that was going to use the blob is never
+// saved. The mutex is held while installing or deleting a file, so the check and the deletion
+// are atomic with respect to installs.
+static mutex sPendingBlobsMutex;
+static unordered_map<C4BlobKey, C4Timestamp> sPendingBlobs;
+static C4Timestamp sNextPendingBlobsPrune = 0;
+static constexpr C4Timestamp kPendingBlobLifetime = 10 * 60 * 1000;   // ms
+
+
+// Must be called with sPendingBlobsMutex locked.
+static void notePending(const C4BlobKey &key) {
+    C4Timestamp now = c4_now();
+    if (now >= sNextPendingBlobsPrune) {
+        for (auto i = sPendingBlobs.begin(); i != sPendingBlobs.end();) {
+            if (now - i->second > kPendingBlobLifetime)
+                i = sPendingBlobs.erase(i);
+            else
+                ++i;
+        }
+        sNextPendingBlobsPrune = now + kPendingBlobLifetime;
+    }
+    sPendingBlobs[key] = now;
+}
+
+
+bool C4BlobStore::deleteBlobUnlessPending(C4BlobKey key) {
+    lock_guard<mutex> lock(sPendingBlobsMutex);
+    if (sPendingBlobs.find(key) != sPendingBlobs.end())
+        return false;
+    deleteBlob(key);
+    return true;
+}
+
+
+void C4BlobStore::blobsReferenced(const vector<C4BlobKey> &keys) {
+    lock_guard<mutex> lock(sPendingBlobsMutex);
+    for (auto &key : keys)
+        sPendingBlobs.erase(key);
+}
+
+
 C4BlobKey C4BlobStore::install(BlobWriteStream *writer, const C4BlobKey* expectedKey) {
     writer->close();
     C4BlobKey key = writer->computeKey();
     if (expectedKey && *expectedKey != key)
         error::_throw(error::CorruptData);
-    writer->install(pathForKey(key));
+    FilePath path = pathForKey(key);
+    path.dir().mkdir();
+    lock_guard<mutex> lock(sPendingBlobsMutex);
+    notePending(key);
+    writer->install(path);
     return key;
 }
 
@@ -240,40 +386,95 @@ void C4BlobStore::deleteBlob(C4BlobKey key) {
 #pragma mark - HOUSEKEEPING:
 
 
-unsigned C4BlobStore::deleteAllExcept(const unordered_set<C4BlobKey> &inUse) {
-    unsigned numDeleted = 0;
-    dir().forEachFile([&](const FilePath &path) {
+// Calls `fn` for every blob file, passing its path and key. The top-level directory is
+// scanned first, then each shard.
+void C4BlobStore::forEachBlobIn(const FilePath &dir,
+                                function_ref<void(const FilePath&, C4BlobKey)> fn) const
+{
+    dir.forEachFile([&](const FilePath &path) {
+        if (path.isDir())
+            return;
         const string &filename = path.fileName();
-        if (auto key = BlobKeyFromFilename(filename); key) {
-            if (find(inUse.cbegin(), inUse.cend(), *key) == inUse.cend()) {
+        if (auto key = BlobKeyFromFilename(filename); key)
+            fn(path, *key);
+        else if (!hasPrefix(filename, "incoming_") && filename != kLayoutFileName)
+            Warn("Skipping unknown file '%s' in Attachments directory", filename.c_str());
+    });
+}
+
+
+vector<FilePath> C4BlobStore::blobDirs() const {
+    vector<FilePath> dirs {dir()};
+    dir().forEachFile([&](const FilePath &path) {
+        if (IsShardDir(path))
+            dirs.push_back(path);
+    });
+    return dirs;
+}
+
+
+// Runs `fn` on each directory, with the directories divided among a few threads.
+static void forEachDirInParallel(const vector<FilePath> &dirs,
+                                 function_ref<void(const FilePath&)> fn)
+{
+    static constexpr unsigned kMaxThreads = 4;
+    unsigned nThreads = min({kMaxThreads, max(thread::hardware_concurrency(), 1u),
+                             unsigned(dirs.size())});
+    atomic<size_t> next {0};
+    exception_ptr error;
+    mutex errorMutex;
+    auto worker = [&] {
+        try {
+            for (size_t i; (i = next++) < dirs.size(); )
+                fn(dirs[i]);
+        } catch (...) {
+            lock_guard<mutex> lock(errorMutex);
+            if (!error)
+                error = current_exception();
+            next = dirs.size();         // stop the other threads early
+        }
+    };
+    vector<thread> threads;
+    for (unsigned t = 1; t < nThreads; ++t)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &t : threads)
+        t.join();
+    if (error)
+        rethrow_exception(error);
+}
+
+
+unsigned C4BlobStore::deleteAllExcept(const unordered_set<C4BlobKey> &inUse) {
+    // Shards are scanned one at a time, several at once, so a huge store is swept in small
+    // directory listings instead of one giant one:
+    atomic<unsigned> numDeleted {0};
+    forEachDirInParallel(blobDirs(), [&](const FilePath &dir) {
+        forEachBlobIn(dir, [&](const FilePath &path, C4BlobKey key) {
+            if (inUse.find(key) == inUse.end()) {
                 ++numDeleted;
-                LogToAt(DBLog, Verbose, "Deleting unused blob '%s", filename.c_str());
+                LogToAt(DBLog, Verbose, "Deleting unused blob '%s", path.fileName().c_str());
                 path.del();
             }
-        } else {
-            Warn("Skipping unknown file '%s' in Attachments directory", filename.c_str());
-        }
+        });
     });
     return numDeleted;
 }
 
 
 void C4BlobStore::copyBlobsTo(C4BlobStore &toStore) {
-    dir().forEachFile([&](const FilePath &path) {
-        const string &filename = path.fileName();
-        if (auto key = BlobKeyFromFilename(filename); key) {
-            auto src = getReadStream(*key);
+    for (const FilePath &dir : blobDirs()) {
+        forEachBlobIn(dir, [&](const FilePath&, C4BlobKey key) {
+            auto src = getReadStream(key);
             auto dst = toStore.getWriteStream();
             uint8_t buffer[4096];
             size_t bytesRead;
             while ((bytesRead = src->read(buffer, sizeof(buffer))) > 0) {
                 dst->write(slice(buffer, bytesRead));
             }
-            toStore.install(dst.get(), &*key);
-        } else {
-            Warn("Skipping unknown file '%s' in Attachments directory", filename.c_str());
-        }
-    });
+            toStore.install(dst.get(), &key);
+        });
+    }
 }
 
 
@@ -281,6 +482,7 @@ void C4BlobStore::replaceWith(C4BlobStore &other) {
     other.dir().moveToReplacingDir(dir(), true);
     _flags = other._flags;
     _encryptionKey = other._encryptionKey;
+    _hasFlatBlobs = other._hasFlatBlobs;
 }
 
 
@@ -26,6 +26,7 @@
 #include "c4Observer.hh"
 #include "c4Query.hh"
 #include "c4QueryImpl.hh"
+#include "DatabaseImpl.hh"
 #include "c4Replicator.hh"
 
 #include "c4.h"
@@ -948,6 +949,15 @@ bool c4db_markSynced(C4Database *database,
 }
 
 
+// this wrapper is only used by tests
+bool c4db_collectBlobsNow(C4Database *database, C4Error *outError) noexcept {
+    return tryCatch<bool>(outError, [&]{
+        asInternal(database)->collectBlobsNow();
+        return true;
+    });
+}
+
+
 char* c4doc_generateID(char *docID, size_t bufferSize) noexcept {
     return C4Document::generateID(docID, bufferSize);
 }
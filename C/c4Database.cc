@@ -287,6 +287,11 @@ Retained<C4Document> C4Database::putDocument(const C4DocPutRequest &rq,
     return getDefaultCollection()->putDocument(rq, outCommonAncestorIndex, outError);
 }
 
+std::vector<Retained<C4Document>> C4Database::putDocuments(const std::vector<C4DocPutRequest> &rqs,
+                                                           std::vector<C4Error> &outErrors) {
+    return getDefaultCollection()->putDocuments(rqs, outErrors);
+}
+
 bool C4Database::purgeDocument(slice docID) {
     return getDefaultCollection()->purgeDocument(docID);
 }
@@ -71,6 +71,12 @@ public:
             options.contentOption = kMetaOnly;
         else
             options.contentOption = kEntireBody;
+        options.startKey = c4options.startKey;
+        options.endKey = c4options.endKey;
+        options.inclusiveStart = (c4options.flags & kC4ExclusiveStartKey) == 0;
+        options.inclusiveEnd   = (c4options.flags & kC4ExclusiveEndKey) == 0;
+        options.maxSequence = c4options.maxSequence;
+        options.limit = c4options.limit;
         return options;
     }
 
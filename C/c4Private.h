@@ -76,6 +76,10 @@ bool c4db_findDocAncestors(C4Database *database,
                            C4StringResult ancestors[C4NONNULL],
                            C4Error* C4NULLABLE outError) C4API;
 
+/** Deletes any blobs that have become unreferenced, instead of waiting for the background
+    collector's usual delay, and returns when it's done. Used by tests. */
+bool c4db_collectBlobsNow(C4Database *database, C4Error* C4NULLABLE outError) C4API;
+
 /** Call this to use BuiltInWebSocket as the WebSocket implementation.
     (Only available if linked with libLiteCoreWebSocket) */
 void C4RegisterBuiltInWebSocket();
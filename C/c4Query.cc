@@ -105,7 +105,9 @@ alloc_slice C4Query::fullTextMatched(const C4FullTextMatch &term) {
 Retained<QueryEnumerator> C4Query::_createEnumerator(const C4QueryOptions *c4options,
                                                      slice encodedParameters)
 {
-    Query::Options options(encodedParameters ? encodedParameters : _parameters);
+    Query::Options options(encodedParameters ? encodedParameters : _parameters, 0, 0,
+                           c4options && c4options->streaming,
+                           c4options && c4options->cacheResults);
     return _query->createEnumerator(&options);
 }
 
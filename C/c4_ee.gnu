@@ -140,6 +140,7 @@ CBL {
 		c4repl_getStatus;
 		c4repl_retry;
 		c4repl_getPendingDocIDs;
+		c4repl_getStats;
 		c4repl_isDocumentPending;
 		c4repl_setOptions;
 		c4repl_setHostReachable;
@@ -428,6 +429,7 @@ CBL {
 
 		c4error_return;
 		c4_dumpInstances;
+		c4db_collectBlobsNow;
 		gC4ExpectExceptions;
 
 		FLDoc_FromJSON;
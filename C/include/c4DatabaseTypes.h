@@ -43,6 +43,7 @@ typedef C4_OPTIONS(uint32_t, C4DatabaseFlags) {
     kC4DB_VersionVectors= 0x08, ///< Upgrade DB to version vectors instead of rev trees [EXPERIMENTAL]
     kC4DB_NoUpgrade     = 0x20, ///< Disable upgrading an older-version database
     kC4DB_NonObservable = 0x40, ///< Disable database/collection observers, for slightly faster writes
+    kC4DB_DeferIndexing = 0x80, ///< Update FTS, array & predictive indexes in bulk at commit, for faster bulk writes
 };
 
 
@@ -97,6 +98,7 @@ typedef struct C4UUID {
 typedef C4_ENUM(uint32_t, C4MaintenanceType) {
     /// Shrinks the database file by removing any empty pages,
     /// and deletes blobs that are no longer referenced by any documents.
+    /// Also merges the segments of any FTS5 full-text indexes (\ref kC4FullText5Index.)
     /// (Runs SQLite `PRAGMA incremental_vacuum; PRAGMA wal_checkpoint(TRUNCATE)`.)
     kC4Compact,
 
@@ -121,6 +123,7 @@ typedef C4_ENUM(uint32_t, C4MaintenanceType) {
     /// Fully scans all indexes to gather database statistics that help optimize queries.
     /// This may take some time, depending on the size of the indexes, but it doesn't have to
     /// be redone unless the database changes drastically, or new indexes are created.
+    /// Also merges the segments of any FTS5 full-text indexes, as kC4Compact does.
     /// (Runs SQLite `PRAGMA analysis_limit=0; ANALYZE`.)
     kC4FullOptimize,
 };  // *NOTE:* These enum values must match the ones in DataFile::MaintenanceType
@@ -41,13 +41,24 @@ typedef C4_OPTIONS(uint16_t, C4EnumeratorFlags) {
                                don't need to access the revision tree or revision bodies. You
                                can still access all the data of the document, but it will
                                trigger loading the document body from the database. */
-    kC4IncludeRevHistory    = 0x40  ///< Put entire revision history/version vector in `revID`
+    kC4IncludeRevHistory    = 0x40, ///< Put entire revision history/version vector in `revID`
+    kC4ExclusiveStartKey    = 0x80, ///< If true, a doc whose ID is `startKey` is skipped.
+    kC4ExclusiveEndKey      = 0x100 ///< If true, a doc whose ID is `endKey` is skipped.
 };
 
 
-/** Options for enumerating over all documents. */
+/** Options for enumerating over all documents.
+    `startKey` and `endKey` are in iteration order, so with `kC4Descending` the start is the
+    higher docID. They only need to remain valid until the enumerator is created, and are
+    ignored when enumerating by sequence.
+    To page through the documents, set `limit`, then begin the next page at the last docID
+    returned, with `kC4ExclusiveStartKey`. */
 typedef struct {
     C4EnumeratorFlags flags;    ///< Option flags */
+    C4Slice startKey;           ///< If non-null, the first docID to return
+    C4Slice endKey;             ///< If non-null, the last docID to return
+    C4SequenceNumber maxSequence; ///< If nonzero, docs with higher sequences are skipped
+    uint64_t limit;             ///< If nonzero, the maximum number of docs to return
 } C4EnumeratorOptions;
 
 /** Default all-docs enumeration options. (Equal to kC4IncludeNonConflicted | kC4IncludeBodies) */
@@ -34,6 +34,7 @@ typedef C4_ENUM(uint32_t, C4IndexType) {
     kC4FullTextIndex,      ///< Full-text index
     kC4ArrayIndex,         ///< Index of array values, for use with UNNEST
     kC4PredictiveIndex,    ///< Index of prediction() results (Enterprise Edition only)
+    kC4FullText5Index,     ///< Full-text index using SQLite's FTS5; ranked by BM25
 };
 
 
@@ -69,6 +70,19 @@ typedef struct {
         To provide a custom list of words, use a string containing the words in lowercase
         separated by spaces. */
     const char* C4NULLABLE stopWords;
+
+    /** FTS5 indexes only: the 'automerge' setting, i.e. how many index segments of the same
+        size are merged together as documents are indexed. Lower values keep the index smaller
+        and faster to query, at the cost of more work while writing. 0 leaves SQLite's default
+        (4); a negative value disables automatic merging, leaving it to \ref c4db_maintenance
+        (kC4Compact or kC4FullOptimize); the maximum is 64. */
+    int automerge;
+
+    /** FTS5 indexes only: the 'crisismerge' setting, i.e. how many segments of the same size
+        force a merge during a write, however long it takes. Raising it avoids occasional long
+        stalls while writing, at the cost of a larger index until the next optimization.
+        0 leaves SQLite's default (16); otherwise it must be at least 2. */
+    int crisismerge;
 } C4IndexOptions;
 
 
@@ -65,6 +65,7 @@ typedef struct C4LogFileOptions {
     int32_t    max_rotate_count; ///< The maximum amount of old log files to keep
     bool       use_plaintext;    ///< Disables binary encoding of the logs (not recommended)
     FLString   header;           ///< Header text to print at the start of every log file
+    bool       use_buffering;    ///< Threads queue messages in per-thread buffers, written by a background thread
 } C4LogFileOptions;
 
 /** Causes log messages to be written to a file, overwriting any previous contents.
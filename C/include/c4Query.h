@@ -107,7 +107,8 @@ C4API_BEGIN_DECLS
                           C4Error* C4NULLABLE outError) C4API;
 
     /** Returns the total number of rows in the query, if known.
-        Not all query enumerators may support this (but the current implementation does.)
+        Not all query enumerators may support this (but the current implementation does, unless
+        the `streaming` option was set.)
         @param e  The query enumerator
         @param outError  On failure, an error will be stored here (probably kC4ErrorUnsupported.)
         @return  The number of rows, or -1 on failure. */
@@ -115,7 +116,7 @@ C4API_BEGIN_DECLS
                                      C4Error* C4NULLABLE outError) C4API;
 
     /** Jumps to a specific row. Not all query enumerators may support this (but the current
-        implementation does.)
+        implementation does, unless the `streaming` option was set.)
         @param e  The query enumerator
         @param rowIndex  The number of the row, starting at 0, or -1 to restart before first row
         @param outError  On failure, an error will be stored here (probably kC4ErrorUnsupported.)
@@ -38,6 +38,12 @@ typedef C4_ENUM(uint32_t, C4QueryLanguage) {
 /** Options for running queries. */
 typedef struct {
     bool rankFullText_DEPRECATED;      ///< Ignored; use the `rank()` query function instead.
+    bool streaming;                    ///< Read rows lazily as the enumerator advances. Lowers
+                                       ///< memory use and time to first row, but the
+                                       ///< enumerator can't `seek` or report its row count.
+    bool cacheResults;                 ///< Remember the results, and reuse them when the query
+                                       ///< is run again with the same parameters and the
+                                       ///< database hasn't changed. Ignored if `streaming`.
 } C4QueryOptions;
 
 
@@ -81,6 +81,11 @@ C4API_BEGIN_DECLS
     /** Creates a new replicator from an already-open C4Socket. This is for use by listeners
         that accept incoming connections, wrap them by calling `c4socket_fromNative()`, then
         start a passive replication to service them.
+        \note  The replicator needs to know which WebSocket protocol the listener accepted in the
+               handshake (the `Sec-WebSocket-Protocol` response header), since that determines
+               how messages are compressed. Put it in `params.optionsDictFleece` as the value of
+               `kC4SocketOptionWSProtocols`; if it's missing, this fails with
+               kC4ErrorInvalidParameter.
         @param db  The local database.
         @param openSocket  An already-created C4Socket.
         @param params  Replication parameters. Will usually use kC4Passive modes.
@@ -156,6 +161,17 @@ C4API_BEGIN_DECLS
      */
     C4SliceResult c4repl_getPendingDocIDs(C4Replicator* repl, C4Error* C4NULLABLE outErr) C4API;
 
+    /** Returns statistics about how the replicator is batching its work, as a Fleece-encoded
+        dictionary. It has a key "insertion" for revisions inserted into the database, and
+        "docsEnded" for document-ended notifications. Each value is a dictionary with keys
+        `batches`, `items`, `capacity` (current target batch size), `latencyMS`, `avgWaitMS`,
+        `maxWaitMS` (time from an item being queued to its batch being processed),
+        `avgProcessingMS`, and `sizeHistogram` (an array whose i'th item counts the batches of
+        size 2^i up to 2^(i+1)-1; the last item includes all larger batches.)
+        Returns nullslice if the replicator hasn't started.
+        \note This function is thread-safe.  */
+    C4SliceResult c4repl_getStats(C4Replicator *repl) C4API;
+
     /** Checks if the document with the given ID has revisions pending push.  This
      *  API is a snapshot and results may change between the time the call was made and the time
      *  the call returns.
@@ -225,6 +225,11 @@ C4API_BEGIN_DECLS
     #define kC4ReplicatorOptionMaxRetries       "maxRetries" ///< Max number of retry attempts (int)
     #define kC4ReplicatorOptionMaxRetryInterval "maxRetryInterval" ///< Max delay betw retries (secs)
     #define kC4ReplicatorOptionAutoPurge        "autoPurge" ///< Enables auto purge; default is true (bool)
+    #define kC4ReplicatorOptionTuningProfile    "tuningProfile" ///< Preset tuning; see [5] (string)
+    #define kC4ReplicatorOptionTuning           "tuning" ///< Overrides of individual tuning values (Dict[int])
+    #define kC4ReplicatorOptionAdaptiveTuning   "adaptiveTuning" ///< Size push windows from RTT (bool)
+    #define kC4ReplicatorOptionAdaptiveBatching "adaptiveBatching" ///< Size insert batches from timing (bool)
+    #define kC4ReplicatorOptionDeferIndexing    "deferIndexing" ///< Pull with kC4DB_DeferIndexing; see [6] (bool)
 
     // TLS options:
     #define kC4ReplicatorOptionRootCerts        "rootCerts"  ///< Trusted root certs (data)
@@ -239,10 +244,21 @@ C4API_BEGIN_DECLS
 
     // WebSocket options:
     #define kC4ReplicatorHeartbeatInterval      "heartbeat" ///< Interval in secs to send a keepalive ping
-    #define kC4SocketOptionWSProtocols          "WS-Protocols" ///< Sec-WebSocket-Protocol header value
+    #define kC4SocketOptionWSProtocols          "WS-Protocols" ///< Sec-WebSocket-Protocol header value;
+                                                       ///< for an incoming replicator, the accepted protocol
 
     // BLIP options:
     #define kC4ReplicatorCompressionLevel       "BLIPCompressionLevel" ///< Data compression level, 0..9
+    #define kC4ReplicatorCodec                  "BLIPCodec" ///< Require a codec: "deflate", "lz4", "zstd".
+                                                    ///< Normally derived from the WebSocket protocol.
+
+    // [6]: kC4ReplicatorOptionDeferIndexing makes the connection that inserts pulled revisions
+    //      update FTS, array and predictive indexes in bulk at each commit, instead of by a
+    //      trigger per document. That's much faster for a large initial pull into an indexed
+    //      database. But each commit drops and recreates the index triggers, which changes the
+    //      schema and makes every other connection to the database re-prepare its statements;
+    //      during a continuous replication that trickles in a few docs at a time, that costs
+    //      more than it saves. Default is false.
 
     // [1]: Auth dictionary keys:
     #define kC4ReplicatorAuthType       "type"           ///< Auth type; see [2] (string)
@@ -271,6 +287,12 @@ C4API_BEGIN_DECLS
     #define kC4ProxyTypeHTTPS           "HTTPS"          ///< HTTPS proxy (using CONNECT method)
     #define kC4ProxyTypeSOCKS           "SOCKS"          ///< SOCKS proxy
 
+    // [5]: tuningProfile values:
+    #define kC4TuningProfileDefault     "default"        ///< Built-in defaults
+    #define kC4TuningProfileLAN         "lan"            ///< Low-latency local network (P2P)
+    #define kC4TuningProfileWAN         "wan"            ///< High bandwidth-delay-product WAN
+    #define kC4TuningProfileLowMemory   "lowMemory"      ///< Memory-constrained devices
+
 
     /** @} */
 
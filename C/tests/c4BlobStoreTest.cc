@@ -19,6 +19,7 @@
 #include "c4Test.hh"
 #include "c4BlobStore.h"
 #include "c4Private.h"
+#include "Benchmark.hh"
 #include <fstream>
 
 using namespace std;
@@ -306,6 +307,61 @@ N_WAY_TEST_CASE_METHOD(BlobStoreTest, "write blobs of many sizes", "[blob][Encry
 }
 
 
+// Writes `size` bytes of pseudo-random data to a new blob in chunks of `chunkSize`, and
+// installs it. Returns the blob's key; if `contents` is non-null, stores the data there too.
+static C4BlobKey writeBlob(C4BlobStore *store, size_t size, size_t chunkSize,
+                           string *contents =nullptr)
+{
+    vector<char> chunk(chunkSize);
+    uint32_t x = 0x12345678;
+    C4Error error;
+    C4WriteStream *stream = c4blob_openWriteStream(store, ERROR_INFO(error));
+    REQUIRE(stream);
+    for (size_t written = 0; written < size; ) {
+        size_t n = min(chunkSize, size - written);
+        for (size_t i = 0; i < n; i++) {
+            x = x * 1103515245 + 12345;
+            chunk[i] = char(x >> 24);
+        }
+        REQUIRE(c4stream_write(stream, chunk.data(), n, WITH_ERROR(&error)));
+        if (contents)
+            contents->append(chunk.data(), n);
+        written += n;
+    }
+    CHECK(c4stream_bytesWritten(stream) == size);
+    C4BlobKey key = c4stream_computeBlobKey(stream);
+    CHECK(c4stream_install(stream, nullptr, WITH_ERROR(&error)));
+    c4stream_closeWriter(stream);
+    return key;
+}
+
+
+N_WAY_TEST_CASE_METHOD(BlobStoreTest, "write large blob with stream", "[blob][Encryption][C]") {
+    // Big enough that the writer moves encryption and file I/O to background threads:
+    static constexpr size_t kSize = 5 * 1024 * 1024 + 17;
+    string contents;
+    C4BlobKey key = writeBlob(store, kSize, 3001, &contents);
+    CHECK(key == c4blob_computeKey(slice(contents)));
+
+    C4Error error;
+    alloc_slice readBack = c4blob_getContents(store, key, ERROR_INFO(error));
+    REQUIRE(readBack.size == kSize);
+    CHECK(readBack == slice(contents));
+}
+
+
+N_WAY_TEST_CASE_METHOD(BlobStoreTest, "write large blob benchmark", "[Perf][.slow]") {
+    static constexpr size_t kSize = 256 * 1024 * 1024;
+    static constexpr size_t kChunkSize = 64 * 1024;
+    Stopwatch st;
+    writeBlob(store, kSize, kChunkSize);
+    double elapsed = st.elapsed();
+    C4Log("Writing %zu MB %s blob took %.3f sec (%.1f MB/s)",
+          kSize / (1024*1024), (encrypted ? "encrypted" : "plain"), elapsed,
+          kSize / (1024.0*1024.0) / elapsed);
+}
+
+
 N_WAY_TEST_CASE_METHOD(BlobStoreTest, "write blob and cancel", "[blob][Encryption][C]") {
     // Write the blob:
     C4Error error;
@@ -372,3 +428,96 @@ N_WAY_TEST_CASE_METHOD(BlobStoreTest, "write identical blob", "[blob][C]") {
         c4stream_closeWriter(stream);
     }
 }
+
+
+N_WAY_TEST_CASE_METHOD(BlobStoreTest, "blob store subdirectories", "[blob][C]") {
+    if (encrypted)
+        return;     // Can't get file paths with encryption
+
+    C4Slice blobToStore = C4STR("This is a blob to store in the store!");
+    C4BlobKey key;
+    REQUIRE(c4blob_create(store, blobToStore, nullptr, &key, WITH_ERROR()));
+
+    // The blob lives in a subdirectory named after the first byte of its digest:
+    alloc_slice p = c4blob_getFilePath(store, key, ERROR_INFO());
+    REQUIRE(p);
+    char shard[8];
+    sprintf(shard, "%02x", key.bytes[0]);
+    string path(p);
+    string suffix = string(kPathSeparator) + shard + kPathSeparator + "QneWo5IYIQ0ZrbCG0hXPGC6jy7E=.blob";
+    CHECK(path.size() > suffix.size());
+    CHECK(path.substr(path.size() - suffix.size()) == suffix);
+}
+
+
+N_WAY_TEST_CASE_METHOD(BlobStoreTest, "migrate flat blob store", "[blob][C]") {
+    if (encrypted)
+        return;     // Can't get file paths with encryption
+
+    // Create some blobs, then move their files up into the top-level directory, which is
+    // the layout used by older versions:
+    vector<C4BlobKey> keys;
+    vector<string> contents;
+    for (int i = 0; i < 20; i++) {
+        contents.push_back("This is blob #" + to_string(i) + ".");
+        C4BlobKey key;
+        REQUIRE(c4blob_create(store, slice(contents.back()), nullptr, &key, WITH_ERROR()));
+        keys.push_back(key);
+
+        alloc_slice p = c4blob_getFilePath(store, key, ERROR_INFO());
+        REQUIRE(p);
+        string path(p);
+        auto fileStart = path.rfind(kPathSeparator);
+        auto shardStart = path.rfind(kPathSeparator, fileStart - 1);
+        string flatPath = path.substr(0, shardStart) + path.substr(fileStart);
+        REQUIRE(rename(path.c_str(), flatPath.c_str()) == 0);
+    }
+
+    // Reopening the database migrates the files back into the subdirectories:
+    reopenDB();
+    store = c4db_getBlobStore(db, nullptr);
+    REQUIRE(store);
+    for (size_t i = 0; i < keys.size(); i++) {
+        alloc_slice gotBlob = c4blob_getContents(store, keys[i], ERROR_INFO());
+        CHECK(gotBlob == slice(contents[i]));
+
+        alloc_slice p = c4blob_getFilePath(store, keys[i], ERROR_INFO());
+        REQUIRE(p);
+        char shard[8];
+        sprintf(shard, "%02x", keys[i].bytes[0]);
+        string path(p);
+        auto shardStart = path.rfind(kPathSeparator, path.rfind(kPathSeparator) - 1) + 1;
+        CHECK(path.substr(shardStart, 2) == shard);
+        CHECK(ifstream(path).good());
+    }
+}
+
+
+N_WAY_TEST_CASE_METHOD(BlobStoreTest, "blob store layout version", "[blob][C]") {
+    if (encrypted)
+        return;     // Can't get file paths with encryption
+
+    C4BlobKey key;
+    REQUIRE(c4blob_create(store, "layout test"_sl, nullptr, &key, WITH_ERROR()));
+    alloc_slice p = c4blob_getFilePath(store, key, ERROR_INFO());
+    REQUIRE(p);
+    string path(p);
+    string storeDir = path.substr(0, path.rfind(kPathSeparator, path.rfind(kPathSeparator) - 1) + 1);
+
+    // The store records its layout:
+    string layoutPath = storeDir + "layout";
+    int version = 0;
+    ifstream(layoutPath) >> version;
+    CHECK(version == 2);
+
+    // A store with a newer layout is refused:
+    ofstream(layoutPath, ios::trunc) << "3\n";
+    reopenDB();
+    {
+        ExpectingExceptions x;
+        C4Error error;
+        CHECK(c4db_getBlobStore(db, &error) == nullptr);
+        CHECK(error == C4Error{LiteCoreDomain, kC4ErrorDatabaseTooNew});
+    }
+    ofstream(layoutPath, ios::trunc) << "2\n";
+}
@@ -19,6 +19,7 @@
 #include "c4Collection.hh"
 #include "c4Database.hh"
 #include "c4Test.hh"
+#include "Benchmark.hh"
 
 using namespace std;
 
@@ -32,6 +33,29 @@ public:
 
     C4CollectionTest(int testOption) :C4Test(testOption) { }
 
+    // Makes put requests for `n` new docs. `docIDs` and `history` must outlive the requests.
+    vector<C4DocPutRequest> numberedDocRequests(unsigned n, vector<string> &docIDs,
+                                                C4String history[1])
+    {
+        history[0] = kRev1ID;
+        docIDs.resize(n);
+        vector<C4DocPutRequest> rqs(n);
+        for (unsigned i = 0; i < n; i++) {
+            char docID[20];
+            sprintf(docID, "doc-%03u", i + 1);
+            docIDs[i] = docID;
+            C4DocPutRequest &rq = rqs[i];
+            rq = {};
+            rq.existingRevision = true;
+            rq.docID = slice(docIDs[i]);
+            rq.history = history;
+            rq.historyCount = 1;
+            rq.body = kFleeceBody;
+            rq.save = true;
+        }
+        return rqs;
+    }
+
     void addNumberedDocs(C4Collection *coll, unsigned n, unsigned start = 1) {
         for (unsigned i = 0; i < n; i++) {
             char docID[20];
@@ -148,3 +172,77 @@ N_WAY_TEST_CASE_METHOD(C4CollectionTest, "Collection Create Docs", "[Database][C
     CHECK(dflt->getDocumentCount() == 0);
     CHECK(dflt->getLastSequence() == 0);
 }
+
+
+N_WAY_TEST_CASE_METHOD(C4CollectionTest, "Collection Put Documents", "[Database][Collection][C]") {
+    C4Collection* dflt = db->getDefaultCollection();
+    {
+        C4Database::Transaction t(db);
+        addNumberedDocs(dflt, 1, 5);
+        t.commit();
+    }
+
+    vector<string> docIDs;
+    C4String history[1];
+    auto rqs = numberedDocRequests(10, docIDs, history);
+    rqs.push_back(rqs[2]);                  // the same doc twice in one batch
+    vector<C4Error> errors;
+    {
+        C4Database::Transaction t(db);
+        auto docs = dflt->putDocuments(rqs, errors);
+        t.commit();
+        REQUIRE(docs.size() == rqs.size());
+        REQUIRE(errors.size() == rqs.size());
+        for (size_t i = 0; i < docs.size(); i++) {
+            INFO("Request #" << i);
+            REQUIRE(docs[i]);
+            CHECK(errors[i].code == 0);
+            CHECK(docs[i]->docID() == rqs[i].docID);
+            CHECK(docs[i]->sequence() > 0);
+        }
+        CHECK(docs[4]->sequence() == 1);    // doc-005 already existed
+    }
+    CHECK(dflt->getDocumentCount() == 10);
+    CHECK(dflt->getLastSequence() == 10);
+    for (auto &docID : docIDs) {
+        auto doc = dflt->getDocument(docID, true, kDocGetAll);
+        REQUIRE(doc);
+        CHECK(doc->revID() == kRev1ID);
+    }
+}
+
+
+N_WAY_TEST_CASE_METHOD(C4CollectionTest, "Collection Put Documents Benchmark", "[Perf][.slow]") {
+    static constexpr unsigned kNumDocs = 100000;
+    C4Collection* single = db->createCollection("single");
+    C4Collection* batched = db->createCollection("batched");
+    vector<string> docIDs;
+    C4String history[1];
+    auto rqs = numberedDocRequests(kNumDocs, docIDs, history);
+
+    Stopwatch st;
+    {
+        C4Database::Transaction t(db);
+        for (auto &rq : rqs)
+            REQUIRE(single->putDocument(rq, nullptr, ERROR_INFO()));
+        t.commit();
+    }
+    st.stop();
+    st.printReport("putDocument", kNumDocs, "doc");
+
+    Stopwatch stBatch;
+    {
+        C4Database::Transaction t(db);
+        vector<C4Error> errors;
+        auto docs = batched->putDocuments(rqs, errors);
+        t.commit();
+        for (auto &error : errors)
+            REQUIRE(error.code == 0);
+    }
+    stBatch.stop();
+    stBatch.printReport("putDocuments", kNumDocs, "doc");
+
+    CHECK(single->getDocumentCount() == kNumDocs);
+    CHECK(batched->getDocumentCount() == kNumDocs);
+    CHECK(batched->getLastSequence() == kNumDocs);
+}
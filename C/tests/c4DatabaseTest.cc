@@ -299,6 +299,92 @@ N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Enumerator", "[Database][Docume
 }
 
 
+N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Enumerator Key Range", "[Database][Enumerator][C]") {
+    setupAllDocs();
+    auto enumerate = [&](C4EnumeratorOptions &options) {
+        vector<string> docIDs;
+        C4Error error;
+        C4DocEnumerator *e = REQUIRED(c4db_enumerateAllDocs(db, &options, WITH_ERROR()));
+        while (c4enum_next(e, &error)) {
+            C4DocumentInfo info;
+            REQUIRE(c4enum_getDocumentInfo(e, &info));
+            docIDs.push_back(slice(info.docID).asString());
+        }
+        c4enum_free(e);
+        CHECK(error == C4Error{});
+        return docIDs;
+    };
+
+    C4EnumeratorOptions options = kC4DefaultEnumeratorOptions;
+    options.startKey = "doc-010"_sl;
+    options.endKey = "doc-012"_sl;
+    CHECK(enumerate(options) == (vector<string>{"doc-010", "doc-011", "doc-012"}));
+
+    options.startKey = "doc-0975"_sl;           // (not an existing docID)
+    options.endKey = nullslice;
+    CHECK(enumerate(options) == (vector<string>{"doc-098", "doc-099"}));
+
+    options.flags |= kC4Descending;
+    options.startKey = "doc-003"_sl;
+    CHECK(enumerate(options) == (vector<string>{"doc-003", "doc-002", "doc-001"}));
+
+    options.startKey = nullslice;
+    options.endKey = "doc-098"_sl;
+    CHECK(enumerate(options) == (vector<string>{"doc-099", "doc-098"}));
+
+    options.flags |= kC4ExclusiveEndKey;
+    CHECK(enumerate(options) == (vector<string>{"doc-099"}));
+
+    options = kC4DefaultEnumeratorOptions;
+    options.flags |= kC4ExclusiveStartKey | kC4ExclusiveEndKey;
+    options.startKey = "doc-010"_sl;
+    options.endKey = "doc-013"_sl;
+    CHECK(enumerate(options) == (vector<string>{"doc-011", "doc-012"}));
+
+    options = kC4DefaultEnumeratorOptions;
+    options.limit = 2;
+    options.maxSequence = 50;
+    options.flags |= kC4Descending;
+    CHECK(enumerate(options) == (vector<string>{"doc-050", "doc-049"}));
+}
+
+
+N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Enumerator Paging", "[Database][Enumerator][C]") {
+    setupAllDocs();
+    C4EnumeratorOptions options = kC4DefaultEnumeratorOptions;
+    options.limit = 10;
+    vector<string> docIDs;
+    unsigned pages = 0;
+    for (size_t lastCount = SIZE_MAX; docIDs.size() != lastCount; ++pages) {
+        lastCount = docIDs.size();
+        C4Error error;
+        C4DocEnumerator *e = REQUIRED(c4db_enumerateAllDocs(db, &options, WITH_ERROR()));
+        unsigned n = 0;
+        while (c4enum_next(e, &error)) {
+            C4DocumentInfo info;
+            REQUIRE(c4enum_getDocumentInfo(e, &info));
+            docIDs.push_back(slice(info.docID).asString());
+            ++n;
+        }
+        c4enum_free(e);
+        CHECK(error == C4Error{});
+        CHECK(n <= 10);
+        // Start the next page after the last docID:
+        if (!docIDs.empty()) {
+            options.startKey = slice(docIDs.back());
+            options.flags |= kC4ExclusiveStartKey;
+        }
+    }
+    CHECK(pages == 11);
+    REQUIRE(docIDs.size() == 99);
+    for (unsigned i = 0; i < docIDs.size(); ++i) {
+        char docID[20];
+        sprintf(docID, "doc-%03u", i + 1);
+        CHECK(docIDs[i] == docID);
+    }
+}
+
+
 N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Enumerator With Info", "[Database][Enumerator][C]") {
     setupAllDocs();
     C4Error error;
@@ -665,6 +751,106 @@ N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Compact", "[Database][C][Blob]"
 }
 
 
+N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Incremental Blob GC", "[Database][C][Blob]")
+{
+    C4BlobStore* store = c4db_getBlobStore(db, ERROR_INFO());
+    REQUIRE(store);
+    vector<string> atts {"This is the first attachment"};
+    C4BlobKey key1, key2, key3;
+    {
+        TransactionHelper t(db);
+        key1 = addDocWithAttachments("doc001"_sl, atts, "text/plain")[0];
+        atts = {"This is the second attachment"};
+        key2 = addDocWithAttachments("doc002"_sl, atts, "text/plain")[0];
+        addDocWithAttachments("doc003"_sl, atts, "text/plain");
+        atts = {"This is the third attachment"};
+        key3 = addDocWithAttachments("doc004"_sl, atts, "text/plain")[0];
+    }
+
+    // Unreferenced blobs are deleted in the background, without compacting:
+    createRev("doc001"_sl, kRev2ID, kC4SliceNull, kRevDeleted);
+    REQUIRE(c4db_purgeDoc(db, "doc002"_sl, WITH_ERROR()));
+    REQUIRE(c4db_collectBlobsNow(db, WITH_ERROR()));
+    CHECK(c4blob_getSize(store, key1) == -1);
+    CHECK(c4blob_getSize(store, key2) > 0);             // still used by doc003
+    CHECK(c4blob_getSize(store, key3) > 0);
+
+    // The index survives reopening the database:
+    reopenDB();
+    store = c4db_getBlobStore(db, ERROR_INFO());
+    REQUIRE(c4db_purgeDoc(db, "doc003"_sl, WITH_ERROR()));
+    REQUIRE(c4db_collectBlobsNow(db, WITH_ERROR()));
+    CHECK(c4blob_getSize(store, key2) == -1);
+    CHECK(c4blob_getSize(store, key3) > 0);
+
+    // If the index isn't known to be complete, nothing is deleted until a compaction has
+    // rebuilt it by scanning the documents:
+    REQUIRE(c4raw_put(db, "info"_sl, "blobRefsComplete"_sl, kC4SliceNull, kC4SliceNull,
+                      WITH_ERROR()));
+    createRev("doc004"_sl, kRev2ID, kC4SliceNull, kRevDeleted);
+    REQUIRE(c4db_collectBlobsNow(db, WITH_ERROR()));
+    CHECK(c4blob_getSize(store, key3) > 0);
+    REQUIRE(c4db_maintenance(db, kC4Compact, WITH_ERROR()));
+    CHECK(c4blob_getSize(store, key3) == -1);
+
+    // A blob created but never referenced is only deleted by compaction:
+    C4BlobKey key4;
+    REQUIRE(c4blob_create(store, "Unattached"_sl, nullptr, &key4, WITH_ERROR()));
+    atts = {"This is the fifth attachment"};
+    C4BlobKey key5;
+    {
+        TransactionHelper t(db);
+        key5 = addDocWithAttachments("doc005"_sl, atts, "text/plain")[0];
+    }
+    REQUIRE(c4db_purgeDoc(db, "doc005"_sl, WITH_ERROR()));
+    REQUIRE(c4db_collectBlobsNow(db, WITH_ERROR()));
+    CHECK(c4blob_getSize(store, key5) == -1);
+    CHECK(c4blob_getSize(store, key4) > 0);
+    REQUIRE(c4db_maintenance(db, kC4Compact, WITH_ERROR()));
+    CHECK(c4blob_getSize(store, key4) == -1);
+}
+
+
+N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Blob GC Of Rewritten Blob", "[Database][C][Blob]")
+{
+    // A blob that's unreferenced, but written again (as a client or the replicator would before
+    // saving a document that uses it) must not be collected before the document is saved:
+    C4BlobStore* store = c4db_getBlobStore(db, ERROR_INFO());
+    REQUIRE(store);
+    vector<string> atts {"This attachment is reused"};
+    C4BlobKey key;
+    {
+        TransactionHelper t(db);
+        key = addDocWithAttachments("doc001"_sl, atts, "text/plain")[0];
+    }
+
+    C4BlobKey key2;
+    SECTION("Written after the purge") {
+        REQUIRE(c4db_purgeDoc(db, "doc001"_sl, WITH_ERROR()));
+        REQUIRE(c4blob_create(store, slice(atts[0]), nullptr, &key2, WITH_ERROR()));
+    }
+    SECTION("Written before the purge") {
+        REQUIRE(c4blob_create(store, slice(atts[0]), nullptr, &key2, WITH_ERROR()));
+        REQUIRE(c4db_purgeDoc(db, "doc001"_sl, WITH_ERROR()));
+    }
+    CHECK(key2 == key);
+    REQUIRE(c4db_collectBlobsNow(db, WITH_ERROR()));
+    CHECK(c4blob_getSize(store, key) > 0);
+
+    {
+        TransactionHelper t(db);
+        addDocWithAttachments("doc002"_sl, atts, "text/plain");
+    }
+    REQUIRE(c4db_collectBlobsNow(db, WITH_ERROR()));
+    CHECK(c4blob_getSize(store, key) > 0);
+
+    // Once the document that used it is purged, the blob is collected as usual:
+    REQUIRE(c4db_purgeDoc(db, "doc002"_sl, WITH_ERROR()));
+    REQUIRE(c4db_collectBlobsNow(db, WITH_ERROR()));
+    CHECK(c4blob_getSize(store, key) == -1);
+}
+
+
 N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database copy", "[Database][C]") {
     static constexpr slice kNuName = "nudb";
 
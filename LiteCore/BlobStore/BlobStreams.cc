@@ -19,6 +19,7 @@
 
 #include "BlobStreams.hh"
 #include "EncryptedStream.hh"
+#include "PipelinedWriteStream.hh"
 #include "Error.hh"
 #include "Logging.hh"
 
@@ -56,12 +57,19 @@ namespace litecore {
         FILE *file;
         _tmpPath = FilePath(blobsDir, "incoming_").mkTempFile(&file);
         _writer = shared_ptr<WriteStream> {new FileWriteStream(file)};
-        if (algorithm != EncryptionAlgorithm::kNoEncryption)
-            _writer = make_shared<EncryptedWriteStream>(_writer, algorithm, encryptionKey);
+        if (algorithm != EncryptionAlgorithm::kNoEncryption) {
+            // Encrypt on a different thread than the file I/O:
+            _writer = make_shared<EncryptedWriteStream>(make_shared<PipelinedWriteStream>(_writer),
+                                                        algorithm, encryptionKey);
+        }
+        // ...and the SHA-1 digest is computed on the caller's thread, in write():
+        _writer = make_shared<PipelinedWriteStream>(_writer);
     }
 
 
     BlobWriteStream::~BlobWriteStream() {
+        // Stop any pipeline threads and close the file before deleting it:
+        _writer = nullptr;
         if (!_installed)
             deleteTempFile();
     }
@@ -33,7 +33,8 @@ namespace litecore {
                                                       EncryptionAlgorithm,
                                                       slice encryptionKey);
 
-    /** A stream for writing a new blob. */
+    /** A stream for writing a new blob. The digest is computed on the caller's thread, while
+        (once the blob gets large) encryption and file I/O run on background threads. */
     class BlobWriteStream final : public WriteStream {
     public:
         BlobWriteStream(const std::string &blobStoreDirectory,
@@ -73,7 +73,7 @@ namespace litecore {
 
             bool commit;
             try {
-                commit = task(keyStore, &sequenceTracker);
+                commit = task(keyStore, &sequenceTracker, t);
             } catch (const exception &) {
                 t.abort();
                 sequenceTracker.endTransaction(false);
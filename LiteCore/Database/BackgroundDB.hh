@@ -26,7 +26,8 @@ namespace litecore {
 
         access_lock<DataFile*>& dataFile()              {return _dataFile;}
 
-        using TransactionTask = function_ref<bool(KeyStore&, SequenceTracker*)>;
+        using TransactionTask = function_ref<bool(KeyStore&, SequenceTracker*,
+                                                   ExclusiveTransaction&)>;
 
         void useInTransaction(slice keyStoreName, TransactionTask task);
 
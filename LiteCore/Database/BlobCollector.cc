@@ -0,0 +1,98 @@
+//
+// BlobCollector.cc
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#include "BlobCollector.hh"
+#include "BlobReferences.hh"
+#include "BackgroundDB.hh"
+#include "DatabaseImpl.hh"
+#include "DataFile.hh"
+#include "c4BlobStore.hh"
+#include "Logging.hh"
+
+namespace litecore {
+    using namespace actor;
+    using namespace std;
+
+    // How long to wait after blobs become unreferenced before collecting them:
+    static constexpr auto kCollectionDelay = chrono::seconds(2);
+
+    // Max number of blobs to delete in one transaction:
+    static constexpr unsigned kBatchSize = 100;
+
+
+    BlobCollector::BlobCollector(DatabaseImpl *db)
+    :Actor(DBLog, "BlobCollector")
+    ,_bgdb(db->backgroundDatabase())
+    ,_blobStore(&db->getBlobStore())
+    ,_timer([this] {enqueue(FUNCTION_TO_QUEUE(BlobCollector::_collect));})
+    { }
+
+
+    void BlobCollector::start() {
+        enqueue(FUNCTION_TO_QUEUE(BlobCollector::_collect));
+    }
+
+
+    void BlobCollector::stop() {
+        enqueue(FUNCTION_TO_QUEUE(BlobCollector::_stop));
+        waitTillCaughtUp();
+    }
+
+
+    void BlobCollector::_stop() {
+        _timer.stop();
+        _stopped = true;
+        logVerbose("BlobCollector: stopped.");
+    }
+
+
+    void BlobCollector::collectNow() {
+        enqueue(FUNCTION_TO_QUEUE(BlobCollector::_collect));
+        waitTillCaughtUp();
+    }
+
+
+    void BlobCollector::blobsUnreferenced() {
+        // This doesn't have to be enqueued, since Timer is thread-safe.
+        _timer.fireEarlierAfter(kCollectionDelay);
+    }
+
+
+    void BlobCollector::_collect() {
+        unsigned numDeleted = 0;
+        bool more;
+        do {
+            if (_stopped)
+                return;
+            // Each batch is a separate transaction, so the database isn't locked for long.
+            // Deleting inside the transaction keeps other connections from re-referencing a
+            // blob between the check and the deletion. A blob that's been written but not yet
+            // used by a saved document isn't deleted, since a document that hasn't been saved
+            // yet may be about to use it; if not, compaction will delete it.
+            more = _bgdb->dataFile().useLocked<bool>([&](DataFile *df) {
+                if (!df)
+                    return false;
+                BlobReferences refs(*df);
+                if (!refs.isComplete())
+                    return false;
+                ExclusiveTransaction t(df);
+                auto candidates = refs.unreferencedBlobs(kBatchSize);
+                for (auto &blob : candidates) {
+                    if (!refs.isReferenced(blob.key)
+                            && _blobStore->deleteBlobUnlessPending(blob.key))
+                        ++numDeleted;
+                    refs.forgetUnreferenced(blob.key, t);
+                }
+                t.commit();
+                return candidates.size() == kBatchSize;
+            });
+        } while (more);
+
+        if (numDeleted > 0)
+            logInfo("BlobCollector: deleted %u unreferenced blobs", numDeleted);
+    }
+
+}
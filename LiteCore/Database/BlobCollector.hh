@@ -0,0 +1,50 @@
+//
+// BlobCollector.hh
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+
+#pragma once
+#include "Base.hh"
+#include "Actor.hh"
+#include "Timer.hh"
+
+struct C4BlobStore;
+
+namespace litecore {
+    class BackgroundDB;
+    class DatabaseImpl;
+
+
+    /** Deletes blobs whose reference counts (see \ref BlobReferences) have dropped to zero,
+        a batch at a time, on a background thread. It does nothing until the blob index is
+        complete; until then only compaction can delete blobs. */
+    class BlobCollector : public actor::Actor {
+    public:
+        explicit BlobCollector(DatabaseImpl* NONNULL);
+
+        /// Asynchronously starts the task, collecting any blobs left unreferenced earlier.
+        void start();
+
+        /// Synchronously stops the task. After this returns it will do nothing.
+        void stop();
+
+        /// Informs the collector that blobs have become unreferenced. It'll collect them after a
+        /// short delay, so that a burst of changes is handled in one pass.
+        void blobsUnreferenced();
+
+        /// Synchronously collects any unreferenced blobs, without waiting for the timer.
+        /// For testing.
+        void collectNow();
+
+    private:
+        void _stop();
+        void _collect();
+
+        BackgroundDB* _bgdb;
+        C4BlobStore*  _blobStore;
+        actor::Timer  _timer;
+        bool          _stopped {false};
+    };
+
+}
@@ -0,0 +1,322 @@
+//
+// BlobReferences.cc
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "BlobReferences.hh"
+#include "c4BlobStore.hh"
+#include "c4Document.hh"
+#include "DataFile.hh"
+#include "KeyStore.hh"
+#include "Record.hh"
+#include "RecordEnumerator.hh"
+#include "Logging.hh"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace litecore {
+    using namespace std;
+    using namespace fleece;
+
+
+    const char* const BlobReferences::kDocsStoreName         = "blobdocs";
+    const char* const BlobReferences::kRefsStoreName         = "blobrefs";
+    const char* const BlobReferences::kUnreferencedStoreName = "blobgc";
+
+    // Key in the info KeyStore whose presence marks the index as complete.
+    // (SQLiteDataFile deletes this when it upgrades an older database's schema.)
+    static constexpr slice kCompleteInfoKey = "blobRefsComplete";
+
+    static constexpr size_t kDigestSize = sizeof(C4BlobKey::bytes);
+
+
+    // The "blobdocs" key of a document. KeyStore names can't contain ':', so this is unambiguous.
+    static string docKey(slice keyStoreName, slice docID) {
+        string key(keyStoreName);
+        key += ':';
+        key.append((const char*)docID.buf, docID.size);
+        return key;
+    }
+
+
+    // A "blobdocs" body is the document's sorted digests, concatenated.
+    static alloc_slice encodeKeys(const BlobReferences::Keys &keys) {
+        alloc_slice body(keys.size() * kDigestSize);
+        auto dst = (uint8_t*)body.buf;
+        for (auto &key : keys) {
+            memcpy(dst, key.bytes, kDigestSize);
+            dst += kDigestSize;
+        }
+        return body;
+    }
+
+
+    static BlobReferences::Keys decodeKeys(slice body) {
+        BlobReferences::Keys keys(body.size / kDigestSize);
+        auto src = (const uint8_t*)body.buf;
+        for (auto &key : keys) {
+            memcpy(key.bytes, src, kDigestSize);
+            src += kDigestSize;
+        }
+        return keys;
+    }
+
+
+    static bool keyLess(const C4BlobKey &a, const C4BlobKey &b) {
+        return memcmp(a.bytes, b.bytes, kDigestSize) < 0;
+    }
+
+
+    BlobReferences::BlobReferences(DataFile &dataFile)
+    :_dataFile(dataFile)
+    { }
+
+
+    bool BlobReferences::exists(const char *name) const {
+        return _dataFile.keyStoreExists(name);
+    }
+
+
+    KeyStore& BlobReferences::store(const char *name) const {
+        return _dataFile.getKeyStore(name, KeyStore::noSequences);
+    }
+
+
+    BlobReferences::Keys BlobReferences::blobsInDocument(C4Document *doc) {
+        Keys blobs;
+        auto callback = [&](FLDict blob) {
+            if (auto key = C4Blob::keyFromDigestProperty(blob); key)
+                blobs.push_back(*key);
+            return true;
+        };
+
+        alloc_slice selectedRevID = doc->selectedRev().revID;
+        // As in a full GC scan, only documents with a revision flagged as having attachments
+        // are searched, but then every revision body is:
+        bool hasAttachments = false;
+        doc->selectCurrentRevision();
+        do {
+            hasAttachments = (doc->selectedRev().flags & kRevHasAttachments) != 0;
+        } while (!hasAttachments && doc->selectNextRevision());
+
+        if (hasAttachments) {
+            doc->selectCurrentRevision();
+            do {
+                if (doc->loadRevisionBody()) {
+                    FLDict body = doc->getProperties();
+                    C4Blob::findBlobReferences(body, callback);
+                    C4Blob::findAttachmentReferences(body, callback);
+                }
+            } while (doc->selectNextRevision());
+        }
+        if (selectedRevID)
+            doc->selectRevision(selectedRevID);
+        return blobs;
+    }
+
+
+#pragma mark - UPDATING:
+
+
+    bool BlobReferences::isComplete() const {
+        KeyStore &info = _dataFile.getKeyStore(DataFile::kInfoKeyStoreName, KeyStore::noSequences);
+        return info.get(kCompleteInfoKey).exists();
+    }
+
+
+    void BlobReferences::setComplete(bool complete, ExclusiveTransaction &t) {
+        KeyStore &info = _dataFile.getKeyStore(DataFile::kInfoKeyStoreName, KeyStore::noSequences);
+        if (complete)
+            info.setKV(kCompleteInfoKey, "1"_sl, t);
+        else
+            info.del(kCompleteInfoKey, t);
+    }
+
+
+    bool BlobReferences::mayHaveDocuments() const {
+        if (!_hasDocsStore)
+            _hasDocsStore = exists(kDocsStoreName);
+        return _hasDocsStore;
+    }
+
+
+    void BlobReferences::setDocumentBlobs(slice keyStoreName, slice docID, Keys blobs,
+                                          ExclusiveTransaction &t)
+    {
+        sort(blobs.begin(), blobs.end(), keyLess);
+        blobs.erase(unique(blobs.begin(), blobs.end()), blobs.end());
+        _newlyReferenced.insert(_newlyReferenced.end(), blobs.begin(), blobs.end());
+
+        string key = docKey(keyStoreName, docID);
+        Keys oldBlobs;
+        if (mayHaveDocuments())
+            oldBlobs = decodeKeys(store(kDocsStoreName).get(key).body());
+        if (blobs == oldBlobs)
+            return;     // (this avoids creating the KeyStores until a blob is referenced)
+
+        // Both vectors are sorted, so walk them together to find the differences:
+        auto oldI = oldBlobs.begin(), newI = blobs.begin();
+        while (oldI != oldBlobs.end() || newI != blobs.end()) {
+            if (newI == blobs.end() || (oldI != oldBlobs.end() && keyLess(*oldI, *newI))) {
+                addReference(*oldI++, -1, t);
+            } else if (oldI == oldBlobs.end() || keyLess(*newI, *oldI)) {
+                addReference(*newI++, +1, t);
+            } else {
+                ++oldI; ++newI;
+            }
+        }
+
+        KeyStore &docs = store(kDocsStoreName);
+        _hasDocsStore = true;
+        if (blobs.empty())
+            docs.del(key, t);
+        else
+            docs.setKV(key, encodeKeys(blobs), t);
+    }
+
+
+    void BlobReferences::addReference(const C4BlobKey &blob, int delta, ExclusiveTransaction &t) {
+        KeyStore &refs = store(kRefsStoreName);
+        string digest = blob.digestString();
+        int64_t count = 0;
+        if (Record rec = refs.get(digest); rec.exists())
+            count = stoll(string(rec.body()));
+        count += delta;
+        if (count > 0) {
+            refs.setKV(digest, to_string(count), t);
+        } else {
+            // Nothing references this blob any more, so it's a candidate for deletion:
+            refs.del(digest, t);
+            store(kUnreferencedStoreName).setKV(digest, to_string(c4_now()), t);
+            _newlyUnreferenced = true;
+        }
+    }
+
+
+    void BlobReferences::moveDocument(slice fromStore, slice fromDocID,
+                                      slice toStore, slice toDocID,
+                                      ExclusiveTransaction &t)
+    {
+        if (!mayHaveDocuments())
+            return;
+        Record rec = store(kDocsStoreName).get(docKey(fromStore, fromDocID));
+        if (!rec.exists())
+            return;
+        // Add the new references before removing the old ones, so counts don't hit zero:
+        setDocumentBlobs(toStore, toDocID, decodeKeys(rec.body()), t);
+        removeDocument(fromStore, fromDocID, t);
+    }
+
+
+    void BlobReferences::removeKeyStore(slice keyStoreName, ExclusiveTransaction &t) {
+        if (!mayHaveDocuments())
+            return;
+        string prefix = docKey(keyStoreName, nullslice);
+        string endKey = prefix;
+        endKey.back() = ':' + 1;
+
+        vector<alloc_slice> docIDs;
+        RecordEnumerator::Options options;
+        options.contentOption = kMetaOnly;
+        options.startKey = slice(prefix);
+        options.endKey = slice(endKey);
+        RecordEnumerator e(store(kDocsStoreName), options);
+        while (e.next()) {
+            slice docID = e->key();
+            if (docID.hasPrefix(slice(prefix))) {
+                docID.moveStart(prefix.size());
+                docIDs.emplace_back(docID);
+            }
+        }
+        for (auto &docID : docIDs)
+            removeDocument(keyStoreName, docID, t);
+    }
+
+
+    void BlobReferences::rebuild(function_ref<void(const DocumentBlobsCallback&)> scan,
+                                 ExclusiveTransaction &t)
+    {
+        for (auto name : {kDocsStoreName, kRefsStoreName, kUnreferencedStoreName}) {
+            if (exists(name))
+                store(name).erase();
+        }
+        unsigned numDocs = 0;
+        scan([&](slice keyStoreName, slice docID, Keys blobs) {
+            if (!blobs.empty()) {
+                setDocumentBlobs(keyStoreName, docID, move(blobs), t);
+                ++numDocs;
+            }
+        });
+        setComplete(true, t);
+        LogTo(DBLog, "Indexed the blobs of %u documents", numDocs);
+    }
+
+
+#pragma mark - GARBAGE COLLECTION:
+
+
+    unordered_set<C4BlobKey> BlobReferences::referencedBlobs() const {
+        unordered_set<C4BlobKey> blobs;
+        if (exists(kRefsStoreName)) {
+            RecordEnumerator::Options options;
+            options.contentOption = kMetaOnly;
+            options.sortOption = kUnsorted;
+            RecordEnumerator e(store(kRefsStoreName), options);
+            while (e.next()) {
+                if (auto key = C4BlobKey::withDigestString(e->key()); key)
+                    blobs.insert(*key);
+            }
+        }
+        return blobs;
+    }
+
+
+    bool BlobReferences::isReferenced(const C4BlobKey &blob) const {
+        return exists(kRefsStoreName)
+            && store(kRefsStoreName).get(blob.digestString(), kMetaOnly).exists();
+    }
+
+
+    vector<BlobReferences::Unreferenced> BlobReferences::unreferencedBlobs(unsigned limit) const {
+        vector<Unreferenced> blobs;
+        if (limit > 0 && exists(kUnreferencedStoreName)) {
+            RecordEnumerator::Options options;
+            options.sortOption = kUnsorted;
+            RecordEnumerator e(store(kUnreferencedStoreName), options);
+            while (blobs.size() < limit && e.next()) {
+                if (auto key = C4BlobKey::withDigestString(e->key()); key) {
+                    // (Entries written before the time was recorded have "0")
+                    C4Timestamp since = stoll(string(e->body()));
+                    blobs.push_back({*key, since});
+                }
+            }
+        }
+        return blobs;
+    }
+
+
+    void BlobReferences::forgetUnreferenced(const C4BlobKey &blob, ExclusiveTransaction &t) {
+        store(kUnreferencedStoreName).del(blob.digestString(), t);
+    }
+
+
+    void BlobReferences::forgetAllUnreferenced(ExclusiveTransaction&) {
+        if (exists(kUnreferencedStoreName))
+            store(kUnreferencedStoreName).erase();
+    }
+
+}
@@ -0,0 +1,142 @@
+//
+// BlobReferences.hh
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "c4BlobStoreTypes.h"
+#include "function_ref.hh"
+#include "fleece/slice.hh"
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+struct C4Document;
+
+namespace litecore {
+    class DataFile;
+    class ExclusiveTransaction;
+    class KeyStore;
+
+
+    /** A persistent index of the blobs referenced by documents, kept in the database file and
+        updated as documents are saved and purged, so that blob garbage collection doesn't have to
+        read every document.
+
+        It uses three KeyStores: "blobdocs" maps each document that references blobs (keyed by
+        its KeyStore name and docID) to the digests it references; "blobrefs" maps each digest
+        to the number of documents referencing it; and "blobgc" holds the digests whose count
+        has dropped to zero, which are candidates for deletion, with the time that happened.
+
+        Databases created before this index existed don't have a complete index. Until it's been
+        rebuilt by a full scan of the documents (\ref rebuild), the candidates must not be
+        deleted, since documents missing from the index may still use them. Older versions of
+        LiteCore don't update the index, so opening a database to write to it upgrades its
+        schema to lock them out, and discards any index built before then. */
+    class BlobReferences {
+    public:
+        using slice = fleece::slice;
+        using Keys = std::vector<C4BlobKey>;
+
+        explicit BlobReferences(DataFile&);
+
+        /** Returns the blobs referenced by a document's revisions. Leaves the same revision
+            selected as before. */
+        static Keys blobsInDocument(C4Document*);
+
+        /** True if the index is known to cover every document. */
+        bool isComplete() const;
+
+        /** Marks the index as complete (as for a new database), or incomplete (after documents
+            have been changed without updating it.) */
+        void setComplete(bool, ExclusiveTransaction&);
+
+        /** False if no document has ever been indexed, so there's nothing to update unless the
+            document being saved has blobs. */
+        bool mayHaveDocuments() const;
+
+        //---- Updating (all require a transaction):
+
+        /** Records the blobs referenced by a document, replacing any it referenced before.
+            An empty vector removes the document from the index. */
+        void setDocumentBlobs(slice keyStoreName, slice docID, Keys, ExclusiveTransaction&);
+
+        void removeDocument(slice keyStoreName, slice docID, ExclusiveTransaction &t) {
+            setDocumentBlobs(keyStoreName, docID, {}, t);
+        }
+
+        /** Updates the index when a document is moved to another KeyStore and/or docID. */
+        void moveDocument(slice fromStore, slice fromDocID,
+                          slice toStore, slice toDocID,
+                          ExclusiveTransaction&);
+
+        /** Removes all the documents of a KeyStore (collection) being deleted. */
+        void removeKeyStore(slice keyStoreName, ExclusiveTransaction&);
+
+        /** Rebuilds the index from scratch. `scan` is called with a function that it must call
+            for every document that references blobs. Afterwards the index is complete. */
+        using DocumentBlobsCallback = fleece::function_ref<void(slice keyStoreName,
+                                                                slice docID,
+                                                                Keys blobs)>;
+        void rebuild(fleece::function_ref<void(const DocumentBlobsCallback&)> scan,
+                     ExclusiveTransaction&);
+
+        /** True if any blobs have become unreferenced since the last call. */
+        bool takeNewlyUnreferenced()                {bool n = _newlyUnreferenced;
+                                                     _newlyUnreferenced = false; return n;}
+
+        /** The blobs that documents have been saved with since the last call. */
+        Keys takeNewlyReferenced()                  {return std::exchange(_newlyReferenced, {});}
+
+        //---- Garbage collection:
+
+        /** Returns the digests of all blobs referenced by any document. */
+        std::unordered_set<C4BlobKey> referencedBlobs() const;
+
+        /** Returns true if any document references the blob. */
+        bool isReferenced(const C4BlobKey&) const;
+
+        /** A blob whose reference count has dropped to zero, and when that happened. */
+        struct Unreferenced {
+            C4BlobKey   key;
+            C4Timestamp since;
+        };
+
+        /** Returns up to `limit` blobs whose reference counts have dropped to zero. */
+        std::vector<Unreferenced> unreferencedBlobs(unsigned limit) const;
+
+        /** Removes a digest returned by \ref unreferencedBlobs, once it's been deleted. */
+        void forgetUnreferenced(const C4BlobKey&, ExclusiveTransaction&);
+
+        /** Removes all the digests returned by \ref unreferencedBlobs. */
+        void forgetAllUnreferenced(ExclusiveTransaction&);
+
+        static const char* const kDocsStoreName;
+        static const char* const kRefsStoreName;
+        static const char* const kUnreferencedStoreName;
+
+    private:
+        KeyStore& store(const char *name) const;
+        bool exists(const char *name) const;
+        void addReference(const C4BlobKey&, int delta, ExclusiveTransaction&);
+
+        DataFile&    _dataFile;
+        mutable bool _hasDocsStore {false};
+        bool         _newlyUnreferenced {false};
+        Keys         _newlyReferenced;
+    };
+
+}
@@ -29,6 +29,7 @@
 #include "VectorDocument.hh"
 #include "SequenceTracker.hh"
 #include "Housekeeper.hh"
+#include "BlobReferences.hh"
 #include "KeyStore.hh"
 #include "SQLiteDataFile.hh"
 #include "RevTree.hh"
@@ -153,6 +154,32 @@ namespace litecore {
         }
 
 
+        // Calls the callback with the blobs used by every document that has any; used to
+        // rebuild the database's BlobReferences index.
+        void findDocumentBlobs(const BlobReferences::DocumentBlobsCallback &callback) {
+            RecordEnumerator::Options options;
+            options.onlyBlobs = true;
+            options.sortOption = kUnsorted;
+            RecordEnumerator e(keyStore(), options);
+            while (e.next()) {
+                Retained<C4Document> doc = _documentFactory->newDocumentInstance(*e);
+                callback(keyStore().name(), e->key(), BlobReferences::blobsInDocument(doc));
+            }
+        }
+
+
+        // Updates the blob index after a document is saved, or purged (if `doc` is null.)
+        void updateBlobReferences(C4Document *doc, slice docID) {
+            BlobReferences &refs = dbImpl()->blobReferences();
+            BlobReferences::Keys blobs;
+            if (doc)
+                blobs = BlobReferences::blobsInDocument(doc);
+            if (!blobs.empty() || refs.mayHaveDocuments())
+                refs.setDocumentBlobs(keyStore().name(), docID, std::move(blobs),
+                                      dbImpl()->transaction());
+        }
+
+
 #pragma mark - DOCUMENTS:
 
 
@@ -326,6 +353,86 @@ namespace litecore {
         }
 
 
+        std::vector<Retained<C4Document>> putDocuments(const std::vector<C4DocPutRequest> &rqs,
+                                                       std::vector<C4Error> &outErrors) override
+        {
+            dbImpl()->mustBeInTransaction();
+            std::vector<Retained<C4Document>> docs(rqs.size());
+            outErrors.assign(rqs.size(), C4Error{});
+
+            auto putOne = [&](size_t i) {
+                try {
+                    docs[i] = putDocument(rqs[i], nullptr, &outErrors[i]);
+                } catch (...) {
+                    docs[i] = nullptr;
+                    outErrors[i] = C4Error::fromCurrentException();
+                }
+            };
+
+            // New docs are created in memory, then saved together with one KeyStore::setBatch.
+            // This is the batched form of the putNewDoc optimization, so a doc whose record
+            // turns out to exist falls back to the regular path.
+            std::vector<size_t> batch;
+            std::unordered_set<slice> batchDocIDs;
+            auto flush = [&] {
+                if (batch.empty())
+                    return;
+                std::vector<C4Document*> batchDocs;
+                batchDocs.reserve(batch.size());
+                for (size_t i : batch)
+                    batchDocs.push_back(docs[i]);
+                std::vector<bool> saved = _documentFactory->saveBatch(batchDocs);
+                for (size_t j = 0; j < batch.size(); ++j) {
+                    if (!saved[j])
+                        putOne(batch[j]);
+                }
+                batch.clear();
+                batchDocIDs.clear();
+            };
+
+            // A request that can't be batched is saved right away, after the pending batch, so
+            // that sequences are assigned in request order:
+            auto putNow = [&](size_t i) {
+                flush();
+                putOne(i);
+            };
+
+            for (size_t i = 0; i < rqs.size(); ++i) {
+                auto &rq = rqs[i];
+                // A later rev of a doc in the batch has to see the earlier one in the db:
+                if (rq.docID.buf && batchDocIDs.count(rq.docID))
+                    flush();
+                if (!(rq.save && rq.docID.buf && isNewDocPutRequest(rq)
+                            && C4Document::isValidDocID(rq.docID))) {
+                    putNow(i);
+                    continue;
+                }
+
+                C4DocPutRequest unsavedRq = rq;
+                unsavedRq.save = false;
+                Retained<C4Document> doc = _documentFactory->newDocumentInstance(Record(rq.docID));
+                bool ok;
+                try {
+                    if (rq.existingRevision)
+                        ok = doc->putExistingRevision(unsavedRq, nullptr) >= 0;
+                    else
+                        ok = doc->putNewRevision(unsavedRq, nullptr);
+                } catch (...) {
+                    ok = false;
+                }
+                if (ok) {
+                    docs[i] = doc;
+                    batch.push_back(i);
+                    batchDocIDs.insert(rq.docID);
+                } else {
+                    putNow(i);
+                }
+            }
+            flush();
+            return docs;
+        }
+
+
         // Is this a PutRequest that doesn't require a Record to exist already?
         bool isNewDocPutRequest(const C4DocPutRequest &rq) {
             if (rq.deltaCB)
@@ -359,8 +466,11 @@ namespace litecore {
             C4Database::Transaction t(getDatabase());
             if (newDocID)
                 C4Document::requireValidDocID(newDocID);
-            keyStore().moveTo(docID, ((CollectionImpl*)toCollection)->keyStore(),
-                              dbImpl()->transaction(), newDocID);
+            KeyStore &toKeyStore = ((CollectionImpl*)toCollection)->keyStore();
+            keyStore().moveTo(docID, toKeyStore, dbImpl()->transaction(), newDocID);
+            dbImpl()->blobReferences().moveDocument(keyStore().name(), docID,
+                                                    toKeyStore.name(), newDocID ? newDocID : docID,
+                                                    dbImpl()->transaction());
             // DOES NOT NOTIFY SEQUENCE TRACKER! (should it?)
             t.commit();
         }
@@ -380,6 +490,7 @@ namespace litecore {
                                     doc->getRevisionBody().size,
                                     SequenceTracker::RevisionFlags(doc->selectedRev().flags));
             }
+            updateBlobReferences(doc, doc->docID());
         }
 
 
@@ -415,6 +526,7 @@ namespace litecore {
                 return false;
             if (_sequenceTracker)
                 _sequenceTracker->useLocked()->documentPurged(docID);
+            updateBlobReferences(nullptr, docID);
             t.commit();
             return true;
         }
@@ -432,9 +544,12 @@ namespace litecore {
                 auto st = _sequenceTracker->useLocked();
                 count = keyStore().expireRecords([&](slice docID) {
                     st->documentPurged(docID);
+                    updateBlobReferences(nullptr, docID);
                 });
             } else {
-                count = keyStore().expireRecords();
+                count = keyStore().expireRecords([&](slice docID) {
+                    updateBlobReferences(nullptr, docID);
+                });
             }
             t.commit();
             return count;
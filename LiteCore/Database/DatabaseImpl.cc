@@ -27,6 +27,8 @@
 #include "TreeDocument.hh"
 #include "VectorDocument.hh"
 #include "BackgroundDB.hh"
+#include "BlobCollector.hh"
+#include "BlobReferences.hh"
 #include "Housekeeper.hh"
 #include "DataFile.hh"
 #include "SQLiteDataFile.hh"
@@ -134,6 +136,7 @@ namespace litecore {
         options.create = (_config.flags & kC4DB_Create) != 0;
         options.writeable = (_config.flags & kC4DB_ReadOnly) == 0;
         options.upgradeable = (_config.flags & kC4DB_NoUpgrade) == 0;
+        options.deferIndexing = (_config.flags & kC4DB_DeferIndexing) != 0;
         options.useDocumentKeys = true;
         options.encryptionAlgorithm = (EncryptionAlgorithm)_config.encryptionKey.algorithm;
         if (options.encryptionAlgorithm != kNoEncryption) {
@@ -202,10 +205,14 @@ namespace litecore {
         if (versDoc.exists()) {
             // Existing db versioning does not match runtime config!
             upgradeDocumentVersioning(curVersioning, newVersioning, transaction());
+            // The upgrade rewrites documents without updating the blob index:
+            blobReferences().setComplete(false, transaction());
         } else if (_config.flags & kC4DB_Create) {
             // First-time initialization:
             (void)generateUUID(kPublicUUIDKey);
             (void)generateUUID(kPrivateUUIDKey);
+            // There are no documents yet, so the blob index is trivially complete:
+            blobReferences().setComplete(true, transaction());
         } else {
             // Should never occur (existing db must have its versioning marked!)
             error::_throw(error::WrongFormat);
@@ -276,6 +283,8 @@ namespace litecore {
 
         for (auto &entry : _collections)
             asInternal(entry.second.get())->close();
+        if (_blobCollector)
+            _blobCollector->stop();
 
         FLEncoder_Free(_flEncoder);
         // Eagerly close the data file to ensure that no other instances will
@@ -318,7 +327,9 @@ namespace litecore {
     }
 
 
+    // (Thread-safe, since the BlobCollector may be created on a Housekeeper thread.)
     C4BlobStore& DatabaseImpl::getBlobStore() const {
+        LOCK(_lazyMembersMutex);
         if (!_blobStore)
             _blobStore = createBlobStore("Attachments", _config.encryptionKey);
         return *_blobStore;
@@ -355,19 +366,23 @@ namespace litecore {
         mustNotBeInTransaction();
         ExclusiveTransaction t(dataFile());
 
-        unordered_set<C4BlobKey> usedDigests;
-        auto blobCallback = [&](FLDict blob) {
-            if (auto key = C4Blob::keyFromDigestProperty(blob); key)
-            usedDigests.insert(*key);
-            return true;
-        };
-
-        forEachCollection([&](C4Collection *coll) {
-            asInternal(coll)->findBlobReferences(blobCallback);
-        });
+        BlobReferences &refs = blobReferences();
+        if (!refs.isComplete()) {
+            // The blob index doesn't cover every document yet, so build it by reading all of
+            // them. This only has to happen once; afterwards it's updated as docs are saved.
+            refs.rebuild([&](const BlobReferences::DocumentBlobsCallback &callback) {
+                forEachCollection([&](C4Collection *coll) {
+                    asInternal(coll)->findDocumentBlobs(callback);
+                });
+            }, t);
+        }
 
         // Now delete all blobs that don't have one of the referenced keys:
+        unordered_set<C4BlobKey> usedDigests = refs.referencedBlobs();
         auto numDeleted = getBlobStore().deleteAllExcept(usedDigests);
+        refs.forgetAllUnreferenced(t);
+        t.commit();
+        C4BlobStore::blobsReferenced(refs.takeNewlyReferenced());   // (from the rebuild)
         if (numDeleted > 0 || !usedDigests.empty()) {
             LogTo(DBLog, "    ...deleted %u blobs (%zu remaining)",
                   numDeleted, usedDigests.size());
@@ -375,7 +390,44 @@ namespace litecore {
     }
 
 
+    BlobReferences& DatabaseImpl::blobReferences() {
+        if (!_blobReferences)
+            _blobReferences = make_unique<BlobReferences>(*_dataFile);
+        return *_blobReferences;
+    }
+
+
+    void DatabaseImpl::startBlobCollector() {
+        LOCK(_blobCollectorMutex);
+        _startBlobCollector();
+    }
+
+
+    void DatabaseImpl::_startBlobCollector() {
+        if (!_blobCollector && (_config.flags & kC4DB_ReadOnly) == 0) {
+            _blobCollector = new BlobCollector(this);
+            _blobCollector->start();
+        }
+    }
+
+
+    void DatabaseImpl::blobsUnreferenced() {
+        LOCK(_blobCollectorMutex);
+        _startBlobCollector();
+        if (_blobCollector)
+            _blobCollector->blobsUnreferenced();
+    }
+
+
+    void DatabaseImpl::collectBlobsNow() {
+        LOCK(_blobCollectorMutex);
+        if (_blobCollector)
+            _blobCollector->collectNow();
+    }
+
+
     BackgroundDB* DatabaseImpl::backgroundDatabase() {
+        LOCK(_lazyMembersMutex);
         if (!_backgroundDB)
             _backgroundDB.reset(new BackgroundDB(this));
         return _backgroundDB.get();
@@ -393,7 +445,15 @@ namespace litecore {
         }
         for (auto &coll : collections)
             asInternal(coll)->stopHousekeeping();
+        {
+            LOCK(_blobCollectorMutex);
+            if (_blobCollector) {
+                _blobCollector->stop();
+                _blobCollector = nullptr;
+            }
+        }
 
+        LOCK(_lazyMembersMutex);
         if (_backgroundDB)
             _backgroundDB->close();
     }
@@ -407,6 +467,9 @@ namespace litecore {
                 }
             }
         }
+        // Collect any blobs left unreferenced when the database was last open:
+        if (_dataFile->keyStoreExists(BlobReferences::kUnreferencedStoreName))
+            startBlobCollector();
     }
 
 
@@ -597,7 +660,9 @@ namespace litecore {
             asInternal(i->second.get())->close();
             _collections.erase(i);
         }
-        _dataFile->deleteKeyStore(collectionNameToKeyStoreName(name));
+        string keyStoreName = collectionNameToKeyStoreName(name);
+        blobReferences().removeKeyStore(keyStoreName, transaction());
+        _dataFile->deleteKeyStore(keyStoreName);
 
         t.commit();
     }
@@ -662,9 +727,19 @@ namespace litecore {
                     t->abort();
             } catch (...) {
                 _cleanupTransaction(false);
+                if (_blobReferences)
+                    (void)_blobReferences->takeNewlyReferenced();   // (they weren't committed)
                 throw;
             }
             _cleanupTransaction(commit);
+            if (_blobReferences) {
+                // Blobs used by the committed documents are no longer pending:
+                auto referenced = _blobReferences->takeNewlyReferenced();
+                if (commit && !referenced.empty())
+                    C4BlobStore::blobsReferenced(referenced);
+                if (_blobReferences->takeNewlyUnreferenced() && commit)
+                    blobsUnreferenced();
+            }
         }
     }
 
@@ -38,6 +38,8 @@ namespace fleece { namespace impl {
 
 namespace litecore {
     class BackgroundDB;
+    class BlobCollector;
+    class BlobReferences;
     class BlobStore;
     class Housekeeper;
     class RevTreeRecord;
@@ -67,6 +69,15 @@ namespace litecore {
 
         BackgroundDB* backgroundDatabase();
 
+        BlobReferences& blobReferences();
+
+        /// Tells the BlobCollector that blobs have become unreferenced, starting it if necessary.
+        /// Thread-safe, since the Housekeeper calls it after expiring documents.
+        void blobsUnreferenced();
+
+        /// Deletes unreferenced blobs now, instead of after the BlobCollector's delay. For testing.
+        void collectBlobsNow();
+
         fleece::impl::Encoder& sharedEncoder() const;
 
         uint64_t myPeerID() const;
@@ -154,6 +165,8 @@ namespace litecore {
 
         unique_ptr<C4BlobStore> createBlobStore(const std::string &dirname, C4EncryptionKey) const;
         void garbageCollectBlobs();
+        void startBlobCollector();
+        void _startBlobCollector();
 
         C4Collection* getOrCreateCollection(slice name, bool canCreate);
 
@@ -175,6 +188,10 @@ namespace litecore {
         uint32_t                    _maxRevTreeDepth {0};   // Max revision-tree depth
         std::recursive_mutex        _clientMutex;           // Mutex for c4db_lock/unlock
         unique_ptr<BackgroundDB>    _backgroundDB;          // for background operations
+        unique_ptr<BlobReferences>  _blobReferences;        // Index of blobs used by docs
+        Retained<BlobCollector>     _blobCollector;         // Deletes unreferenced blobs
+        std::mutex                  _blobCollectorMutex;    // Guards _blobCollector
+        mutable std::mutex          _lazyMembersMutex;      // Guards _blobStore, _backgroundDB
         mutable uint64_t            _myPeerID {0};          // My identifier in version vectors
     };
 
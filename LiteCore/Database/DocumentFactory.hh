@@ -35,6 +35,12 @@ namespace litecore {
                                                        bool mustHaveBodies,
                                                        C4RemoteID remoteDBID) =0;
 
+        /** Saves several documents, as though by calling `save` on each, but lets the
+            implementation write them to the KeyStore in one batch. The documents must have
+            distinct docIDs. Returns false for each document that couldn't be saved due to a
+            conflict. */
+        virtual std::vector<bool> saveBatch(const std::vector<C4Document*> &docs) =0;
+
     private:
         C4Collection* const _coll;    // Unretained, to avoid ref-cycle
     };
@@ -22,6 +22,7 @@
 #include "DatabaseImpl.hh"
 #include "SequenceTracker.hh"
 #include "BackgroundDB.hh"
+#include "BlobReferences.hh"
 #include "DataFile.hh"
 #include "Logging.hh"
 #include "StringUtil.hh"
@@ -34,7 +35,8 @@ namespace litecore {
     Housekeeper::Housekeeper(C4Collection *coll)
     :Actor(DBLog, format("Housekeeper for %.*s", SPLAT(coll->getName())))
     ,_keyStoreName(asInternal(coll)->keyStore().name())
-    ,_bgdb(asInternal(coll->getDatabase())->backgroundDatabase())
+    ,_db(asInternal(coll->getDatabase()))
+    ,_bgdb(_db->backgroundDatabase())
     ,_expiryTimer(std::bind(&Housekeeper::_doExpiration, this))
     { }
 
@@ -75,17 +77,21 @@ namespace litecore {
 
     void Housekeeper::_doExpiration() {
         logVerbose("Housekeeper: expiring documents...");
+        bool blobsUnreferenced = false;
         _bgdb->useInTransaction(DataFile::kDefaultKeyStoreName,
-                                [&](KeyStore &keyStore, SequenceTracker *sequenceTracker) -> bool {
-            if (sequenceTracker) {
-                keyStore.expireRecords([&](slice docID) {
+                                [&](KeyStore &keyStore, SequenceTracker *sequenceTracker,
+                                    ExclusiveTransaction &t) -> bool {
+            BlobReferences blobRefs(keyStore.dataFile());
+            keyStore.expireRecords([&](slice docID) {
+                if (sequenceTracker)
                     sequenceTracker->documentPurged(docID);
-                });
-            } else {
-                keyStore.expireRecords();
-            }
+                blobRefs.removeDocument(keyStore.name(), docID, t);
+            });
+            blobsUnreferenced = blobRefs.takeNewlyUnreferenced();
             return true;
         });
+        if (blobsUnreferenced)
+            _db->blobsUnreferenced();
 
         _scheduleExpiration();
     }
@@ -14,6 +14,7 @@ struct C4Collection;
 
 namespace litecore {
     class BackgroundDB;
+    class DatabaseImpl;
 
 
     class Housekeeper : public actor::Actor {
@@ -38,6 +39,7 @@ namespace litecore {
         void _doExpiration();
 
         alloc_slice   _keyStoreName;
+        DatabaseImpl* _db;
         BackgroundDB* _bgdb;
         actor::Timer  _expiryTimer;
     };
@@ -103,6 +103,8 @@ namespace litecore {
             _backgroundDB->dataFile().useLocked([&](DataFile *df) {
                 _query = nullptr;
                 _currentEnumerator = nullptr;
+                _matchingDocs.clear();
+                _incremental = false;
                 if (_continuous)
                     _backgroundDB->removeTransactionObserver(this);
             });
@@ -132,6 +134,7 @@ namespace litecore {
         _waitingToRun = false;
         logVerbose("Running query...");
         Retained<QueryEnumerator> newQE;
+        bool unchanged = false;
         C4Error error = {};
         fleece::Stopwatch st;
         _backgroundDB->dataFile().useLocked([&](DataFile *df) {
@@ -153,12 +156,27 @@ namespace litecore {
                     if (_continuous)
                         _backgroundDB->addTransactionObserver(this);
                 }
-                // Now run the query:
+                // Now run the query, unless it's known that the changes since the last run
+                // can't have affected the results. (The read transaction ensures that the query
+                // sees the same snapshot as the incremental check.)
+                ReadOnlyTransaction t(df);
+                if (_incremental && _currentEnumerator && !changesAffectResults(options)) {
+                    unchanged = true;
+                    return;
+                }
                 newQE = _query->createEnumerator(&options);
+                if (_continuous && newQE && !_currentEnumerator)
+                    trackMatchingDocs(options);
             } catchError(&error);
         });
         auto time = st.elapsedMS();
 
+        if (unchanged) {
+            logVerbose("Changes up to seq %" PRIu64 " don't affect results (%.3fms)",
+                       _trackedSequence, time);
+            return; // no delegate call
+        }
+
         if (!newQE)
             logError("Query failed with error %s", error.description().c_str());
 
@@ -182,4 +200,55 @@ namespace litecore {
         _delegate->liveQuerierUpdated(newQE, error);
     }
 
+
+#pragma mark - INCREMENTAL UPDATES:
+
+
+    // Called after the first run of a continuous query. If the query supports it, collects the
+    // IDs of the docs currently matching its WHERE clause, so that later changes can be checked
+    // against them by `changesAffectResults`.
+    void LiveQuerier::trackMatchingDocs(const Query::Options &options) {
+        _matchingDocs.clear();
+        _trackedSequence = _query->lastSequence();
+        _trackedPurgeCount = _query->purgeCount();
+        _incremental = _query->findChangedDocuments(options, 0, true, [&](slice docID, bool) {
+            _matchingDocs.emplace(docID);
+        });
+        if (_incremental)
+            logVerbose("Tracking %zu matching docs", _matchingDocs.size());
+        else
+            _matchingDocs.clear();
+    }
+
+
+    // Checks the docs changed since the last check. Results can only have changed if one of
+    // them matches the WHERE clause now, or did before. Updates `_matchingDocs`.
+    bool LiveQuerier::changesAffectResults(const Query::Options &options) {
+        if (_query->purgeCount() != _trackedPurgeCount) {
+            // Purged docs can't be identified, so start over:
+            trackMatchingDocs(options);
+            return true;
+        }
+        sequence_t curSequence = _query->lastSequence();
+        if (curSequence == _trackedSequence)
+            return false;
+
+        bool affected = false;
+        unsigned nChanges = 0;
+        _query->findChangedDocuments(options, _trackedSequence, false,
+                                     [&](slice docID, bool matches) {
+            ++nChanges;
+            if (matches) {
+                _matchingDocs.emplace(docID);
+                affected = true;
+            } else if (_matchingDocs.erase(string(docID)) > 0) {
+                affected = true;
+            }
+        });
+        logVerbose("%u docs changed after seq %" PRIu64 "; results %s",
+                   nChanges, _trackedSequence, (affected ? "may have changed" : "unchanged"));
+        _trackedSequence = curSequence;
+        return affected;
+    }
+
 }
@@ -14,6 +14,8 @@
 #include <atomic>
 #include <chrono>
 #include <memory>
+#include <string>
+#include <unordered_set>
 
 namespace litecore {
     class DatabaseImpl;
@@ -55,6 +57,8 @@ namespace litecore {
         void _runQuery(Query::Options);
         void _stop();
         void _dbChanged(clock::time_point);
+        bool changesAffectResults(const Query::Options&);
+        void trackMatchingDocs(const Query::Options&);
 
         Retained<DatabaseImpl> _database;               // The database
         BackgroundDB* _backgroundDB;                    // Shadow DB on background thread
@@ -64,6 +68,10 @@ namespace litecore {
         Retained<Query> _query;                         // Compiled query
         Retained<QueryEnumerator> _currentEnumerator;   // Latest query results
         clock::time_point _lastTime;                    // Time the query last ran
+        std::unordered_set<std::string> _matchingDocs;  // IDs of docs matching the WHERE clause
+        sequence_t _trackedSequence {0};                // lastSequence of _matchingDocs
+        uint64_t _trackedPurgeCount {0};                // purgeCount of _matchingDocs
+        bool _incremental {false};                      // Is _matchingDocs being maintained?
         bool _continuous;                               // Do I keep running until stopped?
         bool _waitingToRun {false};                     // Is a call to _runQuery scheduled?
         std::atomic<bool> _stopping {false};            // Has stop() been called?
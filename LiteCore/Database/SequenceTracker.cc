@@ -26,21 +26,28 @@
 
 /* THEORY OF OPERATION:
  
-Placeholders are interspersed with documents (represented by Entry objects) in the _changes list.
+Each known document has an Entry, stored in the `_entries` vector and referred to by index.
+The change log `_log` is a ring buffer of Entry indexes, in the order the documents changed.
+Placeholders are not stored in the log; each CollectionChangeNotifier instead remembers the log
+position of the next change it hasn't read. Drawn as a list, with placeholders where they point:
     Pl1 -> A -> Z -> Pl2 -> B -> F
-if document A is changed, its Entry's sequence is updated and it moves to the end:
-    Pl1 -> Z -> Pl2 -> B -> F -> A
+if document A is changed, its Entry's sequence is updated and it moves to the end; its old log
+slot becomes empty (shown as '_') and is skipped from then on:
+    Pl1 -> _ -> Z -> Pl2 -> B -> F -> A
 DatabaseChangeNotifier's readChanges method moves the placeholder forward, adding any Entrys
 passed over to the resulting changes[] array until it reaches the end or the array is full.
            Z -> Pl2 -> B -> F -> A -> Pl1       (and readChanges results in [Z, B, F, A])
-Any document Entry objects before the first placeholder can now be removed:
+Any log slots before the first placeholder can now be removed:
                 Pl2 -> B -> F -> A -> Pl1
 After a document changes and its Entry moves to the end, if the item(s) _directly_ before the Entry
 are placeholders, their notifiers post notifications.
 Here document F changed, and notifier 1 posts a notification:
-                Pl2 -> B -> A -> Pl1 -> F
+                Pl2 -> B -> _ -> A -> Pl1 -> F
 Then document A changes, but no notifications are sent:
-                Pl2 -> B -> Pl1 -> F -> A
+                Pl2 -> B -> _ -> _ -> Pl1 -> F -> A
+When the ring buffer fills up, it's compacted if at least half its slots are empty, else it grows.
+Compaction renumbers the positions of the log and placeholders, but never the Entry indexes, so
+DocChangeNotifiers can hold onto those.
 
 Transactions:
  On begin:
@@ -69,47 +76,9 @@ namespace litecore {
 
     size_t SequenceTracker::kMinChangesToKeep = 100;
 
-    LogDomain ChangesLog("Changes", LogLevel::Warning);
-
-
-    /** Tracks a document's current sequence. */
-    struct SequenceTracker::Entry {
-        alloc_slice const               docID;
-        sequence_t                      sequence {0};
-
-        // Document entry (when docID != nullslice):
-        sequence_t                      committedSequence {0};
-        alloc_slice                     revID;
-        mutable std::vector<DocChangeNotifier*> documentObservers;
-        uint32_t                        bodySize;
-        RevisionFlags                   flags;
-        bool                            idle     :1;
-        bool                            external :1;
-
-        // Placeholder entry (when docID == nullslice):
-        CollectionChangeNotifier* const   databaseObserver {nullptr};
-
-        Entry(const alloc_slice &d, alloc_slice r, sequence_t s, uint32_t bs, RevisionFlags flags)
-        :docID(d), revID(r), sequence(s), bodySize(bs), flags(flags), idle(false), external(false)
-        {
-            DebugAssert(docID != nullslice);
-        }
-
-        explicit Entry(const alloc_slice &d)
-        :Entry(d, nullslice, 0, 0, {})
-        { }
-
-        explicit Entry(CollectionChangeNotifier *o NONNULL)
-        :databaseObserver(o) { }    // placeholder
-
-        bool isPlaceholder() const          {return docID.buf == nullptr;}
-        bool isPurge() const                {return sequence == 0 && !isPlaceholder();}
-        bool isIdle() const                 {return idle && !isPlaceholder();}
-
-        Entry(const Entry&) =delete;
-        Entry& operator=(const Entry&) =delete;
-    };
+    static constexpr size_t kInitialLogCapacity = 64;       // Must be a power of 2
 
+    LogDomain ChangesLog("Changes", LogLevel::Warning);
 
 
     SequenceTracker::SequenceTracker(slice name)
@@ -121,11 +90,15 @@ namespace litecore {
     SequenceTracker::SequenceTracker(SequenceTracker&& other) noexcept 
     :Logging(ChangesLog)
     ,_name(std::move(other._name))
-    ,_changes(std::move(other._changes))
-    ,_idle(std::move(other._idle))
+    ,_entries(std::move(other._entries))
+    ,_freeEntries(std::move(other._freeEntries))
+    ,_log(std::move(other._log))
+    ,_logStart(other._logStart)
+    ,_logEnd(other._logEnd)
+    ,_numLogged(other._numLogged)
+    ,_placeholders(std::move(other._placeholders))
     ,_byDocID(std::move(other._byDocID))
     ,_lastSequence(other._lastSequence)
-    ,_numPlaceholders(other._numPlaceholders)
     ,_numDocObservers(other._numDocObservers)
     ,_transaction(std::move(other._transaction))
     ,_preTransactionLastSequence(other._preTransactionLastSequence)
@@ -152,12 +125,8 @@ namespace litecore {
 
     bool SequenceTracker::changedDuringTransaction() const {
         Assert(inTransaction());
-        if (_lastSequence > _preTransactionLastSequence)
-            return true;
-        for (auto entry = next(_transaction->_placeholder); entry != _changes.end(); ++entry)
-            if (!entry->isPlaceholder())
-                return true;
-        return false;
+        return _lastSequence > _preTransactionLastSequence
+            || hasChangesAfterPlaceholder(_transaction.get());
     }
 
 
@@ -169,9 +138,9 @@ namespace litecore {
             logInfo("commit: sequences #%" PRIu64 " -- #%" PRIu64,
                     _preTransactionLastSequence + 1, _lastSequence);
             // Bump their committedSequences:
-            for (auto entry = next(_transaction->_placeholder); entry != _changes.end(); ++entry) {
-                if (!entry->isPlaceholder()) {
-                    const_cast<Entry&>(*entry).committedSequence = entry->sequence;
+            for (position p = _transaction->_position; p < _logEnd; ++p) {
+                if (EntryIndex i = logSlot(p); i != kNoEntry) {
+                    _entries[i].committedSequence = _entries[i].sequence;
                     housekeeping = true;
                 }
             }
@@ -180,19 +149,18 @@ namespace litecore {
             logInfo("abort: from seq #%" PRIu64 " back to #%" PRIu64, _lastSequence, _preTransactionLastSequence);
             _lastSequence = _preTransactionLastSequence;
 
-            // Revert their committedSequences:
-            const_iterator lastEntry = prev(_changes.end());
-            const_iterator nextEntry = _transaction->_placeholder;
-            const_iterator entry;
-            do {
-                entry = nextEntry;
-                nextEntry = next(entry);
-                if (!entry->isPlaceholder()) {
-                    // moves entry!
-                    _documentChanged(entry->docID, entry->revID,
-                                     entry->committedSequence, entry->bodySize, entry->flags);
-                }
-            } while (entry != lastEntry);
+            // Revert their committedSequences. (Collect the entries first, since reverting
+            // moves them in the log, which may be compacted.)
+            vector<EntryIndex> changed;
+            for (position p = _transaction->_position; p < _logEnd; ++p) {
+                if (EntryIndex i = logSlot(p); i != kNoEntry)
+                    changed.push_back(i);
+            }
+            for (EntryIndex i : changed) {
+                Entry &entry = _entries[i];
+                alloc_slice docID = entry.docID, revID = entry.revID;
+                _documentChanged(docID, revID, entry.committedSequence, entry.bodySize, entry.flags);
+            }
             housekeeping = true;
         }
 
@@ -232,58 +200,60 @@ namespace litecore {
     {
         auto shortBodySize = (uint32_t)min(bodySize, (uint64_t)UINT32_MAX);
         bool listChanged = true;
-        Entry *entry;
+        EntryIndex index;
         auto i = _byDocID.find(docID);
         if (i != _byDocID.end()) {
-            // Move existing entry to the end of the list:
-            entry = &*i->second;
-            if (entry->isIdle() && !hasDBChangeNotifiers()) {
-                listChanged = false;
-            } else {
-                if (entry->isIdle()) {
-                    _changes.splice(_changes.end(), _idle, i->second);
-                    entry->idle = false;
-                } else if (next(i->second) != _changes.end())
-                    _changes.splice(_changes.end(), _changes, i->second);
+            // Move existing entry to the end of the log:
+            index = i->second;
+            Entry &entry = _entries[index];
+            if (entry.isIdle()) {
+                if (hasDBChangeNotifiers())
+                    appendToLog(index);
                 else
-                    listChanged = false;  // it was already at the end
+                    listChanged = false;
+            } else if (afterLastLogged(_logEnd) == entry.logPosition + 1
+                            && !hasPlaceholderAfter(entry.logPosition)) {
+                listChanged = false;  // it was already at the end
+            } else {
+                removeFromLog(entry);
+                appendToLog(index);
             }
-            // Update its revID & sequence:
-            entry->revID = revID;
-            entry->sequence = sequence;
-            entry->bodySize = shortBodySize;
-            entry->flags = flags;
         } else {
             // or create a new entry at the end:
-            _changes.emplace_back(docID, revID, sequence, shortBodySize, flags);
-            iterator change = prev(_changes.end());
-            _byDocID[change->docID] = change;
-            entry = &*change;
+            index = newEntry(docID);
+            appendToLog(index);
         }
 
+        // Update its revID & sequence:
+        Entry &entry = _entries[index];
+        entry.revID = revID;
+        entry.sequence = sequence;
+        entry.bodySize = shortBodySize;
+        entry.flags = flags;
+
         if (!inTransaction()) {
-            entry->committedSequence = sequence;
-            entry->external = true; // it must have come from addExternalTransaction()
+            entry.committedSequence = sequence;
+            entry.external = true; // it must have come from addExternalTransaction()
         }
-
-        // Notify document notifiers:
-        for (auto docNotifier : entry->documentObservers)
-            docNotifier->notify(entry);
-
-        if (listChanged && _numPlaceholders > 0) {
-            // Any placeholders right before this change were up to date, should be notified:
-            bool notified = false;
-            auto ph = next(_changes.rbegin());      // iterating _backwards_, skipping latest
-            while (ph != _changes.rend() && ph->isPlaceholder()) {
-                auto nextph = ph;
-                ++nextph; // precompute next pos, in case 'ph' moves itself during the callback
-                if (ph->databaseObserver) {
-                    ph->databaseObserver->notify();
-                    notified = true;
-                }
-                ph = nextph;
+        position logPosition = entry.logPosition;
+
+        // Notify document notifiers. (Index `_entries` each time, since a callback that adds
+        // a notifier for another document can reallocate it.)
+        for (size_t n = 0; n < _entries[index].documentObservers.size(); ++n)
+            _entries[index].documentObservers[n]->notify(&_entries[index]);
+
+        if (listChanged && !_placeholders.empty()) {
+            // Any placeholders right before this change were up to date, should be notified.
+            // (Collect them first, since a notifier may move itself during the callback.)
+            position upToDate = afterLastLogged(logPosition);
+            vector<CollectionChangeNotifier*> notifiers;
+            for (auto ph = _placeholders.rbegin(); ph != _placeholders.rend(); ++ph) {
+                if ((*ph)->_position >= upToDate)
+                    notifiers.push_back(*ph);
             }
-            if (notified)
+            for (auto notifier : notifiers)
+                notifier->notify();
+            if (!notifiers.empty())
                 removeObsoleteEntries();
         }
     }
@@ -292,96 +262,206 @@ namespace litecore {
     void SequenceTracker::addExternalTransaction(const SequenceTracker &other) {
         Assert(!inTransaction());
         Assert(other.inTransaction());
-        if (!_changes.empty() || _numDocObservers > 0) {
+        if (_numLogged > 0 || !_placeholders.empty() || _numDocObservers > 0) {
             logInfo("addExternalTransaction from %s", other.loggingIdentifier().c_str());
-            auto end = other._changes.end();
-            for (auto e = next(other._transaction->_placeholder); e != end; ++e) {
-                if (!e->isPlaceholder()) {
-                    if (e->sequence != 0) {
-                        Assert(e->sequence > _lastSequence);
-                        _lastSequence = e->sequence;
-                    }
-                    _documentChanged(e->docID, e->revID, e->sequence, e->bodySize, e->flags);
+            for (position p = other._transaction->_position; p < other._logEnd; ++p) {
+                EntryIndex i = other.logSlot(p);
+                if (i == kNoEntry)
+                    continue;
+                const Entry &e = other._entries[i];
+                if (e.sequence != 0) {
+                    Assert(e.sequence > _lastSequence);
+                    _lastSequence = e.sequence;
                 }
+                _documentChanged(e.docID, e.revID, e.sequence, e.bodySize, e.flags);
             }
             removeObsoleteEntries();
         }
     }
 
 
-    SequenceTracker::const_iterator SequenceTracker::begin() const     {return _changes.begin();}
-    SequenceTracker::const_iterator SequenceTracker::end() const       {return _changes.end();}
+#pragma mark - CHANGE LOG:
 
 
-    SequenceTracker::const_iterator
-    SequenceTracker::_since(sequence_t sinceSeq) const {
-        if (sinceSeq >= _lastSequence) {
-            return _changes.cend();
+    // Returns the position just past the last Entry in the log before `end`.
+    // (If there is none, returns the start of the log.)
+    SequenceTracker::position SequenceTracker::afterLastLogged(position end) const {
+        while (end > _logStart && logSlot(end - 1) == kNoEntry)
+            --end;
+        return end;
+    }
+
+
+    bool SequenceTracker::hasPlaceholderAfter(position pos) const {
+        for (auto ph : _placeholders) {
+            if (ph->_position > pos)
+                return true;
+        }
+        return false;
+    }
+
+
+    void SequenceTracker::appendToLog(EntryIndex index) {
+        if (_logEnd - _logStart == _log.size()) {
+            if (_log.size() - _numLogged >= _log.size() / 2 && !_log.empty()) {
+                compactLog();
+            } else {
+                // Grow the ring buffer; positions don't change, only where they're stored:
+                vector<EntryIndex> newLog(max(2 * _log.size(), kInitialLogCapacity));
+                for (position p = _logStart; p < _logEnd; ++p)
+                    newLog[p & (newLog.size() - 1)] = logSlot(p);
+                _log = move(newLog);
+            }
+        }
+        logSlot(_logEnd) = index;
+        _entries[index].logPosition = _logEnd++;
+        ++_numLogged;
+    }
+
+
+    void SequenceTracker::removeFromLog(Entry &entry) {
+        logSlot(entry.logPosition) = kNoEntry;
+        entry.logPosition = kNotInLog;
+        --_numLogged;
+    }
+
+
+    // Squeezes the empty slots out of the log, renumbering the positions of the remaining
+    // Entries and of the placeholders.
+    void SequenceTracker::compactLog() {
+        stable_sort(_placeholders.begin(), _placeholders.end(),
+                    [](CollectionChangeNotifier *a, CollectionChangeNotifier *b) {
+                        return a->_position < b->_position;
+                    });
+        auto ph = _placeholders.begin();
+        position dst = _logStart;
+        for (position src = _logStart; src < _logEnd; ++src) {
+            for (; ph != _placeholders.end() && (*ph)->_position <= src; ++ph)
+                (*ph)->_position = dst;
+            if (EntryIndex i = logSlot(src); i != kNoEntry) {
+                logSlot(dst) = i;
+                _entries[i].logPosition = dst++;
+            }
+        }
+        for (; ph != _placeholders.end(); ++ph)
+            (*ph)->_position = dst;
+        logVerbose("Compacted change log from %" PRIu64 " to %" PRIu64 " entries",
+                   _logEnd - _logStart, dst - _logStart);
+        _logEnd = dst;
+    }
+
+
+    SequenceTracker::EntryIndex SequenceTracker::newEntry(const alloc_slice &docID) {
+        EntryIndex index;
+        if (!_freeEntries.empty()) {
+            index = _freeEntries.back();
+            _freeEntries.pop_back();
         } else {
+            index = EntryIndex(_entries.size());
+            _entries.emplace_back();
+        }
+        Entry &entry = _entries[index];
+        entry.docID = docID;
+        _byDocID[entry.docID] = index;
+        return index;
+    }
+
+
+    void SequenceTracker::freeEntry(EntryIndex index) {
+        Entry &entry = _entries[index];
+        _byDocID.erase(entry.docID);
+        entry = Entry();
+        _freeEntries.push_back(index);
+    }
+
+
+    SequenceTracker::position
+    SequenceTracker::_since(sequence_t sinceSeq) const {
+        position result = _logEnd;
+        if (sinceSeq < _lastSequence) {
             // Scan back till we find a document entry with sequence less than sinceSeq
-            // (but not a purge); then back up one:
-            auto result = _changes.crbegin();
-            for (auto i = _changes.crbegin(); i != _changes.crend(); ++i) {
-                if (i->sequence > sinceSeq || i->isPurge())
-                    result = i;
-                else if (!i->isPlaceholder())
+            // (but not a purge); the result is the entry after it:
+            for (position p = _logEnd; p > _logStart; --p) {
+                EntryIndex i = logSlot(p - 1);
+                if (i == kNoEntry)
+                    continue;
+                auto &entry = _entries[i];
+                if (entry.sequence > sinceSeq || entry.isPurge())
+                    result = p - 1;
+                else
                     break;
             }
-            return prev(result.base());      // (convert `result` to regular fwd iterator)
         }
+        return result;
     }
 
 
     slice SequenceTracker::_docIDAt(sequence_t seq) const {
-        return _since(seq)->docID;
+        position p = _since(seq);
+        return (p < _logEnd) ? _entries[logSlot(p)].docID : nullslice;
     }
 
 
-    SequenceTracker::const_iterator
+#pragma mark - PLACEHOLDERS:
+
+
+    SequenceTracker::position
     SequenceTracker::addPlaceholderAfter(CollectionChangeNotifier *obs, sequence_t seq) {
         Assert(obs);
-        ++_numPlaceholders;
-        return _changes.emplace(_since(seq), obs);
+        _placeholders.push_back(obs);
+        return _since(seq);
     }
 
-    void SequenceTracker::removePlaceholder(const_iterator placeholder) {
-        _changes.erase(placeholder);
-        --_numPlaceholders;
+    void SequenceTracker::removePlaceholder(CollectionChangeNotifier *obs) {
+        auto i = find(_placeholders.begin(), _placeholders.end(), obs);
+        Assert(i != _placeholders.end());
+        _placeholders.erase(i);
         removeObsoleteEntries();
     }
 
 
-    bool SequenceTracker::hasChangesAfterPlaceholder(const_iterator placeholder) const {
-        for (auto i = next(placeholder); i != _changes.end(); ++i) {
-            if (!i->isPlaceholder())
+    bool SequenceTracker::hasChangesAfterPlaceholder(const CollectionChangeNotifier *obs) const {
+        for (position p = obs->_position; p < _logEnd; ++p) {
+            if (logSlot(p) != kNoEntry)
                 return true;
         }
         return false;
     }
 
 
-    size_t SequenceTracker::readChanges(const_iterator placeholder,
+    size_t SequenceTracker::readChanges(CollectionChangeNotifier *obs,
                                         Change changes[], size_t maxChanges,
                                         bool &external)
     {
         external = false;
         size_t n = 0;
-        auto i = next(placeholder);
-        while (i != _changes.end() && n < maxChanges) {
-            if (!i->isPlaceholder()) {
-                // During the loop, collect only changes with the same value for `external`:
-                if (n == 0)
-                    external = i->external;
-                else if (i->external != external)
-                    break;
-                if (changes)
-                    changes[n++] = Change{i->docID, i->revID, i->sequence, i->bodySize, i->flags};
-            }
-            ++i;
+        position p = obs->_position;
+        const EntryIndex *log = _log.data();
+        const size_t mask = _log.size() - 1;
+        for (; p < _logEnd && n < maxChanges; ++p) {
+            EntryIndex i = log[p & mask];
+            if (i == kNoEntry)
+                continue;
+            const Entry &entry = _entries[i];
+            // During the loop, collect only changes with the same value for `external`:
+            if (n == 0)
+                external = entry.external;
+            else if (entry.external != external)
+                break;
+            if (changes)
+                changes[n++] = Change{entry.docID, entry.revID, entry.sequence,
+                                      entry.bodySize, entry.flags};
         }
         if (n > 0) {
-            // Move `placeholder` to just before `i`:
-            _changes.splice(i, _changes, placeholder);
+            // Move the placeholder to position `p`. If it stopped because `changes` filled up,
+            // it goes before any other placeholders there; else after them:
+            obs->_position = p;
+            _placeholders.erase(find(_placeholders.begin(), _placeholders.end(), obs));
+            auto dst = _placeholders.end();
+            if (n == maxChanges)
+                dst = find_if(_placeholders.begin(), _placeholders.end(),
+                              [=](CollectionChangeNotifier *ph) {return ph->_position == p;});
+            _placeholders.insert(dst, obs);
             removeObsoleteEntries();
         }
         return n;
@@ -392,84 +472,99 @@ namespace litecore {
         if (inTransaction())
             return;
         // Any changes before the first placeholder aren't going to be seen, so remove them:
+        position firstPlaceholder = _logEnd;
+        for (auto ph : _placeholders)
+            firstPlaceholder = min(firstPlaceholder, ph->_position);
         size_t nRemoved = 0;
-        while (_changes.size() > kMinChangesToKeep + _numPlaceholders
-                    && !_changes.front().isPlaceholder()) {
-            auto &entry = _changes.front();
-            if (entry.documentObservers.empty()) {
-                // Remove entry entirely if it has no observers
-                _byDocID.erase(entry.docID);
-                _changes.erase(_changes.begin());
-            } else {
-                // Move entry to idle list if it has observers
-                _idle.splice(_idle.end(), _changes, _changes.begin());
-                entry.idle = true;
-            }
+        for (; _logStart < firstPlaceholder; ++_logStart) {
+            EntryIndex i = logSlot(_logStart);
+            if (i == kNoEntry)
+                continue;
+            if (_numLogged <= kMinChangesToKeep)
+                break;
+            Entry &entry = _entries[i];
+            removeFromLog(entry);
+            // Remove entry entirely if it has no observers; else it stays, idle
+            if (entry.documentObservers.empty())
+                freeEntry(i);
             ++nRemoved;
         }
-        logVerbose("Removed %zu old entries (%zu left; idle has %zd, byDocID has %zu)",
-                   nRemoved, _changes.size(), _idle.size(), _byDocID.size());
+        logVerbose("Removed %zu old entries (%zu left; idle has %zu, byDocID has %zu)",
+                   nRemoved, _numLogged, _byDocID.size() - _numLogged, _byDocID.size());
     }
 
 
-    SequenceTracker::const_iterator
+#pragma mark - DOC CHANGE NOTIFIERS:
+
+
+    SequenceTracker::EntryIndex
     SequenceTracker::addDocChangeNotifier(slice docID, DocChangeNotifier* notifier) {
         Assert(docID);
-        iterator entry;
         // Find the entry for the document:
+        EntryIndex index;
         auto i = _byDocID.find(docID);
-        if (i != _byDocID.end()) {
-            entry = i->second;
-        } else {
-            // Document isn't known yet; create an entry and put it in the _idle list
-            entry = _idle.emplace(_idle.end(), alloc_slice(docID));
-            entry->idle = true;
-            _byDocID[entry->docID] = entry;
-        }
-        entry->documentObservers.push_back(notifier);
+        if (i != _byDocID.end())
+            index = i->second;
+        else
+            index = newEntry(alloc_slice(docID));   // Document isn't known yet; add an idle entry
+        _entries[index].documentObservers.push_back(notifier);
         ++_numDocObservers;
-        return entry;
+        return index;
     }
 
 
-    void SequenceTracker::removeDocChangeNotifier(const_iterator entry, DocChangeNotifier* notifier) {
-        auto &observers = entry->documentObservers;
+    void SequenceTracker::removeDocChangeNotifier(EntryIndex index, DocChangeNotifier* notifier) {
+        Entry &entry = _entries[index];
+        auto &observers = entry.documentObservers;
         auto i = find(observers.begin(), observers.end(), notifier);
         Assert(i != observers.end(), "unknown DocChangeNotifier");
         observers.erase(i);
         --_numDocObservers;
-        if (observers.empty() && entry->isIdle()) {
-            _byDocID.erase(entry->docID);
-            Assert(!_idle.empty());
-            _idle.erase(entry);
-        }
+        if (observers.empty() && entry.isIdle())
+            freeEntry(index);
     }
 
 
 #if DEBUG
     string SequenceTracker::dump(bool verbose) const {
+        // Placeholders are listed in log order, and at the same position in the order placed:
+        vector<CollectionChangeNotifier*> placeholders = _placeholders;
+        stable_sort(placeholders.begin(), placeholders.end(),
+                    [](CollectionChangeNotifier *a, CollectionChangeNotifier *b) {
+                        return a->_position < b->_position;
+                    });
+        auto ph = placeholders.begin();
+
         stringstream s;
         s << "[";
         bool first = true;
-        for (auto i = begin(); i != end(); ++i) {
+        auto separate = [&] {
             if (first)
                 first = false;
             else
                 s << ", ";
-            if (!i->isPlaceholder()) {
-                s << (string)i->docID << "@" << i->sequence;
-                if (verbose && i->flags != RevisionFlags::None)
-                    s << '#' << hex << int(i->flags) << dec;
-                if (verbose)
-                    s << '+' << i->bodySize;
-                if (i->external)
-                    s << "'";
-            } else if (_transaction && i == _transaction->_placeholder) {
-                s << "(";
-                first = true;
-            } else {
-                s << "*";
+        };
+        for (position p = _logStart; p <= _logEnd; ++p) {
+            for (; ph != placeholders.end() && (*ph)->_position == p; ++ph) {
+                separate();
+                if (_transaction && *ph == _transaction.get()) {
+                    s << "(";
+                    first = true;
+                } else {
+                    s << "*";
+                }
             }
+            if (p == _logEnd || logSlot(p) == kNoEntry)
+                continue;
+            separate();
+            auto &entry = _entries[logSlot(p)];
+            s << (string)entry.docID << "@" << entry.sequence;
+            if (verbose && entry.flags != RevisionFlags::None)
+                s << '#' << hex << int(entry.flags) << dec;
+            if (verbose)
+                s << '+' << entry.bodySize;
+            if (entry.external)
+                s << "'";
         }
         if (_transaction)
             s << ")";
@@ -491,18 +586,18 @@ namespace litecore {
     }
 
     DocChangeNotifier::~DocChangeNotifier() {
-        tracker._logVerbose("Removing doc change notifier %p from '%.*s'", this, SPLAT(_docEntry->docID));
+        tracker._logVerbose("Removing doc change notifier %p from '%.*s'", this, SPLAT(docID()));
         tracker.removeDocChangeNotifier(_docEntry, this);
     }
 
 
     slice DocChangeNotifier::docID() const {
-        return _docEntry->docID;
+        return tracker._entries[_docEntry].docID;
     }
 
 
     sequence_t DocChangeNotifier::sequence() const {
-        return _docEntry->sequence;
+        return tracker._entries[_docEntry].sequence;
     }
 
 
@@ -519,7 +614,7 @@ namespace litecore {
     :Logging(ChangesLog)
     ,tracker(t)
     ,callback(move(cb))
-    ,_placeholder(tracker.addPlaceholderAfter(this, afterSeq))
+    ,_position(tracker.addPlaceholderAfter(this, afterSeq))
     {
         if (callback)
             logInfo("Created, starting after #%" PRIu64, afterSeq);
@@ -529,7 +624,7 @@ namespace litecore {
     CollectionChangeNotifier::~CollectionChangeNotifier() {
         if (callback)
             logInfo("Deleting");
-        tracker.removePlaceholder(_placeholder);
+        tracker.removePlaceholder(this);
     }
 
 
@@ -544,7 +639,7 @@ namespace litecore {
     size_t CollectionChangeNotifier::readChanges(SequenceTracker::Change changes[],
                                                size_t maxChanges,
                                                bool &external) {
-        size_t n = tracker.readChanges(_placeholder, changes, maxChanges, external);
+        size_t n = tracker.readChanges(this, changes, maxChanges, external);
         logInfo("readChanges(%zu) -> %zu changes", maxChanges, n);
         return n;
     }
@@ -20,9 +20,9 @@
 #include "Base.hh"
 #include "Error.hh"
 #include "Logging.hh"
-#include <list>
 #include <unordered_map>
 #include <functional>
+#include <vector>
 
 namespace litecore {
     class CollectionChangeNotifier;
@@ -97,32 +97,50 @@ namespace litecore {
 #endif
 
     protected:
-        struct Entry;
-        using iterator = std::list<Entry>::iterator;
-        using const_iterator = std::list<Entry>::const_iterator;
+        using EntryIndex = uint32_t;    // Index of an Entry in _entries
+        using position = uint64_t;      // Position in the change log; never reused
+
+        static constexpr EntryIndex kNoEntry  = UINT32_MAX;
+        static constexpr position   kNotInLog = UINT64_MAX;
+
+        /** Tracks a document's current sequence. */
+        struct Entry {
+            alloc_slice                     docID;
+            alloc_slice                     revID;
+            sequence_t                      sequence {0};
+            sequence_t                      committedSequence {0};
+            std::vector<DocChangeNotifier*> documentObservers;
+            position                        logPosition {kNotInLog}; // Where it is in the log
+            uint32_t                        bodySize {0};
+            RevisionFlags                   flags {};
+            bool                            external {false};
+
+            bool isPurge() const                {return sequence == 0;}
+            bool isIdle() const                 {return logPosition == kNotInLog;}
+        };
 
         static size_t kMinChangesToKeep;        // exposed for testing purposes only
 
         bool inTransaction() const              {return _transaction.get() != nullptr;}
 
         bool hasDBChangeNotifiers() const {
-            return _numPlaceholders - (int)inTransaction() > 0;
+            return _placeholders.size() > size_t(inTransaction());
         }
 
-        /** Returns the oldest Entry. */
-        const_iterator begin() const;
+        /** Returns the position of the oldest entry in the change log. */
+        position begin() const                  {return _logStart;}
 
-        /** Returns the end of the Entry list. */
-        const_iterator end() const;
+        /** Returns the position just past the newest entry in the change log. */
+        position end() const                    {return _logEnd;}
 
-        const_iterator addPlaceholderAfter(CollectionChangeNotifier *obs NONNULL, sequence_t);
-        void removePlaceholder(const_iterator);
-        bool hasChangesAfterPlaceholder(const_iterator) const;
-        size_t readChanges(const_iterator placeholder,
+        position addPlaceholderAfter(CollectionChangeNotifier *obs NONNULL, sequence_t);
+        void removePlaceholder(CollectionChangeNotifier* NONNULL);
+        bool hasChangesAfterPlaceholder(const CollectionChangeNotifier* NONNULL) const;
+        size_t readChanges(CollectionChangeNotifier* NONNULL,
                            Change changes[], size_t maxChanges,
                            bool &external);
-        const_iterator addDocChangeNotifier(slice docID, DocChangeNotifier* NONNULL);
-        void removeDocChangeNotifier(const_iterator, DocChangeNotifier* NONNULL);
+        EntryIndex addDocChangeNotifier(slice docID, DocChangeNotifier* NONNULL);
+        void removeDocChangeNotifier(EntryIndex, DocChangeNotifier* NONNULL);
         void removeObsoleteEntries();
 
     private:
@@ -135,18 +153,32 @@ namespace litecore {
                               sequence_t sequence,
                               uint64_t bodySize,
                               RevisionFlags flags);
-        const_iterator _since(sequence_t s) const;
+        position _since(sequence_t s) const;
         slice _docIDAt(sequence_t) const; // for tests only
 
+        EntryIndex& logSlot(position p)             {return _log[p & (_log.size() - 1)];}
+        EntryIndex logSlot(position p) const        {return _log[p & (_log.size() - 1)];}
+        position afterLastLogged(position end) const;
+        bool hasPlaceholderAfter(position) const;
+        void appendToLog(EntryIndex);
+        void removeFromLog(Entry&);
+        void compactLog();
+        EntryIndex newEntry(const alloc_slice &docID);
+        void freeEntry(EntryIndex);
+
         SequenceTracker(const SequenceTracker&) =delete;
         SequenceTracker& operator=(const SequenceTracker&) =delete;
 
         alloc_slice const                       _name;
-        std::list<Entry>                        _changes;
-        std::list<Entry>                        _idle;
-        std::unordered_map<slice, iterator>     _byDocID;
+        std::vector<Entry>                      _entries;       // All Entries, by EntryIndex
+        std::vector<EntryIndex>                 _freeEntries;   // Unused slots in _entries
+        std::vector<EntryIndex>                 _log;           // Ring buffer of changed Entries
+        position                                _logStart {0};  // Position of oldest log slot
+        position                                _logEnd {0};    // Position after newest log slot
+        size_t                                  _numLogged {0}; // Number of Entries in the log
+        std::vector<CollectionChangeNotifier*>  _placeholders;  // In the order they were placed
+        std::unordered_map<slice, EntryIndex>   _byDocID;
         sequence_t                              _lastSequence {0};
-        size_t                                  _numPlaceholders {0};
         size_t                                  _numDocObservers {0};
         unique_ptr<CollectionChangeNotifier>    _transaction;
         sequence_t                              _preTransactionLastSequence;
@@ -175,7 +207,7 @@ namespace litecore {
         DocChangeNotifier& operator=(const DocChangeNotifier&) =delete;
 
         friend class SequenceTracker;
-        SequenceTracker::const_iterator const _docEntry;
+        SequenceTracker::EntryIndex const _docEntry;
     };
 
 
@@ -195,7 +227,7 @@ namespace litecore {
 
         /** Returns true if there are new changes, i.e. if `readChanges` would return nonzero. */
         bool hasChanges() const {
-            return tracker.hasChangesAfterPlaceholder(_placeholder);
+            return tracker.hasChangesAfterPlaceholder(this);
         }
 
         /** Returns changes that have occurred since the last call to `readChanges` (or since
@@ -214,7 +246,7 @@ namespace litecore {
 
         friend class SequenceTracker;
 
-        SequenceTracker::const_iterator const _placeholder;
+        SequenceTracker::position _position;    // Log position of the next change to read
     };
 
 }
@@ -340,16 +340,30 @@ namespace litecore {
         }
 
         bool save(unsigned maxRevTreeDepth =0) override {
+            prepareToSave(maxRevTreeDepth);
+            return savedWithResult(_revTree.save(asInternal(database())->transaction()));
+        }
+
+
+        // Subroutine of save() and TreeDocumentFactory::saveBatch(), before writing the record.
+        void prepareToSave(unsigned maxRevTreeDepth =0) {
             asInternal(database())->mustBeInTransaction();
             requireValidDocID(_docID);
             if (maxRevTreeDepth > 0)
                 _revTree.prune(maxRevTreeDepth);
             else
                 _revTree.prune();
-            switch (_revTree.save(asInternal(database())->transaction())) {
+        }
+
+
+        // Subroutine of save() and TreeDocumentFactory::saveBatch(), after writing the record.
+        bool savedWithResult(RevTreeRecord::SaveResult result) {
+            switch (result) {
                 case litecore::RevTreeRecord::kConflict:
                     return false;
                 case litecore::RevTreeRecord::kNoNewSequence:
+                    // Revision bodies may have been removed, or the record purged:
+                    asInternal(collection())->updateBlobReferences(this, _docID);
                     return true;
                 case litecore::RevTreeRecord::kNewSequence:
                     _selected.flags &= ~kRevNew;
@@ -365,6 +379,10 @@ namespace litecore {
             }
         }
 
+
+        RevTreeRecord& revTree()                    {return _revTree;}
+
+
         int32_t purgeRevision(slice revID) override {
             mustLoadRevisions();
             int32_t total;
@@ -685,6 +703,46 @@ namespace litecore {
         return revID.hasPrefix("1-");
     }
 
+    vector<bool> TreeDocumentFactory::saveBatch(const vector<C4Document*> &docs) {
+        vector<bool> saved(docs.size(), true);
+        if (docs.empty())
+            return saved;
+        ExclusiveTransaction &t = asInternal(collection()->getDatabase())->transaction();
+
+        // Encode the changed records. New revisions get new sequences and existing ones only
+        // bump their subsequence, so they're written as two batches:
+        struct Pending {
+            std::vector<RecordUpdate>   updates;
+            std::vector<size_t>         docIndex;
+        } pending[2];       // [0] keeps sequence, [1] creates sequence
+        for (size_t i = 0; i < docs.size(); ++i) {
+            auto doc = (TreeDocument*)docs[i];
+            doc->prepareToSave();
+            bool createSequence;
+            if (auto rec = doc->revTree().prepareSave(createSequence); rec) {
+                pending[createSequence].updates.push_back(*rec);
+                pending[createSequence].docIndex.push_back(i);
+            } else {
+                // Unchanged, or a deletion; let the regular save path handle it:
+                saved[i] = doc->savedWithResult(doc->revTree().save(t));
+            }
+        }
+
+        KeyStore &store = asInternal(collection())->keyStore();
+        for (int createSequence = 0; createSequence <= 1; ++createSequence) {
+            auto &batch = pending[createSequence];
+            if (batch.updates.empty())
+                continue;
+            vector<sequence_t> seqs = store.setBatch(batch.updates, createSequence, t);
+            for (size_t j = 0; j < seqs.size(); ++j) {
+                auto doc = (TreeDocument*)docs[batch.docIndex[j]];
+                auto result = doc->revTree().finishSave(batch.updates[j], createSequence, seqs[j]);
+                saved[batch.docIndex[j]] = doc->savedWithResult(result);
+            }
+        }
+        return saved;
+    }
+
     C4Document* TreeDocumentFactory::documentContaining(FLValue value) {
         RevTreeRecord *vdoc = RevTreeRecord::containing((const fleece::impl::Value*)value);
         return vdoc ? (TreeDocument*)vdoc->owner : nullptr;
@@ -36,6 +36,8 @@ namespace litecore {
                                                unsigned maxAncestors, bool mustHaveBodies,
                                                C4RemoteID remoteDBID) override;
 
+        std::vector<bool> saveBatch(const std::vector<C4Document*> &docs) override;
+
         static C4Document* documentContaining(FLValue value);
     };
 
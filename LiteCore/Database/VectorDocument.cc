@@ -571,6 +571,7 @@ namespace litecore {
                     return true;
                 case VectorRecord::kNoNewSequence:
                     _updateDocFields();  // flags may have changed
+                    asInternal(collection())->updateBlobReferences(this, _docID);
                     return true;
                 case VectorRecord::kConflict:
                     return false;
@@ -620,6 +621,16 @@ namespace litecore {
     }
 
 
+    vector<bool> VectorDocumentFactory::saveBatch(const vector<C4Document*> &docs) {
+        // Version-vector records aren't batched yet; save them one at a time.
+        vector<bool> saved;
+        saved.reserve(docs.size());
+        for (C4Document *doc : docs)
+            saved.push_back(doc->save());
+        return saved;
+    }
+
+
     vector<alloc_slice> VectorDocumentFactory::findAncestors(const vector<slice> &docIDs,
                                                              const vector<slice> &revIDs,
                                                              unsigned maxAncestors,
@@ -39,6 +39,7 @@ namespace litecore {
             kFullText,      ///< Full-text index, for MATCH queries
             kArray,         ///< Index of array values, for UNNEST queries
             kPredictive,    ///< Index of prediction results
+            kFullText5,     ///< Full-text index using SQLite's FTS5, for MATCH queries
         };
 
         struct Options {
@@ -46,6 +47,8 @@ namespace litecore {
             bool ignoreDiacritics;  ///< True to strip diacritical marks/accents from letters
             bool disableStemming;   ///< Disables stemming
             const char* stopWords;  ///< NULL for default, or comma-delimited string, or empty
+            int automerge;          ///< FTS5 'automerge' setting, 0 for default, <0 to disable
+            int crisismerge;        ///< FTS5 'crisismerge' setting, or 0 for the default
         };
 
         IndexSpec(std::string name_,
@@ -62,10 +65,13 @@ namespace litecore {
         void validateName() const;
 
         const char* typeName() const {
-            static const char* kTypeName[] = {"value", "full-text", "array", "predictive"};
+            static const char* kTypeName[] = {"value", "full-text", "array", "predictive",
+                                              "full-text (FTS5)"};
             return kTypeName[type];
         }
 
+        bool isFullText() const                 {return type == kFullText || type == kFullText5;}
+
         const Options* optionsPtr() const       {return options ? &*options : nullptr;}
 
         /** The required WHAT clause: the list of expressions to index */
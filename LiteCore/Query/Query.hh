@@ -21,6 +21,7 @@
 #include "DataFile.hh"
 #include "Error.hh"
 #include "Logging.hh"
+#include "function_ref.hh"
 #include <atomic>
 #include <vector>
 
@@ -67,18 +68,26 @@ namespace litecore {
 
         virtual void close()                                            {_dataFile = nullptr;}
 
+        /** Makes any streaming enumerators reading inside the DataFile's current transaction
+            read their remaining rows into memory. Called by the DataFile before it commits or
+            aborts the transaction. */
+        virtual void finishStreaming()                                  { }
+
         struct Options {
             Options() =default;
             
             Options(const Options &o)
-            :paramBindings(o.paramBindings), afterSequence(o.afterSequence) { }
+            :paramBindings(o.paramBindings), afterSequence(o.afterSequence)
+            ,purgeCount(o.purgeCount), streaming(o.streaming), cacheResults(o.cacheResults) { }
 
             template <class T>
-            Options(T bindings, sequence_t afterSeq =0, uint64_t withPurgeCount =0)
-            :paramBindings(bindings), afterSequence(afterSeq), purgeCount(withPurgeCount) { }
+            Options(T bindings, sequence_t afterSeq =0, uint64_t withPurgeCount =0,
+                    bool stream =false, bool cache =false)
+            :paramBindings(bindings), afterSequence(afterSeq), purgeCount(withPurgeCount)
+            ,streaming(stream), cacheResults(cache) { }
 
-            Options after(sequence_t afterSeq) const {return Options(paramBindings, afterSeq, purgeCount);}
-            Options withPurgeCount(uint64_t purgeCnt) const {return Options(paramBindings, afterSequence, purgeCnt);}
+            Options after(sequence_t afterSeq) const {return Options(paramBindings, afterSeq, purgeCount, streaming, cacheResults);}
+            Options withPurgeCount(uint64_t purgeCnt) const {return Options(paramBindings, afterSequence, purgeCnt, streaming, cacheResults);}
 
             bool notOlderThan(sequence_t afterSeq, uint64_t purgeCnt) const {
                 return afterSequence > 0 && afterSequence >= afterSeq && purgeCnt == purgeCount;
@@ -87,10 +96,39 @@ namespace litecore {
             alloc_slice const paramBindings;
             sequence_t const  afterSequence {0};
             uint64_t const purgeCount {0};
+            /// If true, rows are read from the database lazily as the enumerator advances,
+            /// instead of all being recorded up front. Such an enumerator doesn't support
+            /// `getRowCount` or `seek`.
+            bool const streaming {false};
+            /// If true, the results are remembered by the Query (keyed by `paramBindings`), and
+            /// a later run with the same bindings reuses them instead of re-running the query,
+            /// as long as none of the KeyStores it reads from have changed. Don't use this with
+            /// queries whose results depend on anything else, like the current time.
+            /// Ignored if `streaming` is set.
+            bool const cacheResults {false};
         };
 
         virtual QueryEnumerator* createEnumerator(const Options* =nullptr) =0;
 
+        /** The total lastSequence / purgeCount of the KeyStores the query reads from. These are
+            only meaningful for before/after comparisons. */
+        virtual sequence_t lastSequence() const =0;
+        virtual uint64_t purgeCount() const =0;
+
+        using ChangedDocCallback = fleece::function_ref<void(slice docID, bool matches)>;
+
+        /** Supports incremental updating of live queries. If this query's results are determined
+            only by the documents of a single collection that match its WHERE clause, calls the
+            callback for each document changed after `afterSequence` (including deletions) with
+            its ID and whether it now matches the WHERE clause, and returns true. If
+            `matchingOnly` is true, documents that don't match aren't reported.
+            If the query doesn't qualify, returns false without calling the callback.
+            Should be called within a ReadOnlyTransaction. */
+        virtual bool findChangedDocuments(const Options&,
+                                          sequence_t afterSequence,
+                                          bool matchingOnly,
+                                          ChangedDocCallback)       {return false;}
+
     protected:
         Query(DataFile&, slice expression, QueryLanguage language);
         virtual ~Query();
@@ -118,10 +156,14 @@ namespace litecore {
         virtual uint64_t missingColumns() const noexcept =0;
         
         /** Random access to rows. May not be supported by all implementations, but does work with
-            the current SQLite query implementation. */
+            the current SQLite query implementation, unless the `streaming` option was set. */
         virtual int64_t getRowCount() const         {return -1;}
         virtual void seek(int64_t rowIndex)         {error::_throw(error::UnsupportedOperation);}
 
+        /** The number of rows a streaming enumerator has read into memory ahead of time, instead
+            of stepping through them as they're requested. (Exposed for testing.) */
+        virtual size_t bufferedRowCount() const                 {return 0;}
+
         virtual bool hasFullText() const                        {return false;}
         virtual const FullTextTerms& fullTextTerms()            {return _fullTextTerms;}
 
@@ -185,6 +185,7 @@ namespace litecore {
         _variables.clear();
         _kvTables.clear();
         _ftsTables.clear();
+        _fts5Tables.clear();
         _indexJoinTables.clear();
         _aliases.clear();
         _dbAlias.clear();
@@ -196,6 +197,18 @@ namespace litecore {
     }
 
 
+    bool QueryParser::isSingleCollectionQuery() const {
+        unsigned nSources = 0;
+        for (auto &alias : _aliases) {
+            if (alias.second.type == kDBAlias)
+                ++nSources;
+            else if (alias.second.type != kResultAlias)
+                return false;
+        }
+        return nSources == 1;
+    }
+
+
     static void handleFleeceException(const FleeceException &x) {
         switch (x.code) {
             case PathSyntaxError:   fail("Invalid property path: %s", x.what());
@@ -321,7 +334,8 @@ namespace litecore {
             // Write columns for the FTS match offsets (in order of appearance of the MATCH expressions)
             for (string &ftsTable : _ftsTables) {
                 const string &alias = _indexJoinTables[ftsTable];
-                extra << ", offsets(" << alias << "." << sqlIdentifier(ftsTable) << ")";
+                extra << (_fts5Tables.count(ftsTable) ? ", fts5_offsets(" : ", offsets(")
+                      << alias << "." << sqlIdentifier(ftsTable) << ")";
             }
             extra << ", ";
             string str = _sql.str();
@@ -590,8 +604,10 @@ namespace litecore {
         for (auto &ftsTable : _indexJoinTables) {
             auto &table = ftsTable.first;
             auto &alias = ftsTable.second;
+            // (FTS5 tables have no 'docid' column; their rowid is the indexed record's.)
+            const char *docIDColumn = _fts5Tables.count(table) ? "rowid" : "docid";
             _sql << " JOIN " << sqlIdentifier(table) << " AS " << alias
-                 << " ON " << alias << ".docid = " << sqlIdentifier(_dbAlias) << ".rowid";
+                 << " ON " << alias << "." << docIDColumn << " = " << sqlIdentifier(_dbAlias) << ".rowid";
         }
     }
 
@@ -1355,7 +1371,13 @@ namespace litecore {
             auto i = _indexJoinTables.find(fts);
             if (i == _indexJoinTables.end())
                 fail("rank() can only be called on FTS indexes");
-            _sql << "rank(matchinfo(" << i->second << "." << sqlIdentifier(i->first) << "))";
+            if (_fts5Tables.count(fts)) {
+                // FTS5 has a built-in BM25 ranking function; it returns lower values for
+                // better matches, where rank() returns higher ones.
+                _sql << "(-bm25(" << i->second << "." << sqlIdentifier(i->first) << "))";
+            } else {
+                _sql << "rank(matchinfo(" << i->second << "." << sqlIdentifier(i->first) << "))";
+            }
             return;
         }
 
@@ -1758,6 +1780,8 @@ namespace litecore {
         if (!canAdd || !alias.empty())
             return alias;
         _ftsTables.push_back(tableName);
+        if (_delegate.isFTS5Table(tableName))
+            _fts5Tables.insert(tableName);
         return indexJoinTableAlias(tableName, "fts");
     }
 
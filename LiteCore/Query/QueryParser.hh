@@ -63,6 +63,7 @@ namespace litecore {
             virtual bool tableExists(const string &tableName) const =0;
             virtual string collectionTableName(const string &collection) const =0;
             virtual string FTSTableName(const string &onTable, const string &property) const =0;
+            virtual bool isFTS5Table(const string &tableName) const          {return false;}
             virtual string unnestedTableName(const string &onTable, const string &property) const =0;
 #ifdef COUCHBASE_ENTERPRISE
             virtual string predictiveTableName(const string &onTable, const string &property) const =0;
@@ -100,6 +101,12 @@ namespace litecore {
         bool isAggregateQuery() const                           {return _isAggregateQuery;}
         bool usesExpiration() const                             {return _checkedExpiration;}
 
+        /** True if the parsed query reads from a single collection, with no joins or UNNESTs. */
+        bool isSingleCollectionQuery() const;
+        /** The alias of the main collection, and whether property paths must start with it. */
+        const string& databaseAlias() const                     {return _dbAlias;}
+        bool propertiesUseSourcePrefix() const                  {return _propertiesUseSourcePrefix;}
+
         string expressionSQL(const Value*);
         string whereClauseSQL(const Value*, string_view dbAlias);
         string eachExpressionSQL(const Value*);
@@ -240,6 +247,7 @@ namespace litecore {
         map<string, string> _indexJoinTables;    // index table name --> alias
         set<string> _kvTables;                   // Collection tables referenced in this query
         vector<string> _ftsTables;               // FTS virtual tables being used
+        set<string> _fts5Tables;                 // Those of _ftsTables that are FTS5
         unsigned _1stCustomResultCol {0};        // Index of 1st result after _baseResultColumns
         bool _aggregatesOK {false};              // Are aggregate fns OK to call?
         bool _isAggregateQuery {false};          // Is this an aggregate query?
@@ -105,7 +105,7 @@ namespace litecore {
         if (auto existingSpec = getIndex(spec.name)) {
             if (existingSpec->type == spec.type && existingSpec->keyStoreName == keyStore->name()) {
                 bool same;
-                if (spec.type == IndexSpec::kFullText)
+                if (spec.isFullText())
                     same = schemaExistsWithSQL(indexTableName, "table", indexTableName, indexSQL);
                 else
                     same = schemaExistsWithSQL(spec.name, "index", indexTableName, indexSQL);
@@ -130,7 +130,7 @@ namespace litecore {
         LogTo(QueryLog, "Deleting %s index '%s'",
               spec.typeName(), spec.name.c_str());
         unregisterIndex(spec.name);
-        if (spec.type != IndexSpec::kFullText)
+        if (!spec.isFullText())
             exec(CONCAT("DROP INDEX IF EXISTS \"" << spec.name << "\""));
         if (!spec.indexTableName.empty())
             garbageCollectIndexTable(spec.indexTableName);
@@ -251,10 +251,11 @@ namespace litecore {
             guaranteed to work in future releases of SQLite. ...
             Imposter tables are for analysis and testing use only." */
 
+        refreshDeferredIndexes();
         auto spec = getIndex(name);
         if (!spec)
             error::_throw(error::NoSuchIndex);
-        else if (spec->type == IndexSpec::kFullText)
+        else if (spec->isFullText())
             error::_throw(error::UnsupportedOperation);
 
         // Construct a list of column names:
@@ -0,0 +1,219 @@
+//
+// SQLiteFTS5Functions.cc
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "SQLite_Internal.hh"
+#include <sqlite3.h>
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <vector>
+
+extern "C" {
+    #include "fts3_tokenizer.h"
+}
+
+using namespace std;
+
+namespace litecore {
+
+    /*  FTS5 has its own tokenizer API, different from FTS3/4's. Rather than porting the
+        'unicodesn' tokenizer, FTS5 indexes use it through an adapter that implements the FTS5 API
+        by calling the FTS3 tokenizer module, so both kinds of index tokenize text (and parse the
+        same tokenizer options) identically. */
+
+
+    // An FTS5 tokenizer instance: an instance of the FTS3 tokenizer it wraps.
+    struct FTS5TokenizerAdapter {
+        const sqlite3_tokenizer_module* module;
+        sqlite3_tokenizer*              tokenizer;
+    };
+
+
+    static int fts5TokenizerCreate(void *context, const char **args, int nArgs,
+                                   Fts5Tokenizer **outTokenizer)
+    {
+        auto module = (const sqlite3_tokenizer_module*)context;
+        sqlite3_tokenizer *tokenizer = nullptr;
+        int rc = module->xCreate(nArgs, args, &tokenizer);
+        if (rc != SQLITE_OK)
+            return rc;
+        tokenizer->pModule = module;        // (FTS3 sets this after calling xCreate)
+        auto adapter = new (nothrow) FTS5TokenizerAdapter{module, tokenizer};
+        if (!adapter) {
+            module->xDestroy(tokenizer);
+            return SQLITE_NOMEM;
+        }
+        *outTokenizer = (Fts5Tokenizer*)adapter;
+        return SQLITE_OK;
+    }
+
+
+    static void fts5TokenizerDelete(Fts5Tokenizer *tokenizer) {
+        auto adapter = (FTS5TokenizerAdapter*)tokenizer;
+        adapter->module->xDestroy(adapter->tokenizer);
+        delete adapter;
+    }
+
+
+    static int fts5TokenizerTokenize(Fts5Tokenizer *tokenizer, void *context, int flags,
+                                     const char *text, int textLen,
+                                     int (*tokenCallback)(void *context, int flags,
+                                                          const char *token, int tokenLen,
+                                                          int start, int end))
+    {
+        auto adapter = (FTS5TokenizerAdapter*)tokenizer;
+        auto module = adapter->module;
+        sqlite3_tokenizer_cursor *cursor;
+        int rc = module->xOpen(adapter->tokenizer, text, textLen, &cursor);
+        if (rc != SQLITE_OK)
+            return rc;
+        cursor->pTokenizer = adapter->tokenizer;
+        const char *token;
+        int tokenLen, start, end, position;
+        while (SQLITE_OK == (rc = module->xNext(cursor, &token, &tokenLen, &start, &end, &position)))
+            if (SQLITE_OK != (rc = tokenCallback(context, 0, token, tokenLen, start, end)))
+                break;
+        module->xClose(cursor);
+        return (rc == SQLITE_DONE) ? SQLITE_OK : rc;
+    }
+
+
+    // Looks up a tokenizer registered with FTS3's `fts3_tokenizer()` function.
+    static const sqlite3_tokenizer_module* findFTS3Tokenizer(sqlite3 *db, const char *name) {
+        const sqlite3_tokenizer_module *module = nullptr;
+        sqlite3_stmt *stmt;
+        if (sqlite3_prepare_v2(db, "SELECT fts3_tokenizer(?)", -1, &stmt, nullptr) != SQLITE_OK)
+            return nullptr;
+        sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_bytes(stmt, 0) == sizeof(module))
+            memcpy(&module, sqlite3_column_blob(stmt, 0), sizeof(module));
+        sqlite3_finalize(stmt);
+        return module;
+    }
+
+
+    // Gets the FTS5 extension API, as described at https://sqlite.org/fts5.html#extending_fts5
+    static fts5_api* getFTS5API(sqlite3 *db) {
+        fts5_api *api = nullptr;
+        sqlite3_stmt *stmt;
+        if (sqlite3_prepare_v2(db, "SELECT fts5(?1)", -1, &stmt, nullptr) != SQLITE_OK)
+            return nullptr;
+        sqlite3_bind_pointer(stmt, 1, (void*)&api, "fts5_api_ptr", nullptr);
+        sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        return api;
+    }
+
+
+#pragma mark - OFFSETS FUNCTION:
+
+
+    // Collects the byte ranges of a column's tokens:
+    static int collectTokenRange(void *context, int flags, const char*, int, int start, int end) {
+        if (!(flags & FTS5_TOKEN_COLOCATED))
+            ((vector<pair<int,int>>*)context)->emplace_back(start, end);
+        return SQLITE_OK;
+    }
+
+
+    /*  FTS5 auxiliary function `fts5_offsets(ftsTable)`, the counterpart of FTS4's offsets().
+        Its result has the same format: for each matched token, four space-separated integers
+        giving the column number, the query term number, and the byte offset and byte length of
+        the token in the column text. SQLiteQuery parses this into FullTextTerms.
+        As in FTS4, each token of a phrase is a separate term: in the query `"sea lion" seal`,
+        "sea" is term 0, "lion" is term 1 and "seal" is term 2. (FTS5 itself numbers phrases.) */
+    static void fts5Offsets(const Fts5ExtensionApi *api, Fts5Context *fts,
+                            sqlite3_context *ctx, int nArgs, sqlite3_value **args)
+    {
+        // The term number of the first token of each phrase:
+        int nPhrases = api->xPhraseCount(fts);
+        vector<int> firstTerm(nPhrases);
+        for (int phrase = 0, term = 0; phrase < nPhrases; ++phrase) {
+            firstTerm[phrase] = term;
+            term += api->xPhraseSize(fts, phrase);
+        }
+
+        struct Instance {int column, term, token;};
+        vector<Instance> instances;
+        int nInstances;
+        int rc = api->xInstCount(fts, &nInstances);
+        for (int i = 0; i < nInstances && rc == SQLITE_OK; ++i) {
+            int phrase, column, token;
+            rc = api->xInst(fts, i, &phrase, &column, &token);
+            if (rc != SQLITE_OK)
+                break;
+            // An instance of a multi-word phrase is reported once; list each of its tokens:
+            int term = firstTerm[phrase];
+            for (int n = api->xPhraseSize(fts, phrase); n > 0; --n)
+                instances.push_back({column, term++, token++});
+        }
+        sort(instances.begin(), instances.end(), [](const Instance &a, const Instance &b) {
+            return a.column < b.column || (a.column == b.column && a.token < b.token);
+        });
+
+        stringstream result;
+        int curColumn = -1;
+        vector<pair<int,int>> tokenRanges;
+        for (auto &inst : instances) {
+            if (rc != SQLITE_OK)
+                break;
+            if (inst.column != curColumn) {
+                // Tokenize the column text to find the byte ranges of its tokens:
+                curColumn = inst.column;
+                tokenRanges.clear();
+                const char *text;
+                int textLen;
+                rc = api->xColumnText(fts, curColumn, &text, &textLen);
+                if (rc == SQLITE_OK && text)
+                    rc = api->xTokenize(fts, text, textLen, &tokenRanges, &collectTokenRange);
+            }
+            if (inst.token >= 0 && size_t(inst.token) < tokenRanges.size()) {
+                auto &range = tokenRanges[inst.token];
+                if (result.tellp() > 0)
+                    result << ' ';
+                result << inst.column << ' ' << inst.term << ' '
+                       << range.first << ' ' << (range.second - range.first);
+            }
+        }
+
+        if (rc == SQLITE_OK)
+            sqlite3_result_text(ctx, result.str().c_str(), -1, SQLITE_TRANSIENT);
+        else
+            sqlite3_result_error_code(ctx, rc);
+    }
+
+
+#pragma mark - REGISTRATION:
+
+
+    int RegisterFTS5Functions(sqlite3 *db) {
+        fts5_api *api = getFTS5API(db);
+        auto module = findFTS3Tokenizer(db, "unicodesn");
+        if (!api || !module)
+            return SQLITE_ERROR;
+        fts5_tokenizer tokenizer = {&fts5TokenizerCreate,
+                                    &fts5TokenizerDelete,
+                                    &fts5TokenizerTokenize};
+        int rc = api->xCreateTokenizer(api, "unicodesn", (void*)module, &tokenizer, nullptr);
+        if (rc == SQLITE_OK)
+            rc = api->xCreateFunction(api, "fts5_offsets", nullptr, &fts5Offsets, nullptr);
+        return rc;
+    }
+
+}
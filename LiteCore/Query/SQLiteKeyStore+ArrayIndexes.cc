@@ -58,10 +58,7 @@ namespace litecore {
             string eachExpr = qp.eachExpressionSQL(expression);
 
             // Populate the index-table with data from existing documents:
-            db().exec(CONCAT("INSERT INTO \"" << unnestTableName << "\" (docid, i, body) "
-                             "SELECT new.rowid, _each.rowid, _each.value " <<
-                             "FROM " << kvTableName << " as new, " << eachExpr << " AS _each "
-                             "WHERE (new.flags & 1) = 0"));
+            db().exec(unnestedTablePopulationSQL(expression, unnestTableName, ""));
 
             // Set up triggers to keep the index-table up to date
             // ...on insertion:
@@ -95,4 +92,18 @@ namespace litecore {
         return unnestTableName;
     }
 
+
+    string SQLiteKeyStore::unnestedTablePopulationSQL(const Value *expression,
+                                                      const string &unnestTableName,
+                                                      const string &rowFilter)
+    {
+        QueryParser qp(db(), tableName());
+        qp.setBodyColumnName("new.body");
+        string eachExpr = qp.eachExpressionSQL(expression);
+        return CONCAT("INSERT INTO \"" << unnestTableName << "\" (docid, i, body) "
+                      "SELECT new.rowid, _each.rowid, _each.value " <<
+                      "FROM " << tableName() << " as new, " << eachExpr << " AS _each "
+                      "WHERE (new.flags & 1) = 0" << (rowFilter.empty() ? "" : " AND ") << rowFilter);
+    }
+
 }
@@ -23,6 +23,9 @@
 #include "QueryParser.hh"
 #include "StringUtil.hh"
 #include "Array.hh"
+#include "Error.hh"
+#include "SQLiteCpp/SQLiteCpp.h"
+#include <algorithm>
 #include <sstream>
 
 extern "C" {
@@ -36,11 +39,22 @@ using namespace fleece::impl;
 namespace litecore {
 
     static void writeTokenizerOptions(stringstream &sql, const IndexSpec::Options*);
+    static void writeFTS5TokenizerOptions(stringstream &sql, const IndexSpec::Options*);
+    static void writeTokenizerArgs(stringstream &sql, const IndexSpec::Options*);
 
 
-    // Creates a FTS index.
+    // The column of an FTS table that holds the rowid of the record it indexes.
+    static const char* FTSDocIDColumn(const IndexSpec &spec) {
+        // (In FTS4 'docid' is an alias of 'rowid', but existing FTS4 SQL has always used 'docid'.)
+        return (spec.type == IndexSpec::kFullText5) ? "rowid" : "docid";
+    }
+
+
+    // Creates a FTS index. (FTS4, or FTS5 if the spec's type is kFullText5.)
     bool SQLiteKeyStore::createFTSIndex(const IndexSpec &spec)
     {
+        bool fts5 = (spec.type == IndexSpec::kFullText5);
+        auto docIDColumn = FTSDocIDColumn(spec);
         auto ftsTableName = db().FTSTableName(tableName(), spec.name);
         // Collect the name of each FTS column and the SQL expression that populates it:
         QueryParser qp(db(), tableName());
@@ -61,22 +75,28 @@ namespace litecore {
         // Build the SQL that creates an FTS table, including the tokenizer options:
         {
             stringstream sql;
-            sql << "CREATE VIRTUAL TABLE \"" << ftsTableName << "\" USING fts4(" << columns << ", ";
-            writeTokenizerOptions(sql, spec.optionsPtr());
+            sql << "CREATE VIRTUAL TABLE \"" << ftsTableName << "\" USING "
+                << (fts5 ? "fts5(" : "fts4(") << columns << ", ";
+            if (fts5)
+                writeFTS5TokenizerOptions(sql, spec.optionsPtr());
+            else
+                writeTokenizerOptions(sql, spec.optionsPtr());
             sql << ")";
-            if (!db().createIndex(spec, this, ftsTableName, sql.str()))
-                return false;
+            bool created = db().createIndex(spec, this, ftsTableName, sql.str());
+            // The merge options aren't part of the table's schema, so they can change even if
+            // the index is otherwise the same; if they changed, the transaction must be committed.
+            bool tuned = fts5 && setFTS5MergeOptions(ftsTableName, spec.optionsPtr());
+            if (!created)
+                return tuned;
         }
 
         // Index the existing records:
-        db().exec(CONCAT("INSERT INTO \"" << ftsTableName << "\" (docid, " << columns << ") "
-                         "SELECT rowid, " << exprs << " FROM kv_" << name() << " AS new "
-                         << whereNewSQL));
+        db().exec(FTSTablePopulationSQL(spec, ftsTableName, ""));
 
         // Set up triggers to keep the FTS table up to date
         // ...on insertion:
         string insertNewSQL = CONCAT("INSERT INTO \"" << ftsTableName
-                                     << "\" (docid, " << columns << ") "
+                                     << "\" (" << docIDColumn << ", " << columns << ") "
                                      "VALUES (new.rowid, " << exprs << ")");
         createTrigger(ftsTableName, "ins",
                       "AFTER INSERT",
@@ -84,7 +104,8 @@ namespace litecore {
                       insertNewSQL);
 
         // ...on delete:
-        string deleteOldSQL = CONCAT("DELETE FROM \"" << ftsTableName << "\" WHERE docid = old.rowid");
+        string deleteOldSQL = CONCAT("DELETE FROM \"" << ftsTableName << "\" "
+                                     "WHERE " << docIDColumn << " = old.rowid");
         createTrigger(ftsTableName, "del",
                       "AFTER DELETE",
                       whereOldSQL,
@@ -103,10 +124,104 @@ namespace litecore {
     }
 
 
+    string SQLiteKeyStore::FTSTablePopulationSQL(const IndexSpec &spec,
+                                                 const string &ftsTableName,
+                                                 const string &rowFilter)
+    {
+        QueryParser qp(db(), tableName());
+        qp.setBodyColumnName("new.body");
+        vector<string> colNames, colExprs;
+        for (Array::iterator i(spec.what()); i; ++i) {
+            colNames.push_back(CONCAT('"' << QueryParser::FTSColumnName(i.value()) << '"'));
+            colExprs.push_back(qp.FTSExpressionSQL(i.value()));
+        }
+        qp.setBodyColumnName("body");
+        string whereNewSQL = qp.whereClauseSQL(spec.where(), "new");
+        if (!rowFilter.empty())
+            whereNewSQL += " AND " + rowFilter;
+        return CONCAT("INSERT INTO \"" << ftsTableName << "\" "
+                      "(" << FTSDocIDColumn(spec) << ", " << join(colNames, ", ") << ") "
+                      "SELECT rowid, " << join(colExprs, ", ") << " FROM kv_" << name() << " AS new "
+                      << whereNewSQL);
+    }
+
+
+    // Applies the FTS5 'automerge' and 'crisismerge' options. These are stored in the FTS5 table's
+    // '_config' table, not its schema, so they're compared with the stored values and only the
+    // ones that differ are written. An option of 0 means SQLite's default.
+    // Returns true if any option was changed.
+    // See https://sqlite.org/fts5.html#fts5_configuration_options_config_table_
+    bool SQLiteKeyStore::setFTS5MergeOptions(const string &ftsTableName,
+                                             const IndexSpec::Options *options)
+    {
+        static constexpr int kDefaultAutomerge = 4, kDefaultCrisismerge = 16;
+        int automerge = kDefaultAutomerge, crisismerge = kDefaultCrisismerge;
+        if (options) {
+            if (options->automerge > 64)
+                error::_throw(error::InvalidParameter,
+                              "FTS5 automerge option must be at most 64 (or negative to disable)");
+            if (options->crisismerge < 0 || options->crisismerge == 1)
+                error::_throw(error::InvalidParameter,
+                              "FTS5 crisismerge option must be 0 (default) or at least 2");
+            if (options->automerge != 0)
+                automerge = max(options->automerge, 0);         // (negative disables it)
+            if (options->crisismerge != 0)
+                crisismerge = options->crisismerge;
+        }
+
+        // Read the current values; an option that's never been set isn't in the table:
+        int curAutomerge = kDefaultAutomerge, curCrisismerge = kDefaultCrisismerge;
+        auto stmt = db().compile(CONCAT("SELECT k, v FROM \"" << ftsTableName << "_config\" "
+                                        "WHERE k IN ('automerge', 'crisismerge')").c_str());
+        while (stmt->executeStep()) {
+            string key = stmt->getColumn(0).getString();
+            (key == "automerge" ? curAutomerge : curCrisismerge) = stmt->getColumn(1).getInt();
+        }
+
+        auto setOption = [&](const char *name, int value) {
+            db().exec(CONCAT("INSERT INTO \"" << ftsTableName << "\" (\"" << ftsTableName << "\", rank) "
+                             "VALUES ('" << name << "', " << value << ")"));
+        };
+        bool changed = false;
+        if (automerge != curAutomerge) {
+            setOption("automerge", automerge);
+            changed = true;
+        }
+        if (crisismerge != curCrisismerge) {
+            setOption("crisismerge", crisismerge);
+            changed = true;
+        }
+        return changed;
+    }
+
+
     // subroutine that generates the option string passed to the FTS tokenizer
     static void writeTokenizerOptions(stringstream &sql, const IndexSpec::Options *options) {
         // See https://www.sqlite.org/fts3.html#tokenizer . 'unicodesn' is our custom tokenizer.
-        sql << "tokenize=unicodesn";
+        sql << "tokenize=";
+        writeTokenizerArgs(sql, options);
+    }
+
+
+    // FTS5 takes the same tokenizer and arguments, but as a single string literal.
+    // See https://sqlite.org/fts5.html#tokenizers
+    static void writeFTS5TokenizerOptions(stringstream &sql, const IndexSpec::Options *options) {
+        stringstream args;
+        writeTokenizerArgs(args, options);
+        string argStr = args.str();
+        sql << "tokenize='";
+        for (char c : argStr) {
+            if (c == '\'')
+                sql << '\'';     // SQL escapes a quote by doubling it
+            sql << c;
+        }
+        sql << "'";
+    }
+
+
+    // Writes the name of our custom tokenizer 'unicodesn', and its arguments
+    static void writeTokenizerArgs(stringstream &sql, const IndexSpec::Options *options) {
+        sql << "unicodesn";
         if (options) {
             // Get the language code (options->language might have a country too, like "en_US")
             string languageCode;
@@ -27,6 +27,8 @@
 #include "SQLiteCpp/SQLiteCpp.h"
 #include "Stopwatch.hh"
 #include "Array.hh"
+#include <set>
+#include <sstream>
 
 using namespace std;
 using namespace fleece;
@@ -67,10 +69,12 @@ namespace litecore {
 
     bool SQLiteKeyStore::createIndex(const IndexSpec &spec, ExclusiveTransaction& t) {
         Stopwatch st;
+        db().endDeferredIndexing();     // Changing the index triggers would confuse it
         bool created;
         switch (spec.type) {
             case IndexSpec::kValue:      created = createValueIndex(spec); break;
-            case IndexSpec::kFullText:   created = createFTSIndex(spec); break;
+            case IndexSpec::kFullText:
+            case IndexSpec::kFullText5:  created = createFTSIndex(spec); break;
             case IndexSpec::kArray:      created = createArrayIndex(spec); break;
 #ifdef COUCHBASE_ENTERPRISE
             case IndexSpec::kPredictive: created = createPredictiveIndex(spec); break;
@@ -92,7 +96,7 @@ namespace litecore {
                                      const string &sourceTableName,
                                      Array::iterator &expressions)
     {
-        Assert(spec.type != IndexSpec::kFullText);
+        Assert(!spec.isFullText());
         QueryParser qp(db(), sourceTableName);
         qp.writeCreateIndex(spec.name,
                             sourceTableName,
@@ -117,6 +121,7 @@ namespace litecore {
 
 
     void SQLiteKeyStore::deleteIndex(slice name, ExclusiveTransaction &t)  {
+        db().endDeferredIndexing();
         auto spec = db().getIndex(name);
         if (!!spec) {
             db().deleteIndex(*spec);
@@ -173,4 +178,122 @@ namespace litecore {
         return createIndex(spec, tableName(), expressions);
     }
 
+
+
+#pragma mark - DEFERRED INDEXING:
+
+
+    /*  In deferred-indexing mode (DataFile::Options::deferIndexing), the first change to a
+        KeyStore in a transaction drops the triggers that keep its FTS, array and predictive
+        index tables up to date, and adds temporary triggers that only record the rowids of the
+        changed records in a temp table. The index rows of those records are rebuilt, one
+        statement per index table, before any query runs on this connection and at commit, when
+        the original triggers are restored. As all this happens inside the transaction, other
+        connections never see the triggers missing or the index tables out of date. */
+
+
+    void SQLiteKeyStore::willModify() {
+        if (!_deferredTriggers && db().options().deferIndexing)
+            deferIndexing();
+    }
+
+
+    void SQLiteKeyStore::deferIndexing() {
+        Assert(db().inTransaction());
+        auto &triggers = _deferredTriggers.emplace();
+        {
+            SQLite::Statement stmt(db(), "SELECT name, sql FROM sqlite_master "
+                                         "WHERE type='trigger' AND tbl_name=?");
+            stmt.bind(1, tableName());
+            while (stmt.executeStep())
+                triggers.emplace_back(stmt.getColumn(0).getString(), stmt.getColumn(1).getString());
+        }
+        if (triggers.empty())
+            return;
+
+        LogTo(QueryLog, "Deferring index updates of %s (%zu triggers)",
+              tableName().c_str(), triggers.size());
+        string dirtyTable = dirtyTableName();
+        stringstream sql;
+        sql << "CREATE TEMP TABLE IF NOT EXISTS \"" << dirtyTable << "\" "
+               "(docid INTEGER PRIMARY KEY);";
+        for (auto &trigger : triggers)
+            sql << "DROP TRIGGER \"" << trigger.first << "\";";
+        static const char* const kDirtyTriggers[3][3] = {
+            {"ins", "AFTER INSERT",                 "new"},
+            {"upd", "AFTER UPDATE OF body, flags",  "new"},
+            {"del", "BEFORE DELETE",                "old"},
+        };
+        for (auto &[suffix, operation, row] : kDirtyTriggers) {
+            sql << "CREATE TEMP TRIGGER \"" << dirtyTable << "::" << suffix << "\" "
+                << operation << " ON " << tableName() << " BEGIN "
+                << "INSERT OR IGNORE INTO \"" << dirtyTable << "\" (docid) VALUES (" << row << ".rowid);"
+                << " END;";
+        }
+        db().exec(sql.str());
+    }
+
+
+    void SQLiteKeyStore::refreshDeferredIndexes() {
+        if (!_deferredTriggers || _deferredTriggers->empty())
+            return;
+        string dirtyTable = dirtyTableName();
+        string dirtyRows = CONCAT("(SELECT docid FROM \"" << dirtyTable << "\")");
+        if (db().intQuery(CONCAT("SELECT EXISTS " << dirtyRows).c_str()) == 0)
+            return;
+
+        Stopwatch st;
+        string rowFilter = "new.rowid IN " + dirtyRows;
+        set<string> refreshed;
+        for (auto &spec : db().getIndexes(this)) {
+            if (refreshed.count(spec.indexTableName))
+                continue;           // (several array or predictive indexes may share a table)
+            string populateSQL;
+            switch (spec.type) {
+                case IndexSpec::kFullText:
+                case IndexSpec::kFullText5:
+                    populateSQL = FTSTablePopulationSQL(spec, spec.indexTableName, rowFilter);
+                    break;
+                case IndexSpec::kArray:
+                    populateSQL = unnestedTablePopulationSQL(spec.what()->get(0),
+                                                             spec.indexTableName, rowFilter);
+                    break;
+#ifdef COUCHBASE_ENTERPRISE
+                case IndexSpec::kPredictive:
+                    populateSQL = predictionTablePopulationSQL(predictionOf(spec),
+                                                               spec.indexTableName, rowFilter);
+                    break;
+#endif
+                default:
+                    continue;       // Value indexes are maintained by SQLite itself
+            }
+            refreshed.insert(spec.indexTableName);
+            const char *docIDColumn = (spec.type == IndexSpec::kFullText5) ? "rowid" : "docid";
+            db().exec(CONCAT("DELETE FROM \"" << spec.indexTableName << "\" "
+                             "WHERE " << docIDColumn << " IN " << dirtyRows));
+            db().exec(populateSQL);
+        }
+        int nDirty = db().exec(CONCAT("DELETE FROM \"" << dirtyTable << "\""));
+        LogTo(QueryLog, "Refreshed %zu index tables of %s for %d changed records in %.3f sec",
+              refreshed.size(), tableName().c_str(), nDirty, st.elapsed());
+    }
+
+
+    void SQLiteKeyStore::endDeferredIndexing() {
+        if (!_deferredTriggers)
+            return;
+        refreshDeferredIndexes();
+        auto triggers = move(*_deferredTriggers);
+        _deferredTriggers.reset();
+        if (triggers.empty())
+            return;
+
+        stringstream sql;
+        for (auto suffix : {"ins", "upd", "del"})
+            sql << "DROP TRIGGER temp.\"" << dirtyTableName() << "::" << suffix << "\";";
+        for (auto &trigger : triggers)
+            sql << trigger.second << ";";
+        db().exec(sql.str());
+    }
+
 }
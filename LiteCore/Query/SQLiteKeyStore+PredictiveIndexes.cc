@@ -33,22 +33,27 @@ using namespace fleece::impl;
 
 namespace litecore {
 
-    bool SQLiteKeyStore::createPredictiveIndex(const IndexSpec &spec) {
+    // Returns the PREDICTION() call of a predictive index, without the result properties.
+    Retained<MutableArray> SQLiteKeyStore::predictionOf(const IndexSpec &spec) {
         auto expressions = spec.what();
         if (expressions->count() != 1)
             error::_throw(error::InvalidQuery, "Predictive index requires exactly one expression");
         const Array *expression = expressions->get(0)->asArray();
         if (!expression)
             error::_throw(error::InvalidQuery, "Predictive index requires a PREDICT() expression");
-
-        // Create a table of the PREDICTION results:
         auto pred = MutableArray::newArray(expression);
         if (pred->count() > 3)
             pred->remove(3, pred->count() - 3);
-        string predTableName = createPredictionTable(pred, spec.optionsPtr());
+        return pred;
+    }
+
+
+    bool SQLiteKeyStore::createPredictiveIndex(const IndexSpec &spec) {
+        // Create a table of the PREDICTION results:
+        string predTableName = createPredictionTable(predictionOf(spec), spec.optionsPtr());
 
         // The final parameters are the result properties to create a SQL index on:
-        Array::iterator i(expression);
+        Array::iterator i(spec.what()->get(0)->asArray());
         i += 3;
         
         // If there are no result properties specified, skip creating the value index;
@@ -83,15 +88,12 @@ namespace litecore {
             db().exec(sql);
 
             // Populate the index-table with data from existing documents:
-            string predictExpr = qp.expressionSQL(expression);
-            db().exec(CONCAT("INSERT INTO \"" << predTableName << "\" (docid, body) "
-                             "SELECT rowid, " << predictExpr <<
-                             "FROM " << kvTableName << " WHERE (flags & 1) = 0"));
+            db().exec(predictionTablePopulationSQL(expression, predTableName, ""));
 
             // Set up triggers to keep the index-table up to date
             // ...on insertion:
             qp.setBodyColumnName("new.body");
-            predictExpr = qp.expressionSQL(expression);
+            string predictExpr = qp.expressionSQL(expression);
             string insertTriggerExpr = CONCAT("INSERT INTO \"" << predTableName <<
                                               "\" (docid, body) "
                                               "VALUES (new.rowid, " << predictExpr << ")");
@@ -121,6 +123,19 @@ namespace litecore {
         return predTableName;
     }
 
+
+    string SQLiteKeyStore::predictionTablePopulationSQL(const Value *expression,
+                                                        const string &predTableName,
+                                                        const string &rowFilter)
+    {
+        QueryParser qp(db(), tableName());
+        string predictExpr = qp.expressionSQL(expression);
+        return CONCAT("INSERT INTO \"" << predTableName << "\" (docid, body) "
+                      "SELECT rowid, " << predictExpr <<
+                      " FROM " << tableName() << " AS new WHERE (flags & 1) = 0"
+                      << (rowFilter.empty() ? "" : " AND ") << rowFilter);
+    }
+
 }
 
 #endif // COUCHBASE_ENTERPRISE
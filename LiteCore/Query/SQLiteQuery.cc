@@ -31,9 +31,13 @@
 #include "Stopwatch.hh"
 #include "SQLiteCpp/SQLiteCpp.h"
 #include <sqlite3.h>
+#include <deque>
+#include <map>
+#include <mutex>
 #include <numeric>      // std::accumulate
 #include <sstream>
 #include <iostream>
+#include <unordered_set>
 
 extern "C" {
 #include "sqlite3_unicodesn_tokenizer.h"        // for unicodesn_tokenizerRunningQuery()
@@ -45,6 +49,7 @@ using namespace fleece::impl;
 namespace litecore {
 
     class SQLiteQueryEnumerator;
+    class SQLiteStreamingQueryEnumerator;
 
 
     // Implicit columns in full-text query result:
@@ -62,6 +67,79 @@ namespace litecore {
             }
             return false;
         }
+
+
+        // Parses the FTS `offsets()` column of a result row into FullTextTerms.
+        void readFullTextTerms(const Array *row, QueryEnumerator::FullTextTerms &terms) {
+            terms.clear();
+            uint64_t dataSource = row->get(kFTSRowidCol)->asInt();
+            // The offsets() function returns a string of space-separated numbers in groups of 4.
+            string offsets = row->get(kFTSOffsetsCol)->asString().asString();
+            const char *termStr = offsets.c_str();
+            while (*termStr) {
+                uint32_t n[4];
+                for (int i = 0; i < 4; ++i) {
+                    char *next;
+                    n[i] = (uint32_t)strtol(termStr, &next, 10);
+                    termStr = next;
+                }
+                terms.push_back({dataSource, n[0], n[1], n[2], n[3]});
+                // {rowid, key #, term #, byte offset, byte length}
+            }
+        }
+
+
+        // Binds the parameters in `json` (a JSON or Fleece dict) to the statement, and removes
+        // their names from `unbound`. An unknown parameter name throws InvalidQueryParam, unless
+        // `ignoreUnknown` is true.
+        void bindQueryParameters(SQLite::Statement &statement, slice json,
+                                 set<string> &unbound, bool ignoreUnknown =false)
+        {
+            alloc_slice fleeceData;
+            if (json[0] == '{' && json[json.size-1] == '}')
+                fleeceData = JSONConverter::convertJSON(json);
+            else
+                fleeceData = json;
+            const Dict *root = Value::fromData(fleeceData)->asDict();
+            if (!root)
+                error::_throw(error::InvalidParameter);
+            for (Dict::iterator it(root); it; ++it) {
+                auto key = (string)it.keyString();
+                unbound.erase(key);
+                auto sqlKey = string("$_") + key;
+                const Value *val = it.value();
+                try {
+                    switch (val->type()) {
+                        case kNull:
+                            break;
+                        case kBoolean:
+                        case kNumber:
+                            if (val->isInteger() && !val->isUnsigned())
+                                statement.bind(sqlKey, (long long)val->asInt());
+                            else
+                                statement.bind(sqlKey, val->asDouble());
+                            break;
+                        case kString:
+                            statement.bind(sqlKey, (string)val->asString());
+                            break;
+                        default: {
+                            // Encode other types as a Fleece blob:
+                            Encoder enc;
+                            enc.writeValue(val);
+                            alloc_slice asFleece = enc.finish();
+                            statement.bind(sqlKey, asFleece.buf, (int)asFleece.size);
+                            break;
+                        }
+                    }
+                } catch (const SQLite::Exception &x) {
+                    if (x.getErrorCode() != SQLITE_RANGE)
+                        throw;
+                    else if (!ignoreUnknown)
+                        error::_throw(error::InvalidQueryParam,
+                                      "Unknown query property '%s'", key.c_str());
+                }
+            }
+        }
     }
 
 
@@ -131,31 +209,34 @@ namespace litecore {
             
             _1stCustomResultColumn = qp.firstCustomResultColumn();
             _columnTitles = qp.columnTitles();
+
+            // A query on a single collection can report which changed docs match it:
+            if (qp.isSingleCollectionQuery() && _keyStores.size() == 1) {
+                _incrementalState = IncrementalState::Unprepared;
+                _propertyPrefix = ".";
+                if (qp.propertiesUseSourcePrefix())
+                    _propertyPrefix += qp.databaseAlias() + ".";
+            }
         }
 
 
-        virtual void close() override {
-            logInfo("Closing query (db is closing)");
-            _statement.reset();
-            _matchedTextStatement.reset();
-            Query::close();
-        }
+        virtual void close() override;
 
 
-        sequence_t lastSequence() const {
+        sequence_t lastSequence() const override {
             // This number is just used for before/after comparisons, so
             // return the total last-sequence of all used KeyStores
-            return std::accumulate(_keyStores.begin(), _keyStores.end(), 0,
+            return std::accumulate(_keyStores.begin(), _keyStores.end(), sequence_t(0),
                                    [](sequence_t total, const SQLiteKeyStore *ks) {
                 return total + ks->lastSequence();
             });
         }
 
 
-        uint64_t purgeCount() const {
+        uint64_t purgeCount() const override {
             // This number is just used for before/after comparisons, so
             // return the total purge-count of all used KeyStores
-            return std::accumulate(_keyStores.begin(), _keyStores.end(), 0,
+            return std::accumulate(_keyStores.begin(), _keyStores.end(), uint64_t(0),
                                    [](uint64_t total, const SQLiteKeyStore *ks) {
                 return total + ks->purgeCount();
             });
@@ -170,7 +251,8 @@ namespace litecore {
 
             if (!_matchedTextStatement) {
                 auto &df = (SQLiteDataFile&)dataFile();
-                string sql = "SELECT * FROM \"" + expr + "\" WHERE docid=?";
+                // (FTS4's 'docid' is an alias of 'rowid', and FTS5 tables only have 'rowid')
+                string sql = "SELECT * FROM \"" + expr + "\" WHERE rowid=?";
                 _matchedTextStatement.reset(new SQLite::Statement(df, sql, true));
             }
 
@@ -216,12 +298,38 @@ namespace litecore {
 
         QueryEnumerator* createEnumerator(const Options *options) override;
 
+        bool findChangedDocuments(const Options&, sequence_t afterSequence, bool matchingOnly,
+                                  ChangedDocCallback) override;
+
         shared_ptr<SQLite::Statement> statement() const {
             if (!_statement)
                 error::_throw(error::NotOpen);
             return _statement;
         }
 
+        // Compiles a private copy of the statement on a connection, for a streaming enumerator
+        // to step through without interfering with other enumerators of this query.
+        shared_ptr<SQLite::Statement> newStatement(SQLiteDataFile &connection) const {
+            return connection.compile(statement()->getQuery().c_str());
+        }
+
+        void registerStreamingEnumerator(SQLiteStreamingQueryEnumerator *e) {
+            lock_guard<mutex> lock(_streamingMutex);
+            _streamingEnumerators.insert(e);
+        }
+        void unregisterStreamingEnumerator(SQLiteStreamingQueryEnumerator *e) {
+            lock_guard<mutex> lock(_streamingMutex);
+            _streamingEnumerators.erase(e);
+        }
+
+        void finishStreaming() override;
+
+        // Returns a new enumerator on the cached results for the options' parameters, if they
+        // were recorded at the given lastSequence & purgeCount; else null.
+        SQLiteQueryEnumerator* cachedEnumerator(const Options&, sequence_t, uint64_t);
+        // Remembers the results recorded by the enumerator, for use by `cachedEnumerator`.
+        void cacheResults(SQLiteQueryEnumerator*);
+
         unsigned objectRef() const                  {return getObjectRef();}   // (for logging)
 
         set<string> _parameters;            // Names of the bindable parameters
@@ -233,11 +341,35 @@ namespace litecore {
         string loggingClassName() const override    {return "Query";}
 
     private:
+        bool prepareIncremental();
+
+        enum class IncrementalState {Unsupported, Unprepared, Prepared};
+
         alloc_slice _json;                                  // Original JSON form of the query
         shared_ptr<SQLite::Statement> _statement;           // Compiled SQLite statement
         unique_ptr<SQLite::Statement> _matchedTextStatement;// Gets the matched text
         vector<string> _columnTitles;                       // Titles of columns
         vector<SQLiteKeyStore*> _keyStores;
+        unordered_set<SQLiteStreamingQueryEnumerator*> _streamingEnumerators; // Open streams
+        mutex _streamingMutex;                              // Guards _streamingEnumerators
+
+        // Used by findChangedDocuments:
+        IncrementalState _incrementalState {IncrementalState::Unsupported};
+        string _propertyPrefix;                             // Path prefix of doc properties
+        shared_ptr<SQLite::Statement> _matchingChangesStatement; // Changed docs matching WHERE
+        shared_ptr<SQLite::Statement> _changesStatement;    // All changed docs
+
+        // Results cached by the `cacheResults` option, keyed by the encoded parameters:
+        struct CachedResult {
+            Retained<Doc> recording;
+            sequence_t lastSequence;
+            uint64_t purgeCount;
+            uint64_t lastUsed;
+        };
+        static constexpr size_t kMaxCachedResults = 16;
+        map<alloc_slice, CachedResult> _resultCache;
+        uint64_t _resultCacheClock {0};
+        mutex _resultCacheMutex;
     };
 
 
@@ -315,6 +447,8 @@ namespace litecore {
             return _iter[1u]->asUnsigned();
         }
 
+        Doc* recording() const                      {return _recording;}
+
 
         virtual bool obsoletedBy(const QueryEnumerator *otherE) override {
             if (!otherE)
@@ -355,21 +489,7 @@ namespace litecore {
         }
 
         const FullTextTerms& fullTextTerms() override {
-            _fullTextTerms.clear();
-            uint64_t dataSource = _iter->asArray()->get(kFTSRowidCol)->asInt();
-            // The offsets() function returns a string of space-separated numbers in groups of 4.
-            string offsets = _iter->asArray()->get(kFTSOffsetsCol)->asString().asString();
-            const char *termStr = offsets.c_str();
-            while (*termStr) {
-                uint32_t n[4];
-                for (int i = 0; i < 4; ++i) {
-                    char *next;
-                    n[i] = (uint32_t)strtol(termStr, &next, 10);
-                    termStr = next;
-                }
-                _fullTextTerms.push_back({dataSource, n[0], n[1], n[2], n[3]});
-                // {rowid, key #, term #, byte offset, byte length}
-            }
+            readFullTextTerms(_iter->asArray(), _fullTextTerms);
             return _fullTextTerms;
         }
 
@@ -388,20 +508,24 @@ namespace litecore {
 
     // Reads from 'live' SQLite statement and records the results into a Fleece array,
     // which is then used as the data source of a SQLiteQueryEnum.
+    // (A SQLiteStreamingQueryEnumerator instead keeps a runner and reads one row at a time.)
     class SQLiteQueryRunner {
     public:
-        SQLiteQueryRunner(SQLiteQuery *query, const Query::Options *options, sequence_t lastSequence, uint64_t purgeCount)
+        SQLiteQueryRunner(SQLiteQuery *query, const Query::Options *options,
+                          sequence_t lastSequence, uint64_t purgeCount,
+                          shared_ptr<SQLite::Statement> statement =nullptr,
+                          SharedKeys *sharedKeys =nullptr)
         :_query(query)
         ,_lastSequence(lastSequence)
         ,_purgeCount(purgeCount)
-        ,_statement(query->statement())
-        ,_sk(query->dataFile().documentKeys())
+        ,_statement(statement ? move(statement) : query->statement())
+        ,_sk(sharedKeys ? sharedKeys : query->dataFile().documentKeys())
         ,_options(options ? *options : Query::Options())
         {
             _statement->clearBindings();
             _unboundParameters = query->_parameters;
             if (options && options->paramBindings.buf)
-                bindParameters(options->paramBindings);
+                bindQueryParameters(*_statement, options->paramBindings, _unboundParameters);
             if (!_unboundParameters.empty()) {
                 stringstream msg;
                 for (const string &param : _unboundParameters)
@@ -419,53 +543,6 @@ namespace litecore {
             } catch (...) { }
         }
 
-        void bindParameters(slice json) {
-            alloc_slice fleeceData;
-            if (json[0] == '{' && json[json.size-1] == '}')
-                fleeceData = JSONConverter::convertJSON(json);
-            else
-                fleeceData = json;
-            const Dict *root = Value::fromData(fleeceData)->asDict();
-            if (!root)
-                error::_throw(error::InvalidParameter);
-            for (Dict::iterator it(root); it; ++it) {
-                auto key = (string)it.keyString();
-                _unboundParameters.erase(key);
-                auto sqlKey = string("$_") + key;
-                const Value *val = it.value();
-                try {
-                    switch (val->type()) {
-                        case kNull:
-                            break;
-                        case kBoolean:
-                        case kNumber:
-                            if (val->isInteger() && !val->isUnsigned())
-                                _statement->bind(sqlKey, (long long)val->asInt());
-                            else
-                                _statement->bind(sqlKey, val->asDouble());
-                            break;
-                        case kString:
-                            _statement->bind(sqlKey, (string)val->asString());
-                            break;
-                        default: {
-                            // Encode other types as a Fleece blob:
-                            Encoder enc;
-                            enc.writeValue(val);
-                            alloc_slice asFleece = enc.finish();
-                            _statement->bind(sqlKey, asFleece.buf, (int)asFleece.size);
-                            break;
-                        }
-                    }
-                } catch (const SQLite::Exception &x) {
-                    if (x.getErrorCode() == SQLITE_RANGE)
-                        error::_throw(error::InvalidQueryParam,
-                                      "Unknown query property '%s'", key.c_str());
-                    else
-                        throw;
-                }
-            }
-        }
-
         bool encodeColumn(Encoder &enc, int i) {
             SQLite::Column col = _statement->getColumn(i);
             switch (col.getType()) {
@@ -497,11 +574,41 @@ namespace litecore {
             return true;
         }
 
+        // Steps the statement; if there is a row, writes it to the encoder as an array of
+        // columns followed by an integer bitmap of the missing columns, and returns true.
+        bool encodeNextRow(Encoder &enc) {
+            unicodesn_tokenizerRunningQuery(true);
+            try {
+                if (!_statement->executeStep()) {
+                    unicodesn_tokenizerRunningQuery(false);
+                    return false;
+                }
+            } catch (...) {
+                unicodesn_tokenizerRunningQuery(false);
+                throw;
+            }
+            unicodesn_tokenizerRunningQuery(false);
+
+            int nCols = _statement->getColumnCount();
+            auto firstCustomCol = _query->_1stCustomResultColumn;
+            uint64_t missingCols = 0;
+            enc.beginArray(nCols);
+            for (int i = 0; i < nCols; ++i) {
+                int offsetColumn = i - firstCustomCol;
+                if (!encodeColumn(enc, i) && offsetColumn >= 0 && offsetColumn < 64) {
+                    missingCols |= (1ULL << offsetColumn);
+                }
+            }
+            enc.endArray();
+            // Add an integer containing a bit-map of which columns are missing/undefined:
+            enc.writeUInt(missingCols);
+            return true;
+        }
+
         // Collects all the (remaining) rows into a Fleece array of arrays,
         // and returns an enumerator impl that will replay them.
         SQLiteQueryEnumerator* fastForward() {
             fleece::Stopwatch st;
-            int nCols = _statement->getColumnCount();
             uint64_t rowCount = 0;
             // Give this encoder its own SharedKeys instead of using the database's DocumentKeys,
             // because the query results might include dicts with new keys that aren't in the
@@ -510,30 +617,8 @@ namespace litecore {
             auto sk = retained(new SharedKeys);
             enc.setSharedKeys(sk);
             enc.beginArray();
-
-            unicodesn_tokenizerRunningQuery(true);
-            try {
-                 auto firstCustomCol = _query->_1stCustomResultColumn;
-                 while (_statement->executeStep()) {
-                     uint64_t missingCols = 0;
-                     enc.beginArray(nCols);
-                     for (int i = 0; i < nCols; ++i) {
-                         int offsetColumn = i - firstCustomCol;
-                         if (!encodeColumn(enc, i) && offsetColumn >= 0 && offsetColumn < 64) {
-                             missingCols |= (1ULL << offsetColumn);
-                         }
-                    }
-                    enc.endArray();
-                    // Add an integer containing a bit-map of which columns are missing/undefined:
-                    enc.writeUInt(missingCols);
-                    ++rowCount;
-                }
-            } catch (...) {
-                unicodesn_tokenizerRunningQuery(false);
-                throw;
-            }
-            unicodesn_tokenizerRunningQuery(false);
-
+            while (encodeNextRow(enc))
+                ++rowCount;
             enc.endArray();
             return new SQLiteQueryEnumerator(_query, &_options, _lastSequence, _purgeCount,
                                              enc.finishDoc().get(), rowCount, st.elapsed());
@@ -551,6 +636,223 @@ namespace litecore {
 
 
 
+    // Query enumerator that steps its own SQLite statement as it's advanced, encoding only the
+    // current row into Fleece. Time to the first row and memory usage don't grow with the
+    // size of the result set, but there's no random access.
+    // The enumerator holds a ReadOnlyTransaction until it reaches the end or is released, and
+    // resets the statement before ending it. Since that transaction's snapshot is shared by
+    // everything else on the connection, the DataFile calls `finish` before it begins or commits
+    // another transaction; the rest of the rows are then read into memory.
+    class SQLiteStreamingQueryEnumerator : public QueryEnumerator, Logging {
+    public:
+        SQLiteStreamingQueryEnumerator(SQLiteQuery *query,
+                                       const Query::Options *options,
+                                       sequence_t lastSequence,
+                                       uint64_t purgeCount)
+        :QueryEnumerator(options, lastSequence, purgeCount)
+        ,Logging(QueryLog)
+        ,_query(query)
+        ,_sharedKeys(new SharedKeys)
+        ,_1stCustomResultColumn(query->_1stCustomResultColumn)
+        ,_hasFullText(!query->_ftsTables.empty())
+        {
+            auto &df = (SQLiteDataFile&)query->dataFile();
+            if (!df.inTransaction()) {
+                // Read from a connection of my own, so other transactions on the database's
+                // connection can't disturb my snapshot:
+                _connection = df.openStreamConnection();
+                _transaction = make_unique<ReadOnlyTransaction>(*_connection);
+                _runner = make_unique<SQLiteQueryRunner>(query, options, lastSequence, purgeCount,
+                                                         query->newStatement(*_connection),
+                                                         _connection->documentKeys());
+            } else {
+                // Only the database's connection can see the uncommitted changes, so read from
+                // it; `finish` will buffer the remaining rows before the transaction ends.
+                _transaction = make_unique<ReadOnlyTransaction>(df);
+                _runner = make_unique<SQLiteQueryRunner>(query, options, lastSequence, purgeCount,
+                                                         query->newStatement(df));
+            }
+            _query->registerStreamingEnumerator(this);
+            logInfo("Created streaming enumerator on {Query#%u}", query->objectRef());
+        }
+
+        ~SQLiteStreamingQueryEnumerator() {
+            _query->unregisterStreamingEnumerator(this);
+            endTransaction();
+            logInfo("Deleted after %llu rows", (unsigned long long)_rowCount);
+        }
+
+        // Reads the first row. Called by createEnumerator while still inside its read
+        // transaction, so the statement's snapshot is no older than lastSequence/purgeCount.
+        void start() {
+            lock_guard<mutex> lock(_mutex);
+            _peeked = readRow();
+        }
+
+        // Reads the remaining rows into memory and ends the transaction, if reading inside the
+        // DataFile's transaction. Called by the query when that transaction is about to end.
+        void finish() {
+            lock_guard<mutex> lock(_mutex);
+            if (!_runner || _connection)
+                return;
+            while (Retained<Doc> rowDoc = encodeRow())
+                _bufferedRows.push_back(move(rowDoc));
+            logVerbose("Buffered the remaining %zu rows", _bufferedRows.size());
+        }
+
+        // Finalizes the statement. Called when the query is closed (i.e. the db is closing.)
+        void close() {
+            lock_guard<mutex> lock(_mutex);
+            endTransaction();
+            _bufferedRows.clear();
+            _queryClosed = true;
+        }
+
+        size_t bufferedRowCount() const override {
+            lock_guard<mutex> lock(_mutex);
+            return _bufferedRows.size();
+        }
+
+        bool next() override {
+            lock_guard<mutex> lock(_mutex);
+            if (_peeked) {
+                _peeked = false;
+            } else if (!readRow()) {
+                _row = nullptr;
+                logVerbose("END");
+                return false;
+            }
+            ++_rowCount;
+            if (willLog(LogLevel::Verbose)) {
+                alloc_slice json = _row->toJSON();
+                logVerbose("--> %.*s", SPLAT(json));
+            }
+            return true;
+        }
+
+        Array::iterator columns() const noexcept override {
+            Array::iterator i(_row);
+            i += _1stCustomResultColumn;
+            return i;
+        }
+
+        uint64_t missingColumns() const noexcept override {
+            return _missingColumns;
+        }
+
+        virtual bool obsoletedBy(const QueryEnumerator *other) override {
+            // There's no recording to compare, so any change to the database counts:
+            return other && (other->purgeCount() != _purgeCount
+                                || other->lastSequence() > _lastSequence);
+        }
+
+        QueryEnumerator* refresh(Query *query) override {
+            // createEnumerator returns null if the database hasn't changed since I was created:
+            auto newOptions = _options.after(_lastSequence).withPurgeCount(_purgeCount);
+            return query->createEnumerator(&newOptions);
+        }
+
+        bool hasFullText() const override {
+            return _hasFullText;
+        }
+
+        const FullTextTerms& fullTextTerms() override {
+            readFullTextTerms(_row, _fullTextTerms);
+            return _fullTextTerms;
+        }
+
+    protected:
+        string loggingClassName() const override    {return "QueryEnum";}
+
+    private:
+        // Makes the next row current, from the buffer or the statement. Returns false at the end.
+        bool readRow() {
+            Retained<Doc> rowDoc;
+            if (!_bufferedRows.empty()) {
+                rowDoc = move(_bufferedRows.front());
+                _bufferedRows.pop_front();
+            } else if (_runner) {
+                rowDoc = encodeRow();
+            } else if (_queryClosed) {
+                error::_throw(error::NotOpen);
+            }
+            if (!rowDoc)
+                return false;
+            _rowDoc = move(rowDoc);
+            auto item = _rowDoc->asArray();
+            _row = item->get(0)->asArray();
+            _missingColumns = item->get(1)->asUnsigned();
+            return true;
+        }
+
+        // Steps the statement and encodes the row and its missing-columns flags.
+        // At the end, resets the statement, ends the transaction and returns null.
+        Retained<Doc> encodeRow() {
+            _encoder.setSharedKeys(_sharedKeys);
+            _encoder.beginArray(2);
+            if (!_runner->encodeNextRow(_encoder)) {
+                _encoder.reset();
+                endTransaction();
+                return nullptr;
+            }
+            _encoder.endArray();
+            return _encoder.finishDoc();
+        }
+
+        // Resets the statement (by freeing the runner), *then* ends the read transaction, and
+        // closes my connection if I have one.
+        void endTransaction() {
+            _runner.reset();
+            _transaction.reset();
+            _connection.reset();
+        }
+
+        Retained<SQLiteQuery> _query;
+        mutable mutex _mutex;                   // Guards the runner, buffer and current row
+        unique_ptr<SQLiteDataFile> _connection; // My own connection, unless in a transaction
+        unique_ptr<ReadOnlyTransaction> _transaction; // Keeps the snapshot; null when finished
+        unique_ptr<SQLiteQueryRunner> _runner;  // Owns the statement; null when finished
+        deque<Retained<Doc>> _bufferedRows;     // Rows read ahead by `finish`
+        Retained<SharedKeys> _sharedKeys;       // Keys for rows (not the DB's DocumentKeys)
+        Encoder _encoder;
+        Retained<Doc> _rowDoc;                  // Fleece data of the current row
+        const Array* _row {nullptr};            // Column values of the current row
+        uint64_t _missingColumns {0};
+        uint64_t _rowCount {0};
+        unsigned _1stCustomResultColumn;        // Column index of the 1st column declared in JSON
+        bool _hasFullText;
+        bool _peeked {false};                   // True if `_row` has been read but not returned
+        bool _queryClosed {false};
+    };
+
+
+    void SQLiteQuery::close() {
+        logInfo("Closing query (db is closing)");
+        {
+            lock_guard<mutex> lock(_streamingMutex);
+            for (auto e : _streamingEnumerators)
+                e->close();
+            _streamingEnumerators.clear();
+        }
+        _statement.reset();
+        _matchedTextStatement.reset();
+        _matchingChangesStatement.reset();
+        _changesStatement.reset();
+        {
+            lock_guard<mutex> lock(_resultCacheMutex);
+            _resultCache.clear();
+        }
+        Query::close();
+    }
+
+
+    void SQLiteQuery::finishStreaming() {
+        lock_guard<mutex> lock(_streamingMutex);
+        for (auto e : _streamingEnumerators)
+            e->finish();
+    }
+
+
     // The factory method that creates a SQLite Query.
     Retained<Query> SQLiteDataFile::compileQuery(slice selectorExpression,
                                                  QueryLanguage language,
@@ -565,6 +867,9 @@ namespace litecore {
     // The factory method that creates a SQLite QueryEnumerator, but only if the database has
     // changed since lastSeq.
     QueryEnumerator* SQLiteQuery::createEnumerator(const Options *options) {
+        // Index tables mustn't be stale if this connection has deferred indexing:
+        ((SQLiteDataFile&)dataFile()).refreshDeferredIndexes();
+
         // Start a read-only transaction, to ensure that the result of lastSequence() and purgeCount() will be
         // consistent with the query results.
         ReadOnlyTransaction t(dataFile());
@@ -573,8 +878,181 @@ namespace litecore {
         uint64_t purgeCnt = purgeCount();
         if(options && options->notOlderThan(curSeq, purgeCnt))
             return nullptr;
+        if (options && options->streaming) {
+            Retained<SQLiteStreamingQueryEnumerator> e =
+                                new SQLiteStreamingQueryEnumerator(this, options, curSeq, purgeCnt);
+            e->start();
+            return std::move(e).detach();
+        }
+        if (options && options->cacheResults) {
+            if (auto e = cachedEnumerator(*options, curSeq, purgeCnt))
+                return e;
+        }
         SQLiteQueryRunner recorder(this, options, curSeq, purgeCnt);
-        return recorder.fastForward();
+        SQLiteQueryEnumerator *e = recorder.fastForward();
+        if (options && options->cacheResults)
+            cacheResults(e);
+        return e;
+    }
+
+
+    SQLiteQueryEnumerator* SQLiteQuery::cachedEnumerator(const Options &options,
+                                                         sequence_t curSeq,
+                                                         uint64_t purgeCnt)
+    {
+        Retained<Doc> recording;
+        {
+            lock_guard<mutex> lock(_resultCacheMutex);
+            auto i = _resultCache.find(options.paramBindings);
+            if (i == _resultCache.end())
+                return nullptr;
+            CachedResult &cached = i->second;
+            if (cached.lastSequence != curSeq || cached.purgeCount != purgeCnt) {
+                _resultCache.erase(i);
+                return nullptr;
+            }
+            cached.lastUsed = ++_resultCacheClock;
+            recording = cached.recording;
+        }
+        logVerbose("Reusing cached results");
+        auto rowCount = recording->asArray()->count() / 2;
+        return new SQLiteQueryEnumerator(this, &options, curSeq, purgeCnt,
+                                         recording, rowCount, 0.0);
+    }
+
+
+    void SQLiteQuery::cacheResults(SQLiteQueryEnumerator *e) {
+        lock_guard<mutex> lock(_resultCacheMutex);
+        auto &key = e->options().paramBindings;
+        if (_resultCache.size() >= kMaxCachedResults && _resultCache.find(key) == _resultCache.end()) {
+            // Evict the least recently used entry:
+            auto lru = _resultCache.begin();
+            for (auto i = _resultCache.begin(); i != _resultCache.end(); ++i) {
+                if (i->second.lastUsed < lru->second.lastUsed)
+                    lru = i;
+            }
+            _resultCache.erase(lru);
+        }
+        _resultCache[key] = {e->recording(), e->lastSequence(), e->purgeCount(),
+                             ++_resultCacheClock};
+    }
+
+
+#pragma mark - INCREMENTAL CHANGES:
+
+
+    static constexpr slice kSinceParameter = "_lq_since"_sl;
+
+
+    // Compiles the statements used by findChangedDocuments. The matching-changes statement is
+    // compiled from a variant of the query whose only result is the doc ID, and whose WHERE
+    // clause also requires the doc's sequence to be greater than the `$_lq_since` parameter.
+    bool SQLiteQuery::prepareIncremental() {
+        if (_incrementalState != IncrementalState::Unprepared)
+            return _incrementalState == IncrementalState::Prepared;
+        _incrementalState = IncrementalState::Unsupported;
+        try {
+            Retained<Doc> doc = Doc::fromJSON(_json);
+            const Dict *query = doc->root()->asDict();
+            if (!query)
+                return false;
+
+            Encoder enc;
+            enc.beginDictionary();
+            const Value *where = nullptr;
+            for (Dict::iterator i(query); i; ++i) {
+                slice key = i.keyString();
+                if (key.caseEquivalent("WHERE"_sl))
+                    where = i.value();
+                else if (key.caseEquivalent("FROM"_sl)) {
+                    enc.writeKey(key);
+                    enc.writeValue(i.value());
+                }
+                // (All other clauses -- WHAT, ORDER_BY, GROUP_BY, LIMIT... -- are left out.)
+            }
+            enc.writeKey("WHAT"_sl);
+            enc.beginArray();
+            enc.beginArray();
+            enc.writeString(slice(_propertyPrefix + "_id"));
+            enc.endArray();
+            enc.endArray();
+
+            enc.writeKey("WHERE"_sl);
+            enc.beginArray();
+            enc.writeString("AND"_sl);
+            enc.beginArray();
+            enc.writeString(">"_sl);
+            enc.beginArray();
+            enc.writeString(slice(_propertyPrefix + "_sequence"));
+            enc.endArray();
+            enc.beginArray();
+            enc.writeString(slice("$" + string(kSinceParameter)));
+            enc.endArray();
+            enc.endArray();
+            if (where)
+                enc.writeValue(where);
+            else
+                enc.writeBool(true);
+            enc.endArray();
+            enc.endDictionary();
+            Retained<Doc> probe = enc.finishDoc();
+
+            auto &df = (SQLiteDataFile&)dataFile();
+            const string &tableName = _keyStores[0]->tableName();
+            QueryParser qp(df, tableName);
+            qp.parse(probe->root());
+            _matchingChangesStatement = df.compile(qp.SQL().c_str());
+            _changesStatement = df.compile(("SELECT key FROM \"" + tableName
+                                            + "\" WHERE sequence > ?").c_str());
+        } catch (const std::exception &x) {
+            logInfo("Query can't report changed documents: %s", x.what());
+            _matchingChangesStatement.reset();
+            _changesStatement.reset();
+            return false;
+        }
+        _incrementalState = IncrementalState::Prepared;
+        return true;
+    }
+
+
+    bool SQLiteQuery::findChangedDocuments(const Options &options,
+                                           sequence_t afterSequence,
+                                           bool matchingOnly,
+                                           ChangedDocCallback callback)
+    {
+        if (!_statement || !prepareIncremental())
+            return false;
+
+        // First the changed docs that match the WHERE clause:
+        unordered_set<string> matching;
+        {
+            auto &stmt = *_matchingChangesStatement;
+            stmt.clearBindings();
+            set<string> unbound;
+            if (options.paramBindings)
+                bindQueryParameters(stmt, options.paramBindings, unbound, true);
+            stmt.bind("$_" + string(kSinceParameter), (long long)afterSequence);
+            UsingStatement u(stmt);
+            while (stmt.executeStep()) {
+                slice docID = getColumnAsSlice(stmt, 0);
+                if (!matchingOnly)
+                    matching.emplace(docID);
+                callback(docID, true);
+            }
+        }
+
+        // Then the rest of the changed docs, including deleted ones:
+        if (!matchingOnly) {
+            auto &stmt = *_changesStatement;
+            stmt.bind(1, (long long)afterSequence);
+            UsingStatement u(stmt);
+            while (stmt.executeStep()) {
+                slice docID = getColumnAsSlice(stmt, 0);
+                if (matching.find(string(docID)) == matching.end())
+                    callback(docID, false);
+            }
+        }
+        return true;
     }
 
 }
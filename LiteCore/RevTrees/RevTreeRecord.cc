@@ -200,42 +200,62 @@ namespace litecore {
         Assert(revsAvailable());
         if (!_changed)
             return kNoNewSequence;
-        updateMeta();
-        sequence_t sequence = _rec.sequence();
         bool createSequence;
-        if (auto cur = currentRevision(); cur) {
-            createSequence = (sequence == 0 || hasNewRevisions());
-            removeNonLeafBodies();
-            slice newBody;
-            alloc_slice newExtra;
-            std::tie(newBody, newExtra) = encode();
-
-            RecordUpdate newRec(_rec);
-            newRec.body = newBody;
-            newRec.extra = newExtra;
-
-            sequence = _store.set(newRec, createSequence, transaction);
-            if (!sequence)
-                return kConflict;               // Conflict
-
-            if (createSequence)
-                _rec.updateSequence(sequence);
-            else
-                _rec.updateSubsequence();
-            _rec.setExists();
-            
-            // (Don't update _rec body or extra, because it'd invalidate all the inner pointers from
-            // Rev objects into the existing body/extra buffer.)
-            LogVerbose(DBLog, "Saved doc '%.*s' #%s; body=%zu, extra=%zu",
-                  SPLAT(newRec.key), revid(newRec.version).str().c_str(),
-                  newRec.body.size, newRec.extra.size);
-            if (createSequence)
-                saved(sequence);
+        if (auto newRec = prepareSave(createSequence); newRec) {
+            sequence_t sequence = _store.set(*newRec, createSequence, transaction);
+            return finishSave(*newRec, createSequence, sequence);
         } else {
-            createSequence = false;
+            // No current revision, so delete the record:
+            sequence_t sequence = _rec.sequence();
             if (sequence && !_store.del(_rec.key(), transaction, sequence))
                 return kConflict;
+            _changed = false;
+            return kNoNewSequence;
+        }
+    }
+
+    std::optional<RecordUpdate> RevTreeRecord::prepareSave(bool &createSequence) {
+        Assert(revsAvailable());
+        createSequence = false;
+        if (!_changed)
+            return std::nullopt;
+        updateMeta();
+        if (!currentRevision())
+            return std::nullopt;
+        createSequence = (_rec.sequence() == 0 || hasNewRevisions());
+        removeNonLeafBodies();
+        slice newBody;
+        std::tie(newBody, _pendingExtra) = encode();
+
+        RecordUpdate newRec(_rec);
+        newRec.body = newBody;
+        newRec.extra = _pendingExtra;
+        return newRec;
+    }
+
+    RevTreeRecord::SaveResult RevTreeRecord::finishSave(const RecordUpdate &newRec,
+                                                        bool createSequence,
+                                                        sequence_t sequence)
+    {
+        if (!sequence) {
+            _pendingExtra = nullslice;
+            return kConflict;               // Conflict
         }
+
+        if (createSequence)
+            _rec.updateSequence(sequence);
+        else
+            _rec.updateSubsequence();
+        _rec.setExists();
+
+        // (Don't update _rec body or extra, because it'd invalidate all the inner pointers from
+        // Rev objects into the existing body/extra buffer.)
+        LogVerbose(DBLog, "Saved doc '%.*s' #%s; body=%zu, extra=%zu",
+              SPLAT(newRec.key), revid(newRec.version).str().c_str(),
+              newRec.body.size, newRec.extra.size);
+        if (createSequence)
+            saved(sequence);
+        _pendingExtra = nullslice;
         _changed = false;
         return createSequence ? kNewSequence : kNoNewSequence;
     }
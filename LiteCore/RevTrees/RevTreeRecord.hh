@@ -21,6 +21,7 @@
 #include "Record.hh"
 #include "Doc.hh"
 #include <memory>
+#include <optional>
 #include <vector>
 
 namespace fleece { namespace impl {
@@ -68,6 +69,14 @@ namespace litecore {
         enum SaveResult {kConflict, kNoNewSequence, kNewSequence};
         SaveResult save(ExclusiveTransaction& transaction);
 
+        /** The two halves of `save`, for writing many records with `KeyStore::setBatch`.
+            `prepareSave` encodes the record and returns the update to write; it returns nullopt
+            if the record is unchanged, or has no current revision and so must be deleted by
+            calling `save`. After writing, pass the update and the resulting sequence (0 on
+            conflict) to `finishSave`. */
+        std::optional<RecordUpdate> prepareSave(bool &createSequence);
+        SaveResult finishSave(const RecordUpdate&, bool createSequence, sequence_t);
+
         bool updateMeta();
 
         fleece::Retained<fleece::impl::Doc> fleeceDocFor(slice) const;
@@ -108,5 +117,6 @@ namespace litecore {
         Record          _rec;
         std::vector<Retained<VersFleeceDoc>> _fleeceScopes;
         ContentOption   _contentLoaded;
+        alloc_slice     _pendingExtra;          // Encoded `extra` between prepareSave/finishSave
     };
 }
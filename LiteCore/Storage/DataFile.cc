@@ -101,7 +101,8 @@ namespace litecore {
 
     const DataFile::Options DataFile::Options::defaults = {
         {true},                 // sequences
-        true, true, true, true  // create, writeable, useDocumentKeys, upgradeable
+        true, true, true, true, // create, writeable, useDocumentKeys, upgradeable
+        false                   // deferIndexing
     };
 
 
@@ -144,9 +145,7 @@ namespace litecore {
         //    other classes with interest in the data file do not continue to
         //    operate on it
         _closeSignaled = true;
-        for (auto &query : _queries)
-            query->close();
-        _queries.clear();
+        closeQueries();
 
         for (auto& i : _keyStores) {
             i.second->close();
@@ -220,6 +219,10 @@ namespace litecore {
     {
         shared->condemn(true);
         try {
+            // Streaming query enumerators have connections of their own; close them first:
+            if (file)
+                file->closeQueries();
+
             // Wait for other connections to close -- in multithreaded setups there may be races where
             // another thread takes a bit longer to close its connection.
             int n = 0;
@@ -428,6 +431,30 @@ namespace litecore {
     }
 
 
+    void DataFile::registerQuery(Query *query) {
+        lock_guard<mutex> lock(_queriesMutex);
+        _queries.insert(query);
+    }
+
+    void DataFile::unregisterQuery(Query *query) {
+        lock_guard<mutex> lock(_queriesMutex);
+        _queries.erase(query);
+    }
+
+    void DataFile::closeQueries() {
+        lock_guard<mutex> lock(_queriesMutex);
+        for (auto &query : _queries)
+            query->close();
+        _queries.clear();
+    }
+
+    void DataFile::finishStreamingQueries() {
+        lock_guard<mutex> lock(_queriesMutex);
+        for (auto &query : _queries)
+            query->finishStreaming();
+    }
+
+
     ReadOnlyTransaction::ReadOnlyTransaction(DataFile *db) {
         db->beginReadOnlyTransaction();
         _db = db;
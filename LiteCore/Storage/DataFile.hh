@@ -26,6 +26,7 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <atomic> // for std::atomic_uint
+#include <mutex>
 #ifdef check
 #undef check
 #endif
@@ -65,6 +66,7 @@ namespace litecore {
             bool                writeable      :1;      ///< If false, db is opened read-only
             bool                useDocumentKeys:1;      ///< Use SharedKeys for Fleece docs
             bool                upgradeable    :1;      ///< DB schema can be upgraded
+            bool                deferIndexing  :1;      ///< Update FTS/array indexes at commit
             EncryptionAlgorithm encryptionAlgorithm;    ///< What encryption (if any)
             alloc_slice         encryptionKey;          ///< Encryption key, if encrypting
             static const Options defaults;
@@ -126,8 +128,8 @@ namespace litecore {
         virtual fleece::alloc_slice rawQuery(const std::string &query) =0;
 
         // to be called only by Query:
-        void registerQuery(Query *query)        {_queries.insert(query);}
-        void unregisterQuery(Query *query)      {_queries.erase(query);}
+        void registerQuery(Query *query);
+        void unregisterQuery(Query *query);
 
         //////// KEY-STORES:
 
@@ -240,6 +242,10 @@ namespace litecore {
 
         void forOpenKeyStores(function_ref<void(KeyStore&)> fn);
 
+        /** Calls finishStreaming() on every open Query. Call this before ending a transaction,
+            if streaming query enumerators may be reading inside it. */
+        void finishStreamingQueries();
+
         virtual Factory& factory() const =0;
 
     private:
@@ -253,6 +259,7 @@ namespace litecore {
                                    Shared *shared, Factory &factory);
         
         KeyStore& addKeyStore(const std::string &name, KeyStore::Capabilities);
+        void closeQueries();
         void beginTransactionScope(ExclusiveTransaction*);
         void transactionBegan(ExclusiveTransaction*);
         void transactionEnding(ExclusiveTransaction*, bool committing);
@@ -270,6 +277,7 @@ namespace litecore {
         std::unordered_map<std::string, unique_ptr<KeyStore>> _keyStores;// Opened KeyStores
         mutable Retained<fleece::impl::PersistentSharedKeys> _documentKeys;
         std::unordered_set<Query*> _queries;                    // Query objects
+        std::mutex              _queriesMutex;                  // Guards _queries
         bool                    _inTransaction {false};         // Am I in a Transaction?
         std::atomic_bool        _closeSignaled {false};         // Have I been asked to close?
     };
@@ -61,6 +61,17 @@ namespace litecore {
         }
     }
 
+    vector<sequence_t> KeyStore::setBatch(const vector<RecordUpdate> &recs,
+                                          bool updateSequence,
+                                          ExclusiveTransaction &t)
+    {
+        vector<sequence_t> seqs;
+        seqs.reserve(recs.size());
+        for (auto &rec : recs)
+            seqs.push_back(set(rec, updateSequence, t));
+        return seqs;
+    }
+
     void KeyStore::setKV(Record& rec, ExclusiveTransaction &t) {
         setKV(rec.key(), rec.version(), rec.body(), t);
         rec.setExists();
@@ -103,6 +103,14 @@ namespace litecore {
                                bool updateSequence,
                                ExclusiveTransaction &transaction) MUST_USE_RESULT =0;
 
+        /** Writes a batch of records, with the same semantics as calling `set` on each in order.
+            Implementations can amortize statement setup and sequence bookkeeping across the
+            batch, which matters when inserting thousands of records in one transaction.
+            @return  The records' new sequence numbers, in the same order; 0 marks a conflict. */
+        virtual std::vector<sequence_t> setBatch(const std::vector<RecordUpdate> &recs,
+                                                 bool updateSequence,
+                                                 ExclusiveTransaction &transaction) MUST_USE_RESULT;
+
         /** Alternative `set` that takes a `Record` directly.
             It updates the `sequence` property, instead of returning the new sequence.
             It throws a Conflict exception on conflict. */
@@ -35,10 +35,10 @@ namespace litecore {
                                        Options options)
     :_store(&store)
     {
-        LogVerbose(QueryLog, "RecordEnumerator %p: (%s, %d%d%d %d)",
+        LogVerbose(QueryLog, "RecordEnumerator %p: (%s, %d%d%d %d, limit %llu)",
                 this, store.name().c_str(),
                 options.includeDeleted, options.onlyConflicts, options.onlyBlobs,
-                options.sortOption);
+                options.sortOption, (unsigned long long)options.limit);
         _impl.reset(_store->newEnumeratorImpl(false, 0, options));
     }
 
@@ -33,6 +33,11 @@ namespace litecore {
     };
 
     /** KeyStore enumerator/iterator that returns a range of Records.
+        When enumerating by key, `startKey` and `endKey` are in iteration order; so if the
+        enumeration is descending, `startKey` is the higher one. They're ignored when
+        enumerating by sequence.
+        To page through a KeyStore, set `limit`, then start the next page at the last key
+        returned with `inclusiveStart` false; each page only reads the records it returns.
         Usage:
             for (auto e=db.enumerate(); e.next(); ) {...}
         or
@@ -49,6 +54,12 @@ namespace litecore {
             bool           onlyConflicts  = false;   ///< Only include records with conflicts
             SortOption     sortOption     = kAscending;    ///< Sort order, or unsorted
             ContentOption  contentOption  = kEntireBody;       ///< Load record bodies?
+            slice          startKey;                 ///< First key to return, if any
+            slice          endKey;                   ///< Last key to return, if any
+            bool           inclusiveStart = true;    ///< Include a record whose key is `startKey`?
+            bool           inclusiveEnd   = true;    ///< Include a record whose key is `endKey`?
+            sequence_t     maxSequence    = 0;       ///< If nonzero, skip records with higher sequences
+            uint64_t       limit          = 0;       ///< If nonzero, max number of records to return
 
             Options() { }
         };
@@ -195,15 +195,44 @@ namespace litecore {
     }
 
 
+    // Delegate of the connections opened by openStreamConnection. It forwards to the main
+    // connection's delegate, but doesn't pass on notifications of commits, since those are
+    // already delivered to the main connection.
+    class StreamConnectionDelegate final : public DataFile::Delegate {
+    public:
+        explicit StreamConnectionDelegate(DataFile::Delegate *delegate) :_delegate(delegate) { }
+
+        string databaseName() const override {
+            return _delegate->databaseName();
+        }
+        alloc_slice blobAccessor(const fleece::impl::Dict *blob) const override {
+            return _delegate->blobAccessor(blob);
+        }
+
+    private:
+        DataFile::Delegate* const _delegate;
+    };
+
+
     SQLiteDataFile::SQLiteDataFile(const FilePath &path,
                                    DataFile::Delegate *delegate,
                                    const Options *options)
     :DataFile(path, delegate, options)
+    ,_streamDelegate(new StreamConnectionDelegate(delegate))
     {
         reopen();
     }
 
 
+    unique_ptr<SQLiteDataFile> SQLiteDataFile::openStreamConnection() {
+        checkOpen();
+        Options readOptions = options();
+        readOptions.create = readOptions.writeable = readOptions.upgradeable = false;
+        return unique_ptr<SQLiteDataFile>(
+                        factory().openFile(filePath(), _streamDelegate.get(), &readOptions));
+    }
+
+
     SQLiteDataFile::~SQLiteDataFile() {
         close();
     }
@@ -214,7 +243,7 @@ namespace litecore {
         reopenSQLiteHandle();
         decrypt();
 
-        withFileLock([this]{
+        auto checkSchema = [this]{
             // http://www.sqlite.org/pragma.html
             _schemaVersion = SchemaVersion((int)_sqlDb->execAndGet("PRAGMA user_version"));
             bool isNew = false;
@@ -228,7 +257,7 @@ namespace litecore {
                       "BEGIN; "
                       "CREATE TABLE IF NOT EXISTS "      // Table of metadata about KeyStores
                       "  kvmeta (name TEXT PRIMARY KEY, lastSeq INTEGER DEFAULT 0, purgeCnt INTEGER DEFAULT 0) WITHOUT ROWID; "
-                      "PRAGMA user_version=400; "
+                      "PRAGMA user_version=500; "
                       "END;"
                       );
                 Assert(intQuery("PRAGMA auto_vacuum") == 2, "Incremental vacuum was not enabled!");
@@ -275,7 +304,30 @@ namespace litecore {
                 }
                 _schemaVersion = SchemaVersion::WithNewDocs;
             }
-        });
+
+            if (_schemaVersion < SchemaVersion::WithBlobIndex && options().writeable) {
+                // Schema upgrade: Older versions don't update the index of the blobs used by
+                // documents (see BlobReferences), and blob garbage collection would delete blobs
+                // they've added references to. So lock them out, and throw away any index that
+                // was built before, since it can't be trusted to be complete.
+                if (!options().upgradeable)
+                    error::_throw(error::CantUpgradeDatabase,
+                                  "Database needs upgrade to index blob references");
+                _exec("BEGIN; ");
+                if (tableExists("kv_" + DataFile::kInfoKeyStoreName))
+                    _exec("DELETE FROM kv_" + DataFile::kInfoKeyStoreName
+                          + " WHERE key='blobRefsComplete'; ");
+                _exec("PRAGMA user_version=500; "
+                      "END;");
+                _schemaVersion = SchemaVersion::WithBlobIndex;
+            }
+        };
+        // A read-only connection won't create or upgrade the schema, so it needn't wait for
+        // transactions on other connections to end:
+        if (options().writeable)
+            withFileLock(checkSchema);
+        else
+            checkSchema();
 
         _exec(format("PRAGMA cache_size=%d; "            // Memory cache
                      "PRAGMA mmap_size=%d; "             // Memory-mapped reads
@@ -307,6 +359,8 @@ namespace litecore {
         int rc = register_unicodesn_tokenizer(sqlite);
         if (rc != SQLITE_OK)
             warn("Unable to register FTS tokenizer: SQLite err %d", rc);
+        else if ((rc = RegisterFTS5Functions(sqlite)) != SQLITE_OK)
+            warn("Unable to register FTS5 tokenizer: SQLite err %d", rc);
     }
 
 
@@ -511,6 +565,20 @@ namespace litecore {
 
 
     void SQLiteDataFile::_endTransaction(ExclusiveTransaction *t, bool commit) {
+        if (commit) {
+            try {
+                endDeferredIndexing();
+            } catch (...) {
+                // The indexes can't be brought up to date, so the changes can't be committed:
+                _endTransaction(t, false);
+                throw;
+            }
+        }
+
+        // COMMIT/ROLLBACK releases the savepoints of streaming enumerators reading inside this
+        // transaction (the others have connections of their own):
+        finishStreamingQueries();
+
         // Notify key-stores so they can save state:
         forOpenKeyStores([commit](KeyStore &ks) {
             ((SQLiteKeyStore&)ks).transactionWillEnd(commit);
@@ -520,6 +588,24 @@ namespace litecore {
     }
 
 
+    void SQLiteDataFile::refreshDeferredIndexes() {
+        if (options().deferIndexing && inTransaction()) {
+            forOpenKeyStores([](KeyStore &ks) {
+                ((SQLiteKeyStore&)ks).refreshDeferredIndexes();
+            });
+        }
+    }
+
+
+    void SQLiteDataFile::endDeferredIndexing() {
+        if (options().deferIndexing && inTransaction()) {
+            forOpenKeyStores([](KeyStore &ks) {
+                ((SQLiteKeyStore&)ks).endDeferredIndexing();
+            });
+        }
+    }
+
+
     void SQLiteDataFile::beginReadOnlyTransaction() {
         checkOpen();
         _exec("SAVEPOINT roTransaction");
@@ -699,6 +785,12 @@ namespace litecore {
         return onTable + "::" + property;
     }
 
+    bool SQLiteDataFile::isFTS5Table(const string &tableName) const {
+        string sql;
+        return getSchema(tableName, "table", tableName, sql)
+            && sql.find(" USING fts5(") != string::npos;
+    }
+
     string SQLiteDataFile::unnestedTableName(const string &onTable, const string &property) const {
         return onTable + ":unnest:" + property;
     }
@@ -816,10 +908,30 @@ namespace litecore {
     }
 
 
+    // Merges the b-trees of each FTS5 index into one, which speeds up queries. (FTS5 otherwise
+    // merges incrementally as it's updated, according to its 'automerge' option.)
+    void SQLiteDataFile::optimizeFTS5Indexes() {
+        vector<string> tables;
+        {
+            SQLite::Statement stmt(*_sqlDb, "SELECT name FROM sqlite_master "
+                                            "WHERE type='table' AND sql LIKE '% USING fts5(%'");
+            while (stmt.executeStep())
+                tables.push_back(stmt.getColumn(0).getString());
+        }
+        for (auto &table : tables) {
+            fleece::Stopwatch st;
+            execWithLock(CONCAT("INSERT INTO \"" << table << "\" (\"" << table << "\") "
+                                "VALUES ('optimize')"));
+            logInfo("Optimized FTS5 index table '%s' in %.3f sec", table.c_str(), st.elapsed());
+        }
+    }
+
+
     void SQLiteDataFile::maintenance(MaintenanceType what) {
         checkOpen();
         switch (what) {
             case kCompact:
+                optimizeFTS5Indexes();
                 _optimize();
                 _vacuum(true);
                 break;
@@ -839,6 +951,7 @@ namespace litecore {
             case kFullOptimize:
                 /* "...to disable the analysis limit, causing ANALYZE to do a complete scan of each
                     index, set the analysis limit to 0." */
+                optimizeFTS5Indexes();
                 execWithLock("PRAGMA analysis_limit=0; ANALYZE");
                 break;
             default:
@@ -848,6 +961,7 @@ namespace litecore {
 
 
     alloc_slice SQLiteDataFile::rawQuery(const string &query) {
+        refreshDeferredIndexes();
         SQLite::Statement stmt(*_sqlDb, query);
         int nCols = stmt.getColumnCount();
         fleece::Encoder enc;
@@ -54,6 +54,7 @@ namespace litecore {
         void vacuum(bool always) noexcept;
         void _vacuum(bool always);
         void integrityCheck();
+        void optimizeFTS5Indexes();
         void maintenance(MaintenanceType) override;
 
         static void shutdown() { }
@@ -94,10 +95,19 @@ namespace litecore {
 
         Retained<Query> compileQuery(slice expression, QueryLanguage, KeyStore*) override;
 
+        /// If indexing is deferred (Options::deferIndexing), brings the index tables up to date
+        /// with the changes made so far in the current transaction. Called before queries run.
+        void refreshDeferredIndexes();
+
+        /// Opens another, read-only connection to the file, for a streaming query enumerator to
+        /// step through while other transactions come and go on this one.
+        std::unique_ptr<SQLiteDataFile> openStreamConnection();
+
     // QueryParser::delegate:
         virtual bool tableExists(const std::string &tableName) const override;
         virtual string collectionTableName(const string &collection) const override;
         virtual std::string FTSTableName(const string &collection, const std::string &property) const override;
+        virtual bool isFTS5Table(const std::string &tableName) const override;
         virtual std::string unnestedTableName(const string &collection, const std::string &property) const override;
 #ifdef COUCHBASE_ENTERPRISE
         virtual std::string predictiveTableName(const string &collection, const std::string &property) const override;
@@ -138,6 +148,7 @@ namespace litecore {
         void deleteIndex(const SQLiteIndexSpec&);
         std::optional<SQLiteIndexSpec> getIndex(slice name);
         std::vector<SQLiteIndexSpec> getIndexes(const KeyStore*);
+        void endDeferredIndexing();
 
     private:
         friend class SQLiteKeyStore;
@@ -147,14 +158,16 @@ namespace litecore {
         enum class SchemaVersion {
             None            = 0,    // Newly created database
             MinReadable     = 201,  // Cannot open earlier versions than this (CBL 2.0)
-            MaxReadable     = 499,  // Cannot open versions newer than this
+            MaxReadable     = 599,  // Cannot open versions newer than this
 
             WithIndexTable  = 301,  // Added 'indexes' table (CBL 2.5)
             WithPurgeCount  = 302,  // Added 'purgeCnt' column to KeyStores (CBL 2.7)
 
             WithNewDocs     = 400,  // New document/revision storage (CBL 3.0)
 
-            Current = WithNewDocs
+            WithBlobIndex   = 500,  // Documents' blobs are indexed; older versions can't write
+
+            Current = WithBlobIndex
         };
 
         void reopenSQLiteHandle();
@@ -178,6 +191,7 @@ namespace litecore {
         mutable unique_ptr<SQLite::Statement>   _getPurgeCntStmt, _setPurgeCntStmt;
         CollationContextVector          _collationContexts;
         SchemaVersion                   _schemaVersion {SchemaVersion::None};
+        unique_ptr<DataFile::Delegate>  _streamDelegate; // Delegate of openStreamConnection's
     };
 
 
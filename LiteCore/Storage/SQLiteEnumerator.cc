@@ -36,12 +36,11 @@ namespace litecore {
 
    class SQLiteEnumerator : public RecordEnumerator::Impl {
     public:
-        SQLiteEnumerator(SQLite::Statement *stmt, ContentOption content)
-        :_stmt(stmt),
-         _content(content)
-        {
-            LogTo(SQL, "Enumerator: %s", _stmt->getQuery().c_str());
-        }
+        SQLiteEnumerator(shared_ptr<SQLite::Statement> stmt, ContentOption content)
+        :_stmt(move(stmt))
+        ,_using(*_stmt)
+        ,_content(content)
+        { }
 
         virtual bool next() override {
             return _stmt->executeStep();
@@ -54,17 +53,53 @@ namespace litecore {
         }
 
     private:
-        unique_ptr<SQLite::Statement> _stmt;
+        shared_ptr<SQLite::Statement> _stmt;
+        UsingStatement _using;          // Resets the statement when I'm done, so it can be reused
         ContentOption _content;
     };
 
 
+    // Returns a compiled statement for an enumerator. Statements are cached by their SQL, which
+    // only depends on the combination of options; the parameters are bound afterwards.
+    // A cached statement can only be used by one enumerator at a time, so if it's busy a new
+    // uncached one is compiled. The cache's own reference only changes under _stmtMutex, so a
+    // use_count of 1 seen while holding it means no enumerator has the statement.
+    shared_ptr<SQLite::Statement> SQLiteKeyStore::compileEnumerator(const string &sql) {
+        {
+            lock_guard<mutex> lock(_stmtMutex);
+            auto i = _enumStmtCache.find(sql);
+            if (i != _enumStmtCache.end() && i->second.use_count() == 1) {
+                db().checkOpen();
+                return i->second;
+            }
+        }
+
+        shared_ptr<SQLite::Statement> stmt(db().compile(sql.c_str()));
+        if (QueryLog.willLog(LogLevel::Debug)) {
+            // https://www.sqlite.org/eqp.html
+            stringstream plan;
+            plan << sql;
+            SQLite::Statement x(db(), "EXPLAIN QUERY PLAN " + sql);
+            while (x.executeStep()) {
+                plan << "\n\t";
+                for (int i = 0; i < 3; ++i)
+                    plan << x.getColumn(i).getInt() << "|";
+                plan << " " << x.getColumn(3).getText();
+            }
+            LogDebug(QueryLog, "%s", plan.str().c_str());
+        }
+        lock_guard<mutex> lock(_stmtMutex);
+        _enumStmtCache.emplace(sql, stmt);     // no-op if another statement got cached meanwhile
+        return stmt;
+    }
+
+
     RecordEnumerator::Impl* SQLiteKeyStore::newEnumeratorImpl(bool bySequence,
                                                               sequence_t since,
                                                               RecordEnumerator::Options options)
     {
         if (_db.options().writeable) {
-            if (bySequence)
+            if (bySequence || options.maxSequence > 0)
                 createSequenceIndex();
             if (options.onlyConflicts)
                 createConflictsIndex();
@@ -81,16 +116,22 @@ namespace litecore {
         sql << " FROM kv_" << name();
         
         bool writeAnd = false;
-        if (bySequence) {
-            sql << " WHERE sequence > ?";
+        auto beginCondition = [&] {
+            sql << (writeAnd ? " AND " : " WHERE ");
             writeAnd = true;
-        } else {
-            if (!options.includeDeleted || options.onlyBlobs || options.onlyConflicts)
-                sql << " WHERE ";
+        };
+
+        if (bySequence) {
+            beginCondition();
+            sql << "sequence > ?";
+        }
+        if (options.maxSequence > 0) {
+            beginCondition();
+            sql << "sequence <= ?";
         }
 
         auto writeFlagTest = [&](DocumentFlags flag, const char *test) {
-            if (writeAnd) sql << " AND "; else writeAnd = true;
+            beginCondition();
             sql << "(flags & " << int(flag) << ") " << test;
         };
         
@@ -101,31 +142,44 @@ namespace litecore {
         if (options.onlyConflicts)
             writeFlagTest(DocumentFlags::kConflicted, "!= 0");
 
+        // Key range; this lets SQLite seek the primary-key index instead of scanning:
+        bool descending = (options.sortOption == kDescending);
+        slice startKey, endKey;
+        if (!bySequence) {
+            startKey = options.startKey;
+            endKey = options.endKey;
+        }
+        if (startKey) {
+            beginCondition();
+            sql << "key " << (descending ? "<" : ">") << (options.inclusiveStart ? "= ?" : " ?");
+        }
+        if (endKey) {
+            beginCondition();
+            sql << "key " << (descending ? ">" : "<") << (options.inclusiveEnd ? "= ?" : " ?");
+        }
+
         if (options.sortOption != kUnsorted) {
             sql << (bySequence ? " ORDER BY sequence" : " ORDER BY key");
             if (options.sortOption == kDescending)
                 sql << " DESC";
         }
+        if (options.limit > 0)
+            sql << " LIMIT ?";
 
-        auto sqlStr = sql.str();
-        auto stmt = new SQLite::Statement(db(), sqlStr);        // TODO: Cache a statement
-        LogTo(SQL, "%s", sqlStr.c_str());
-        if (QueryLog.willLog(LogLevel::Debug)) {
-            // https://www.sqlite.org/eqp.html
-            SQLite::Statement x(db(), "EXPLAIN QUERY PLAN " + sqlStr);
-            while (x.executeStep()) {
-                sql << "\n\t";
-                for (int i = 0; i < 3; ++i)
-                    sql << x.getColumn(i).getInt() << "|";
-                sql << " " << x.getColumn(3).getText();
-            }
-            LogDebug(QueryLog, "%s", sql.str().c_str());
-        }
-
+        auto stmt = compileEnumerator(sql.str());
 
+        int param = 1;
         if (bySequence)
-            stmt->bind(1, (long long)since);
-        return new SQLiteEnumerator(stmt, options.contentOption);
+            stmt->bind(param++, (long long)since);
+        if (options.maxSequence > 0)
+            stmt->bind(param++, (long long)options.maxSequence);
+        if (startKey)
+            stmt->bind(param++, startKey.asString());
+        if (endKey)
+            stmt->bind(param++, endKey.asString());
+        if (options.limit > 0)
+            stmt->bind(param++, (long long)min(options.limit, uint64_t(INT64_MAX)));
+        return new SQLiteEnumerator(move(stmt), options.contentOption);
     }
 
 }
@@ -49,6 +49,7 @@ namespace litecore {
 
 
     void SQLiteDataFile::deleteKeyStore(const std::string &name) {
+        endDeferredIndexing();
         exec("DROP TABLE IF EXISTS kv_" + name);
         // TODO: Do I need to drop indexes, triggers?
     }
@@ -94,6 +95,7 @@ namespace litecore {
     void SQLiteKeyStore::close() {
         // If statements are left open, closing the database will fail with a "db busy" error...
         _stmtCache.clear();
+        _enumStmtCache.clear();
         KeyStore::close();
     }
 
@@ -196,6 +198,10 @@ namespace litecore {
             _hasExpirationColumn = false;
         _uncommittedExpirationColumn = false;
 
+        // (If committing, SQLiteDataFile has already ended deferred indexing; a rollback restores
+        // the triggers by itself.)
+        _deferredTriggers.reset();
+
         if (_existence == kUncommitted) {
             if (commit) {
                 _existence = kCommitted;
@@ -276,6 +282,7 @@ namespace litecore {
         if (db().willLog(LogLevel::Verbose) && name() != "default")
             db()._logVerbose("KeyStore(%-s) set '%.*s'", name().c_str(), SPLAT(key));
 
+        willModify();
         enum { KeyParam = 1, VersionParam, BodyParam };
         auto &stmt = compileCached("INSERT OR REPLACE INTO kv_@ (key, version, body) VALUES (?, ?, ?)");
         UsingStatement u(stmt);
@@ -286,38 +293,42 @@ namespace litecore {
     }
 
 
-    sequence_t SQLiteKeyStore::set(const RecordUpdate &rec, bool updateSequence, ExclusiveTransaction&) {
-        DebugAssert(rec.key.size > 0);
-        DebugAssert(_capabilities.sequences);
+    // About subsequences: Rather than adding another column, we store the subsequence in the
+    // `flags` column, left-shifted so it doesn't interfere with the defined flag bits.
+
+    static constexpr const char* kInsertRecordSQL =
+        "INSERT OR IGNORE INTO kv_@ (version, body, extra, flags, sequence, key)"
+        " VALUES (?, ?, ?, ?, ?, ?)";
+    static constexpr const char* kUpdateRecordSQL =
+        "UPDATE kv_@ SET version=?, body=?, extra=?, flags=?, sequence=?"
+        " WHERE key=? AND sequence=? AND (flags >> 16) = ?";
 
-        // About subsequences: Rather than adding another column, we store the subsequence in the
-        // `flags` column, left-shifted so it doesn't interfere with the defined flag bits.
 
+    // Binds `rec` to the insert or update statement (whichever applies) and runs it.
+    // `newSeq` is the sequence to assign if `updateSequence` is true.
+    // Returns false if the statement's condition wasn't met, i.e. a conflict.
+    static bool execSetStatement(SQLite::Statement &insertStmt,
+                                 SQLite::Statement &updateStmt,
+                                 const RecordUpdate &rec,
+                                 bool updateSequence,
+                                 sequence_t newSeq)
+    {
         enum { VersionParam = 1, BodyParam, ExtraParam, FlagsParam, SequenceParam, KeyParam,
                OldSequenceParam, OldSubsequenceParam };
-        const char *opName;
         SQLite::Statement *stmt;
         if (rec.sequence == 0) {
             // Insert only:
-            stmt = &compileCached(
-                    "INSERT OR IGNORE INTO kv_@ (version, body, extra, flags, sequence, key)"
-                    " VALUES (?, ?, ?, ?, ?, ?)");
-            opName = "insert";
+            stmt = &insertStmt;
         } else {
             // Replace only:
-            stmt = &compileCached(
-                    "UPDATE kv_@ SET version=?, body=?, extra=?, flags=?, sequence=?"
-                    " WHERE key=? AND sequence=? AND (flags >> 16) = ?");
+            stmt = &updateStmt;
             stmt->bind(OldSequenceParam,    (long long)rec.sequence);
             stmt->bind(OldSubsequenceParam, (long long)rec.subsequence);
-            opName = "update";
         }
 
-        sequence_t seq = 0;
+        sequence_t seq = newSeq;
         int64_t rawFlags = int(rec.flags);
-        if (updateSequence) {
-            seq = lastSequence() + 1;
-        } else {
+        if (!updateSequence) {
             Assert(rec.sequence > 0);
             seq = rec.sequence;
             // If we don't update the sequence, update the subsequence so MVCC can work:
@@ -331,11 +342,24 @@ namespace litecore {
         stmt->bindNoCopy(KeyParam,     (const char*)rec.key.buf, (int)rec.key.size);
         stmt->bind      (SequenceParam,(long long)seq);
 
+        UsingStatement u(*stmt);
+        return stmt->exec() > 0;
+    }
+
+
+    sequence_t SQLiteKeyStore::set(const RecordUpdate &rec, bool updateSequence, ExclusiveTransaction&) {
+        DebugAssert(rec.key.size > 0);
+        DebugAssert(_capabilities.sequences);
+
+        sequence_t seq = updateSequence ? lastSequence() + 1 : rec.sequence;
+        willModify();
+
         if (db().willLog(LogLevel::Verbose) && name() != "default")
-            db()._logVerbose("KeyStore(%-s) %s %.*s", name().c_str(), opName, SPLAT(rec.key));
+            db()._logVerbose("KeyStore(%-s) %s %.*s", name().c_str(),
+                             (rec.sequence ? "update" : "insert"), SPLAT(rec.key));
 
-        UsingStatement u(*stmt);
-        if (stmt->exec() == 0)
+        if (!execSetStatement(compileCached(kInsertRecordSQL), compileCached(kUpdateRecordSQL),
+                              rec, updateSequence, seq))
             return 0;               // condition wasn't met, i.e. conflict
 
         if (updateSequence)
@@ -344,8 +368,46 @@ namespace litecore {
     }
 
 
+    vector<sequence_t> SQLiteKeyStore::setBatch(const vector<RecordUpdate> &recs,
+                                                bool updateSequence,
+                                                ExclusiveTransaction&)
+    {
+        DebugAssert(_capabilities.sequences);
+        vector<sequence_t> seqs;
+        seqs.reserve(recs.size());
+        if (recs.empty())
+            return seqs;
+
+        if (db().willLog(LogLevel::Verbose) && name() != "default")
+            db()._logVerbose("KeyStore(%-s) set batch of %zu records", name().c_str(), recs.size());
+
+        willModify();
+        // Look up the statements and the last sequence once, not once per record:
+        auto &insertStmt = compileCached(kInsertRecordSQL);
+        auto &updateStmt = compileCached(kUpdateRecordSQL);
+        sequence_t lastSeq = lastSequence();
+        const sequence_t firstSeq = lastSeq;
+        for (auto &rec : recs) {
+            DebugAssert(rec.key.size > 0);
+            sequence_t seq = updateSequence ? lastSeq + 1 : rec.sequence;
+            if (execSetStatement(insertStmt, updateStmt, rec, updateSequence, seq)) {
+                if (updateSequence)
+                    lastSeq = seq;
+                seqs.push_back(seq);
+            } else {
+                seqs.push_back(0);      // conflict; its sequence goes to the next record
+            }
+        }
+
+        if (lastSeq != firstSeq)
+            setLastSequence(lastSeq);
+        return seqs;
+    }
+
+
     bool SQLiteKeyStore::del(slice key, ExclusiveTransaction&, sequence_t seq) {
         Assert(key);
+        willModify();
         SQLite::Statement *stmt;
         db()._logVerbose("SQLiteKeyStore(%s) del key '%.*s' seq %" PRIu64,
                         _name.c_str(), SPLAT(key), seq);
@@ -373,6 +435,7 @@ namespace litecore {
         if (newKey == nullslice)
             newKey = key;
         sequence_t seq = dstStore->lastSequence() + 1;
+        dstStore->willModify();
 
         // ???? Should the version be reset since it's in a new collection?
         auto &stmt = compileCached(
@@ -403,6 +466,7 @@ namespace litecore {
     bool SQLiteKeyStore::setDocumentFlag(slice key, sequence_t seq, DocumentFlags flags,
                                          ExclusiveTransaction&)
     {
+        willModify();
         // "flags + 0x10000" increments the subsequence stored in the upper bits, for MVCC.
         auto &stmt = compileCached(
                     "UPDATE kv_@ SET flags = ((flags + 0x10000) | ?) WHERE key=? AND sequence=?");
@@ -416,6 +480,7 @@ namespace litecore {
 
     void SQLiteKeyStore::erase() {
         ExclusiveTransaction t(db());
+        willModify();
         db().exec(string("DELETE FROM kv_"+name()));
         setLastSequence(0);
         t.commit();
@@ -438,6 +503,12 @@ namespace litecore {
     }
 
 
+    // Number of docIDs looked up by each step of withDocBodies. Its query has this many
+    // parameters in its `IN (...)` clause, so the same compiled statement serves any number of
+    // docIDs; unused parameters in the last chunk are bound to NULL, which matches nothing.
+    static constexpr unsigned kDocBodiesChunkSize = 128;
+
+
     vector<alloc_slice> SQLiteKeyStore::withDocBodies(const vector<slice> &docIDs,
                                                       WithDocBodyCallback callback)
     {
@@ -446,43 +517,51 @@ namespace litecore {
 
         unordered_map<slice,size_t> docIndices; // maps docID -> index in docIDs[]
         docIndices.reserve(docIDs.size());
+        for (size_t n = 0; n < docIDs.size(); ++n)
+            docIndices.insert({docIDs[n], n});
+
+        // Parameter 1 is the callback, and the rest are docIDs:
+        static const string kSQL = [] {
+            stringstream sql;
+            sql << "SELECT key, fl_callback(key, version, body, extra, sequence, ?) FROM kv_@"
+                   " WHERE key IN (?";
+            for (unsigned i = 1; i < kDocBodiesChunkSize; ++i)
+                sql << ",?";
+            sql << ")";
+            return sql.str();
+        }();
 
-        // Construct SQL query with a big "IN (...)" clause for all the docIDs:
-        stringstream sql;
-        sql << "SELECT key, fl_callback(key, version, body, extra, sequence, ?) FROM kv_" << name()
-            << " WHERE key IN ('";
-        unsigned n = 0;
-        for (slice docID : docIDs) {
-            docIndices.insert({docID, n});
-            if (n++ > 0)
-                sql << "','";
-            if (docID.findByte('\'')) {
-                string escaped(docID);
-                replace(escaped, "'", "''");
-                sql << escaped;
-            } else {
-                sql << docID;
-            }
-        }
-        sql << "')";
-
-        SQLite::Statement stmt(db(), sql.str());
-        LogStatement(stmt);
-        stmt.bindPointer(1, &callback, kWithDocBodiesCallbackPointerType);
+        lock_guard<mutex> lock(_stmtMutex);
+        auto &stmt = compileCached(kSQL);
 
-        // Run the statement and put the results into an array in the same order as docIDs:
+        // Run the statement on each chunk of docIDs, and put the results into an array in the
+        // same order as docIDs:
         alloc_slice empty(size_t(0));
         vector<alloc_slice> results(docIDs.size());
-        while (stmt.executeStep()) {
-            slice docID = getColumnAsSlice(stmt, 0);
-            slice value = getColumnAsSlice(stmt, 1);
-            size_t i = docIndices[docID];
-            //Log("    -- %zu: %.*s --> '%.*s'", i, SPLAT(docID), SPLAT(revs));
-            if (value.size == 0 && value.buf != 0)
-                results[i] = empty;     // reuse one empty slice instead of creating one per row
-            else
-                results[i] = alloc_slice(value);
+        for (size_t start = 0; start < docIDs.size(); start += kDocBodiesChunkSize) {
+            UsingStatement u(stmt);
+            stmt.bindPointer(1, &callback, kWithDocBodiesCallbackPointerType);
+            for (unsigned i = 0; i < kDocBodiesChunkSize; ++i) {
+                if (start + i < docIDs.size()) {
+                    slice docID = docIDs[start + i];
+                    stmt.bindNoCopy(2 + i, (const char*)docID.buf, (int)docID.size);
+                } else {
+                    stmt.bind(2 + i);
+                }
+            }
+            while (stmt.executeStep()) {
+                slice docID = getColumnAsSlice(stmt, 0);
+                slice value = getColumnAsSlice(stmt, 1);
+                size_t i = docIndices[docID];
+                //Log("    -- %zu: %.*s --> '%.*s'", i, SPLAT(docID), SPLAT(revs));
+                if (value.size == 0 && value.buf != 0)
+                    results[i] = empty;     // reuse one empty slice instead of creating one per row
+                else
+                    results[i] = alloc_slice(value);
+            }
         }
+        // Don't leave the cached statement pointing at the caller's docIDs or callback:
+        stmt.clearBindings();
         return results;
     }
 
@@ -577,6 +656,7 @@ namespace litecore {
             }
         }
         if (!none) {
+            willModify();
             expired = db().exec(format("DELETE FROM kv_%s WHERE expiration <= %" PRId64,
                                        name().c_str(), t));
         }
@@ -28,6 +28,7 @@
 
 namespace fleece::impl {
     class ArrayIterator;
+    class MutableArray;
     class Value;
 }
 namespace SQLite {
@@ -64,6 +65,9 @@ namespace litecore {
         bool read(Record &rec, ReadBy, ContentOption) const override;
 
         sequence_t set(const RecordUpdate&, bool updateSequence, ExclusiveTransaction&) override;
+        std::vector<sequence_t> setBatch(const std::vector<RecordUpdate>&,
+                                         bool updateSequence,
+                                         ExclusiveTransaction&) override;
         void setKV(slice key, slice version, slice value, ExclusiveTransaction&) override;
 
         bool del(slice key, ExclusiveTransaction&, sequence_t s = 0) override;
@@ -97,6 +101,10 @@ namespace litecore {
         /// Adds the `expiration` column to the table. Called only by SQLiteQuery.
         void addExpiration();
 
+        /// In deferred-indexing mode, brings this KeyStore's FTS, array and predictive index
+        /// tables up to date with the records changed so far in the current transaction.
+        void refreshDeferredIndexes();
+
     protected:
         virtual bool mayHaveExpiration() override;
         RecordEnumerator::Impl* newEnumeratorImpl(bool bySequence,
@@ -105,9 +113,13 @@ namespace litecore {
 
         std::unique_ptr<SQLite::Statement> compile(const char *sql) const;
         SQLite::Statement& compileCached(const std::string &sqlTemplate) const;
+        std::shared_ptr<SQLite::Statement> compileEnumerator(const std::string &sql);
 
         void transactionWillEnd(bool commit);
 
+        /// Must be called before any change to the table's records.
+        void willModify();
+
         void close() override;
         void reopen() override;
 
@@ -140,21 +152,40 @@ namespace litecore {
                               fleece::impl::ArrayIterator &expressions);
         void _createFlagsIndex(const char *indexName NONNULL, DocumentFlags flag, bool &created);
         bool createFTSIndex(const IndexSpec&);
+        bool setFTS5MergeOptions(const std::string &ftsTableName, const IndexSpec::Options*);
         bool createArrayIndex(const IndexSpec&);
         std::string createUnnestedTable(const fleece::impl::Value *arrayPath, const IndexSpec::Options*);
 
+        // These return the SQL that populates an index table from the records; `rowFilter`, if
+        // not empty, is a condition on `new.rowid` that limits which records are indexed.
+        std::string FTSTablePopulationSQL(const IndexSpec&,
+                                          const std::string &ftsTableName,
+                                          const std::string &rowFilter);
+        std::string unnestedTablePopulationSQL(const fleece::impl::Value *arrayPath,
+                                               const std::string &unnestTableName,
+                                               const std::string &rowFilter);
+
 #ifdef COUCHBASE_ENTERPRISE
         bool createPredictiveIndex(const IndexSpec&);
         std::string createPredictionTable(const fleece::impl::Value *arrayPath, const IndexSpec::Options*);
+        std::string predictionTablePopulationSQL(const fleece::impl::Value *prediction,
+                                                 const std::string &predTableName,
+                                                 const std::string &rowFilter);
+        static fleece::Retained<fleece::impl::MutableArray> predictionOf(const IndexSpec&);
         void garbageCollectPredictiveIndexes();
 #endif
 
+        std::string dirtyTableName() const                  {return tableName() + "::dirty";}
+        void deferIndexing();
+        void endDeferredIndexing();
+
         using StatementCache = std::unordered_map<std::string,std::unique_ptr<SQLite::Statement>>;
 
         enum Existence : uint8_t { kNonexistent, kUncommitted, kCommitted };
 
         mutable std::mutex _stmtMutex;
         mutable StatementCache _stmtCache;
+        std::unordered_map<std::string,std::shared_ptr<SQLite::Statement>> _enumStmtCache;
         bool _createdSeqIndex {false}, _createdConflictsIndex {false}, _createdBlobsIndex {false};
         bool _lastSequenceChanged {false};
         bool _purgeCountChanged {false};
@@ -164,6 +195,9 @@ namespace litecore {
         bool _hasExpirationColumn {false};
         bool _uncommittedExpirationColumn {false};
         Existence _existence;
+        // Names and SQL of the index triggers dropped while indexing is deferred; if present,
+        // indexing has been deferred in this transaction.
+        std::optional<std::vector<std::pair<std::string,std::string>>> _deferredTriggers;
     };
 
 }
@@ -75,4 +75,8 @@ namespace litecore {
 
 
     void RegisterSQLiteFunctions(sqlite3 *db, fleeceFuncContext);
+
+    // Registers the 'unicodesn' tokenizer with FTS5 (it must already be registered with FTS3),
+    // and the `fts5_offsets()` auxiliary function.
+    int RegisterFTS5Functions(sqlite3 *db);
 }
@@ -20,8 +20,11 @@
 #include "Actor.hh"
 #include "Logging.hh"
 #include "Timer.hh"
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <climits>
+#include <cmath>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -32,7 +35,38 @@ namespace litecore { namespace actor {
     static constexpr int AnyGen = INT_MAX;
 
     
-    /** A simple queue that adds objects one at a time and sends them to its target in a batch. */
+    /** Statistics about the batches delivered by a Batcher. */
+    struct BatcherStats {
+        static constexpr size_t kHistogramBuckets = 12;
+
+        uint64_t        batches {0};            ///< Number of batches popped
+        uint64_t        items {0};              ///< Total number of items in them
+        size_t          capacity {0};           ///< Current target batch size
+        Timer::duration latency {};             ///< Current max delay before processing
+        Timer::duration totalWait {};           ///< Sum of times from first push to pop
+        Timer::duration maxWait {};             ///< Longest time from first push to pop
+        Timer::duration totalProcessing {};     ///< Sum of times reported by batchProcessed
+        /// Bucket `i` counts batches of size [2^i, 2^(i+1)); the last bucket is open-ended.
+        std::array<uint64_t, kHistogramBuckets> sizeHistogram {};
+
+        static size_t bucketFor(size_t size) {
+            size_t bucket = 0;
+            while (size > 1 && bucket < kHistogramBuckets - 1) {
+                size >>= 1;
+                ++bucket;
+            }
+            return bucket;
+        }
+    };
+
+
+    /** A simple queue that adds objects one at a time and sends them to its target in a batch.
+
+        In adaptive mode (see \ref setAdaptive) the capacity and latency are not fixed: after
+        each batch the owner reports how long it took to process (\ref batchProcessed), and the
+        capacity is adjusted so that a full batch takes about the target time. When the queue is
+        light -- nothing has piled up and batches are small -- the latency shrinks, since waiting
+        for more items only delays them. */
     template <class ITEM>
     class Batcher {
     public:
@@ -45,9 +79,20 @@ namespace litecore { namespace actor {
         :_processNow(move(processNow))
         ,_processLater(move(processLater))
         ,_latency(latency)
+        ,_maxLatency(latency)
         ,_capacity(capacity)
         { }
 
+        /** Enables adaptive batch sizing. The capacity will be kept within
+            [minCapacity, maxCapacity]; the latency will never exceed the initial value. */
+        void setAdaptive(Timer::duration targetTime, size_t minCapacity, size_t maxCapacity) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _targetTime = targetTime;
+            _minCapacity = std::max(minCapacity, size_t(1));
+            _maxCapacity = std::max(maxCapacity, _minCapacity);
+            _capacity = std::clamp(_capacity, _minCapacity, _maxCapacity);
+        }
+
         /** Adds an item to the queue, and schedules a call to the Actor if necessary.
             Thread-safe. */
         void push(ITEM *item) {
@@ -56,6 +101,7 @@ namespace litecore { namespace actor {
             if (!_items) {
                 _items.reset(new std::vector<Retained<ITEM>>);
                 _items->reserve(_capacity ? _capacity : 200);
+                _firstPushTime = Timer::clock::now();
             }
             _items->push_back(item);
             if (!_scheduled) {
@@ -63,9 +109,11 @@ namespace litecore { namespace actor {
                 _scheduled = true;
                 _processLater(_generation);
             }
-            if (_latency > Timer::duration(0) && _capacity > 0 && _items->size() == _capacity) {
+            if (_maxLatency > Timer::duration(0) && _capacity > 0 && !_full
+                    && _items->size() >= _capacity) {
                 // I'm full -- schedule a pop NOW
                 LogVerbose(SyncLog, "Batcher scheduling immediate pop");
+                _full = true;
                 _processNow(_generation);
             }
         }
@@ -80,18 +128,72 @@ namespace litecore { namespace actor {
             if (gen < _generation)
                 return {};
             _scheduled = false;
+            _full = false;
             ++_generation;
+            if (_items) {
+                auto wait = Timer::clock::now() - _firstPushTime;
+                ++_stats.batches;
+                _stats.items += _items->size();
+                _stats.totalWait += wait;
+                _stats.maxWait = std::max(_stats.maxWait, wait);
+                ++_stats.sizeHistogram[BatcherStats::bucketFor(_items->size())];
+            }
             return move(_items);
         }
 
+        /** Reports that a batch of `count` items returned by \ref pop took `elapsed` to process.
+            Updates the stats, and in adaptive mode the capacity and latency.
+            Thread-safe. */
+        void batchProcessed(size_t count, Timer::duration elapsed) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats.totalProcessing += elapsed;
+            if (_targetTime <= Timer::duration(0) || count == 0)
+                return;
+
+            // Smoothed per-item cost; the capacity is how many items fit in the target time:
+            double perItem = std::chrono::duration<double>(elapsed).count() / count;
+            _perItemTime = (_perItemTime > 0) ? 0.75 * _perItemTime + 0.25 * perItem : perItem;
+            double target = std::chrono::duration<double>(_targetTime).count();
+            double capacity = std::round(target / std::max(_perItemTime, 1e-9));
+            _capacity = std::clamp(size_t(std::min(capacity, double(_maxCapacity))),
+                                   _minCapacity, _maxCapacity);
+
+            // If the queue is light, stop waiting so long for more items; if items are piling
+            // up, go back toward the full latency so they accumulate into bigger batches:
+            size_t queued = _items ? _items->size() : 0;
+            if (queued == 0 && count < _capacity / 4)
+                _latency = std::max(_latency / 2, _maxLatency / 8);
+            else
+                _latency = std::min(_latency * 2, _maxLatency);
+        }
+
+        /** Returns a snapshot of the statistics. Thread-safe. */
+        BatcherStats stats() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            BatcherStats stats = _stats;
+            stats.capacity = _capacity;
+            stats.latency = _latency;
+            return stats;
+        }
+
+    protected:
+        /// The current delay before processing; only call from the `processLater` function.
+        Timer::duration currentLatency() const      {return _latency;}
+
     private:
         std::function<void(int gen)> _processNow, _processLater;
-        Timer::duration _latency;
+        Timer::duration _latency, _maxLatency;
         size_t _capacity;
-        std::mutex _mutex;
+        Timer::duration _targetTime {};             // Adaptive mode if nonzero
+        size_t _minCapacity {1}, _maxCapacity {SIZE_MAX};
+        double _perItemTime {0};                    // Smoothed processing time per item (secs)
+        mutable std::mutex _mutex;
         Items _items;
+        Timer::time _firstPushTime;
+        BatcherStats _stats;
         int _generation {0};
         bool _scheduled {false};
+        bool _full {false};
     };
 
 
@@ -113,7 +215,8 @@ namespace litecore { namespace actor {
                      Timer::duration latency ={},
                      size_t capacity = 0)
         :Batcher<ITEM>([=](int gen) {actor->enqueue(_name, processor, gen);},
-                       [=](int gen) {actor->enqueueAfter(latency, _name, processor, gen);},
+                       [=](int gen) {actor->enqueueAfter(this->currentLatency(), _name,
+                                                         processor, gen);},
                        latency,
                        capacity)
         ,_name(name)
@@ -18,6 +18,8 @@
 
 
 // For zlib API documentation, see: https://zlib.net/manual.html
+// For zstd: https://facebook.github.io/zstd/zstd_manual.html
+// For LZ4 frames: https://github.com/lz4/lz4/blob/dev/doc/lz4frame_manual.html
 
 
 #include "Codec.hh"
@@ -25,8 +27,16 @@
 #include "Logging.hh"
 #include "Endian.hh"
 #include <algorithm>
+#include <iterator>
 #include <mutex>
 
+#ifdef LITECORE_USE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef LITECORE_USE_LZ4
+#include <lz4frame.h>
+#endif
+
 namespace litecore { namespace blip {
     using namespace fleece;
 
@@ -238,4 +248,319 @@ namespace litecore { namespace blip {
                    (int)((uint8_t*)output.next() - outStart), outStart);
     }
 
+
+#pragma mark - SHARED HELPERS:
+
+
+#if defined(LITECORE_USE_ZSTD) || defined(LITECORE_USE_LZ4)
+    // Returns the largest input size whose worst-case compressed size, as computed by `bound`,
+    // fits in `capacity`. (The bound functions are monotonic but have no inverse.)
+    template <class BOUND>
+    static size_t maxInputForCapacity(size_t capacity, BOUND bound) {
+        size_t n = capacity;
+        while (n > 0) {
+            size_t worst = bound(n);
+            if (worst <= capacity)
+                break;
+            n -= std::min(n, worst - capacity);
+        }
+        return n;
+    }
+#endif
+
+
+#ifdef LITECORE_USE_ZSTD
+#pragma mark - ZSTD:
+
+
+    // Extra output space reserved beyond ZSTD_compressBound, for the frame header (written
+    // along with the first block) and the empty block that terminates a flush.
+    static constexpr size_t kZstdHeadroom = 32;
+
+    // Raw-content dictionary that primes the compression window at the start of a connection.
+    // zstd matches best against content at the _end_ of a dictionary, so the most common strings
+    // come last. Both peers must use the identical bytes: any change here requires a new codec
+    // name in the WebSocket protocol.
+    static constexpr const char kZstdDictionary[] =
+        "\"_attachments\":{\"blob_1\":{\"content_type\":\"application/octet-stream\","
+        "\"digest\":\"sha1-\",\"length\":,\"revpos\":,\"stub\":true}}"
+        "getAttachment\0digest\0proveAttachment\0nonce\0"
+        "getCheckpoint\0setCheckpoint\0client\0checkpoint\0"
+        "subChanges\0since\0continuous\0filter\0channels\0activeOnly\0versioning\0"
+        "proposeChanges\0conflictsWith\0maxHistory\0blobs\0deltas\0"
+        "\"@type\":\"blob\",\"content_type\":\"digest\":\"sha1-"
+        "\"_deleted\":true,\"_id\":\"\",\"_rev\":\"\",\"_revisions\":"
+        "Profile\0changes\0Profile\0norev\0error\0Error-Code\0Error-Domain\0HTTP\0"
+        "Profile\0rev\0id\0rev\0sequence\0deleted\0history\0noconflicts\0"
+        "[[1,\"\",\"1-\",true],[2,\"\",\"2-\",0],[3,\"\",\"3-\",0]]";
+
+
+    void ZstdEncoder::check(size_t ret) const {
+        if (ZSTD_isError(ret))
+            error::_throw(error::CorruptData, "zstd error: %s", ZSTD_getErrorName(ret));
+    }
+
+
+    ZstdEncoder::ZstdEncoder(int level)
+    :_ctx(ZSTD_createCCtx())
+    {
+        if (!_ctx)
+            throw std::bad_alloc();
+        if (level < 0)
+            level = kDefaultLevel;
+        check(ZSTD_CCtx_setParameter(_ctx, ZSTD_c_compressionLevel, level));
+        check(ZSTD_CCtx_loadDictionary(_ctx, kZstdDictionary, sizeof(kZstdDictionary) - 1));
+    }
+
+
+    ZstdEncoder::~ZstdEncoder() {
+        ZSTD_freeCCtx(_ctx);
+    }
+
+
+    void ZstdEncoder::write(slice_istream &input, slice_ostream &output, Mode mode) {
+        if (mode == Mode::Raw)
+            return _writeRaw(input, output);
+        else if (mode != Mode::SyncFlush)
+            error::_throw(error::InvalidParameter);
+
+        Assert(output.capacity() > 0);
+        size_t origInputSize = input.size, origOutputSize = output.capacity();
+        logInfo("Compressing %zu bytes into %zu-byte buf (zstd)", input.size, origOutputSize);
+
+        // As in Deflater::_writeAndFlush, only consume as much input as is guaranteed to fit in
+        // the output once flushed, so nothing is left stranded inside the encoder:
+        size_t maxInput = 0;
+        if (output.capacity() > kZstdHeadroom)
+            maxInput = maxInputForCapacity(output.capacity() - kZstdHeadroom,
+                                           [](size_t n) {return ZSTD_compressBound(n);});
+        ZSTD_inBuffer in = {input.buf, std::min(input.size, maxInput), 0};
+        ZSTD_outBuffer out = {output.next(), output.capacity(), 0};
+        size_t remaining = ZSTD_compressStream2(_ctx, &out, &in, ZSTD_e_flush);
+        check(remaining);
+        _unflushed = remaining;
+
+        addToChecksum({input.buf, in.pos});
+        input.skip(in.pos);
+        output.advanceTo((uint8_t*)output.next() + out.pos);
+
+        logInfo("    compressed %zu bytes to %zu, %zu unflushed",
+                (origInputSize - input.size), (origOutputSize - output.capacity()), _unflushed);
+    }
+
+
+    void ZstdDecoder::check(size_t ret) const {
+        if (ZSTD_isError(ret))
+            error::_throw(error::CorruptData, "zstd error: %s", ZSTD_getErrorName(ret));
+    }
+
+
+    ZstdDecoder::ZstdDecoder()
+    :_ctx(ZSTD_createDCtx())
+    {
+        if (!_ctx)
+            throw std::bad_alloc();
+        check(ZSTD_DCtx_loadDictionary(_ctx, kZstdDictionary, sizeof(kZstdDictionary) - 1));
+    }
+
+
+    ZstdDecoder::~ZstdDecoder() {
+        ZSTD_freeDCtx(_ctx);
+    }
+
+
+    void ZstdDecoder::write(slice_istream &input, slice_ostream &output, Mode mode) {
+        if (mode == Mode::Raw)
+            return _writeRaw(input, output);
+
+        logInfo("Decompressing %zu bytes into %zu-byte buf (zstd)", input.size, output.capacity());
+        ZSTD_inBuffer in = {input.buf, input.size, 0};
+        ZSTD_outBuffer out = {output.next(), output.capacity(), 0};
+        check(ZSTD_decompressStream(_ctx, &out, &in));
+        input.skip(in.pos);
+        addToChecksum({output.next(), out.pos});
+        output.advanceTo((uint8_t*)output.next() + out.pos);
+        // "If `output.pos == output.size`, there might be some data left within internal buffers"
+        _outputFull = (out.pos == out.size);
+    }
+#endif // LITECORE_USE_ZSTD
+
+
+#ifdef LITECORE_USE_LZ4
+#pragma mark - LZ4:
+
+
+    static const LZ4F_preferences_t kLZ4Preferences = [] {
+        LZ4F_preferences_t prefs = { };
+        prefs.frameInfo.blockSizeID = LZ4F_max64KB;
+        prefs.frameInfo.blockMode = LZ4F_blockLinked;      // Blocks can refer to earlier ones
+        prefs.autoFlush = 1;                                // Don't buffer input between calls
+        return prefs;
+    }();
+
+
+    void LZ4Encoder::check(size_t ret) const {
+        if (LZ4F_isError(ret))
+            error::_throw(error::CorruptData, "LZ4 error: %s", LZ4F_getErrorName(ret));
+    }
+
+
+    LZ4Encoder::LZ4Encoder() {
+        check(LZ4F_createCompressionContext(&_ctx, LZ4F_VERSION));
+    }
+
+
+    LZ4Encoder::~LZ4Encoder() {
+        LZ4F_freeCompressionContext(_ctx);
+    }
+
+
+    void LZ4Encoder::write(slice_istream &input, slice_ostream &output, Mode mode) {
+        if (mode == Mode::Raw)
+            return _writeRaw(input, output);
+        else if (mode != Mode::SyncFlush)
+            error::_throw(error::InvalidParameter);
+
+        size_t origInputSize = input.size, origOutputSize = output.capacity();
+        logInfo("Compressing %zu bytes into %zu-byte buf (LZ4)", input.size, origOutputSize);
+        if (!_begun) {
+            // The frame header goes at the start of the first compressed frame:
+            if (output.capacity() < LZ4F_HEADER_SIZE_MAX)
+                return;
+            size_t n = LZ4F_compressBegin(_ctx, output.next(), output.capacity(), &kLZ4Preferences);
+            check(n);
+            output.advanceTo((uint8_t*)output.next() + n);
+            _begun = true;
+        }
+
+        size_t count = std::min(input.size, maxInputForCapacity(output.capacity(), [](size_t n) {
+            return LZ4F_compressBound(n, &kLZ4Preferences);
+        }));
+        if (count > 0) {
+            size_t n = LZ4F_compressUpdate(_ctx, output.next(), output.capacity(),
+                                           input.buf, count, nullptr);
+            check(n);
+            output.advanceTo((uint8_t*)output.next() + n);
+            addToChecksum({input.buf, count});
+            input.skip(count);
+        }
+        // With autoFlush there's nothing buffered, but flushing is cheap and makes sure of it:
+        size_t n = LZ4F_flush(_ctx, output.next(), output.capacity(), nullptr);
+        check(n);
+        output.advanceTo((uint8_t*)output.next() + n);
+
+        logInfo("    compressed %zu bytes to %zu",
+                (origInputSize - input.size), (origOutputSize - output.capacity()));
+    }
+
+
+    void LZ4Decoder::check(size_t ret) const {
+        if (LZ4F_isError(ret))
+            error::_throw(error::CorruptData, "LZ4 error: %s", LZ4F_getErrorName(ret));
+    }
+
+
+    LZ4Decoder::LZ4Decoder() {
+        check(LZ4F_createDecompressionContext(&_ctx, LZ4F_VERSION));
+    }
+
+
+    LZ4Decoder::~LZ4Decoder() {
+        LZ4F_freeDecompressionContext(_ctx);
+    }
+
+
+    void LZ4Decoder::write(slice_istream &input, slice_ostream &output, Mode mode) {
+        if (mode == Mode::Raw)
+            return _writeRaw(input, output);
+
+        logInfo("Decompressing %zu bytes into %zu-byte buf (LZ4)", input.size, output.capacity());
+        size_t srcSize = input.size, dstSize = output.capacity();
+        check(LZ4F_decompress(_ctx, output.next(), &dstSize, input.buf, &srcSize, nullptr));
+        input.skip(srcSize);
+        addToChecksum({output.next(), dstSize});
+        output.advanceTo((uint8_t*)output.next() + dstSize);
+        _outputFull = (dstSize > 0 && output.capacity() == 0);
+    }
+#endif // LITECORE_USE_LZ4
+
+
+#pragma mark - CODEC TYPES:
+
+
+    static constexpr const char* kCodecNames[] = {"deflate", "lz4", "zstd"};
+
+
+    const char* codecName(CodecType type) {
+        return kCodecNames[int(type)];
+    }
+
+
+    std::optional<CodecType> codecNamed(slice name) {
+        for (size_t i = 0; i < std::size(kCodecNames); ++i) {
+            if (name == slice(kCodecNames[i]))
+                return CodecType(i);
+        }
+        return std::nullopt;
+    }
+
+
+    bool codecAvailable(CodecType type) {
+        switch (type) {
+            case CodecType::Deflate:
+                return true;
+            case CodecType::LZ4:
+#ifdef LITECORE_USE_LZ4
+                return true;
+#else
+                return false;
+#endif
+            case CodecType::Zstd:
+#ifdef LITECORE_USE_ZSTD
+                return true;
+#else
+                return false;
+#endif
+        }
+        return false;
+    }
+
+
+    std::unique_ptr<Codec> newEncoder(CodecType type, int level) {
+        switch (type) {
+            case CodecType::Deflate:
+                return std::make_unique<Deflater>(Deflater::CompressionLevel(level));
+#ifdef LITECORE_USE_LZ4
+            case CodecType::LZ4:
+                return std::make_unique<LZ4Encoder>();
+#endif
+#ifdef LITECORE_USE_ZSTD
+            case CodecType::Zstd:
+                return std::make_unique<ZstdEncoder>(level);
+#endif
+            default:
+                error::_throw(error::Unimplemented, "BLIP codec '%s' is not available",
+                              codecName(type));
+        }
+    }
+
+
+    std::unique_ptr<Codec> newDecoder(CodecType type) {
+        switch (type) {
+            case CodecType::Deflate:
+                return std::make_unique<Inflater>();
+#ifdef LITECORE_USE_LZ4
+            case CodecType::LZ4:
+                return std::make_unique<LZ4Decoder>();
+#endif
+#ifdef LITECORE_USE_ZSTD
+            case CodecType::Zstd:
+                return std::make_unique<ZstdDecoder>();
+#endif
+            default:
+                error::_throw(error::Unimplemented, "BLIP codec '%s' is not available",
+                              codecName(type));
+        }
+    }
+
 } }
@@ -21,8 +21,19 @@
 #include "fleece/Fleece.hh"
 #include "Logging.hh"
 #include "slice_stream.hh"
+#include <memory>
+#include <optional>
 #include <zlib.h>
 
+#ifdef LITECORE_USE_ZSTD
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+#endif
+#ifdef LITECORE_USE_LZ4
+struct LZ4F_cctx_s;
+struct LZ4F_dctx_s;
+#endif
+
 namespace litecore { namespace blip {
 
 
@@ -60,6 +71,10 @@ namespace litecore { namespace blip {
             the output yet for lack of space. */
         virtual unsigned unflushedBytes() const         {return 0;}
 
+        /** Bytes that a SyncFlush always ends its output with. BLIP strips these before sending
+            a frame and restores them on receipt. Empty if the codec has no such trailer. */
+        virtual slice flushTrailer() const              {return fleece::nullslice;}
+
         static constexpr size_t kChecksumSize = 4;
 
         /** Writes the codec's current checksum to the output slice.
@@ -91,6 +106,8 @@ namespace litecore { namespace blip {
                    Mode, size_t maxInput =SIZE_MAX);
         void check(int) const;
 
+        slice flushTrailer() const override             {return {"\x00\x00\xFF\xFF", 4};}
+
         mutable ::z_stream _z { };
         FlateFunc const _flate;
     };
@@ -125,4 +142,108 @@ namespace litecore { namespace blip {
         void write(slice_istream &input, slice_ostream &output, Mode =Mode::Default) override;
     };
 
+
+#ifdef LITECORE_USE_ZSTD
+    /** Compressing codec using zstd's streaming API. The whole connection is one zstd frame,
+        primed with a built-in dictionary of common BLIP and replication strings.
+        Only SyncFlush (and Raw) modes are supported. */
+    class ZstdEncoder final : public Codec {
+    public:
+        static constexpr int kDefaultLevel = 3;
+
+        explicit ZstdEncoder(int level =kDefaultLevel);
+        ~ZstdEncoder();
+
+        void write(slice_istream &input, slice_ostream &output, Mode =Mode::Default) override;
+        unsigned unflushedBytes() const override        {return (unsigned)_unflushed;}
+
+    private:
+        void check(size_t) const;
+
+        ::ZSTD_CCtx_s* _ctx;
+        size_t _unflushed {0};
+    };
+
+
+    /** Decompressing codec for the output of ZstdEncoder. */
+    class ZstdDecoder final : public Codec {
+    public:
+        ZstdDecoder();
+        ~ZstdDecoder();
+
+        void write(slice_istream &input, slice_ostream &output, Mode =Mode::Default) override;
+        unsigned unflushedBytes() const override        {return _outputFull;}
+
+    private:
+        void check(size_t) const;
+
+        ::ZSTD_DCtx_s* _ctx;
+        bool _outputFull {false};
+    };
+#endif
+
+
+#ifdef LITECORE_USE_LZ4
+    /** Compressing codec using the LZ4 frame API with linked blocks, so each BLIP frame can
+        refer back to data in earlier ones. Only SyncFlush (and Raw) modes are supported. */
+    class LZ4Encoder final : public Codec {
+    public:
+        LZ4Encoder();
+        ~LZ4Encoder();
+
+        void write(slice_istream &input, slice_ostream &output, Mode =Mode::Default) override;
+
+    private:
+        void check(size_t) const;
+
+        ::LZ4F_cctx_s* _ctx;
+        bool _begun {false};
+    };
+
+
+    /** Decompressing codec for the output of LZ4Encoder. */
+    class LZ4Decoder final : public Codec {
+    public:
+        LZ4Decoder();
+        ~LZ4Decoder();
+
+        void write(slice_istream &input, slice_ostream &output, Mode =Mode::Default) override;
+        unsigned unflushedBytes() const override        {return _outputFull;}
+
+    private:
+        void check(size_t) const;
+
+        ::LZ4F_dctx_s* _ctx;
+        bool _outputFull {false};
+    };
+#endif
+
+
+#pragma mark - CODEC TYPES:
+
+
+    /** Compression algorithms BLIP can use. Deflate is always available; LZ4 and zstd only if
+        LiteCore was built with LITECORE_USE_LZ4 / LITECORE_USE_ZSTD. */
+    enum class CodecType : uint8_t {
+        Deflate,
+        LZ4,
+        Zstd,
+    };
+
+    /** The codec's name as used in WebSocket protocol names and options, e.g. "zstd". */
+    const char* codecName(CodecType);
+
+    /** Looks up a codec by name. Returns nullopt if the name is unknown. */
+    std::optional<CodecType> codecNamed(fleece::slice name);
+
+    /** True if support for the codec was compiled in. */
+    bool codecAvailable(CodecType);
+
+    /** Creates a compressing codec. `level` is the compression level, or -1 for the codec's
+        default; it's ignored by LZ4. Throws Unimplemented if the codec isn't available. */
+    std::unique_ptr<Codec> newEncoder(CodecType, int level =-1);
+
+    /** Creates a decompressing codec. Throws Unimplemented if the codec isn't available. */
+    std::unique_ptr<Codec> newDecoder(CodecType);
+
 } }
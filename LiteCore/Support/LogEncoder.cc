@@ -56,7 +56,7 @@ namespace litecore {
         auto now = LogDecoder::now();
         _writeUVarInt(now.secs);
         _lastElapsed = -(int)now.microsecs;  // so first delta will be accurate
-        _st.reset();
+        _startTime = clock::now();
     }
 
     LogEncoder::~LogEncoder() {
@@ -89,15 +89,271 @@ namespace litecore {
 
 
     int64_t LogEncoder::_timeElapsed() const {
-        return int64_t(_st.elapsed() * kTicksPerSec);
+        return _timeElapsed(clock::now());
     }
 
+    int64_t LogEncoder::_timeElapsed(clock::time_point when) const {
+        return chrono::duration_cast<chrono::microseconds>(when - _startTime).count();
+    }
+
+
+#pragma mark - FORMAT STRINGS:
+
+
+    namespace {
+        // A printf-style substitution found in a format string.
+        struct Substitution {
+            const char *spec;       // Points to the conversion char; spec[-1], spec[-2] are modifiers
+            bool minus;             // Has a '-' flag (i.e. "%-s" is a tokenized string)
+            bool dotStar;           // Has a ".*" precision (an extra `int` arg giving the size)
+
+            char type() const       {return *spec;}
+            bool isToken() const    {return *spec == 's' && minus && !dotStar;}
+        };
+
+
+        // Calls `fn` with each substitution in a format string.
+        template <class FN>
+        void forEachSubstitution(const char *format, FN fn) {
+            for (const char *c = format; *c != '\0'; ++c) {
+                if (*c == '%') {
+                    Substitution sub {nullptr, false, false};
+                    ++c;
+                    if (*c == '-') {
+                        sub.minus = true;
+                        ++c;
+                    }
+                    c += strspn(c, "#0- +'");
+                    while (isdigit(*c))
+                        ++c;
+                    if (*c == '.') {
+                        ++c;
+                        if (*c == '*') {
+                            sub.dotStar = true;
+                            ++c;
+                        } else {
+                            while (isdigit(*c))
+                                ++c;
+                        }
+                    }
+                    c += strspn(c, "hljtzq");
+                    sub.spec = c;
+                    fn(sub);
+                }
+            }
+        }
+
+
+        // Reads substitution values from a va_list.
+        class VAListReader {
+        public:
+            explicit VAListReader(va_list args)     {va_copy(_args, args);}
+            ~VAListReader()                         {va_end(_args);}
+
+            long long nextSigned(const Substitution &sub) {
+                const char *c = sub.spec;
+                if (c[-1] == 'q')
+                    return va_arg(_args, long long);
+                else if (c[-1] == 'z')
+                    return va_arg(_args, ptrdiff_t);
+                else if (c[-1] != 'l')
+                    return va_arg(_args, int);
+                else if (c[-2] != 'l')
+                    return va_arg(_args, long);
+                else
+                    return va_arg(_args, long long);
+            }
+
+            unsigned long long nextUnsigned(const Substitution &sub) {
+                const char *c = sub.spec;
+                if (c[-1] == 'q')
+                    return va_arg(_args, unsigned long long);
+                else if (c[-1] == 'z')
+                    return va_arg(_args, size_t);
+                else if (c[-1] != 'l')
+                    return va_arg(_args, unsigned int);
+                else if (c[-2] != 'l')
+                    return va_arg(_args, unsigned long);
+                else
+                    return va_arg(_args, unsigned long long);
+            }
+
+            double nextDouble()                     {return va_arg(_args, double);}
+
+            slice nextString(const Substitution &sub) {
+                if (sub.dotStar) {
+                    size_t size = va_arg(_args, int);
+                    return slice(va_arg(_args, const char*), size);
+                } else {
+                    return slice(va_arg(_args, const char*));
+                }
+            }
+
+            const char* nextToken(slice &outText) {
+                auto token = va_arg(_args, const char*);
+                outText = slice(token);
+                return token;
+            }
+
+            size_t nextPointer()                    {return va_arg(_args, size_t);}
+
+#if __APPLE__
+            // "%@" substitutes an Objective-C or CoreFoundation object's description.
+            slice nextObject() {
+                CFTypeRef param = va_arg(_args, CFTypeRef);
+                if (param == nullptr)
+                    return "(null)"_sl;
+                CFStringRef description;
+                if (CFGetTypeID(param) == CFStringGetTypeID())
+                    description = (CFStringRef)param;
+                else
+                    description = CFCopyDescription(param);
+                _object = alloc_slice(nsstring_slice(description));
+                if (description != param)
+                    CFRelease(description);
+                return _object;
+            }
+#endif
+
+        private:
+            va_list _args;
+#if __APPLE__
+            alloc_slice _object;
+#endif
+        };
+
+
+        // Reads substitution values written by LogEncoder::captureArgs.
+        class CapturedReader {
+        public:
+            explicit CapturedReader(slice captured)     :_in(captured) { }
+
+            long long nextSigned(const Substitution&)     {return next<long long>();}
+            unsigned long long nextUnsigned(const Substitution&) {return next<unsigned long long>();}
+            double nextDouble()                           {return next<double>();}
+            slice nextString(const Substitution&)         {return nextBytes();}
+            size_t nextPointer()                          {return next<size_t>();}
+            slice nextObject()                            {return nextBytes();}
+
+            const char* nextToken(slice &outText) {
+                auto token = next<const char*>();
+                outText = nextBytes();
+                return token;
+            }
+
+        private:
+            template <class T> T next() {
+                T value;
+                if (_in.size < sizeof(T))
+                    throw invalid_argument("Truncated captured log arguments");
+                memcpy(&value, _in.buf, sizeof(T));
+                _in.moveStart(sizeof(T));
+                return value;
+            }
+
+            slice nextBytes() {
+                auto size = next<uint32_t>();
+                if (_in.size < size)
+                    throw invalid_argument("Truncated captured log arguments");
+                slice result(_in.buf, size);
+                _in.moveStart(size);
+                return result;
+            }
+
+            slice _in;
+        };
+
+
+        template <class T>
+        void appendValue(string &out, const T &value) {
+            out.append((const char*)&value, sizeof(value));
+        }
+
+        void appendBytes(string &out, slice bytes) {
+            appendValue(out, uint32_t(bytes.size));
+            out.append((const char*)bytes.buf, bytes.size);
+        }
+    }
+
+
+#pragma mark - LOGGING:
+
+
     void LogEncoder::vlog(const char *domain, const map<unsigned, string> &objectMap,
                           ObjectRef object, const char *format, va_list args) {
         lock_guard<mutex> lock(_mutex);
+        _writeHeader(_timeElapsed(), domain, objectMap, object, format, slice(format));
+        VAListReader reader(args);
+        _writeArgs(format, reader);
+        _didWrite();
+    }
+
 
+    /*static*/ void LogEncoder::captureArgs(const char *format, va_list args, string &out) {
+        VAListReader reader(args);
+        forEachSubstitution(format, [&](const Substitution &sub) {
+            switch(sub.type()) {
+                case 'c':
+                case 'd':
+                case 'i':
+                    appendValue(out, reader.nextSigned(sub));
+                    break;
+                case 'u':
+                case 'x': case 'X':
+                    appendValue(out, reader.nextUnsigned(sub));
+                    break;
+                case 'e': case 'E':
+                case 'f': case 'F':
+                case 'g': case 'G':
+                case 'a': case 'A':
+                    appendValue(out, reader.nextDouble());
+                    break;
+                case 's':
+                    if (sub.isToken()) {
+                        slice text;
+                        appendValue(out, reader.nextToken(text));
+                        appendBytes(out, text);
+                    } else {
+                        appendBytes(out, reader.nextString(sub));
+                    }
+                    break;
+                case 'p':
+                    appendValue(out, reader.nextPointer());
+                    break;
+#if __APPLE__
+                case '@':
+                    appendBytes(out, reader.nextObject());
+                    break;
+#endif
+                case '%':
+                    break;
+                default:
+                    throw invalid_argument("Unknown type in LogEncoder format string");
+            }
+        });
+    }
+
+
+    void LogEncoder::logCaptured(clock::time_point when, const char *domain,
+                                 const map<unsigned, string> &objectMap, ObjectRef object,
+                                 const void *formatKey, const char *format, slice capturedArgs)
+    {
+        lock_guard<mutex> lock(_mutex);
+        // Messages captured on different threads can arrive slightly out of order; since the
+        // file stores unsigned deltas, clamp the time so it never goes backwards.
+        auto elapsed = max(_timeElapsed(when), _lastElapsed);
+        _writeHeader(elapsed, domain, objectMap, object, formatKey, slice(format));
+        CapturedReader reader(capturedArgs);
+        _writeArgs(format, reader);
+        _didWrite();
+    }
+
+
+    void LogEncoder::_writeHeader(int64_t elapsed, const char *domain,
+                                  const map<unsigned, string> &objectMap, ObjectRef object,
+                                  const void *formatKey, slice format)
+    {
         // Write the number of ticks elapsed since the last message:
-        auto elapsed = _timeElapsed();
         uint64_t delta = elapsed - _lastElapsed;
         _lastElapsed = elapsed;
         _writeUVarInt(delta);
@@ -119,135 +375,76 @@ namespace litecore {
             }
         }
 
-        _writeStringToken(format);
+        _writeStringToken(formatKey, format);
+    }
+
 
-        // Parse the format string looking for substitutions:
-        for (const char *c = format; *c != '\0'; ++c) {
-            if (*c == '%') {
-                bool minus = false;
-                bool dotStar = false;
-                ++c;
-                if (*c == '-') {
-                    minus = true;
-                    ++c;
+    template <class READER>
+    void LogEncoder::_writeArgs(const char *format, READER &reader) {
+        forEachSubstitution(format, [&](const Substitution &sub) {
+            switch(sub.type()) {
+                case 'c':
+                case 'd':
+                case 'i': {
+                    long long param = reader.nextSigned(sub);
+                    uint8_t sign = (param < 0) ? 1 : 0;
+                    _writer.write(&sign, 1);
+                    _writeUVarInt(abs(param));
+                    break;
                 }
-                c += strspn(c, "#0- +'");
-                while (isdigit(*c))
-                    ++c;
-                if (*c == '.') {
-                    ++c;
-                    if (*c == '*') {
-                        dotStar = true;
-                        ++c;
+                case 'u':
+                case 'x': case 'X': {
+                    _writeUVarInt(reader.nextUnsigned(sub));
+                    break;
+                }
+                case 'e': case 'E':
+                case 'f': case 'F':
+                case 'g': case 'G':
+                case 'a': case 'A': {
+                    fleece::endian::littleEndianDouble param = reader.nextDouble();
+                    _writer.write(&param, sizeof(param));
+                    break;
+                }
+                case 's': {
+                    if (sub.isToken()) {
+                        slice text;
+                        const char *token = reader.nextToken(text);
+                        _writeStringToken(token, text);
                     } else {
-                        while (isdigit(*c))
-                            ++c;
+                        slice str = reader.nextString(sub);
+                        _writeUVarInt(str.size);
+                        if (str.size > 0)
+                            _writer.write(str);
                     }
+                    break;
+                }
+                case 'p': {
+                    size_t param = reader.nextPointer();
+                    if (sizeof(param) == 8)
+                        param = fleece::endian::encLittle64(param);
+                    else
+                        param = fleece::endian::encLittle32((uint32_t)param);
+                    _writer.write(&param, sizeof(param));
+                    break;
                 }
-                c += strspn(c, "hljtzq");
-
-                switch(*c) {
-                    case 'c':
-                    case 'd':
-                    case 'i': {
-                        long long param;
-                        if (c[-1] == 'q')
-                            param = va_arg(args, long long);
-                        else if (c[-1] == 'z')
-                            param = va_arg(args, ptrdiff_t);
-                        else if (c[-1] != 'l')
-                            param = va_arg(args, int);
-                        else if (c[-2] != 'l')
-                            param = va_arg(args, long);
-                        else
-                            param = va_arg(args, long long);
-                        uint8_t sign = (param < 0) ? 1 : 0;
-                        _writer.write(&sign, 1);
-                        _writeUVarInt(abs(param));
-                        break;
-                    }
-                    case 'u':
-                    case 'x': case 'X': {
-                        unsigned long long param;
-                        if (c[-1] == 'q')
-                            param = va_arg(args, unsigned long long);
-                        else if (c[-1] == 'z')
-                            param = va_arg(args, size_t);
-                        else if (c[-1] != 'l')
-                            param = va_arg(args, unsigned int);
-                        else if (c[-2] != 'l')
-                            param = va_arg(args, unsigned long);
-                        else
-                            param = va_arg(args, unsigned long long);
-                        _writeUVarInt(param);
-                        break;
-                    }
-                    case 'e': case 'E':
-                    case 'f': case 'F':
-                    case 'g': case 'G':
-                    case 'a': case 'A': {
-                        fleece::endian::littleEndianDouble param = va_arg(args, double);
-                        _writer.write(&param, sizeof(param));
-                        break;
-                    }
-                    case 's': {
-                        const char *str;
-                        size_t size;
-                        if (dotStar) {
-                            size = va_arg(args, int);
-                            str = va_arg(args, const char*);
-                        } else {
-                            str = va_arg(args, const char*);
-                            size = strlen(str);
-                        }
-                        if (minus && !dotStar) {
-                            _writeStringToken(str);
-                        } else {
-                            _writeUVarInt(size);
-                            if (size > 0)
-                                _writer.write(str, size);
-                        }
-                        break;
-                    }
-                    case 'p': {
-                        size_t param = va_arg(args, size_t);
-                        if (sizeof(param) == 8)
-                            param = fleece::endian::encLittle64(param);
-                        else
-                            param = fleece::endian::encLittle32((uint32_t)param);
-                        _writer.write(&param, sizeof(param));
-                        break;
-                    }
 #if __APPLE__
-                    case '@': {
-                        // "%@" substitutes an Objective-C or CoreFoundation object's description.
-                        CFTypeRef param = va_arg(args, CFTypeRef);
-                        if (param == nullptr) {
-                            _writeUVarInt(6);
-                            _writer.write("(null)", 6);
-                        } else {
-                            CFStringRef description;
-                            if (CFGetTypeID(param) == CFStringGetTypeID())
-                                description = (CFStringRef)param;
-                            else
-                                description = CFCopyDescription(param);
-                            nsstring_slice descSlice(description);
-                            _writeUVarInt(descSlice.size);
-                            _writer.write(descSlice);
-                            if (description != param)
-                                CFRelease(description);
-                        }
-                        break;
-                    }
-#endif
-                    case '%':
-                        break;
-                    default:
-                        throw invalid_argument("Unknown type in LogEncoder format string");
+                case '@': {
+                    slice description = reader.nextObject();
+                    _writeUVarInt(description.size);
+                    _writer.write(description);
+                    break;
                 }
+#endif
+                case '%':
+                    break;
+                default:
+                    throw invalid_argument("Unknown type in LogEncoder format string");
             }
-        }
+        });
+    }
+
 
+    void LogEncoder::_didWrite() {
         if (_writer.length() > kBufferSize)
             _flush();
         else
@@ -261,12 +458,19 @@ namespace litecore {
 
 
     void LogEncoder::_writeStringToken(const char *token) {
-        const auto name = _formats.find((size_t)token);
+        _writeStringToken(token, slice(token));
+    }
+
+
+    // Tokens are identified by address; `text` is the token's string, written the first time.
+    void LogEncoder::_writeStringToken(const void *key, slice text) {
+        const auto name = _formats.find((size_t)key);
         if (name == _formats.end()) {
             const auto n = (unsigned)_formats.size();
-            _formats.insert({(size_t)token, n});
+            _formats.insert({(size_t)key, n});
             _writeUVarInt(n);
-            _writer.write(token, strlen(token)+1);  // add the actual string the first time
+            _writer.write(text);                    // add the actual string the first time
+            _writer.write("\0", 1);
         } else {
             _writeUVarInt(name->second);
         }
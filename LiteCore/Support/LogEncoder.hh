@@ -23,10 +23,12 @@
 #include "PlatformCompat.hh"
 #include "Logging.hh"
 #include <stdarg.h>
+#include <chrono>
 #include <iosfwd>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -38,6 +40,8 @@ namespace litecore {
         The API is thread-safe. */
     class LogEncoder {
     public:
+        using clock = std::chrono::steady_clock;
+
         LogEncoder(std::ostream &out, LogLevel level);
         ~LogEncoder();
 
@@ -49,6 +53,21 @@ namespace litecore {
 
         void log(const char *domain, const std::map<unsigned, std::string>&, ObjectRef, const char *format, ...) __printflike(5, 6);
 
+        /** Copies the arguments of a log message into `out`, so the message can be encoded later
+            (perhaps on another thread) by \ref logCaptured. Doesn't use any encoder state, so it
+            needs no locking. */
+        static void captureArgs(const char *format, va_list args, std::string &out);
+
+        /** Logs a message whose arguments were saved by \ref captureArgs.
+            @param when  The time the message was logged.
+            @param formatKey  The address of the original format string, which identifies it.
+            @param format  A copy of the format string.
+            @param capturedArgs  The data produced by captureArgs. */
+        void logCaptured(clock::time_point when, const char *domain,
+                         const std::map<unsigned, std::string>&, ObjectRef,
+                         const void *formatKey, const char *format,
+                         fleece::slice capturedArgs);
+
         void flush();
         
         uint64_t tellp();
@@ -69,8 +88,15 @@ namespace litecore {
 
     private:
         int64_t _timeElapsed() const;
+        int64_t _timeElapsed(clock::time_point) const;
+        void _writeHeader(int64_t elapsed, const char *domain,
+                          const std::map<unsigned, std::string>&, ObjectRef,
+                          const void *formatKey, fleece::slice format);
+        template <class READER> void _writeArgs(const char *format, READER&);
+        void _didWrite();
         void _writeUVarInt(uint64_t);
         void _writeStringToken(const char *token);
+        void _writeStringToken(const void *key, fleece::slice text);
         void _flush();
         void _scheduleFlush();
         void performScheduledFlush();
@@ -79,7 +105,7 @@ namespace litecore {
         fleece::Writer _writer;
         std::ostream &_out;
         std::unique_ptr<actor::Timer> _flushTimer;
-        fleece::Stopwatch _st;
+        clock::time_point _startTime;
         int64_t _lastElapsed {0};
         int64_t _lastSaved {0};
         LogLevel _level;
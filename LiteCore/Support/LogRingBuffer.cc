@@ -0,0 +1,60 @@
+//
+// LogRingBuffer.cc
+//
+// Copyright (c) 2021 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "LogRingBuffer.hh"
+#include "Error.hh"
+
+namespace litecore {
+    using namespace std;
+
+
+    LogRingBuffer::LogRingBuffer(size_t capacity)
+    :_capacity(capacity)
+    ,_buffer(new uint8_t[capacity])
+    {
+        Assert(capacity >= 64 && capacity % 8 == 0);
+    }
+
+
+    bool LogRingBuffer::push(slice record) {
+        if (record.size > maxRecordSize())
+            return false;
+        size_t size = recordSize(record.size);
+        uint64_t head = _head.load(memory_order_relaxed);
+        uint64_t tail = _tail.load(memory_order_acquire);
+        size_t pos = size_t(head % _capacity);
+        size_t contiguous = _capacity - pos;
+
+        // A record never wraps around; if it doesn't fit at the end, pad and start over at 0:
+        size_t needed = (contiguous >= size) ? size : contiguous + size;
+        if (head + needed - tail > _capacity)
+            return false;
+        if (contiguous < size) {
+            memcpy(&_buffer[pos], &kPadding, kLengthSize);
+            head += contiguous;
+            pos = 0;
+        }
+
+        uint32_t length = uint32_t(record.size);
+        memcpy(&_buffer[pos], &length, kLengthSize);
+        memcpy(&_buffer[pos + kLengthSize], record.buf, record.size);
+        _head.store(head + size, memory_order_release);
+        return true;
+    }
+
+}
@@ -0,0 +1,97 @@
+//
+// LogRingBuffer.hh
+//
+// Copyright (c) 2021 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "fleece/slice.hh"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace litecore {
+
+    /** A fixed-capacity queue of variable-length records, with a single producer thread and a
+        single consumer thread, that needs no locks. Used by buffered logging: each thread
+        writes its messages into its own buffer, and the log drainer reads them out. */
+    class LogRingBuffer {
+    public:
+        using slice = fleece::slice;
+
+        explicit LogRingBuffer(size_t capacity);
+
+        size_t capacity() const                     {return _capacity;}
+
+        /// The largest record that can ever be pushed.
+        size_t maxRecordSize() const                {return _capacity / 2 - kLengthSize;}
+
+        /// Number of bytes currently in use.
+        size_t used() const                         {return size_t(_head.load() - _tail.load());}
+
+        bool empty() const                          {return _head.load() == _tail.load();}
+
+        //---- Producer:
+
+        /// Appends a record. Returns false if there isn't room for it right now.
+        bool push(slice record);
+
+        //---- Consumer:
+
+        /// Calls `fn(slice)` for each record currently in the buffer, without removing them
+        /// (so the slices stay valid.) Returns a position to pass to \ref release.
+        template <class FN>
+        uint64_t peekAll(FN fn) const {
+            uint64_t tail = _tail.load(std::memory_order_relaxed);
+            uint64_t head = _head.load(std::memory_order_acquire);
+            while (tail < head) {
+                size_t pos = size_t(tail % _capacity);
+                uint32_t length;
+                memcpy(&length, &_buffer[pos], kLengthSize);
+                if (length == kPadding) {
+                    tail += _capacity - pos;            // skip to the start of the buffer
+                } else {
+                    fn(slice(&_buffer[pos + kLengthSize], length));
+                    tail += recordSize(length);
+                }
+            }
+            return tail;
+        }
+
+        /// Frees the space used by the records returned by a call to \ref peekAll.
+        void release(uint64_t position)             {_tail.store(position, std::memory_order_release);}
+
+        //---- Lifecycle:
+
+        /// Marks the buffer as no longer used by its producer (its thread has exited.)
+        void abandon()                              {_abandoned = true;}
+        bool abandoned() const                      {return _abandoned;}
+
+    private:
+        static constexpr size_t   kLengthSize = sizeof(uint32_t);
+        static constexpr uint32_t kPadding = UINT32_MAX;   // Length marking unused end of buffer
+
+        // Records are 8-byte aligned, so there's always room for a padding marker at the end.
+        static size_t recordSize(size_t length)     {return (kLengthSize + length + 7) & ~size_t(7);}
+
+        size_t const                _capacity;
+        std::unique_ptr<uint8_t[]>  _buffer;
+        std::atomic<uint64_t>       _head {0};      // Total bytes ever written (by producer)
+        std::atomic<uint64_t>       _tail {0};      // Total bytes ever released (by consumer)
+        std::atomic<bool>           _abandoned {false};
+    };
+
+}
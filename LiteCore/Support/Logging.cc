@@ -20,13 +20,19 @@
 #include "StringUtil.hh"
 #include "LogEncoder.hh"
 #include "LogDecoder.hh"
+#include "LogRingBuffer.hh"
 #include "PlatformIO.hh"
 #include "FilePath.hh"
 #include "Error.hh"
+#include "ThreadUtil.hh"
+#include <algorithm>
+#include <condition_variable>
 #include <string>
 #include <fstream>
 #include <iostream>
 #include <mutex>
+#include <thread>
+#include <vector>
 #include <ctime>
 
 #if __APPLE__
@@ -75,10 +81,10 @@ namespace litecore {
     static LogDomain _ActorLog("Actor");
     LogDomain &ActorLog = _ActorLog;
 
-    LogLevel LogDomain::sCallbackMinLevel = LogLevel::Uninitialized;
-    static LogDomain::Callback_t sCallback = LogDomain::defaultCallback;
+    atomic<LogLevel> LogDomain::sCallbackMinLevel {LogLevel::Uninitialized};
+    static atomic<LogDomain::Callback_t> sCallback {LogDomain::defaultCallback};
     static bool sCallbackPreformatted = false;
-    LogLevel LogDomain::sFileMinLevel = LogLevel::None;
+    atomic<LogLevel> LogDomain::sFileMinLevel {LogLevel::None};
     unsigned LogDomain::slastObjRef {0};
     map<unsigned, string> LogDomain::sObjNames;
     static ofstream* sFileOut[5] = {}; // File per log level
@@ -89,6 +95,8 @@ namespace litecore {
     static int64_t sMaxSize = 1024; // For rotation
     static string sInitialMessage;  // For rotation, goes at top of each log
     static mutex sLogMutex;
+    static atomic<bool> sBuffered {false};      // Is buffered file logging enabled?
+    static vector<unsigned> sRetiredObjects;    // Objects unregistered while buffering
 
     static const char* const kLevelNames[] = {"debug", "verbose", "info",
                 "warning", "error", nullptr};
@@ -217,6 +225,7 @@ namespace litecore {
     }
 
     void LogDomain::flushLogFiles() {
+        drainFileLogBuffers();
         unique_lock<mutex> lock(sLogMutex);
 
         for(auto& encoder : sLogEncoder)
@@ -247,6 +256,9 @@ namespace litecore {
     void LogDomain::writeEncodedLogsTo(const LogFileOptions& options,
                                        const string &initialMessage)
     {
+        // Write out any buffered messages to the current files before changing anything:
+        drainFileLogBuffers();
+
         unique_lock<mutex> lock(sLogMutex);
         sMaxSize = max((int64_t)1024, options.maxSize);
         sMaxCount = max(0, options.maxCount);
@@ -259,6 +271,7 @@ namespace litecore {
         sCurrentOptions = options;
         sLogDirectory = options.path;
         sInitialMessage = initialMessage;
+        setBuffered(options.buffered && !options.isPlaintext && !sLogDirectory.empty());
         if (sLogDirectory.empty()) {
             sFileMinLevel = LogLevel::None;
         } else {
@@ -290,6 +303,7 @@ namespace litecore {
             static once_flag f;
             call_once(f, []{
                 atexit([]{
+                    drainFileLogBuffers(false);
                     if (sLogMutex.try_lock()) {     // avoid deadlock on crash inside logging code
                         if (sLogEncoder[0]) {
                             for(auto& encoder : sLogEncoder) {
@@ -353,7 +367,7 @@ namespace litecore {
 
     // Only call while holding sLogMutex!
     LogLevel LogDomain::_callbackLogLevel() noexcept {
-        auto level = sCallbackMinLevel;
+        LogLevel level = sCallbackMinLevel;
         if (level == LogLevel::Uninitialized) {
             // Allow 'LiteCoreLog' env var to set initial callback level:
             level = kC4Cpp_DefaultLog.levelFromEnvironment();
@@ -409,7 +423,7 @@ namespace litecore {
         _level = level;
         // The effective level is the level at which I will actually trigger because there is
         // a place for my output to go:
-        _effectiveLevel = max((LogLevel)_level, min(_callbackLogLevel(), sFileMinLevel));
+        _effectiveLevel = max((LogLevel)_level, min(_callbackLogLevel(), sFileMinLevel.load()));
     }
 
 
@@ -424,6 +438,230 @@ namespace litecore {
     }
 
 
+#pragma mark - BUFFERED FILE LOGGING:
+
+
+    // When LogFileOptions::buffered is set, messages bound for the binary log files don't go
+    // through sLogMutex. Instead, each thread copies its messages into its own LogRingBuffer, and
+    // a background "drainer" thread periodically merges the buffers, in timestamp order, into the
+    // LogEncoders.
+
+    // Each thread's buffer capacity:
+    static constexpr size_t kThreadBufferSize = 64 * 1024;
+
+    // How often the drainer writes buffered messages to the encoders:
+    static constexpr auto kDrainInterval = 50ms;
+
+    // How long a thread waits for room in a full buffer before logging synchronously instead:
+    static constexpr auto kMaxBufferWait = 100ms;
+
+    // Header of a buffered message. Followed by the format string (with its NUL) and the
+    // arguments as encoded by LogEncoder::captureArgs.
+    struct BufferedLogHeader {
+        LogEncoder::clock::time_point time;
+        const char* domain;
+        const char* formatKey;      // Address of the original format string; identifies it
+        unsigned    objRef;
+        LogLevel    level;
+    };
+
+    // State shared by the threads' buffers and the drainer. Never destroyed, because threads
+    // may still be logging while the process exits.
+    struct LogBufferState {
+        mutex                                 buffersMutex;   // Protects `buffers`
+        vector<shared_ptr<LogRingBuffer>>     buffers;        // One per thread that has logged
+        mutex                                 drainMutex;     // Held during a drain pass
+        mutex                                 wakeMutex;
+        condition_variable                    wake;           // Wakes the drainer thread
+        bool                                  wakeRequested {false};
+        bool                                  drainerStarted {false};
+    };
+
+    static thread_local bool tIsDrainer = false;
+
+    static LogBufferState& bufferState() {
+        static auto sState = new LogBufferState;
+        return *sState;
+    }
+
+    static void wakeDrainer() {
+        auto &state = bufferState();
+        {
+            lock_guard<mutex> lock(state.wakeMutex);
+            state.wakeRequested = true;
+        }
+        state.wake.notify_one();
+    }
+
+
+    // The calling thread's buffer, created on demand.
+    struct ThreadLogBuffer {
+        shared_ptr<LogRingBuffer> ring;
+        string                    scratch;  // Message being captured
+
+        ThreadLogBuffer()
+        :ring(make_shared<LogRingBuffer>(kThreadBufferSize))
+        {
+            auto &state = bufferState();
+            lock_guard<mutex> lock(state.buffersMutex);
+            state.buffers.push_back(ring);
+        }
+
+        ~ThreadLogBuffer() {
+            ring->abandon();                // The drainer will free it once it's empty
+        }
+    };
+
+
+    // Must have sLogMutex held
+    void LogDomain::setBuffered(bool buffered) {
+        if (buffered && !sBuffered) {
+            auto &state = bufferState();
+            if (!state.drainerStarted) {
+                state.drainerStarted = true;
+                thread(&LogDomain::drainerThread).detach();
+            }
+        }
+        sBuffered = buffered;
+        if (!buffered) {
+            // Objects unregistered while buffering were kept around for the drainer:
+            for (unsigned ref : sRetiredObjects)
+                sObjNames.erase(ref);
+            sRetiredObjects.clear();
+        }
+    }
+
+
+    // Copies a message into the calling thread's buffer. Returns false if it couldn't, in which
+    // case the caller should log it the normal way.
+    bool LogDomain::bufferFileLog(LogLevel level, const char *domain, unsigned objRef,
+                                  const char *fmt, va_list args)
+    {
+        if (tIsDrainer)
+            return false;
+        static thread_local ThreadLogBuffer tBuffer;
+
+        BufferedLogHeader header {LogEncoder::clock::now(), domain, fmt, objRef, level};
+        string &scratch = tBuffer.scratch;
+        scratch.assign((const char*)&header, sizeof(header));
+        scratch.append(fmt, strlen(fmt) + 1);
+        LogEncoder::captureArgs(fmt, args, scratch);
+
+        if (scratch.size() > tBuffer.ring->maxRecordSize())
+            return false;
+        auto deadline = LogEncoder::clock::now() + kMaxBufferWait;
+        while (!tBuffer.ring->push(slice(scratch))) {
+            // Buffer is full, so prod the drainer and wait for it to make room:
+            wakeDrainer();
+            if (LogEncoder::clock::now() > deadline || !sBuffered)
+                return false;
+            this_thread::yield();
+        }
+        if (tBuffer.ring->used() > kThreadBufferSize / 2)
+            wakeDrainer();
+        return true;
+    }
+
+
+    // Writes all buffered messages to the encoders. If `wait` is false, and another thread is
+    // already draining, returns immediately.
+    void LogDomain::drainFileLogBuffers(bool wait) {
+        auto &state = bufferState();
+        unique_lock<mutex> drainLock(state.drainMutex, defer_lock);
+        if (wait)
+            drainLock.lock();
+        else if (!drainLock.try_lock())
+            return;
+
+        vector<shared_ptr<LogRingBuffer>> buffers;
+        {
+            lock_guard<mutex> lock(state.buffersMutex);
+            buffers = state.buffers;
+        }
+
+        unique_lock<mutex> lock(sLogMutex);
+        // Objects unregistered before this point are done logging; their names can be
+        // forgotten once this pass has written their messages:
+        vector<unsigned> retired;
+        swap(retired, sRetiredObjects);
+
+        // Collect the messages from all the buffers, and sort them by time:
+        struct Entry {
+            BufferedLogHeader header;       // (copied, since records aren't aligned)
+            slice body;
+        };
+        vector<Entry> entries;
+        vector<uint64_t> positions(buffers.size());
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            positions[i] = buffers[i]->peekAll([&](slice record) {
+                Entry entry;
+                memcpy(&entry.header, record.buf, sizeof(BufferedLogHeader));
+                entry.body = record.from(sizeof(BufferedLogHeader));
+                entries.push_back(entry);
+            });
+        }
+        stable_sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+            return a.header.time < b.header.time;
+        });
+
+        // Write them:
+        bool wroteLevel[5] = {};
+        for (auto &entry : entries) {
+            auto level = entry.header.level;
+            auto encoder = sLogEncoder[(int)level];
+            if (!encoder || level < sFileMinLevel)
+                continue;
+            auto format = (const char*)entry.body.buf;
+            slice args = entry.body.from(strlen(format) + 1);
+            try {
+                encoder->logCaptured(entry.header.time, entry.header.domain, sObjNames,
+                                     (LogEncoder::ObjectRef)entry.header.objRef,
+                                     entry.header.formatKey, format, args);
+            } catch (const exception &x) {
+                fprintf(stderr, "LiteCore: failed to write buffered log message: %s\n", x.what());
+            }
+            wroteLevel[(int)level] = true;
+        }
+
+        for (size_t i = 0; i < buffers.size(); ++i)
+            buffers[i]->release(positions[i]);
+
+        for (int i = 0; i < 5; ++i) {
+            if (wroteLevel[i] && sLogEncoder[i] && sLogEncoder[i]->tellp() >= sMaxSize)
+                Logging::rotateLog(LogLevel(i));
+        }
+        for (unsigned ref : retired)
+            sObjNames.erase(ref);
+        lock.unlock();
+
+        // Free the buffers of threads that have exited:
+        lock_guard<mutex> buffersLock(state.buffersMutex);
+        state.buffers.erase(remove_if(state.buffers.begin(), state.buffers.end(),
+                                      [](const shared_ptr<LogRingBuffer> &buf) {
+                                          return buf->abandoned() && buf->empty();
+                                      }),
+                            state.buffers.end());
+    }
+
+
+    void LogDomain::drainerThread() {
+        tIsDrainer = true;
+        SetThreadName("CBL Log drainer");
+        auto &state = bufferState();
+        while (true) {
+            {
+                unique_lock<mutex> lock(state.wakeMutex);
+                if (sBuffered)
+                    state.wake.wait_for(lock, kDrainInterval, [&] {return state.wakeRequested;});
+                else
+                    state.wake.wait(lock, [&] {return state.wakeRequested;});
+                state.wakeRequested = false;
+            }
+            drainFileLogBuffers();
+        }
+    }
+
+
 #pragma mark - LOGGING:
 
 
@@ -435,10 +673,27 @@ namespace litecore {
         if (!willLog(level))
             return;
 
+        // Buffered file logging doesn't need the mutex, so do it first:
+        bool toFile = (level >= sFileMinLevel);
+        if (toFile && sBuffered.load(memory_order_relaxed)) {
+            va_list args2;
+            va_copy(args2, args);
+            if (bufferFileLog(level, _name, objRef, fmt, args2))
+                toFile = false;
+            va_end(args2);
+        }
+
+        // Don't lock the mutex if the callback isn't going to be called either:
+        LogLevel callbackLevel = sCallbackMinLevel;
+        if (!toFile && !(doCallback && sCallback.load() && (callbackLevel == LogLevel::Uninitialized
+                                                            || level >= callbackLevel)))
+            return;
+
         unique_lock<mutex> lock(sLogMutex);
 
         // Invoke the client callback:
-        if (doCallback && sCallback && level >= _callbackLogLevel()) {
+        Callback_t callback = sCallback;
+        if (doCallback && callback && level >= _callbackLogLevel()) {
             auto obj = getObject(objRef);
 
             va_list args2;
@@ -450,22 +705,22 @@ namespace litecore {
                     n = snprintf(sFormatBuffer, sizeof(sFormatBuffer), "{%s#%u} ", obj.c_str(), objRef);
                 vsnprintf(&sFormatBuffer[n], sizeof(sFormatBuffer) - n, fmt, args2);
                 va_list noArgs { };
-                sCallback(*this, level, sFormatBuffer, noArgs);
+                callback(*this, level, sFormatBuffer, noArgs);
             } else {
                 // Not preformatted: pass the format string and va_list to the callback
                 // (prefixing the object ref # if any):
                 if (objRef) {
                     snprintf(sFormatBuffer, sizeof(sFormatBuffer), "{%s#%u} %s", obj.c_str(), objRef, fmt);
-                    sCallback(*this, level, sFormatBuffer, args2);
+                    callback(*this, level, sFormatBuffer, args2);
                 } else {
-                    sCallback(*this, level, fmt, args2);
+                    callback(*this, level, fmt, args2);
                 }
             }
             va_end(args2);
         }
 
         // Write to the encoded log file:
-        if (level >= sFileMinLevel) {
+        if (toFile) {
             dylog(level, _name, (LogEncoder::ObjectRef)objRef, fmt, args);
         }
     }
@@ -529,14 +784,15 @@ namespace litecore {
     }
     
     static void invokeCallback(LogDomain &domain, LogLevel level, const char *fmt, ...) {
+        LogDomain::Callback_t callback = sCallback;
         va_list args;
         va_start(args, fmt);
         if (sCallbackPreformatted) {
             vsnprintf(sFormatBuffer, sizeof(sFormatBuffer), fmt, args);
             va_list noArgs { };
-            sCallback(domain, level, sFormatBuffer, noArgs);
+            callback(domain, level, sFormatBuffer, noArgs);
         } else {
-            sCallback(domain, level, fmt, args);
+            callback(domain, level, fmt, args);
         }
         va_end(args);
     }
@@ -586,7 +842,7 @@ namespace litecore {
 
         unsigned objRef = ++slastObjRef;
         sObjNames.insert({objRef, nickname});
-        if (sCallback && level >= _callbackLogLevel())
+        if (sCallback.load() && level >= _callbackLogLevel())
         invokeCallback(*this, level, "{%s#%u}==> %s @%p",
                        nickname.c_str(), objRef, description.c_str(), object);
         return objRef;
@@ -594,7 +850,10 @@ namespace litecore {
 
     void LogDomain::unregisterObject(unsigned objectRef) {
         unique_lock<mutex> lock(sLogMutex);
-        sObjNames.erase(objectRef);
+        if (sBuffered)
+            sRetiredObjects.push_back(objectRef);   // Buffered messages may still refer to it
+        else
+            sObjNames.erase(objectRef);
     }
 
 
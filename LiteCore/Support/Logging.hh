@@ -70,6 +70,7 @@ struct LogFileOptions
     int64_t maxSize;
     int maxCount;
     bool isPlaintext;
+    bool buffered {false};  ///< Threads queue binary log messages in buffers; a background thread writes them
 };
 
 class LogDomain {
@@ -143,6 +144,10 @@ private:
     static void _invalidateEffectiveLevels() noexcept;
 
     void dylog(LogLevel level, const char* domain, unsigned objRef, const char *fmt, va_list);
+    static bool bufferFileLog(LogLevel, const char *domain, unsigned objRef, const char *fmt, va_list);
+    static void drainFileLogBuffers(bool wait =true);
+    static void drainerThread();
+    static void setBuffered(bool);
 
     std::atomic<LogLevel> _effectiveLevel {LogLevel::Uninitialized};
     std::atomic<LogLevel> _level;
@@ -152,8 +157,9 @@ private:
     static unsigned slastObjRef;
     static std::map<unsigned,std::string> sObjNames;
     static LogDomain* sFirstDomain;
-    static LogLevel sCallbackMinLevel;
-    static LogLevel sFileMinLevel;
+    // (Atomic because LogDomain::vlog reads them before deciding whether to lock sLogMutex.)
+    static std::atomic<LogLevel> sCallbackMinLevel;
+    static std::atomic<LogLevel> sFileMinLevel;
 };
 
 extern "C" LogDomain kC4Cpp_DefaultLog;
@@ -0,0 +1,88 @@
+//
+// MPSCQueue.hh
+//
+// Copyright (c) 2021 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include <atomic>
+#include <utility>
+
+namespace litecore { namespace actor {
+
+    /** A lock-free, unbounded, multiple-producer single-consumer FIFO queue.
+        Any number of threads may call `push` concurrently, but only one thread at a time may
+        call `pop`. (This is D. Vyukov's node-based MPSC queue.)
+
+        A push that is still in progress on another thread can briefly hide the items pushed
+        after it, so `pop` may return false even though a later push has completed. Callers
+        that know an item must be present (e.g. because they keep their own count) should
+        retry. */
+    template <class T>
+    class MPSCQueue {
+    public:
+        MPSCQueue()
+        :_head(new Node)
+        ,_tail(_head.load(std::memory_order_relaxed))
+        { }
+
+        ~MPSCQueue() {
+            T item;
+            while (pop(item))
+                ;
+            delete _tail;
+        }
+
+        /** Adds an item to the end of the queue. Thread-safe and wait-free. */
+        void push(T item) {
+            Node *node = new Node(std::move(item));
+            Node *prev = _head.exchange(node, std::memory_order_acq_rel);
+            prev->next.store(node, std::memory_order_release);
+        }
+
+        /** Removes the item at the front of the queue. Must only be called by the consumer.
+            @return  True if an item was popped, false if the queue appeared empty. */
+        bool pop(T &outItem) {
+            Node *tail = _tail;
+            Node *next = tail->next.load(std::memory_order_acquire);
+            if (!next)
+                return false;
+            outItem = std::move(next->item);
+            _tail = next;           // `next` becomes the new (empty) stub node
+            delete tail;
+            return true;
+        }
+
+        /** True if the queue appears empty. Only meaningful when called by the consumer. */
+        bool empty() const {
+            return _tail->next.load(std::memory_order_acquire) == nullptr;
+        }
+
+    private:
+        struct Node {
+            Node() =default;
+            explicit Node(T &&i)    :item(std::move(i)) { }
+            std::atomic<Node*> next {nullptr};
+            T item {};
+        };
+
+        MPSCQueue(const MPSCQueue&) =delete;
+        MPSCQueue& operator=(const MPSCQueue&) =delete;
+
+        alignas(64) std::atomic<Node*> _head;   // Most recently pushed node (producers)
+        alignas(64) Node*              _tail;   // Stub node before the front item (consumer)
+    };
+
+} }
@@ -0,0 +1,157 @@
+//
+// PipelinedWriteStream.cc
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "PipelinedWriteStream.hh"
+#include "Error.hh"
+#include "Logging.hh"
+#include "ThreadUtil.hh"
+#include <algorithm>
+
+namespace litecore {
+    using namespace std;
+
+
+    PipelinedWriteStream::PipelinedWriteStream(shared_ptr<WriteStream> output,
+                                               uint64_t startThreshold,
+                                               size_t chunkSize,
+                                               size_t maxQueuedChunks)
+    :_output(move(output))
+    ,_startThreshold(startThreshold)
+    ,_chunkSize(chunkSize)
+    ,_maxQueuedChunks(maxQueuedChunks)
+    {
+        Assert(_chunkSize > 0 && _maxQueuedChunks > 0);
+    }
+
+
+    PipelinedWriteStream::~PipelinedWriteStream() {
+        // If close() wasn't called, the stream is being abandoned; don't bother writing the rest.
+        if (_thread.joinable())
+            stopWriter(true);
+    }
+
+
+    void PipelinedWriteStream::write(slice data) {
+        checkError();
+        if (!_pipelined) {
+            if (_bytesWritten + data.size <= _startThreshold) {
+                _output->write(data);
+                _bytesWritten += data.size;
+                return;
+            }
+            _thread = thread(&PipelinedWriteStream::runWriter, this);
+            _pipelined = true;
+        }
+        _bytesWritten += data.size;
+
+        while (data.size > 0) {
+            if (_pending.empty() && data.size >= _chunkSize) {
+                // Queue a full chunk directly, without copying it into _pending first:
+                enqueue(alloc_slice(data.buf, _chunkSize));
+                data.moveStart(_chunkSize);
+            } else {
+                size_t n = min(data.size, _chunkSize - _pending.size());
+                _pending.append((const char*)data.buf, n);
+                data.moveStart(n);
+                if (_pending.size() >= _chunkSize)
+                    flushPending();
+            }
+        }
+    }
+
+
+    void PipelinedWriteStream::close() {
+        if (_thread.joinable()) {
+            flushPending();
+            stopWriter(false);
+        }
+        checkError();
+        _output->close();
+    }
+
+
+    void PipelinedWriteStream::flushPending() {
+        if (!_pending.empty()) {
+            enqueue(alloc_slice(_pending));
+            _pending.clear();
+        }
+    }
+
+
+    void PipelinedWriteStream::enqueue(alloc_slice chunk) {
+        {
+            unique_lock<mutex> lock(_mutex);
+            _cond.wait(lock, [&]{return _queue.size() < _maxQueuedChunks || _error;});
+            if (!_error)
+                _queue.push_back(move(chunk));
+        }
+        _cond.notify_all();
+        checkError();
+    }
+
+
+    void PipelinedWriteStream::runWriter() {
+        SetThreadName("LiteCore Blob Writer");
+        unique_lock<mutex> lock(_mutex);
+        while (true) {
+            _cond.wait(lock, [&]{return !_queue.empty() || _stopping;});
+            if (_queue.empty())
+                break;                      // Stopping, and everything's been written
+            alloc_slice chunk = move(_queue.front());
+            _queue.pop_front();
+            lock.unlock();
+            _cond.notify_all();             // Wake the producer if it's waiting for space
+
+            try {
+                _output->write(chunk);
+            } catch (...) {
+                lock.lock();
+                _error = current_exception();
+                _queue.clear();
+                lock.unlock();
+                _cond.notify_all();
+                return;
+            }
+            lock.lock();
+        }
+    }
+
+
+    void PipelinedWriteStream::stopWriter(bool discardQueued) noexcept {
+        {
+            unique_lock<mutex> lock(_mutex);
+            if (discardQueued)
+                _queue.clear();
+            _stopping = true;
+        }
+        _cond.notify_all();
+        _thread.join();
+    }
+
+
+    void PipelinedWriteStream::checkError() {
+        exception_ptr error;
+        {
+            unique_lock<mutex> lock(_mutex);
+            error = _error;
+        }
+        if (error)
+            rethrow_exception(error);
+    }
+
+}
@@ -0,0 +1,80 @@
+//
+// PipelinedWriteStream.hh
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "Stream.hh"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace litecore {
+
+    /** A WriteStream that passes data to another WriteStream on a background thread, so the
+        caller can go on producing (and hashing) data while the output encrypts and writes it.
+        Data is handed over in chunks through a bounded queue, so a slow output blocks the
+        caller instead of letting memory use grow without limit.
+
+        The thread isn't started until more than `startThreshold` bytes have been written;
+        until then writes go straight to the output, so small streams don't pay for a thread.
+        An exception thrown by the output is rethrown by the next call to write() or close(). */
+    class PipelinedWriteStream final : public WriteStream {
+    public:
+        static constexpr uint64_t kDefaultStartThreshold = 1024 * 1024;
+        static constexpr size_t kDefaultChunkSize = 64 * 1024;
+        static constexpr size_t kDefaultMaxQueuedChunks = 16;
+
+        explicit PipelinedWriteStream(std::shared_ptr<WriteStream> output,
+                                      uint64_t startThreshold =kDefaultStartThreshold,
+                                      size_t chunkSize =kDefaultChunkSize,
+                                      size_t maxQueuedChunks =kDefaultMaxQueuedChunks);
+        ~PipelinedWriteStream();
+
+        void write(slice) override;
+
+        /** Waits for all queued data to be written, then closes the output stream. */
+        void close() override;
+
+        /** True once the background thread has been started. */
+        bool isPipelined() const                {return _pipelined;}
+
+    private:
+        void enqueue(alloc_slice chunk);
+        void flushPending();
+        void runWriter();
+        void stopWriter(bool discardQueued) noexcept;
+        void checkError();
+
+        std::shared_ptr<WriteStream> _output;       // Stream the data is written to
+        uint64_t const _startThreshold;
+        size_t const _chunkSize, _maxQueuedChunks;
+        uint64_t _bytesWritten {0};
+        bool _pipelined {false};                    // Has _thread been started?
+        std::string _pending;                       // Data not yet queued (< _chunkSize)
+        std::thread _thread;                        // Thread that writes to _output
+        std::mutex _mutex;                          // Guards the members below
+        std::condition_variable _cond;
+        std::deque<alloc_slice> _queue;             // Chunks waiting to be written
+        bool _stopping {false};
+        std::exception_ptr _error;                  // Exception thrown by _output
+    };
+
+}
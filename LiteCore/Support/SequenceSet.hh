@@ -17,9 +17,10 @@
 //
 
 #pragma once
-#include <map>
+#include <algorithm>
 #include <string>
 #include <utility>
+#include <vector>
 #include "betterassert.hh"
 
 namespace litecore {
@@ -28,11 +29,14 @@ namespace litecore {
         This is used by the replicator to keep track of which revisions are being pushed.
 
         \note The implementation is optimized for consecutive ranges of sequences: it stores
-        ranges using a std::map that maps the first sequence in a range to the end of the range. */
+        ranges in a sorted vector of (start, end) pairs. Since sequences are mostly added near
+        the end, and the number of ranges stays small, this is much cheaper than a tree, and
+        doesn't allocate a node per range. */
     class SequenceSet {
     public:
         using sequence = uint64_t;
-        using Map = std::map<sequence, sequence>;
+        using Range = std::pair<sequence, sequence>;
+        using Ranges = std::vector<Range>;
 
         SequenceSet() =default;
 
@@ -54,18 +58,17 @@ namespace litecore {
         size_t rangesCount() const              {return _sequences.size();}
 
         /** Returns the lowest sequence in the set. If the set is empty, returns 0. */
-        sequence first() const                  {return empty() ? 0 : _sequences.begin()->first;}
+        sequence first() const                  {return empty() ? 0 : _sequences.front().first;}
 
         /** Returns the highest sequence in the set. If the set is empty, returns 0. */
-        sequence last() const                   {return empty() ? 0 : prev(_sequences.end())->second - 1;}
+        sequence last() const                   {return empty() ? 0 : _sequences.back().second - 1;}
 
         /** Is the sequence in the set? */
         bool contains(sequence s) const {
-            auto i = _sequences.upper_bound(s); // first range with start > s
+            auto i = _upperBound(s); // first range with start > s
             if (i == _sequences.begin())
                 return false;
-            i = prev(i);
-            return s < i->second;
+            return s < prev(i)->second;
         }
 
         bool operator== (const SequenceSet &other) const  {return _sequences == other._sequences;}
@@ -73,22 +76,33 @@ namespace litecore {
 
         /** Adds a sequence. */
         void add(sequence s) {
-            (void)_add(s);
+            add(s, s + 1);
         }
 
         /** Adds all sequences in the range [s0...s1), _not including s1_ */
         void add(sequence s0, sequence s1) {
             assert (s1 >= s0);
-            if (s1 > s0) {
-                auto lower = _add(s0);
-                if (s1 > s0 + 1) {
-                    auto upper = _add(s1 - 1);
-                    if (upper != lower) {
-                        // Merge lower and upper, discarding any ranges in between:
-                        lower->second = upper->second;
-                        _sequences.erase(next(lower), next(upper));
-                    }
-                }
+            if (s1 == s0)
+                return;
+            if (_sequences.empty() || s0 > _sequences.back().second) {
+                // Fast path: appending a new range at the end
+                _sequences.emplace_back(s0, s1);
+                return;
+            }
+            // First range that overlaps or touches [s0, s1), i.e. that ends at or after s0:
+            auto lo = std::lower_bound(_sequences.begin(), _sequences.end(), s0,
+                                       [](const Range &r, sequence s) {return r.second < s;});
+            // First range past [s0, s1) that doesn't touch it, i.e. that starts after s1:
+            auto hi = std::upper_bound(lo, _sequences.end(), s1,
+                                       [](sequence s, const Range &r) {return s < r.first;});
+            if (lo == hi) {
+                // * Insert a new range
+                _sequences.emplace(lo, s0, s1);
+            } else {
+                // * Extend `lo` to cover [s0, s1) and all ranges up to `hi`, and remove those
+                lo->first = std::min(lo->first, s0);
+                lo->second = std::max(prev(hi)->second, s1);
+                _sequences.erase(next(lo), hi);
             }
         }
 
@@ -101,11 +115,11 @@ namespace litecore {
             // * s is at the end of a range, so decrement its end
             // * s is in the middle of a range, so split the range
 
-            auto i = _sequences.upper_bound(s); // first range with start > s
+            auto i = _upperBound(s); // first range with start > s
             if (i == _sequences.begin())
                 return false;
             i = prev(i);
-            
+
             if (s >= i->second) {
                 // * not contained in a range
                 return false;
@@ -115,16 +129,16 @@ namespace litecore {
                     _sequences.erase(i);
                 } else {
                     // * at the start of a range
-                    _sequences.emplace_hint(next(i), s + 1, i->second);
-                    _sequences.erase(i);
+                    i->first = s + 1;
                 }
             } else if (s == i->second - 1) {
                 // * at the end of a range
                 i->second = s;
             } else {
                 // * split the range:
-                _sequences.emplace_hint(next(i), s + 1, i->second);
+                sequence end = i->second;
                 i->second = s;
+                _sequences.emplace(next(i), s + 1, end);
             }
             return true;
         }
@@ -133,27 +147,40 @@ namespace litecore {
         /** Removes all sequences in the range [s0...s1), _not including s1_ */
         void remove(sequence s0, sequence s1) {
             assert (s1 >= s0);
-            if (s1 > s0) {
-                remove(s0);
-                if (s1 > s0 + 1) {
-                    remove(s1 - 1);
-                    if (s1 > s0 + 2) {
-                        // Remove any remaining ranges between s0 and s1:
-                        auto begin = _sequences.upper_bound(s0); // first range with start > s0
-                        auto end = begin;
-                        while (end != _sequences.end() && end->second <= s1)
-                            ++end;
-                        _sequences.erase(begin, end);
-                    }
-                }
+            if (s1 == s0)
+                return;
+            // First range that overlaps [s0, s1), i.e. that ends after s0:
+            auto lo = std::upper_bound(_sequences.begin(), _sequences.end(), s0,
+                                       [](sequence s, const Range &r) {return s < r.second;});
+            // First range past [s0, s1), i.e. that starts at or after s1:
+            auto hi = std::lower_bound(lo, _sequences.end(), s1,
+                                       [](const Range &r, sequence s) {return r.first < s;});
+            if (lo == hi)
+                return;
+            auto last = prev(hi);
+            bool keepHead = (lo->first < s0), keepTail = (last->second > s1);
+            if (lo == last && keepHead && keepTail) {
+                // * split the range:
+                sequence end = lo->second;
+                lo->second = s0;
+                _sequences.emplace(next(lo), s1, end);
+                return;
             }
+            // * trim the ranges at the ends, and remove the ones in between:
+            if (keepHead)
+                (lo++)->second = s0;
+            if (keepTail) {
+                last->first = s1;
+                hi = last;
+            }
+            _sequences.erase(lo, hi);
         }
 
 
         /** Iteration is over pair<sequence,sequence> values, where the first sequence is the
             start of a consecutive range, and the second sequence is the end of the range
             (one past the last sequence in the range.) */
-        using const_iterator = Map::const_iterator;
+        using const_iterator = Ranges::const_iterator;
         const_iterator begin() const                  {return _sequences.begin();}
         const_iterator end() const                    {return _sequences.end();}
 
@@ -161,50 +188,17 @@ namespace litecore {
         std::string to_string() const;
 
     private:
-        // Implementation of add; returns an iterator pointing to the range containing `s`
-        Map::iterator _add(sequence s) {
-            // Possibilities:
-            // * s is already contained within a range
-            // * s is just before a range, so prepend it
-            // * s is just after a range, so append it
-            // * s fills a crack between two ranges (i.e. both of the above), so merge them
-            // * s creates a new range of length 1
-
-            auto upper = _sequences.upper_bound(s); // first range with start > s
-            if (upper != _sequences.end() && s == upper->first - 1) {
-                // s is just before upper; extend it or merge:
-                if (upper != _sequences.begin()) {
-                    auto lower = prev(upper);
-                    if (lower->second == s) {
-                        // * Merge upper and lower
-                        lower->second = upper->second;
-                        _sequences.erase(upper);
-                        return lower;
-                    }
-                }
-                // * Prepend s to upper:
-                auto newUpper = _sequences.emplace_hint(upper, s, upper->second);
-                _sequences.erase(upper);
-                return newUpper;
-            }
-
-            if (upper != _sequences.begin()) {
-                auto lower = prev(upper);
-                if (s < lower->second) {
-                    // * Already contained
-                    return lower;
-                } else if (s == lower->second) {
-                    // * Append s to lower:
-                    ++lower->second;
-                    return lower;
-                }
-            }
+        // Returns the first range whose start is greater than `s`.
+        Ranges::iterator _upperBound(sequence s) {
+            return std::upper_bound(_sequences.begin(), _sequences.end(), s,
+                                    [](sequence s, const Range &r) {return s < r.first;});
+        }
 
-            // * Insert a singleton
-            return _sequences.emplace_hint(upper, s, s + 1);
+        Ranges::const_iterator _upperBound(sequence s) const {
+            return const_cast<SequenceSet*>(this)->_upperBound(s);
         }
 
-        Map _sequences;    // Maps start of range --> end of range (exclusive)
+        Ranges _sequences;    // Sorted, non-overlapping, non-adjacent ranges [start, end)
     };
 
 }
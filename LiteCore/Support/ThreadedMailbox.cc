@@ -23,7 +23,10 @@
 #include "Error.hh"
 #include "Timer.hh"
 #include "Logging.hh"
+#include "WorkStealingDeque.hh"
+#include <condition_variable>
 #include <future>
+#include <mutex>
 #include <random>
 #include <map>
 #include <sstream>
@@ -68,6 +71,49 @@ namespace litecore { namespace actor {
     static random_device rd;
     static mt19937 sRandGen(rd());
 
+
+    // State of one thread of a WorkStealing Scheduler.
+    struct Scheduler::Worker {
+        Worker(Scheduler *s, unsigned taskID)
+        :scheduler(s)
+        ,id(taskID)
+        ,rand(taskID)
+        { }
+
+        void wake() {
+            {
+                lock_guard<std::mutex> lock(sleepMutex);
+                wakeup = true;
+            }
+            sleepCond.notify_one();
+        }
+
+        Scheduler* const                    scheduler;
+        unsigned const                      id;
+        WorkStealingDeque<ThreadedMailbox*> deque;      // Mailboxes scheduled on this thread
+        MPSCQueue<ThreadedMailbox*>         inbox;      // Mailboxes scheduled by other threads
+        std::mutex                          inboxMutex; // Held while popping from inbox
+        atomic<unsigned>                    inboxCount {0}; // Approximate size of inbox
+        atomic<bool>                        sleeping {false};
+        std::mutex                          sleepMutex;
+        condition_variable                  sleepCond;
+        bool                                wakeup {false};
+        minstd_rand                         rand;       // Picks victims to steal from
+    };
+
+
+    thread_local Scheduler::Worker* Scheduler::sCurrentWorker;
+
+
+    Scheduler::Scheduler(unsigned numThreads, Backend backend)
+    :_numThreads(numThreads)
+    ,_backend(backend)
+    { }
+
+
+    Scheduler::~Scheduler() = default;
+
+
     Scheduler* Scheduler::sharedScheduler() {
         if (!sScheduler) {
             sScheduler = new Scheduler;
@@ -84,7 +130,13 @@ namespace litecore { namespace actor {
                 if (_numThreads == 0)
                     _numThreads = 2;
             }
-            LogTo(ActorLog, "Starting Scheduler<%p> with %u threads", this, _numThreads);
+            LogTo(ActorLog, "Starting Scheduler<%p> with %u threads (%s)", this, _numThreads,
+                  (_backend == Backend::WorkStealing ? "work-stealing" : "shared queue"));
+            _stopping = false;
+            if (_backend == Backend::WorkStealing && _workers.empty()) {
+                for (unsigned id = 1; id <= _numThreads; id++)
+                    _workers.emplace_back(new Worker(this, id));
+            }
             for (unsigned id = 1; id <= _numThreads; id++)
                 _threadPool.emplace_back([this,id]{task(id);});
         }
@@ -93,39 +145,194 @@ namespace litecore { namespace actor {
 
     void Scheduler::stop() {
         LogTo(ActorLog, "Stopping Scheduler<%p>...", this);
-        _queue.close();
+        if (_backend == Backend::WorkStealing) {
+            _stopping = true;
+            for (auto &worker : _workers)
+                worker->wake();
+        } else {
+            _queue.close();
+        }
         for (auto &t : _threadPool) {
             t.join();
         }
+        _threadPool.clear();
         LogTo(ActorLog, "Scheduler<%p> has stopped", this);
         _started.clear();
     }
 
 
+    void Scheduler::runSynchronous() {
+        Assert(_backend == Backend::SharedQueue);
+        task(0);
+    }
+
+
     void Scheduler::task(unsigned taskID) {
         LogVerbose(ActorLog, "   task %d starting", taskID);
         char name[100];
         sprintf(name, "CBL Scheduler#%u", taskID);
         SetThreadName(name);
-        ThreadedMailbox *mailbox;
-        while ((mailbox = _queue.pop()) != nullptr) {
-            LogVerbose(ActorLog, "   task %d calling Actor<%p>", taskID, mailbox);
-            mailbox->performNextMessage();
-            mailbox = nullptr;
+        if (_backend == Backend::WorkStealing) {
+            workerTask(*_workers[taskID - 1]);
+        } else {
+            ThreadedMailbox *mailbox;
+            while ((mailbox = _queue.pop()) != nullptr) {
+                LogVerbose(ActorLog, "   task %d calling Actor<%p>", taskID, mailbox);
+                mailbox->performNextMessage();
+                mailbox = nullptr;
+            }
         }
         LogTo(ActorLog, "   task %d finished", taskID);
     }
 
 
     void Scheduler::schedule(ThreadedMailbox *mbox) {
-        sScheduler->_queue.push(mbox);
+        if (_backend == Backend::SharedQueue) {
+            _queue.push(mbox);
+            return;
+        }
+
+        if (sCurrentWorker && sCurrentWorker->scheduler == this) {
+            // Called from one of my threads (usually an Actor messaging another Actor):
+            // push onto this thread's deque, and let an idle thread steal it if there is one.
+            if (sCurrentWorker->deque.push(mbox)) {
+                wakeIdleWorker();
+                return;
+            }
+        }
+        // Called from elsewhere, or the deque is full: hand it to a Worker's inbox.
+        Worker &worker = pickWorker();
+        ++worker.inboxCount;                    // (before pushing, so it can't go negative)
+        worker.inbox.push(mbox);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (worker.sleeping.load(memory_order_relaxed))
+            worker.wake();
+    }
+
+
+#pragma mark - WORK-STEALING:
+
+
+    void Scheduler::workerTask(Worker &worker) {
+        sCurrentWorker = &worker;
+        while (true) {
+            ThreadedMailbox *mailbox = findWork(worker);
+            if (mailbox) {
+                LogVerbose(ActorLog, "   task %d calling Actor<%p>", worker.id, mailbox);
+                mailbox->performNextMessage();
+            } else if (_stopping) {
+                break;
+            } else {
+                idle(worker);
+            }
+        }
+        sCurrentWorker = nullptr;
+    }
+
+
+    ThreadedMailbox* Scheduler::findWork(Worker &worker) {
+        // Move mailboxes scheduled from other threads into my deque, where idle threads can
+        // steal them:
+        ThreadedMailbox *mailbox;
+        unsigned moved = 0;
+        while ((mailbox = popInbox(worker)) != nullptr) {
+            if (!worker.deque.push(mailbox))
+                return mailbox;                 // Deque is full, so run this one right away
+            ++moved;
+        }
+        if (moved > 1)
+            wakeIdleWorker();
+
+        // Take my own work from the top, i.e. oldest first. Popping from the bottom would let an
+        // Actor that keeps messaging another starve the mailboxes scheduled before them.
+        while (!worker.deque.empty()) {
+            if ((mailbox = worker.deque.steal()) != nullptr)
+                return mailbox;
+        }
+
+        // Nothing of my own to do, so try to steal, starting at a random victim. A victim's
+        // inbox is fair game too, since it may be busy running a long message:
+        auto n = _workers.size();
+        auto start = worker.rand() % n;
+        for (size_t i = 0; i < n; ++i) {
+            Worker *victim = _workers[(start + i) % n].get();
+            if (victim == &worker)
+                continue;
+            if ((mailbox = victim->deque.steal()) != nullptr)
+                return mailbox;
+            if ((mailbox = popInbox(*victim)) != nullptr)
+                return mailbox;
+        }
+        return nullptr;
+    }
+
+
+    ThreadedMailbox* Scheduler::popInbox(Worker &worker) {
+        // The inbox only allows one consumer at a time, so whoever pops holds its mutex. If
+        // another thread is already popping, don't wait; it'll take care of the mailboxes.
+        if (worker.inboxCount.load(memory_order_acquire) == 0)
+            return nullptr;
+        unique_lock<std::mutex> lock(worker.inboxMutex, try_to_lock);
+        ThreadedMailbox *mailbox;
+        if (!lock || !worker.inbox.pop(mailbox))
+            return nullptr;
+        --worker.inboxCount;
+        return mailbox;
+    }
+
+
+    bool Scheduler::hasWork(Worker &worker) {
+        for (auto &w : _workers) {
+            if (w->inboxCount.load(memory_order_acquire) > 0 || !w->deque.empty())
+                return true;
+        }
+        return false;
+    }
+
+
+    void Scheduler::idle(Worker &worker) {
+        worker.sleeping.store(true);
+        ++_numSleeping;
+        atomic_thread_fence(memory_order_seq_cst);
+        // Check again after announcing I'm asleep, so a concurrent schedule() can't be missed:
+        if (!hasWork(worker) && !_stopping) {
+            unique_lock<std::mutex> lock(worker.sleepMutex);
+            worker.sleepCond.wait(lock, [&]{return worker.wakeup;});
+            worker.wakeup = false;
+        }
+        --_numSleeping;
+        worker.sleeping.store(false);
     }
 
 
-    // Explicitly instantiate the Channel specializations we need; this corresponds to the
-    // "extern template..." declarations at the bottom of Actor.hh
+    void Scheduler::wakeIdleWorker() {
+        atomic_thread_fence(memory_order_seq_cst);
+        if (_numSleeping.load(memory_order_relaxed) == 0)
+            return;
+        for (auto &w : _workers) {
+            if (w->sleeping.load(memory_order_relaxed)) {
+                w->wake();
+                return;
+            }
+        }
+    }
+
+
+    Scheduler::Worker& Scheduler::pickWorker() {
+        // Prefer an idle Worker, since it can start on the mailbox immediately:
+        if (_numSleeping.load(memory_order_relaxed) > 0) {
+            for (auto &w : _workers) {
+                if (w->sleeping.load(memory_order_relaxed))
+                    return *w;
+            }
+        }
+        return *_workers[_nextWorker.fetch_add(1, memory_order_relaxed) % _workers.size()];
+    }
+
+
+    // Explicitly instantiate the Channel specialization we need; this corresponds to the
+    // "extern template..." declaration at the bottom of ThreadedMailbox.hh
     template class Channel<ThreadedMailbox*>;
-    template class Channel<std::function<void()>>;
 
 
 #pragma mark - MAILBOX:
@@ -139,8 +346,16 @@ namespace litecore { namespace actor {
     ThreadedMailbox::ThreadedMailbox(Actor *a, const std::string &name, ThreadedMailbox *parent)
     :_actor(a)
     ,_name(name)
+    ,_scheduler(parent ? parent->_scheduler : Scheduler::sharedScheduler())
     {
-        Scheduler::sharedScheduler()->start();
+        _scheduler->start();
+    }
+
+
+    void ThreadedMailbox::setScheduler(Scheduler *s) {
+        Assert(_queueCount == 0);
+        _scheduler = s;
+        _scheduler->start();
     }
 
     void ThreadedMailbox::enqueue(const char* name, const std::function<void()> &f) {
@@ -170,7 +385,8 @@ namespace litecore { namespace actor {
 #endif
         };
 
-        if (push(wrappedBlock))
+        _queue.push(wrappedBlock);
+        if (++_queueCount == 1)
             reschedule();
     }
 
@@ -209,7 +425,8 @@ namespace litecore { namespace actor {
 #endif
             };
             
-            if (push(wrappedBlock))
+            _queue.push(wrappedBlock);
+            if (++_queueCount == 1)
                 reschedule();
         });
 
@@ -250,24 +467,27 @@ namespace litecore { namespace actor {
 
 
     void ThreadedMailbox::reschedule() {
-        Scheduler::schedule(this);
+        _scheduler->schedule(this);
     }
 
 
     void ThreadedMailbox::performNextMessage() {
         LogVerbose(ActorLog, "%s performNextMessage", _actor->actorName().c_str());
         DebugAssert(++_active == 1);     // Fail-safe check to detect 'impossible' re-entrant call
-        sCurrentActor = _actor;
-        auto &fn = front();
-        fn();
-        sCurrentActor = nullptr;
+        {
+            std::function<void()> fn;
+            while (!_queue.pop(fn))
+                this_thread::yield();   // The message's push hasn't finished linking it in yet
+            sCurrentActor = _actor;
+            fn();
+            sCurrentActor = nullptr;
+        }
         
         DebugAssert(--_active == 0);
 
-        bool empty;
-        popNoWaiting(empty);
+        bool more = (--_queueCount > 0);
         release(_actor); // For enqueue's retain call
-        if (!empty)
+        if (more)
             reschedule();
     }
 
@@ -19,6 +19,7 @@
 #pragma once
 #include "Channel.hh"
 #include "ChannelManifest.hh"
+#include "MPSCQueue.hh"
 #include "RefCounted.hh"
 #include "Stopwatch.hh"
 #include <atomic>
@@ -29,6 +30,12 @@
 #include <functional>
 #include <vector>
 
+// Set to 0 to make the shared Scheduler use a single mutex-protected queue instead of
+// per-thread work-stealing deques.
+#ifndef ACTORS_USE_WORK_STEALING
+#define ACTORS_USE_WORK_STEALING 1
+#endif
+
 namespace litecore { namespace actor {
     using fleece::RefCounted;
     using fleece::Retained;
@@ -43,14 +50,22 @@ namespace litecore { namespace actor {
 
 
     #ifndef ACTORS_USE_GCD
-    /** Default Actor mailbox implementation that uses a thread pool run by a Scheduler. */
-    class ThreadedMailbox : Channel<std::function<void()>> {
+    /** Default Actor mailbox implementation that uses a thread pool run by a Scheduler.
+        Messages are queued in a lock-free MPSC queue; the mailbox is handed to the Scheduler
+        when its first message arrives, and re-handed after each message while more remain. */
+    class ThreadedMailbox {
     public:
+        /** If a parent mailbox is given, this mailbox uses the parent's Scheduler;
+            otherwise it uses the shared Scheduler. */
         ThreadedMailbox(Actor*, const std::string &name ="", ThreadedMailbox *parentMailbox =nullptr);
 
         const std::string& name() const                     {return _name;}
 
-        unsigned eventCount() const                         {return (unsigned)size() + (unsigned)_delayedEventCount;}
+        Scheduler* scheduler() const                        {return _scheduler;}
+        /** Changes the Scheduler. Must only be called while no messages are queued. */
+        void setScheduler(Scheduler *s);
+
+        unsigned eventCount() const                         {return (unsigned)_queueCount + (unsigned)_delayedEventCount;}
 
         void enqueue(const char* name, const std::function<void()>&);
         void enqueueAfter(delay_t delay, const char* name, const std::function<void()>&);
@@ -71,7 +86,10 @@ namespace litecore { namespace actor {
 
         Actor* const _actor;
         std::string const _name;
+        Scheduler* _scheduler;
 
+        MPSCQueue<std::function<void()>> _queue;    // Pending messages
+        std::atomic<int> _queueCount {0};           // Number of messages pushed but not yet run
         int _delayedEventCount {0};
 #if DEBUG
         std::atomic_int _active {0};
@@ -97,13 +115,22 @@ namespace litecore { namespace actor {
         It managers a thread pool on which Mailboxes and Actors will run. */
     class Scheduler {
     public:
-        Scheduler(unsigned numThreads =0)
-        :_numThreads(numThreads)
-        { }
+        enum class Backend {
+            SharedQueue,    ///< All threads take mailboxes from one mutex-protected Channel
+            WorkStealing,   ///< Each thread has a lock-free deque; idle threads steal from others
+        };
+
+        static constexpr Backend kDefaultBackend = ACTORS_USE_WORK_STEALING ? Backend::WorkStealing
+                                                                            : Backend::SharedQueue;
+
+        Scheduler(unsigned numThreads =0, Backend backend =kDefaultBackend);
+        ~Scheduler();
 
         /** Returns a per-process shared instance. */
         static Scheduler* sharedScheduler();
 
+        Backend backend() const                             {return _backend;}
+
         /** Starts the background threads that will run queued Actors. */
         void start();
 
@@ -111,20 +138,36 @@ namespace litecore { namespace actor {
         void stop();
 
         /** Runs the scheduler on the current thread; doesn't return until all pending
-            messages are handled. */
-        void runSynchronous()                               {task(0);}
+            messages are handled. (Only supported by the SharedQueue backend.) */
+        void runSynchronous();
 
     protected:
         friend class ThreadedMailbox;
 
         /** A request for an Actor's performNextMessage method to be called. */
-        static void schedule(ThreadedMailbox* mbox);
+        void schedule(ThreadedMailbox* mbox);
 
     private:
+        struct Worker;
+
         void task(unsigned taskID);
+        void workerTask(Worker&);
+        ThreadedMailbox* findWork(Worker&);
+        ThreadedMailbox* popInbox(Worker&);
+        bool hasWork(Worker&);
+        void idle(Worker&);
+        void wakeIdleWorker();
+        Worker& pickWorker();
+
+        static thread_local Worker* sCurrentWorker;     // The Worker running on this thread
 
         unsigned _numThreads;
-        Channel<ThreadedMailbox*> _queue;
+        Backend const _backend;
+        Channel<ThreadedMailbox*> _queue;                   // Used by SharedQueue backend
+        std::vector<std::unique_ptr<Worker>> _workers;      // Used by WorkStealing backend
+        std::atomic<unsigned> _numSleeping {0};             // Number of idle Workers
+        std::atomic<unsigned> _nextWorker {0};              // Round-robin for external schedules
+        std::atomic<bool> _stopping {false};
         std::vector<std::thread> _threadPool;
         std::atomic_flag _started = ATOMIC_FLAG_INIT;
 
@@ -133,7 +176,6 @@ namespace litecore { namespace actor {
 
     // This prevents the compiler from specializing Channel in every compilation unit:
     extern template class Channel<ThreadedMailbox*>;
-    extern template class Channel<std::function<void()>>;
 #endif
 
 } }
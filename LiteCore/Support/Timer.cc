@@ -18,12 +18,25 @@
 
 #include "Timer.hh"
 #include "ThreadUtil.hh"
-#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 using namespace std;
 
 namespace litecore { namespace actor {
 
+    static inline unsigned countTrailingZeros(uint64_t word) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, word);
+        return unsigned(index);
+#else
+        return unsigned(__builtin_ctzll(word));
+#endif
+    }
+
+
     Timer::Manager& Timer::manager() {
         static Manager* sManager = new Manager;
         return *sManager;
@@ -31,69 +44,243 @@ namespace litecore { namespace actor {
 
 
     Timer::Manager::Manager()
-    :_thread([this](){ run(); })
+    :_epoch(clock::now())
+    ,_thread([this](){ run(); })
     { }
 
 
+    uint64_t Timer::Manager::tickAt(time t, bool roundUp) const {
+        if (t <= _epoch)
+            return 0;
+        duration d = t - _epoch;
+        auto ms = chrono::duration_cast<chrono::milliseconds>(d);
+        return uint64_t(ms.count()) + (roundUp && ms < d);
+    }
+
+
+    Timer::time Timer::Manager::timeOfTick(uint64_t tick) const {
+        auto maxTick = chrono::duration_cast<chrono::milliseconds>(time::max() - _epoch).count();
+        if (tick >= uint64_t(maxTick))
+            return time::max();
+        return _epoch + chrono::milliseconds(tick);
+    }
+
+
     // Body of the manager's background thread. Waits for timers and calls their callbacks.
     void Timer::Manager::run() {
         SetThreadName("Timer (CBL)");
         unique_lock<mutex> lock(_mutex);
         while(true) {
-            auto earliest = _schedule.begin();
-            if (earliest == _schedule.end()) {
-                // Schedule is empty; just wait for a change
-                _condition.wait(lock);
-
-            } else if (earliest->first <= clock::now()) {
-                // A Timer is ready to fire, so remove it and call the callback:
-                auto timer = earliest->second;
-                timer->_triggered = true;
-                _unschedule(timer);
-
-                // Fire the timer, while not holding the mutex (to avoid deadlocks if the
-                // timer callback calls the Timer API.)
-                lock.unlock();
-                try {
-                    timer->_callback();
-                } catch (...) { }
-                timer->_triggered = false;                   // note: not holding any lock
-                if (timer->_autoDelete)
-                    delete timer;
-                lock.lock();
-
-            } else {
-                // Wait for the first timer's fireTime, or until the _schedule is updated:
-                auto nextFireTime = earliest->first;
-                _condition.wait_until(lock, nextFireTime);
+            if (_ready.empty()) {
+                // Move every timer that's come due into _ready:
+                advanceTo(tickAt(clock::now(), false));
+                if (_ready.empty()) {
+                    // Nothing is due; wait until something may be, or until a timer is
+                    // scheduled earlier than that:
+                    _wakeTick = nextExpiry();
+                    if (_wakeTick == kNoTick)
+                        _condition.wait(lock);
+                    else
+                        _condition.wait_until(lock, timeOfTick(_wakeTick));
+                    _wakeTick = 0;
+                    continue;
+                }
             }
+
+            // A Timer is ready to fire, so remove it and call the callback. The rest of _ready
+            // stays scheduled, so the callback can still stop or delete them:
+            auto timer = _ready.head;
+            timer->_triggered = true;
+            _unschedule(timer);
+
+            // Fire the timer, while not holding the mutex (to avoid deadlocks if the
+            // timer callback calls the Timer API.)
+            lock.unlock();
+            try {
+                timer->_callback();
+            } catch (...) { }
+            timer->_triggered = false;                   // note: not holding any lock
+            if (timer->_autoDelete)
+                delete timer;
+            lock.lock();
         }
     }
 
 
-    // Removes a Timer from _scheduled. Returns true if the next fire time is affected.
+    // Processes ticks up to and including `target`, cascading timers down the wheel and moving
+    // the ones that come due into _ready. Empty ticks are skipped over.
     // Precondition: _mutex must be locked.
-    // Postconditions: timer is not in _scheduled. timer->_state != kScheduled.
-    bool Timer::Manager::_unschedule(Timer *timer) {
+    void Timer::Manager::advanceTo(uint64_t target) {
+        constexpr uint64_t kSlotMask = kSlots - 1;
+        while (_currentTick < target) {
+            // The next tick at which anything can happen is either the next occupied slot of
+            // level 0, or the start of its next rotation:
+            uint64_t next = (_currentTick | kSlotMask) + 1;
+            unsigned index = nextOccupiedSlot(0, unsigned(_currentTick & kSlotMask));
+            if (index < kSlots)
+                next = (_currentTick & ~kSlotMask) + index;
+            if (next > target) {
+                _currentTick = target;
+                break;
+            }
+            _currentTick = next;
+
+            if ((next & kSlotMask) == 0) {
+                // Level 0 wrapped around, so cascade the slots of the coarser levels that now
+                // cover the current time. (Top-down, since each cascades into the ones below.)
+                auto digit = [&](unsigned level) {
+                    return unsigned((next >> (kSlotBits * level)) & kSlotMask);
+                };
+                unsigned top = 1;
+                while (top < kLevels - 1 && digit(top) == 0)
+                    ++top;
+                if (digit(top) == 0)
+                    moveAll(_overflow, nullptr);
+                for (unsigned level = top; level >= 1; --level) {
+                    setOccupied(level, digit(level), false);
+                    moveAll(_wheel[level][digit(level)], nullptr);
+                }
+            }
+
+            setOccupied(0, unsigned(next & kSlotMask), false);
+            moveAll(_wheel[0][next & kSlotMask], &_ready);
+        }
+    }
+
+
+    // Returns the earliest tick at which a scheduled timer might come due, or kNoTick if
+    // there are none. For a coarser level this is the start of the slot, when it'll cascade.
+    // Precondition: _mutex must be locked.
+    uint64_t Timer::Manager::nextExpiry() const {
+        if (!_ready.empty())
+            return _currentTick;
+        for (unsigned level = 0; level < kLevels; ++level) {
+            unsigned shift = kSlotBits * level;
+            unsigned index = nextOccupiedSlot(level, unsigned(_currentTick >> shift) & (kSlots - 1));
+            if (index < kSlots)
+                return ((_currentTick >> (shift + kSlotBits)) << (shift + kSlotBits))
+                        + (uint64_t(index) << shift);
+        }
+        if (!_overflow.empty())
+            return ((_currentTick >> (kSlotBits * kLevels)) + 1) << (kSlotBits * kLevels);
+        return kNoTick;
+    }
+
+
+    // Returns the index of the first occupied slot of a level after `after`, or kSlots if none.
+    unsigned Timer::Manager::nextOccupiedSlot(unsigned level, unsigned after) const {
+        const uint64_t *bits = &_occupied[level * kSlots / 64];
+        unsigned index = after + 1;
+        while (index < kSlots) {
+            uint64_t word = bits[index / 64] >> (index % 64);
+            if (word)
+                return index + countTrailingZeros(word);
+            index = (index / 64 + 1) * 64;
+        }
+        return kSlots;
+    }
+
+
+    void Timer::Manager::setOccupied(unsigned level, unsigned index, bool occupied) {
+        uint64_t &word = _occupied[(level * kSlots + index) / 64];
+        uint64_t bit = uint64_t(1) << (index % 64);
+        word = occupied ? (word | bit) : (word & ~bit);
+    }
+
+
+    // Adds a Timer to the wheel slot (or _ready) corresponding to its _tick.
+    // Precondition: _mutex must be locked. timer is not in any slot.
+    void Timer::Manager::_schedule(Timer *timer) {
+        uint64_t tick = timer->_tick;
+        if (tick <= _currentTick) {
+            append(_ready, timer);
+            return;
+        }
+        // Use the finest level whose current rotation includes the tick:
+        for (unsigned level = 0; level < kLevels; ++level) {
+            unsigned shift = kSlotBits * (level + 1);
+            if ((tick >> shift) == (_currentTick >> shift)) {
+                unsigned index = unsigned(tick >> (shift - kSlotBits)) & (kSlots - 1);
+                append(_wheel[level][index], timer);
+                setOccupied(level, index, true);
+                return;
+            }
+        }
+        append(_overflow, timer);
+    }
+
+
+    void Timer::Manager::append(Slot &slot, Timer *timer) {
+        timer->_slot = &slot;
+        timer->_next = nullptr;
+        timer->_prev = slot.tail;
+        if (slot.tail)
+            slot.tail->_next = timer;
+        else
+            slot.head = timer;
+        slot.tail = timer;
+    }
+
+
+    void Timer::Manager::remove(Timer *timer) {
+        Slot *slot = timer->_slot;
+        if (timer->_prev)
+            timer->_prev->_next = timer->_next;
+        else
+            slot->head = timer->_next;
+        if (timer->_next)
+            timer->_next->_prev = timer->_prev;
+        else
+            slot->tail = timer->_prev;
+        timer->_prev = timer->_next = nullptr;
+        timer->_slot = nullptr;
+
+        if (slot->empty()) {
+            const Slot *first = &_wheel[0][0], *end = first + kLevels * kSlots;
+            if (!less<const Slot*>()(slot, first) && less<const Slot*>()(slot, end)) {
+                auto i = unsigned(slot - first);
+                setOccupied(i / kSlots, i % kSlots, false);
+            }
+        }
+    }
+
+
+    // Moves all Timers from one slot to the end of another, or if `to` is null, reschedules
+    // them (which cascades them down the wheel.) The caller updates the occupancy bitmap.
+    void Timer::Manager::moveAll(Slot &from, Slot *to) {
+        Timer *timer = from.head;
+        from.head = from.tail = nullptr;
+        while (timer) {
+            Timer *next = timer->_next;
+            if (to)
+                append(*to, timer);
+            else
+                _schedule(timer);
+            timer = next;
+        }
+    }
+
+
+    // Removes a Timer from the wheel.
+    // Precondition: _mutex must be locked.
+    // Postconditions: timer is not in the wheel. timer->_state != kScheduled.
+    void Timer::Manager::_unschedule(Timer *timer) {
         if (timer->_state != kScheduled)
-            return false;
-        bool affectsTiming = (timer->_entry == _schedule.begin());
-        _schedule.erase(timer->_entry);
-        timer->_entry = _schedule.end();
+            return;
+        remove(timer);
         timer->_state = kUnscheduled;
         timer->_fireTime = time();
-        return affectsTiming && !_schedule.empty();
     }
 
 
     // Unschedules a timer, preventing it from firing if it hasn't been triggered yet.
     // (Called by Timer::stop())
+    // Run() doesn't need to be woken: at worst it wakes up for a slot that's since emptied.
     // Precondition: _mutex must NOT be locked.
-    // Postcondition: timer is not in _scheduled. timer->_state != kScheduled.
+    // Postcondition: timer is not in the wheel. timer->_state != kScheduled.
     void Timer::Manager::unschedule(Timer *timer, bool deleting) {
         unique_lock<mutex> lock(_mutex);
-        if (_unschedule(timer))
-            _condition.notify_one();        // wakes up run() so it can recalculate its wait time
+        _unschedule(timer);
 
         if (deleting) {
             timer->_state = kDeleted;
@@ -108,7 +295,7 @@ namespace litecore { namespace actor {
     // Schedules or re-schedules a timer. (Called by Timer::fireAt/fireAfter())
     // If `earlier` is true, it will only move the fire time closer, else it returns `false`.
     // Precondition: _mutex must NOT be locked.
-    // Postcondition: timer is in _scheduled. timer->_state == kScheduled.
+    // Postcondition: timer is in the wheel. timer->_state == kScheduled.
     bool Timer::Manager::setFireTime(Timer *timer, clock::time_point when, bool earlier) {
         unique_lock<mutex> lock(_mutex);
         // Don't allow timer's callback to reschedule itself when deletion is pending:
@@ -116,12 +303,13 @@ namespace litecore { namespace actor {
             return false;
         if (earlier && timer->scheduled() && when >= timer->_fireTime)
             return false;
-        bool notify = _unschedule(timer);
-        timer->_entry = _schedule.insert({when, timer});
+        _unschedule(timer);
         timer->_state = kScheduled;
         timer->_fireTime = when;
-        if (timer->_entry == _schedule.begin() || notify)
-            _condition.notify_one();        // wakes up run() so it can recalculate its wait time
+        timer->_tick = tickAt(when);
+        _schedule(timer);
+        if (timer->_tick < _wakeTick)
+            _condition.notify_one();        // wakes up run() since it's sleeping past this time
         return true;
     }
 
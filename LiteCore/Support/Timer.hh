@@ -19,15 +19,16 @@
 #pragma once
 #include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <functional>
-#include <map>
 #include <mutex>
 #include <thread>
 #include <condition_variable>
 
 namespace litecore { namespace actor {
 
-    /** An object that can trigger a callback at (approximately) a specific future time. */
+    /** An object that can trigger a callback at (approximately) a specific future time.
+        Fire times are rounded up to the next millisecond. */
     class Timer {
     public:
         using clock = std::chrono::steady_clock;
@@ -86,26 +87,57 @@ namespace litecore { namespace actor {
 
         enum state : uint8_t {
             kUnscheduled,               // Idle
-            kScheduled,                 // In _scheduled queue, waiting to fire
+            kScheduled,                 // In Manager's wheel, waiting to fire
             kDeleted,                   // Destructor called, waiting for fire to complete
         };
 
-        /** Internal singleton that tracks all scheduled Timers and runs a background thread. */
+        /** Internal singleton that tracks all scheduled Timers and runs a background thread.
+            Timers are kept in a hierarchical timing wheel with 1ms ticks: four levels of 256
+            slots each, where level N's slots are 256^N ticks wide. Scheduling and unscheduling
+            are O(1) list operations; as time advances, each slot of a higher level is cascaded
+            down into finer slots when the lower level wraps around to it. */
         class Manager {
         public:
-            using map = std::multimap<time, Timer*>;
-            
+            /** An intrusive list of Timers (linked through Timer::_prev and _next.) */
+            struct Slot {
+                Timer* head {nullptr};
+                Timer* tail {nullptr};
+                bool empty() const                  {return head == nullptr;}
+            };
+
             Manager();
             bool setFireTime(Timer*, time, bool ifEarlier =false);
             void unschedule(Timer*, bool deleting =false);
-            
+
         private:
-            bool _unschedule(Timer*);
+            static constexpr unsigned kLevels = 4;
+            static constexpr unsigned kSlotBits = 8;
+            static constexpr unsigned kSlots = 1 << kSlotBits;
+            static constexpr uint64_t kNoTick = UINT64_MAX;
+
+            uint64_t tickAt(time, bool roundUp =true) const;
+            time timeOfTick(uint64_t tick) const;
+
+            void _schedule(Timer*);
+            void _unschedule(Timer*);
+            void append(Slot&, Timer*);
+            void remove(Timer*);
+            void setOccupied(unsigned level, unsigned index, bool occupied);
+            void advanceTo(uint64_t tick);
+            void moveAll(Slot &from, Slot *to);
+            uint64_t nextExpiry() const;
+            unsigned nextOccupiedSlot(unsigned level, unsigned after) const;
             void run();
 
-            map _schedule;                      // A priority queue of Timers ordered by time
-            std::mutex _mutex;                  // Thread-safety for _schedule
-            std::condition_variable _condition; // Used to signal that _schedule has changed
+            time const _epoch;                  // Time of tick 0
+            uint64_t _currentTick {0};          // Last tick processed; due timers are in _ready
+            uint64_t _wakeTick {0};             // Tick run() is sleeping until; 0 while awake
+            Slot _wheel[kLevels][kSlots];       // The timing wheel
+            uint64_t _occupied[kLevels * kSlots / 64] {};   // Bitmap of non-empty wheel slots
+            Slot _overflow;                     // Timers too far in the future for the wheel
+            Slot _ready;                        // Timers that are due, in firing order
+            std::mutex _mutex;                  // Thread-safety for all of the above
+            std::condition_variable _condition; // Used to wake run() when a timer is due earlier
             std::thread _thread;                // Bg thread that waits & fires Timers
         };
 
@@ -117,7 +149,10 @@ namespace litecore { namespace actor {
         std::atomic<state> _state {kUnscheduled};   // Current state
         std::atomic<bool> _triggered {false};   // True while callback is being called
         bool _autoDelete {false};               // If true, delete after firing
-        Manager::map::iterator _entry;          // My map entry in Manager::_schedule
+        uint64_t _tick {0};                     // Tick at which I fire
+        Timer* _prev {nullptr};                 // Links in Manager's slot list
+        Timer* _next {nullptr};
+        Manager::Slot* _slot {nullptr};         // Manager slot I'm in, if scheduled
     };
 
 } }
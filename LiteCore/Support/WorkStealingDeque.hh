@@ -0,0 +1,100 @@
+//
+// WorkStealingDeque.hh
+//
+// Copyright (c) 2021 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace litecore { namespace actor {
+
+    /** A fixed-capacity lock-free Chase-Lev work-stealing deque of pointers.
+        The owning thread pushes and pops at the bottom; any other thread may steal from the top.
+        Based on "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê et al, 2013).
+        @tparam T  A pointer type; nullptr is returned when there's nothing to pop/steal.
+        @tparam Capacity  Maximum number of items; must be a power of 2. */
+    template <class T, size_t Capacity = 1024>
+    class WorkStealingDeque {
+    public:
+        static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+
+        /** Adds an item at the bottom. Only the owner thread may call this.
+            @return  False if the deque is full. */
+        bool push(T item) {
+            int64_t b = _bottom.load(std::memory_order_relaxed);
+            int64_t t = _top.load(std::memory_order_acquire);
+            if (b - t >= int64_t(Capacity))
+                return false;
+            _items[b & kMask].store(item, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        /** Removes the item at the bottom (most recently pushed.) Only the owner may call this.
+            @return  The item, or nullptr if the deque is empty. */
+        T pop() {
+            int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+            _bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = _top.load(std::memory_order_relaxed);
+            T item = nullptr;
+            if (t <= b) {
+                item = _items[b & kMask].load(std::memory_order_relaxed);
+                if (t == b) {
+                    // Last item; race against thieves for it:
+                    if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                      std::memory_order_relaxed))
+                        item = nullptr;
+                    _bottom.store(b + 1, std::memory_order_relaxed);
+                }
+            } else {
+                _bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return item;
+        }
+
+        /** Removes the item at the top (least recently pushed.) May be called by any thread.
+            @return  The item, or nullptr if the deque is empty or another thread won the race. */
+        T steal() {
+            int64_t t = _top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = _bottom.load(std::memory_order_acquire);
+            if (t >= b)
+                return nullptr;
+            T item = _items[t & kMask].load(std::memory_order_relaxed);
+            if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed))
+                return nullptr;
+            return item;
+        }
+
+        /** True if the deque appears empty. (Only a hint, unless called by the owner.) */
+        bool empty() const {
+            return _bottom.load(std::memory_order_acquire) <= _top.load(std::memory_order_acquire);
+        }
+
+    private:
+        static constexpr int64_t kMask = int64_t(Capacity) - 1;
+
+        alignas(64) std::atomic<int64_t> _top {0};
+        alignas(64) std::atomic<int64_t> _bottom {0};
+        std::atomic<T> _items[Capacity];
+    };
+
+} }
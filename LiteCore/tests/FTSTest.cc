@@ -23,6 +23,10 @@
 #include "FleeceImpl.hh"
 
 #include "LiteCoreTest.hh"
+#include <algorithm>
+#include <map>
+#include <set>
+#include <tuple>
 
 using namespace litecore;
 using namespace std;
@@ -72,8 +76,8 @@ public:
         _stringsInDB[i] = sentence;
     }
 
-    void createIndex(IndexSpec::Options options) {
-        store->createIndex("sentence", "[[\".sentence\"]]", IndexSpec::kFullText, &options);
+    void createIndex(IndexSpec::Options options, IndexSpec::Type type =IndexSpec::kFullText) {
+        store->createIndex("sentence", "[[\".sentence\"]]", type, &options);
     }
 
     void testQuery(const char *queryStr,
@@ -551,3 +555,132 @@ TEST_CASE_METHOD(FTSTest, "No alias on MATCH", "[FTS][Query]") {
         Retained<Query> query = db->compileQuery(q);  // just verify it compiles
     }
 }
+
+
+TEST_CASE_METHOD(FTSTest, "Query Full-Text Deferred Indexing", "[FTS][Query]") {
+    createIndex({"english", true});
+    auto options = db->options();
+    options.deferIndexing = true;
+    reopenDatabase(&options);
+
+    auto countMatches = [&](const char *word) {
+        Retained<Query> query = db->compileQuery(json5(
+                    string("{WHAT: [['._id']], WHERE: ['MATCH()', 'sentence', '") + word + "']}"));
+        Retained<QueryEnumerator> e(query->createEnumerator());
+        int n = 0;
+        while (e->next())
+            ++n;
+        return n;
+    };
+    CHECK(countMatches("adventures") == 1);
+    CHECK(countMatches("elephant") == 0);
+
+    {
+        ExclusiveTransaction t(store->dataFile());
+        createDoc(t, 4, "An elephant never forgets");
+        createDoc(t, 5, "Elephants are large");
+        // Queries within the transaction must see the changes, although no trigger indexed them:
+        CHECK(countMatches("adventures") == 0);
+        CHECK(countMatches("elephant") == 2);
+        createDoc(t, 6, "The elephant in the room");
+        CHECK(countMatches("elephant") == 3);
+        t.commit();
+    }
+    CHECK(countMatches("adventures") == 0);
+    CHECK(countMatches("elephant") == 3);
+
+    {
+        ExclusiveTransaction t(store->dataFile());
+        createDoc(t, 7, "Elephant seals");
+        t.abort();
+    }
+    CHECK(countMatches("elephant") == 3);
+
+    // Without deferred indexing, the restored triggers keep the index up to date:
+    options.deferIndexing = false;
+    reopenDatabase(&options);
+    {
+        ExclusiveTransaction t(store->dataFile());
+        createDoc(t, 8, "A baby elephant");
+        t.commit();
+    }
+    CHECK(countMatches("elephant") == 4);
+}
+
+
+TEST_CASE_METHOD(FTSTest, "Query Full-Text FTS5", "[FTS][Query]") {
+    IndexSpec::Options options {"english", true};
+    options.automerge = 8;
+    options.crisismerge = 32;
+    createIndex(options, IndexSpec::kFullText5);
+    CHECK(store->getIndexes().size() == 1);
+    CHECK(store->getIndexes()[0].type == IndexSpec::kFullText5);
+
+    // Creating it again with the same options is a no-op:
+    CHECK(!store->createIndex("sentence", "[[\".sentence\"]]", IndexSpec::kFullText5, &options));
+    // ...but changing a merge option updates the index's config:
+    options.automerge = 16;
+    CHECK(store->createIndex("sentence", "[[\".sentence\"]]", IndexSpec::kFullText5, &options));
+    CHECK(!store->createIndex("sentence", "[[\".sentence\"]]", IndexSpec::kFullText5, &options));
+    options.automerge = 65;
+    ExpectException(error::LiteCore, error::InvalidParameter, [&] {
+        store->createIndex("sentence", "[[\".sentence\"]]", IndexSpec::kFullText5, &options);
+    });
+
+    auto checkQuery = [&](map<int,size_t> expectedTerms) {
+        Retained<Query> query = db->compileQuery(json5(
+                    "{WHAT: [['.sentence']], WHERE: ['MATCH()', 'sentence', 'search'],"
+                    " ORDER_BY: [['DESC', ['rank()', 'sentence']]]}"));
+        Retained<QueryEnumerator> e(query->createEnumerator());
+        map<int,size_t> terms;
+        while (e->next()) {
+            slice sentence = e->columns()[0]->asString();
+            auto i = find(_stringsInDB.begin(), _stringsInDB.end(), string(sentence));
+            REQUIRE(i != _stringsInDB.end());
+            REQUIRE(e->hasFullText());
+            for (auto term : e->fullTextTerms()) {
+                // The stemmer makes "search" match "searching" too:
+                CHECK(string(sentence).substr(term.start, 6) == "search");
+                CHECK(query->getMatchedText(term) == sentence);
+            }
+            terms[int(i - _stringsInDB.begin())] = e->fullTextTerms().size();
+        }
+        CHECK(terms == expectedTerms);
+    };
+    checkQuery({{0, 1}, {1, 3}, {2, 3}, {4, 1}});
+
+    // The index is updated by triggers like an FTS4 index:
+    {
+        ExclusiveTransaction t(store->dataFile());
+        createDoc(t, 0, "Nothing to see here");
+        createDoc(t, 5, "Search and rescue");
+        t.commit();
+    }
+    checkQuery({{1, 3}, {2, 3}, {4, 1}, {5, 1}});
+
+    // Compacting merges the index's segments:
+    db->maintenance(DataFile::kCompact);
+    checkQuery({{1, 3}, {2, 3}, {4, 1}, {5, 1}});
+
+    // Each token of a phrase is numbered as a separate term, like FTS4 does:
+    auto phraseTerms = [&] {
+        Retained<Query> query = db->compileQuery(json5(
+                    "{WHAT: [['.sentence']], WHERE: ['MATCH()', 'sentence', '\"full text\" engine']}"));
+        Retained<QueryEnumerator> e(query->createEnumerator());
+        set<tuple<string,uint32_t,uint32_t>> terms;
+        while (e->next()) {
+            string sentence(e->columns()[0]->asString());
+            for (auto term : e->fullTextTerms())
+                terms.emplace(sentence, term.start, term.termIndex);
+        }
+        return terms;
+    };
+    auto fts5Terms = phraseTerms();
+    CHECK(fts5Terms.size() == 6);
+
+    // Replacing it with an FTS4 index:
+    createIndex({"english", true});
+    CHECK(store->getIndexes()[0].type == IndexSpec::kFullText);
+    checkQuery({{1, 3}, {2, 3}, {4, 1}, {5, 1}});
+    CHECK(phraseTerms() == fts5Terms);
+}
@@ -22,9 +22,11 @@
 #include "LiteCoreTest.hh"
 #include "StringUtil.hh"
 #include "PlatformCompat.hh"
+#include "Stopwatch.hh"
 #include <regex>
 #include <sstream>
 #include <fstream>
+#include <thread>
 
 using namespace std;
 
@@ -337,3 +339,106 @@ TEST_CASE("Logging plaintext", "[Log]") {
 
     LogDomain::writeEncodedLogsTo(prevOptions); // undo writeEncodedLogsTo() call above
 }
+
+
+TEST_CASE("Logging buffered", "[Log]") {
+    char folderName[64];
+    sprintf(folderName, "Log_Buffered_%" PRIms "/", chrono::milliseconds(time(nullptr)).count());
+    FilePath tmpLogDir = TestFixture::sTempDir[folderName];
+    tmpLogDir.delRecursive();
+    tmpLogDir.mkdir();
+
+    static constexpr int kThreads = 4, kMessages = 500;
+    const LogFileOptions prevOptions = LogDomain::currentLogFileOptions();
+    LogFileOptions fileOptions { tmpLogDir.canonicalPath(), LogLevel::Info, 1024*1024, 5, false, true };
+    LogDomain::writeEncodedLogsTo(fileOptions, "Hello");
+    {
+        vector<thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([t] {
+                LogObject obj("thread" + to_string(t));
+                for (int i = 0; i < kMessages; ++i)
+                    obj.doLog("Message %d from thread %d: %s, %.1f", i, t, "buffered", i / 2.0);
+            });
+        }
+        for (auto &t : threads)
+            t.join();
+    }
+    LogDomain::flushLogFiles();
+
+    vector<string> infoFiles;
+    tmpLogDir.forEachFile([&infoFiles](const FilePath f) {
+       if (f.path().find("info") != string::npos)
+           infoFiles.push_back(f.path());
+    });
+    REQUIRE(infoFiles.size() == 1);
+    ifstream fin(infoFiles[0], ios::binary);
+    stringstream out;
+    LogDecoder decoder(fin);
+    decoder.decodeTo(out, vector<string> { "", "", "INFO", "", "" });
+
+    // Every message made it, intact and in timestamp order:
+    regex messageLine("(\\d{2}:\\d{2}:\\d{2}\\.\\d{6})\\|.*"
+                      "Message (\\d+) from thread (\\d): buffered, (\\d+\\.\\d)");
+    string line, lastTime;
+    int count = 0;
+    while (getline(out, line)) {
+        smatch m;
+        if (!regex_search(line, m, messageLine))
+            continue;
+        ++count;
+        CHECK(stod(m[4]) == stoi(m[2]) / 2.0);
+        CHECK(m[1].str() >= lastTime);
+        lastTime = m[1];
+    }
+    CHECK(count == kThreads * kMessages);
+
+    LogDomain::writeEncodedLogsTo(prevOptions); // undo writeEncodedLogsTo() call above
+}
+
+
+// Logs from several threads to the binary log files, and reports calls per second.
+static void benchmarkLogging(bool buffered) {
+    static LogDomain sBenchLog("Bench", LogLevel::Verbose);
+    static constexpr int kThreads = 8, kMessagesPerThread = 200000;
+
+    char folderName[64];
+    sprintf(folderName, "Log_Bench_%" PRIms "/", chrono::milliseconds(time(nullptr)).count());
+    FilePath tmpLogDir = TestFixture::sTempDir[folderName];
+    tmpLogDir.delRecursive();
+    tmpLogDir.mkdir();
+
+    const LogFileOptions prevOptions = LogDomain::currentLogFileOptions();
+    auto prevCallbackLevel = LogDomain::callbackLogLevel();
+    LogDomain::setCallbackLogLevel(LogLevel::Warning);
+    LogFileOptions fileOptions { tmpLogDir.canonicalPath(), LogLevel::Verbose, 100*1024*1024, 2,
+                                 false, buffered };
+    LogDomain::writeEncodedLogsTo(fileOptions, "Benchmark");
+
+    fleece::Stopwatch st;
+    vector<thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([t] {
+            for (int i = 0; i < kMessagesPerThread; ++i)
+                LogVerbose(sBenchLog, "Benchmark message %d from thread %d: %s", i, t, "hello");
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+    double logTime = st.elapsed();
+    LogDomain::flushLogFiles();
+    double totalTime = st.elapsed();
+
+    LogDomain::writeEncodedLogsTo(prevOptions);
+    LogDomain::setCallbackLogLevel(prevCallbackLevel);
+    tmpLogDir.delRecursive();
+
+    double calls = double(kThreads) * kMessagesPerThread;
+    C4Log("%-10s: %10.0f log calls/sec on %d threads (%10.0f/sec including final flush)",
+          (buffered ? "Buffered" : "Unbuffered"), calls / logTime, kThreads, calls / totalTime);
+}
+
+TEST_CASE("Logging Benchmark", "[Log][Perf][.slow]") {
+    benchmarkLogging(false);
+    benchmarkLogging(true);
+}
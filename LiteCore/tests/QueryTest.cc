@@ -22,6 +22,7 @@
 #include <cfloat>
 #include <cinttypes>
 #include <chrono>
+#include <map>
 #include <numeric>
 #include "date/date.h"
 #include "ParseDate.hh"
@@ -293,6 +294,216 @@ N_WAY_TEST_CASE_METHOD(QueryTest, "Query refresh", "[Query]") {
 }
 
 
+N_WAY_TEST_CASE_METHOD(QueryTest, "Query streaming", "[Query]") {
+    addNumberedDocs();
+    Retained<Query> query{ store->compileQuery(json5(
+                     "{WHAT: ['.num', ['*', ['.num'], ['.num']]], WHERE: ['>', ['.num'], 10]}")) };
+    Query::Options options(nullslice, 0, 0, true);
+
+    // A recording enumerator running alongside must not disturb the streaming one:
+    Retained<QueryEnumerator> e(query->createEnumerator(&options));
+    Retained<QueryEnumerator> recorded(query->createEnumerator());
+    CHECK(e->bufferedRowCount() == 0);
+    CHECK(e->getRowCount() == -1);
+    ExpectException(error::LiteCore, error::UnsupportedOperation, [&] {
+        e->seek(0);
+    });
+
+    int num = 11;
+    while (e->next()) {
+        REQUIRE(recorded->next());
+        auto cols = e->columns();
+        REQUIRE(cols.count() == 2);
+        CHECK(cols[0]->asInt() == num);
+        CHECK(cols[1]->asInt() == num * num);
+        CHECK(e->missingColumns() == recorded->missingColumns());
+        ++num;
+    }
+    CHECK(num == 101);
+    CHECK(!recorded->next());
+    CHECK(!e->next());
+
+    CHECK(e->refresh(query) == nullptr);
+    deleteDoc("rec-030"_sl, false);
+    Retained<QueryEnumerator> e2(e->refresh(query));
+    REQUIRE(e2 != nullptr);
+    CHECK(e2->options().streaming);
+    num = 11;
+    while (e2->next())
+        ++num;
+    CHECK(num == 100);
+}
+
+
+N_WAY_TEST_CASE_METHOD(QueryTest, "Query streaming across a transaction", "[Query]") {
+    addNumberedDocs();
+    Retained<Query> query{ store->compileQuery(json5(
+                     "{WHAT: ['.num'], WHERE: ['>', ['.num'], 10]}")) };
+    Query::Options options(nullslice, 0, 0, true);
+    Retained<QueryEnumerator> e(query->createEnumerator(&options));
+    int num = 11;
+    for (; num <= 50; ++num) {
+        REQUIRE(e->next());
+        CHECK(e->columns()[0]->asInt() == num);
+    }
+
+    // Writing while the stream is open must work, and mustn't change what the stream returns:
+    {
+        ExclusiveTransaction t(db);
+        writeNumberedDoc(1000, nullslice, t);
+        t.commit();
+    }
+    while (e->next()) {
+        CHECK(e->columns()[0]->asInt() == num);
+        ++num;
+    }
+    CHECK(num == 101);
+
+    Retained<QueryEnumerator> e2(e->refresh(query));
+    REQUIRE(e2 != nullptr);
+    num = 0;
+    while (e2->next())
+        ++num;
+    CHECK(num == 91);
+}
+
+
+N_WAY_TEST_CASE_METHOD(QueryTest, "Query streaming stays lazy", "[Query]") {
+    addNumberedDocs();
+    Retained<Query> query{ store->compileQuery(json5(
+                     "{WHAT: ['.num'], WHERE: ['>', ['.num'], 10]}")) };
+    Query::Options options(nullslice, 0, 0, true);
+    Retained<QueryEnumerator> e(query->createEnumerator(&options));
+    int num = 11;
+    for (; num <= 30; ++num) {
+        REQUIRE(e->next());
+        CHECK(e->columns()[0]->asInt() == num);
+    }
+
+    // Other queries and transactions must neither make the stream read ahead, nor change what
+    // it returns:
+    Retained<QueryEnumerator> other(query->createEnumerator());
+    CHECK(other->getRowCount() == 90);
+    {
+        ReadOnlyTransaction t(store->dataFile());
+    }
+    deleteDoc("rec-050"_sl, false);
+    CHECK(e->bufferedRowCount() == 0);
+    while (e->next()) {
+        CHECK(e->columns()[0]->asInt() == num);
+        ++num;
+        CHECK(e->bufferedRowCount() == 0);
+    }
+    CHECK(num == 101);
+
+    // A stream opened inside a transaction sees its changes, and reads ahead when it commits:
+    Retained<QueryEnumerator> inner;
+    {
+        ExclusiveTransaction t(db);
+        writeNumberedDoc(1000, nullslice, t);
+        inner = query->createEnumerator(&options);
+        REQUIRE(inner->next());
+        CHECK(inner->bufferedRowCount() == 0);
+        t.commit();
+    }
+    CHECK(inner->bufferedRowCount() == 89);
+    num = 1;
+    while (inner->next())
+        ++num;
+    CHECK(num == 90);
+}
+
+
+N_WAY_TEST_CASE_METHOD(QueryTest, "Query result cache", "[Query]") {
+    addNumberedDocs();
+    Retained<Query> query{ store->compileQuery(json5(
+                     "{WHAT: ['.num'], WHERE: ['>=', ['.num'], ['$min']]}")) };
+    auto run = [&](const char *params) {
+        Query::Options options(alloc_slice(slice(params)), 0, 0, false, true);
+        return Retained<QueryEnumerator>(query->createEnumerator(&options));
+    };
+    auto count = [](QueryEnumerator *e) {
+        int n = 0;
+        while (e->next())
+            ++n;
+        return n;
+    };
+
+    Retained<QueryEnumerator> e1 = run("{\"min\": 11}");
+    CHECK(count(e1) == 90);
+
+    // Same parameters, unchanged database: the results are reused.
+    Retained<QueryEnumerator> e2 = run("{\"min\": 11}");
+    CHECK(e2 != e1);
+    CHECK(e2->lastSequence() == e1->lastSequence());
+    CHECK(!e1->obsoletedBy(e2));
+    CHECK(count(e2) == 90);
+
+    // Different parameters get their own results:
+    Retained<QueryEnumerator> e3 = run("{\"min\": 91}");
+    CHECK(count(e3) == 10);
+
+    // A change to the database invalidates the cache:
+    deleteDoc("rec-030"_sl, false);
+    Retained<QueryEnumerator> e4 = run("{\"min\": 11}");
+    CHECK(e4->lastSequence() > e1->lastSequence());
+    CHECK(e1->obsoletedBy(e4));
+    CHECK(count(e4) == 89);
+    Retained<QueryEnumerator> e5 = run("{\"min\": 91}");
+    CHECK(count(e5) == 10);
+}
+
+
+N_WAY_TEST_CASE_METHOD(QueryTest, "Query changed documents", "[Query]") {
+    addNumberedDocs();
+    Retained<Query> query{ store->compileQuery(json5(
+        "{WHAT: ['.num'], WHERE: ['>=', ['.num'], ['$min']], ORDER_BY: [['.num']], LIMIT: ['$lim']}")) };
+    Query::Options options(alloc_slice(slice("{\"min\": 91, \"lim\": 5}")));
+
+    auto findChanges = [&](sequence_t since, bool matchingOnly) {
+        map<string,bool> changes;
+        ReadOnlyTransaction t(store->dataFile());
+        CHECK(query->findChangedDocuments(options, since, matchingOnly, [&](slice docID, bool matches) {
+            changes[string(docID)] = matches;
+        }));
+        return changes;
+    };
+
+    auto changes = findChanges(0, true);
+    CHECK(changes.size() == 10);
+    CHECK(changes.begin()->first == "rec-091");
+    sequence_t seq = query->lastSequence();
+    CHECK(seq == 100);
+    CHECK(findChanges(seq, false).empty());
+
+    deleteDoc("rec-095"_sl, false);
+    deleteDoc("rec-010"_sl, false);
+    {
+        ExclusiveTransaction t(store->dataFile());
+        writeNumberedDoc(5, "five"_sl, t);
+        writeNumberedDoc(150, nullslice, t);
+        t.commit();
+    }
+    changes = findChanges(seq, false);
+    CHECK(changes == (map<string,bool>{{"rec-005", false}, {"rec-010", false},
+                                       {"rec-095", false}, {"rec-150", true}}));
+    CHECK(findChanges(seq, true) == (map<string,bool>{{"rec-150", true}}));
+
+    // A query with an explicit FROM alias:
+    query = store->compileQuery(json5(
+        "{WHAT: ['.doc.num'], FROM: [{AS: 'doc'}], WHERE: ['>', ['.doc.num'], 99]}"));
+    CHECK(findChanges(0, true) == (map<string,bool>{{"rec-100", true}, {"rec-150", true}}));
+
+    // A JOIN doesn't qualify:
+    query = store->compileQuery(json5(
+        "{WHAT: [['.main.num']], FROM: [{AS: 'main'}, {AS: 'other', ON: ['=', ['.main.num'], ['.other.num']]}]}"));
+    ReadOnlyTransaction t(store->dataFile());
+    CHECK(!query->findChangedDocuments(options, 0, false, [&](slice, bool) {
+        FAIL("Callback shouldn't be called");
+    }));
+}
+
+
 N_WAY_TEST_CASE_METHOD(QueryTest, "Query boolean", "[Query]") {
     {
         ExclusiveTransaction t(store->dataFile());
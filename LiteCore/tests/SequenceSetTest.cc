@@ -18,7 +18,9 @@
 
 #include "LiteCoreTest.hh"
 #include "SequenceSet.hh"
+#include "RemoteSequenceSet.hh"
 #include "SecureRandomize.hh"
+#include "Stopwatch.hh"
 #include <sstream>
 
 using namespace std;
@@ -287,3 +289,122 @@ TEST_CASE("SequenceSet: stress test", "[SequenceSet]") {
 
     checkEmpty(s);
 }
+
+
+TEST_CASE("RemoteSequenceSet", "[SequenceSet]") {
+    using namespace litecore::repl;
+    RemoteSequenceSet s;
+    s.clear(RemoteSequence(slice("10")));
+    CHECK(s.empty());
+    CHECK(s.since() == RemoteSequence(slice("10")));
+
+    for (int i = 11; i <= 20; ++i)
+        s.add(RemoteSequence(slice(std::to_string(i))), i * 100);
+    CHECK(s.size() == 10);
+    CHECK(s.bodySizeOfSequence(RemoteSequence(slice("15"))) == 1500);
+    CHECK(s.bodySizeOfSequence(RemoteSequence(slice("25"))) == 0);
+
+    bool wasEarliest;
+    uint64_t bodySize;
+    s.remove(RemoteSequence(slice("12")), wasEarliest, bodySize);
+    CHECK(!wasEarliest);
+    CHECK(bodySize == 1200);
+    CHECK(s.since() == RemoteSequence(slice("10")));
+    s.remove(RemoteSequence(slice("12")), wasEarliest, bodySize);
+    CHECK(!wasEarliest);
+    CHECK(bodySize == 0);
+    s.remove(RemoteSequence(slice("11")), wasEarliest, bodySize);
+    CHECK(wasEarliest);
+    CHECK(s.since() == RemoteSequence(slice("12")));
+    CHECK(s.size() == 8);
+
+    SECTION("Out of order") {
+        // Non-increasing sequences switch the set over to its index:
+        s.add(RemoteSequence(slice("5")), 500);
+        s.add(RemoteSequence(slice("\"abc\"")), 1);
+        CHECK(s.size() == 10);
+        CHECK(s.bodySizeOfSequence(RemoteSequence(slice("5"))) == 500);
+        CHECK(s.bodySizeOfSequence(RemoteSequence(slice("18"))) == 1800);
+        s.remove(RemoteSequence(slice("5")), wasEarliest, bodySize);
+        CHECK(!wasEarliest);
+        CHECK(bodySize == 500);
+        for (int i = 13; i <= 20; ++i)
+            s.remove(RemoteSequence(slice(std::to_string(i))), wasEarliest, bodySize);
+        CHECK(s.size() == 1);
+        CHECK(s.since() == RemoteSequence(slice("5")));
+    }
+
+    SECTION("Remove all") {
+        for (int i = 13; i <= 20; ++i)
+            s.remove(RemoteSequence(slice(std::to_string(i))), wasEarliest, bodySize);
+        CHECK(s.empty());
+        CHECK(s.since() == RemoteSequence(slice("20")));
+    }
+}
+
+
+// Replays the sequence bookkeeping of a large replication: sequences arrive in batches, are
+// marked pending, then complete in a shuffled order within a window of in-flight revisions,
+// while the checkpoint is recomputed from the earliest incomplete one.
+TEST_CASE("SequenceSet Benchmark", "[SequenceSet][Perf][.slow]") {
+    static constexpr uint64_t kRevs = 1000000, kBatch = 200, kWindow = 1000;
+
+    vector<uint64_t> order(kRevs);
+    for (uint64_t i = 0; i < kRevs; ++i)
+        order[i] = i + 1;
+    for (uint64_t i = 0; i < kRevs; i += kWindow) {
+        for (uint64_t j = min(i + kWindow, kRevs) - 1; j > i; --j)
+            swap(order[j], order[i + RandomNumber(uint32_t(j - i + 1))]);
+    }
+
+    {
+        // Pusher side, as in Checkpoint: pending sequences are removed from the completed set,
+        // then added back when they're done.
+        fleece::Stopwatch st;
+        SequenceSet completed;
+        completed.add(0, 1);
+        uint64_t checkpoint = 0;
+        for (uint64_t i = 0; i < kRevs; i += kBatch) {
+            for (uint64_t seq = i + 1; seq <= i + kBatch; ++seq)
+                completed.remove(seq);
+            if (i >= kWindow) {
+                for (uint64_t j = i - kWindow; j < i - kWindow + kBatch; ++j) {
+                    completed.add(order[j]);
+                    checkpoint = completed.begin()->second - 1;
+                }
+            }
+        }
+        for (uint64_t j = kRevs - kWindow; j < kRevs; ++j)
+            completed.add(order[j]);
+        checkpoint = completed.begin()->second - 1;
+        CHECK(checkpoint == kRevs);
+        st.printReport("SequenceSet", kRevs, "rev");
+    }
+
+    {
+        // Puller side: remote sequences are added as they arrive and removed as they're saved.
+        using namespace litecore::repl;
+        fleece::Stopwatch st;
+        RemoteSequenceSet missing;
+        missing.clear(RemoteSequence());
+        bool wasEarliest;
+        uint64_t bodySize;
+        for (uint64_t i = 0; i < kRevs; i += kBatch) {
+            for (uint64_t seq = i + 1; seq <= i + kBatch; ++seq)
+                missing.add(RemoteSequence(slice(std::to_string(seq))), 1000);
+            if (i >= kWindow) {
+                for (uint64_t j = i - kWindow; j < i - kWindow + kBatch; ++j) {
+                    missing.remove(RemoteSequence(slice(std::to_string(order[j]))),
+                                   wasEarliest, bodySize);
+                    if (wasEarliest)
+                        (void)missing.since();
+                }
+            }
+        }
+        for (uint64_t j = kRevs - kWindow; j < kRevs; ++j)
+            missing.remove(RemoteSequence(slice(std::to_string(order[j]))), wasEarliest, bodySize);
+        CHECK(missing.empty());
+        CHECK(missing.since() == RemoteSequence(slice(std::to_string(kRevs))));
+        st.printReport("RemoteSequenceSet", kRevs, "rev");
+    }
+}
@@ -18,6 +18,9 @@
 
 #include "LiteCoreTest.hh"
 #include "SequenceTracker.hh"
+#include "SecureRandomize.hh"
+#include "Stopwatch.hh"
+#include "StringUtil.hh"
 #include <sstream>
 
 using namespace std;
@@ -53,7 +56,7 @@ namespace litecore {
         string dump(bool verbose =false) { return tracker.dump(verbose); }
 #endif
 
-        SequenceTracker::const_iterator since(sequence_t s) {
+        SequenceTracker::position since(sequence_t s) {
             return tracker._since(s);
         }
 
@@ -61,7 +64,7 @@ namespace litecore {
             return tracker._docIDAt(s);
         }
         
-        SequenceTracker::const_iterator end() {
+        SequenceTracker::position end() {
             return tracker.end();
         }
 
@@ -439,3 +442,49 @@ TEST_CASE_METHOD(litecore::SequenceTrackerTest, "SequenceTracker Purge", "[notif
         CHECK(changes[1].sequence == 0);
     }
 }
+
+
+// Simulates a busy database with several observers: one that keeps up, one that reads changes
+// only occasionally, and one that never reads them.
+TEST_CASE("SequenceTracker Benchmark", "[notification][Perf][.slow]") {
+    static constexpr int kDocs = 10000, kChanges = 1000000, kPerTransaction = 1000;
+    static constexpr size_t kBatch = 100;
+
+    vector<alloc_slice> docIDs, revIDs;
+    for (int i = 0; i < kDocs; ++i) {
+        docIDs.emplace_back(format("doc-%06d", i));
+        revIDs.emplace_back(format("1-%08x", i));
+    }
+
+    SequenceTracker tracker("bench");
+    CollectionChangeNotifier upToDate(tracker, [](CollectionChangeNotifier&) { });
+    CollectionChangeNotifier lagging(tracker, [](CollectionChangeNotifier&) { });
+    CollectionChangeNotifier idle(tracker, nullptr);
+    vector<unique_ptr<DocChangeNotifier>> docNotifiers;
+    for (int i = 0; i < kDocs; i += 100)
+        docNotifiers.emplace_back(new DocChangeNotifier(tracker, docIDs[i], nullptr));
+
+    SequenceTracker::Change changes[kBatch];
+    bool external;
+    size_t nRead = 0;
+    fleece::Stopwatch st;
+    sequence_t seq = 0;
+    for (int t = 0; t < kChanges / kPerTransaction; ++t) {
+        tracker.beginTransaction();
+        for (int i = 0; i < kPerTransaction; ++i) {
+            auto doc = RandomNumber(kDocs);
+            tracker.documentChanged(docIDs[doc], revIDs[doc], ++seq, 1000, {});
+        }
+        tracker.endTransaction(true);
+
+        while (size_t n = upToDate.readChanges(changes, kBatch, external))
+            nRead += n;
+        if (t % 10 == 9) {
+            while (size_t n = lagging.readChanges(changes, kBatch, external))
+                nRead += n;
+        }
+    }
+    st.printReport("Tracking changes", kChanges, "change");
+    CHECK(nRead > 0);
+    CHECK(idle.hasChanges());
+}
@@ -23,10 +23,19 @@
 #include "catch.hpp"
 #include "NumConversion.hh"
 #include "Actor.hh"
+#include "Batcher.hh"
+#include "Timer.hh"
+#include "SecureRandomize.hh"
+#include "Stopwatch.hh"
 #include "URLTransformer.hh"
+#include <algorithm>
+#include <atomic>
 #include <exception>
 #include <chrono>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
 #ifdef WIN32
 #include "Error.hh"
 #include <winerror.h>
@@ -281,6 +290,94 @@ namespace {
         this_thread::sleep_for(2s);
     }
 
+#ifndef ACTORS_USE_GCD
+    using litecore::actor::Scheduler;
+    using litecore::actor::ThreadedMailbox;
+    using BenchClock = std::chrono::steady_clock;
+
+    // Actor that records the latency of each message it receives, and forwards it to the
+    // next actor in a ring until its hop count runs out.
+    class BenchActor : public litecore::actor::Actor {
+    public:
+        BenchActor(ThreadedMailbox *parent, atomic<int64_t> &remaining)
+        :Actor(litecore::kC4Cpp_DefaultLog, "BenchActor", parent)
+        ,_remaining(remaining)
+        { }
+
+        void setNext(BenchActor *next)      {_next = next;}
+
+        void ping(int hops, BenchClock::time_point sent) {
+            enqueue(FUNCTION_TO_QUEUE(BenchActor::_ping), hops, sent);
+        }
+
+        vector<double> latencies;           // microseconds; only touched on the actor's queue
+
+    private:
+        void _ping(int hops, BenchClock::time_point sent) {
+            auto now = BenchClock::now();
+            latencies.push_back(chrono::duration<double, micro>(now - sent).count());
+            if (hops > 0)
+                _next->ping(hops - 1, now);
+            --_remaining;
+        }
+
+        atomic<int64_t> &_remaining;
+        BenchActor* _next {nullptr};
+    };
+
+
+    // Sends messages from several external threads to a ring of actors that forward them to
+    // each other, and reports throughput and latency for a Scheduler backend.
+    void benchmarkScheduler(Scheduler::Backend backend, const char *name) {
+        static constexpr int kNumActors = 64, kNumSenders = 8, kMessagesPerSender = 20000,
+                             kHops = 4;
+        Scheduler scheduler(0, backend);
+        ThreadedMailbox root(nullptr, "bench");
+        root.setScheduler(&scheduler);
+
+        atomic<int64_t> remaining {int64_t(kNumSenders) * kMessagesPerSender * (kHops + 1)};
+        vector<Retained<BenchActor>> actors;
+        for (int i = 0; i < kNumActors; ++i)
+            actors.push_back(new BenchActor(&root, remaining));
+        for (int i = 0; i < kNumActors; ++i)
+            actors[i]->setNext(actors[(i + 1) % kNumActors]);
+
+        fleece::Stopwatch st;
+        vector<thread> senders;
+        for (int s = 0; s < kNumSenders; ++s) {
+            senders.emplace_back([&, s] {
+                for (int i = 0; i < kMessagesPerSender; ++i)
+                    actors[(s * kMessagesPerSender + i) % kNumActors]->ping(kHops, BenchClock::now());
+            });
+        }
+        for (auto &t : senders)
+            t.join();
+        while (remaining > 0)
+            this_thread::sleep_for(1ms);
+        double elapsed = st.elapsed();
+
+        vector<double> latencies;
+        for (auto &actor : actors) {
+            actor->waitTillCaughtUp();
+            latencies.insert(latencies.end(), actor->latencies.begin(), actor->latencies.end());
+        }
+        actors.clear();
+        scheduler.stop();
+
+        sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) {return latencies[size_t(p * (latencies.size() - 1))];};
+        C4Log("%-13s: %10.0f msgs/sec; latency p50 %7.1fus, p99 %8.1fus, p99.9 %8.1fus",
+              name, latencies.size() / elapsed,
+              percentile(0.50), percentile(0.99), percentile(0.999));
+        CHECK(latencies.size() == size_t(kNumSenders) * kMessagesPerSender * (kHops + 1));
+    }
+
+    TEST_CASE("Actor Scheduler Benchmark", "[Perf][.slow]") {
+        benchmarkScheduler(Scheduler::Backend::SharedQueue, "Shared queue");
+        benchmarkScheduler(Scheduler::Backend::WorkStealing, "Work-stealing");
+    }
+#endif
+
     TEST_CASE("URL Transformation") {
         slice withPort, unaffected;
         alloc_slice withoutPort;
@@ -326,3 +423,185 @@ namespace {
         CHECK(++strategy == URLTransformStrategy::RemovePort);
     }
 }
+
+
+#pragma mark - TIMER:
+
+
+using litecore::actor::Timer;
+
+
+TEST_CASE("Timer fires in order", "[Timer]") {
+    // Fire times span several wheel slots, and one is far enough out to cascade from level 1:
+    static constexpr int kDelays[] = {50, 10, 300, 30, 10, 20, 0};
+    constexpr size_t kNumTimers = sizeof(kDelays) / sizeof(kDelays[0]);
+    mutex m;
+    vector<int> fired;
+    atomic<size_t> numFired {0};
+    vector<unique_ptr<Timer>> timers;
+    auto start = Timer::clock::now();
+    for (int delay : kDelays) {
+        timers.emplace_back(new Timer([&, delay] {
+            auto elapsed = Timer::clock::now() - start;
+            lock_guard<mutex> lock(m);
+            // Record a negative delay if the timer fired too early:
+            fired.push_back(elapsed >= chrono::milliseconds(delay) ? delay : -delay);
+            ++numFired;
+        }));
+    }
+    for (size_t i = 0; i < kNumTimers; ++i)
+        timers[i]->fireAt(start + chrono::milliseconds(kDelays[i]));
+
+    REQUIRE_BEFORE(2s, numFired == kNumTimers);
+    lock_guard<mutex> lock(m);
+    CHECK(fired == (vector<int>{0, 10, 10, 20, 30, 50, 300}));
+}
+
+
+TEST_CASE("Timer reschedule and stop", "[Timer]") {
+    atomic<int> count {0};
+    Timer timer([&] {++count;});
+
+    SECTION("Stop") {
+        timer.fireAfter(50ms);
+        CHECK(timer.scheduled());
+        timer.stop();
+        CHECK(!timer.scheduled());
+    }
+    SECTION("Reschedule later") {
+        timer.fireAfter(20ms);
+        timer.fireAfter(10s);
+        this_thread::sleep_for(100ms);
+        CHECK(count == 0);
+        CHECK(!timer.fireEarlierAfter(20s));
+        CHECK(timer.fireEarlierAfter(10ms));
+        REQUIRE_BEFORE(2s, count == 1);
+    }
+    SECTION("Reschedule earlier") {
+        timer.fireAfter(1h);
+        CHECK(timer.fireEarlierAfter(10ms));
+        REQUIRE_BEFORE(2s, count == 1);
+    }
+    this_thread::sleep_for(100ms);
+    CHECK(count <= 1);
+    CHECK(!timer.scheduled());
+}
+
+
+TEST_CASE("Timer callback stops other timers", "[Timer]") {
+    // Timers due at the same time are fired in a batch, in the order they were scheduled;
+    // ones that haven't been called yet can still be stopped or deleted by an earlier callback.
+    atomic<int> count {0};
+    auto victim = new Timer([&] {++count;});
+    Timer other([&] {++count;});
+    auto killer = new Timer([&] {
+        delete victim;
+        other.stop();
+    });
+    killer->autoDelete();
+    auto at = Timer::clock::now() + 20ms;
+    killer->fireAt(at);
+    victim->fireAt(at);
+    other.fireAt(at);
+    this_thread::sleep_for(200ms);
+    CHECK(count == 0);
+    CHECK(!other.scheduled());
+}
+
+
+TEST_CASE("Timer Benchmark", "[Timer][Perf][.slow]") {
+    static constexpr int kNumTimers = 100000, kReschedules = 10;
+    vector<unique_ptr<Timer>> timers;
+    atomic<int> fired {0};
+    for (int i = 0; i < kNumTimers; ++i)
+        timers.emplace_back(new Timer([&] {++fired;}));
+
+    // Schedule, then repeatedly push back, timers as heartbeats and idle timeouts would:
+    {
+        fleece::Stopwatch st;
+        for (int r = 0; r < kReschedules; ++r) {
+            for (int i = 0; i < kNumTimers; ++i)
+                timers[i]->fireAfter(chrono::milliseconds(10000 + litecore::RandomNumber(50000)));
+        }
+        st.printReport("Rescheduling timers", kNumTimers * kReschedules, "timer");
+    }
+    {
+        fleece::Stopwatch st;
+        for (auto &timer : timers)
+            timer->stop();
+        st.printReport("Stopping timers", kNumTimers, "timer");
+    }
+
+    // Fire them all within a short time:
+    {
+        fleece::Stopwatch st;
+        auto start = Timer::clock::now();
+        for (int i = 0; i < kNumTimers; ++i)
+            timers[i]->fireAt(start + chrono::microseconds(litecore::RandomNumber(100000)));
+        REQUIRE_BEFORE(10s, fired == kNumTimers);
+        st.printReport("Firing timers", kNumTimers, "timer");
+    }
+}
+
+
+#pragma mark - BATCHER:
+
+
+namespace {
+    struct BatchItem : public fleece::RefCounted { };
+}
+
+
+TEST_CASE("Adaptive Batcher", "[Batcher]") {
+    using litecore::actor::Batcher;
+    using litecore::actor::BatcherStats;
+    int processNowCalls = 0, processLaterCalls = 0;
+    Batcher<BatchItem> batcher([&](int) {++processNowCalls;},
+                               [&](int) {++processLaterCalls;},
+                               20ms, 100);
+    batcher.setAdaptive(10ms, 10, 1000);
+
+    auto pushAndPop = [&](size_t n) {
+        for (size_t i = 0; i < n; ++i)
+            batcher.push(new BatchItem);
+        auto items = batcher.pop();
+        REQUIRE(items);
+        CHECK(items->size() == n);
+        return items->size();
+    };
+
+    // Filling the batch triggers an immediate pop, once:
+    pushAndPop(150);
+    CHECK(processLaterCalls == 1);
+    CHECK(processNowCalls == 1);
+
+    // Cheap items: the capacity grows until a batch takes the target time, up to the max:
+    for (int i = 0; i < 10; ++i)
+        batcher.batchProcessed(pushAndPop(100), 1ms);
+    CHECK(batcher.stats().capacity == 1000);
+
+    // Expensive items: it shrinks, down to the min:
+    for (int i = 0; i < 10; ++i)
+        batcher.batchProcessed(pushAndPop(100), 1s);
+    CHECK(batcher.stats().capacity == 10);
+
+    // At 0.2ms per item it settles near 50 items:
+    for (int i = 0; i < 40; ++i)
+        batcher.batchProcessed(pushAndPop(100), 20ms);
+    CHECK(batcher.stats().capacity >= 45);
+    CHECK(batcher.stats().capacity <= 50);
+
+    // Light load: the latency drops, but not below 1/8 of the original:
+    for (int i = 0; i < 10; ++i)
+        batcher.batchProcessed(pushAndPop(1), 1ms);
+    BatcherStats stats = batcher.stats();
+    CHECK(stats.latency == Timer::duration(20ms) / 8);
+
+    CHECK(stats.batches == 71);
+    CHECK(stats.items == 150 + 60 * 100 + 10);
+    CHECK(stats.sizeHistogram[0] == 10);
+    CHECK(stats.sizeHistogram[6] == 60);           // 64...127
+    CHECK(stats.sizeHistogram[7] == 1);            // 128...255
+    CHECK(BatcherStats::bucketFor(1000000) == BatcherStats::kHistogramBuckets - 1);
+    CHECK(stats.maxWait >= stats.totalWait / 71);
+}
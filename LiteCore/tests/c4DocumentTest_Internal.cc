@@ -135,6 +135,38 @@ N_WAY_TEST_CASE_METHOD(C4Test, "Document FindDocAncestors", "[Document][C]") {
 }
 
 
+N_WAY_TEST_CASE_METHOD(C4Test, "Document FindDocAncestors Many", "[Document][C]") {
+    // Looks up more docs than fit in one chunk of the underlying query, including a docID
+    // that would need escaping if it were put into SQL as a literal.
+    if (!isRevTrees())
+        return;
+    static constexpr unsigned kNumDocs = 300;
+    std::vector<std::string> docIDStrs;
+    for (unsigned i = 0; i < kNumDocs; ++i)
+        docIDStrs.push_back("doc-" + std::to_string(i));
+    docIDStrs[150] = "O'Brien";
+    for (unsigned i = 0; i < kNumDocs; i += 2)
+        createRev(slice(docIDStrs[i]), kRevID, kFleeceBody);
+
+    std::vector<C4String> docIDs, revIDs;
+    for (auto &docID : docIDStrs) {
+        docIDs.push_back(slice(docID));
+        revIDs.push_back(kRevID);
+    }
+    std::vector<C4SliceResult> ancestors(kNumDocs);
+    REQUIRE(c4db_findDocAncestors(db, kNumDocs, 4, false, 1, docIDs.data(), revIDs.data(),
+                                  ancestors.data(), WITH_ERROR()));
+    for (unsigned i = 0; i < kNumDocs; ++i) {
+        INFO("Doc " << docIDStrs[i]);
+        alloc_slice result(std::move(ancestors[i]));
+        if (i % 2 == 0)
+            CHECK(result == "8"_sl);      // kRevHaveLocal | kRevSame
+        else
+            CHECK(!result);
+    }
+}
+
+
 // Repro case for https://github.com/couchbase/couchbase-lite-core/issues/478
 N_WAY_TEST_CASE_METHOD(C4Test, "Document Clobber Remote Rev", "[Document][C]") {
 
@@ -48,6 +48,13 @@ namespace litecore { namespace blip {
 
     static const auto kDefaultCompressionLevel = (Deflater::CompressionLevel)6;
 
+    static unique_ptr<Codec> newOutputCodec(CodecType type, int8_t level) {
+        // The default level is tuned for deflate; other codecs use their own defaults.
+        if (type == CodecType::Deflate && level < 0)
+            level = kDefaultCompressionLevel;
+        return newEncoder(type, level);
+    }
+
     const char* const kMessageTypeNames[8] = {"REQ", "RES", "ERR", "?3?",
                                               "ACKREQ", "AKRES", "?6?", "?7?"};
 
@@ -110,8 +117,11 @@ namespace litecore { namespace blip {
         MessageMap              _pendingRequests, _pendingResponses;
         atomic<MessageNo>       _lastMessageNo {0};
         MessageNo               _numRequestsReceived {0};
-        Deflater                _outputCodec;
-        Inflater                _inputCodec;
+        CodecType               _codecType;
+        bool                    _codecRequired;     // If true, _codecType can't change
+        int8_t                  _compressionLevel;
+        unique_ptr<Codec>       _outputCodec;
+        unique_ptr<Codec>       _inputCodec;
         unique_ptr<uint8_t[]>   _frameBuf;
         RequestHandlers         _requestHandlers;
         size_t                  _maxOutboxDepth {0}, _totalOutboxDepth {0}, _countOutboxDepth {0};
@@ -121,13 +131,18 @@ namespace litecore { namespace blip {
 
     public:
 
-        BLIPIO(Connection *connection, WebSocket *webSocket, Deflater::CompressionLevel compressionLevel)
+        BLIPIO(Connection *connection, WebSocket *webSocket,
+               CodecType codecType, bool codecRequired, int8_t compressionLevel)
         :Actor(BLIPLog, string("BLIP[") + connection->name() + "]")
         ,_connection(connection)
         ,_webSocket(webSocket)
         ,_incomingFrames(this, "incomingFrames", &BLIPIO::_onWebSocketMessages)
         ,_outbox(10)
-        ,_outputCodec(compressionLevel)
+        ,_codecType(codecType)
+        ,_codecRequired(codecRequired)
+        ,_compressionLevel(compressionLevel)
+        ,_outputCodec(newOutputCodec(codecType, compressionLevel))
+        ,_inputCodec(newDecoder(codecType))
         {
             _pendingRequests.reserve(10);
             _pendingResponses.reserve(10);
@@ -181,6 +196,14 @@ namespace litecore { namespace blip {
         virtual void onWebSocketGotHTTPResponse(int status,
                                                 const websocket::Headers &headers) override
         {
+            // The server's choice of protocol determines the codec; switch to it before
+            // any frames are sent or received. (A successful response without a protocol means
+            // plain "BLIP_3", i.e. deflate.)
+            if (status < 300) {
+                slice protocol = headers["Sec-WebSocket-Protocol"_sl];
+                enqueue(FUNCTION_TO_QUEUE(BLIPIO::_setCodec),
+                        Connection::codecForProtocol(protocol));
+            }
             _connection->gotHTTPResponse(status, headers);
         }
 
@@ -217,6 +240,26 @@ namespace litecore { namespace blip {
             _webSocket->connect(this);
         }
 
+        void _setCodec(CodecType type) {
+            if (type == _codecType)
+                return;
+            if (_codecRequired) {
+                // The server accepted a protocol with a different codec than we insist on:
+                warn("Server chose codec '%s' but '%s' is required; closing",
+                     codecName(type), codecName(_codecType));
+                _close(kCodeProtocolError, alloc_slice("BLIP codec doesn't match protocol"));
+                return;
+            }
+            if (_totalBytesWritten > 0 || _totalBytesRead > 0) {
+                warn("Can't switch to codec '%s' after frames have been sent", codecName(type));
+                return;
+            }
+            logInfo("Using '%s' codec", codecName(type));
+            _outputCodec = newOutputCodec(type, _compressionLevel);
+            _inputCodec = newDecoder(type);
+            _codecType = type;
+        }
+
         /** Implementation of public close() method. Closes the WebSocket. */
         void _close(CloseCode closeCode, alloc_slice message) {
             if (_webSocket && !_closingWithError) {
@@ -361,7 +404,7 @@ namespace litecore { namespace blip {
 
                     // Ask the MessageOut to write data to fill the buffer:
                     auto prevBytesSent = msg->_bytesSent;
-                    msg->nextFrameToSend(_outputCodec, out, frameFlags);
+                    msg->nextFrameToSend(*_outputCodec, out, frameFlags);
                     *flagsPos = frameFlags;
                     slice frame = out.output();
                     bytesWritten += frame.size;
@@ -458,7 +501,7 @@ namespace litecore { namespace blip {
                     if (msg) {
                         MessageIn::ReceiveState state;
                         try {
-                            state = msg->receivedFrame(_inputCodec, payload, flags);
+                            state = msg->receivedFrame(*_inputCodec, payload, flags);
                         } catch (...) {
                             // If this is the final frame, then msg may not be in either pending list
                             // anymore. But on an exception we need to call its progress handler to
@@ -639,13 +682,39 @@ namespace litecore { namespace blip {
         else
             logInfo("Opening connection...");
 
-        _compressionLevel = kDefaultCompressionLevel;
+        _compressionLevel = Deflater::DefaultCompression;
         auto levelP = options.get(kCompressionLevelOption);
         if (levelP.isInteger())
             _compressionLevel = (int8_t)levelP.asInt();
 
+        optional<CodecType> requiredCodec;
+        if (slice name = options.get(kCodecOption).asString(); name) {
+            requiredCodec = codecNamed(name);
+            if (!requiredCodec || !codecAvailable(*requiredCodec))
+                error::_throw(error::InvalidParameter, "Unsupported BLIP codec '%.*s'",
+                              SPLAT(name));
+        }
+
+        // A server already knows the protocol it accepted; a client finds out when the
+        // response arrives (see BLIPIO::onWebSocketGotHTTPResponse):
+        auto codec = requiredCodec.value_or(CodecType::Deflate);
+        if (_role == Role::Server) {
+            slice protocol = webSocket->acceptedProtocol();
+            if (!protocol)
+                protocol = options.get(kProtocolsOption).asString();
+            if (!protocol)
+                error::_throw(error::InvalidParameter,
+                              "A server-side BLIP connection needs to know the accepted WebSocket "
+                              "protocol; set the '%s' option", kProtocolsOption);
+            codec = codecForProtocol(protocol);
+            if (requiredCodec && *requiredCodec != codec)
+                error::_throw(error::InvalidParameter,
+                              "BLIP codec '%s' doesn't match accepted protocol '%.*s'",
+                              codecName(*requiredCodec), SPLAT(protocol));
+        }
+
         // Now connect the websocket:
-        _io = new BLIPIO(this, webSocket, (Deflater::CompressionLevel)_compressionLevel);
+        _io = new BLIPIO(this, webSocket, codec, requiredCodec.has_value(), _compressionLevel);
     }
 
 
@@ -690,6 +759,29 @@ namespace litecore { namespace blip {
     }
 
 
+    string Connection::protocolName(CodecType codec) {
+        string name = kWSProtocolName;
+        if (codec != CodecType::Deflate)
+            (name += '.') += codecName(codec);
+        return name;
+    }
+
+
+    CodecType Connection::codecForProtocol(slice protocol) {
+        // The protocol looks like "BLIP_3.zstd+CBMobile_3"; the codec name follows the '.':
+        slice_istream in(protocol);
+        slice blipProtocol = in.readToDelimiterOrEnd("+"_sl);
+        slice prefix(kWSProtocolName);
+        if (blipProtocol.size > prefix.size + 1 && blipProtocol.hasPrefix(prefix)
+                && blipProtocol[prefix.size] == '.') {
+            slice name(blipProtocol.offset(prefix.size + 1), blipProtocol.end());
+            if (auto codec = codecNamed(name); codec && codecAvailable(*codec))
+                return *codec;
+        }
+        return CodecType::Deflate;
+    }
+
+
     void Connection::gotHTTPResponse(int status, const websocket::Headers &headers) {
         delegate().onHTTPResponse(status, headers);
     }
@@ -26,6 +26,7 @@
 namespace litecore { namespace blip {
     class BLIPIO;
     class ConnectionDelegate;
+    enum class CodecType : uint8_t;
     class MessageOut;
 
 
@@ -52,6 +53,25 @@ namespace litecore { namespace blip {
             0 (no compression) to 9 (best compression). */
         static constexpr const char *kCompressionLevelOption = "BLIPCompressionLevel";
 
+        /** Option giving the WebSocket protocol(s). On a server this is the protocol it accepted,
+            like "BLIP_3.zstd+CBMobile_3", and the codec is derived from it. It's required on a
+            server, unless the WebSocket knows its acceptedProtocol(). (A client derives its
+            codec from the Sec-WebSocket-Protocol response header instead.) */
+        static constexpr const char *kProtocolsOption = "WS-Protocols";
+
+        /** Option to require a compression codec, by name ("deflate", "lz4", "zstd".) The codec is
+            normally derived from the negotiated protocol; if this is set and disagrees with it,
+            a server throws from the constructor and a client fails the handshake. */
+        static constexpr const char *kCodecOption = "BLIPCodec";
+
+        /** WebSocket 'protocol' name for BLIP using a specific codec, e.g. "BLIP_3.zstd".
+            Deflate is the default, so its name is just kWSProtocolName. */
+        static std::string protocolName(CodecType);
+
+        /** Returns the codec named by a negotiated WebSocket protocol, like "BLIP_3.zstd+CBMobile_3".
+            Returns Deflate if the protocol doesn't name a codec, or names an unavailable one. */
+        static CodecType codecForProtocol(fleece::slice protocol);
+
         /** Creates a BLIP connection on a WebSocket. */
         Connection(websocket::WebSocket*,
                    const fleece::AllocedDict &options,
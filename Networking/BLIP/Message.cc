@@ -168,14 +168,15 @@ namespace litecore { namespace blip {
             uint8_t checksum[Codec::kChecksumSize];
             auto trailer = (void*)&frame[frame.size - Codec::kChecksumSize];
             memcpy(checksum, trailer, Codec::kChecksumSize);
-            if (mode == Codec::Mode::SyncFlush) {
+            slice flushTrailer = codec.flushTrailer();
+            if (mode == Codec::Mode::SyncFlush && flushTrailer.size > 0) {
                 // Replace checksum with the untransmitted deflate empty-block trailer,
                 // which is conveniently the same size:
-                static_assert(Codec::kChecksumSize == 4,
-                              "Checksum not same size as deflate trailer");
-                memcpy(trailer, "\x00\x00\xFF\xFF", 4);
+                Assert(flushTrailer.size == Codec::kChecksumSize);
+                memcpy(trailer, flushTrailer.buf, flushTrailer.size);
             } else {
-                // In uncompressed message, just trim off the checksum:
+                // In uncompressed message (or one whose codec has no trailer),
+                // just trim off the checksum:
                 frame.setSize(frame.size - Codec::kChecksumSize);
             }
 
@@ -294,7 +295,8 @@ namespace litecore { namespace blip {
 
     void MessageIn::readFrame(Codec &codec, int mode, slice_istream &frame, bool finalFrame) {
         uint8_t buffer[4096];
-        while (frame.size > 0) {
+        // Keep going after the input is consumed if the codec still has output buffered:
+        while (frame.size > 0 || codec.unflushedBytes() > 0) {
             slice_ostream output(buffer, sizeof(buffer));
             codec.write(frame, output, Codec::Mode(mode));
             if (output.bytesWritten() > 0)
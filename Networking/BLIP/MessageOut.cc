@@ -72,12 +72,14 @@ namespace litecore { namespace blip {
 
             if (mode == Codec::Mode::SyncFlush) {
                 size_t bytesWritten = (frameSize - Codec::kChecksumSize) - frame.capacity();
-                if (bytesWritten > 0) {
-                    // SyncFlush always ends the output with the 4 bytes 00 00 FF FF.
+                slice trailer = codec.flushTrailer();
+                if (bytesWritten > 0 && trailer.size > 0) {
+                    // A deflate SyncFlush always ends the output with the 4 bytes 00 00 FF FF.
                     // We can remove those, then add them when reading the data back in.
-                    Assert(bytesWritten >= 4 &&
-                           memcmp((const char*)frame.next() - 4, "\x00\x00\xFF\xFF", 4) == 0);
-                    frame.retreat(4);
+                    Assert(bytesWritten >= trailer.size &&
+                           memcmp((const char*)frame.next() - trailer.size,
+                                  trailer.buf, trailer.size) == 0);
+                    frame.retreat(trailer.size);
                 }
             }
 
@@ -36,6 +36,7 @@ namespace litecore { namespace net {
         {HTTPStatus::Conflict,           "Conflict"},
         {HTTPStatus::Gone,               "Gone"},
         {HTTPStatus::PreconditionFailed, "Precondition Failed"},
+        {HTTPStatus::PayloadTooLarge,    "Payload Too Large"},
         {HTTPStatus::ServerError,        "Internal Server Error"},
         {HTTPStatus::NotImplemented,     "Not Implemented"},
         {HTTPStatus::GatewayError,       "Bad Gateway"},
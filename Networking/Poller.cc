@@ -32,6 +32,9 @@
 #include <unistd.h>
 #include <poll.h>
 #endif
+#ifdef LITECORE_POLLER_EPOLL
+#include <sys/epoll.h>
+#endif
 
 #define WSLog (*(LogDomain*)kC4WebSocketLog)
 
@@ -75,6 +78,18 @@ namespace litecore { namespace net {
         _interruptReadFD = readSock.release();
         _interruptWriteFD = writeSock.release();
 #endif
+
+#ifdef LITECORE_POLLER_EPOLL
+        _epollFD = ::epoll_create1(EPOLL_CLOEXEC);
+        if (_epollFD < 0)
+            throwSocketError();
+        // The interrupt pipe is level-triggered, so every message written to it gets read:
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = _interruptReadFD;
+        if (::epoll_ctl(_epollFD, EPOLL_CTL_ADD, _interruptReadFD, &ev) < 0)
+            throwSocketError();
+#endif
     }
 
 
@@ -88,6 +103,10 @@ namespace litecore { namespace net {
             ::closesocket(_interruptWriteFD);
 #endif
         }
+#ifdef LITECORE_POLLER_EPOLL
+        if (_epollFD >= 0)
+            ::close(_epollFD);
+#endif
     }
 
 
@@ -100,9 +119,14 @@ namespace litecore { namespace net {
     void Poller::addListener(int fd, Event event, Listener listener) {
         Assert(fd >= 0);
         lock_guard<mutex> lock(_mutex);
-        _listeners[fd][event] = move(listener);
+        auto &listeners = _listeners[fd];
+        listeners[event] = move(listener);
+#ifdef LITECORE_POLLER_EPOLL
+        _updateEpoll(fd, listeners);    // epoll_ctl is thread-safe, so no need to wake the thread
+#else
         if (_waiting)
             _interrupt(0);  // wake the poller thread so it will detect the new listener fd
+#endif
     }
 
 
@@ -111,6 +135,10 @@ namespace litecore { namespace net {
         lock_guard<mutex> lock(_mutex);
         if (auto i = _listeners.find(fd); i != _listeners.end())
             _listeners.erase(i);
+#ifdef LITECORE_POLLER_EPOLL
+        // Ignore errors: the fd may already be closed, which implicitly removed it from epoll.
+        (void) ::epoll_ctl(_epollFD, EPOLL_CTL_DEL, fd, nullptr);
+#endif
         // no need to interrupt the poll thread
     }
 
@@ -262,6 +290,81 @@ namespace litecore { namespace net {
         return result;
     }
 
+#else
+
+    // Reads a message from the interrupt pipe and handles it. Returns false if the thread
+    // should stop.
+    bool Poller::handleInterrupt() {
+        int message;
+        if (::read(_interruptReadFD, &message, sizeof(message)) < ssize_t(sizeof(message)))
+            return true;
+        if (message < 0) {
+            // Receiving a negative message aborts the loop
+            LogTo(WSLog, "Poller: thread is stopping");
+            return false;
+        } else if (message > 0) {
+            // A positive message is a file descriptor to tell it's disconnected:
+            LogDebug(WSLog, "Poller: fd %d is disconnected", message);
+            callAndRemoveListener(message, kDisconnected);
+            removeListeners(message);
+        }
+        return true;
+    }
+
+#ifdef LITECORE_POLLER_EPOLL
+
+    // Registers the fd's current interests with epoll. The registration is edge-triggered, so
+    // a ready fd isn't reported over and over while nobody's listening; but modifying it makes
+    // the kernel check the fd's current state, so a listener added after the fd became ready
+    // still gets called.
+    void Poller::_updateEpoll(int fd, const array<Listener,3> &listeners) {
+        epoll_event ev = {};
+        ev.events = EPOLLET | EPOLLRDHUP;
+        if (listeners[kReadable])
+            ev.events |= EPOLLIN;
+        if (listeners[kWriteable])
+            ev.events |= EPOLLOUT;
+        ev.data.fd = fd;
+        if (::epoll_ctl(_epollFD, EPOLL_CTL_MOD, fd, &ev) < 0) {
+            if (errno != ENOENT || ::epoll_ctl(_epollFD, EPOLL_CTL_ADD, fd, &ev) < 0)
+                throwSocketError();
+        }
+    }
+
+
+    bool Poller::poll() {
+        static constexpr int kMaxEvents = 64;
+        epoll_event events[kMaxEvents];
+        int n;
+        while ((n = ::epoll_wait(_epollFD, events, kMaxEvents, -1)) < 0) {
+            if (errno != EINTR) {
+                LogError(WSLog, "Poller: epoll_wait() returned errno %d; stopping thread", errno);
+                return false;
+            }
+        }
+
+        bool result = true;
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            uint32_t revents = events[i].events;
+            if (fd == _interruptReadFD) {
+                if (!handleInterrupt())
+                    result = false;
+            } else {
+                LogDebug(WSLog, "Poller: fd %d got event 0x%02x", fd, revents);
+                if (revents & (EPOLLIN | EPOLLHUP | EPOLLRDHUP))
+                    callAndRemoveListener(fd, kReadable);
+                if (revents & EPOLLOUT)
+                    callAndRemoveListener(fd, kWriteable);
+                if (revents & EPOLLERR) {
+                    callAndRemoveListener(fd, kDisconnected);
+                    removeListeners(fd);
+                }
+            }
+        }
+        return result;
+    }
+
 #else
 
     bool Poller::poll() {
@@ -298,20 +401,9 @@ namespace litecore { namespace net {
             if (entry.revents) {
                 auto fd = entry.fd;
                 if (fd == _interruptReadFD) {
-                    // This is an interrupt -- read the byte from the pipe:
-                    int message;
-                    ::read(_interruptReadFD, &message, sizeof(message));
-                    if (message < 0) {
-                        // Receiving a negative message aborts the loop
-                        LogTo(WSLog, "Poller: thread is stopping");
+                    // This is an interrupt -- read the message from the pipe:
+                    if (!handleInterrupt())
                         result = false;
-                    } else if (message > 0) {
-                        // A positive message is a file descriptor to tell it's disconnected:
-                        fd = message;
-                        LogDebug(WSLog, "Poller: fd %d is disconnected", fd);
-                        callAndRemoveListener(fd, kDisconnected);
-                        removeListeners(fd);
-                    }
                 } else {
                     LogDebug(WSLog, "Poller: fd %d got event 0x%02x", fd, entry.revents);
                     if (entry.revents & (POLLIN | POLLHUP))
@@ -328,6 +420,7 @@ namespace litecore { namespace net {
         return result;
     }
 
-#endif
+#endif // LITECORE_POLLER_EPOLL
+#endif // WIN32
 
 } }
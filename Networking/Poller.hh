@@ -14,13 +14,18 @@
 #include "sockpp/platform.h"
 #include "sockpp/socket.h"
 
+// On Linux the Poller uses epoll, unless the build opts out (CMake option LITECORE_POLLER_USE_POLL):
+#if defined(__linux__) && !defined(LITECORE_POLLER_USE_POLL)
+    #define LITECORE_POLLER_EPOLL 1
+#endif
+
 namespace litecore { namespace net {
 	// This needs to stay here because of the platform variations of
 	// socket_t and INVALID_SOCKET (Windows has them globally and
 	// Unix has them in this namespace)
 	using namespace sockpp; 
 	
-    /** Enables async I/O by running `poll` on a background thread. */
+    /** Enables async I/O by running `poll` (or `epoll` on Linux) on a background thread. */
     class Poller {
     public:
         /// The single shared instance (all that's necessary in normal use)
@@ -57,6 +62,10 @@ namespace litecore { namespace net {
         bool poll();
         void callAndRemoveListener(int fd, Event);
         void _interrupt(int fd);
+        bool handleInterrupt();
+#ifdef LITECORE_POLLER_EPOLL
+        void _updateEpoll(int fd, const std::array<Listener,3>&);
+#endif
 
         std::mutex _mutex;
         std::unordered_map<socket_t, std::array<Listener,3>> _listeners; // array indexed by Event
@@ -65,6 +74,9 @@ namespace litecore { namespace net {
 
         socket_t _interruptReadFD  {INVALID_SOCKET}; // Pipe used to interrupt poll()
         socket_t _interruptWriteFD {INVALID_SOCKET}; // Other end of the pipe
+#ifdef LITECORE_POLLER_EPOLL
+        int _epollFD {-1};                           // epoll instance watching the listeners' fds
+#endif
     };
 
 } }
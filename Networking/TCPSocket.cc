@@ -35,6 +35,9 @@
 #include "sockpp/tls_socket.h"
 #include "PlatformIO.hh"
 #include "c4ExceptionUtils.hh"   // for ExpectingExceptions
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
 #include <chrono>
 #include <regex>
 #include <string>
@@ -349,8 +352,8 @@ namespace litecore { namespace net {
         slice result(alloced.buf, size_t(0));
 
         while (true) {
-            // Read more bytes:
-            ssize_t n = _read((void*)result.end(), alloced.size - result.size);
+            // Read more bytes (starting with any that were pushed back by a prior read):
+            ssize_t n = read((void*)result.end(), alloced.size - result.size);
             if (n < 0)
                 return nullslice;
             if (n == 0) {
@@ -382,10 +385,45 @@ namespace litecore { namespace net {
     }
 
 
-    bool TCPSocket::readHTTPBody(const Headers &headers, alloc_slice &body) {
+    bool TCPSocket::bufferedInputContains(slice delim) const {
+        return slice(_unread.buf, _unreadLen).find(delim).buf != nullptr;
+    }
+
+
+    // Non-blocking read of everything that's available, appended to the unread buffer.
+    // (Loops till EWOULDBLOCK, since a TLS socket may hold decrypted data the Poller can't see.)
+    bool TCPSocket::bufferAvailableInput(size_t maxSize) {
+        Assert(_nonBlocking);
+        while (_unreadLen < maxSize && !_eofOnRead) {
+            size_t capacity = min(max(2 * _unreadLen, kInitialDelimitedReadBufferSize), maxSize);
+            if (capacity > _unread.size)
+                _unread.resize(capacity);
+            ssize_t n = _socket->read((void*)_unread.offset(_unreadLen), capacity - _unreadLen);
+            if (n > 0) {
+                _unreadLen += n;
+            } else if (n == 0) {
+                _eofOnRead = true;
+            } else if (socketToPosixErrCode(_socket->last_error()) == EWOULDBLOCK) {
+                break;
+            } else {
+                checkStreamError();
+                return false;
+            }
+        }
+        return true;
+    }
+
+
+    bool TCPSocket::readHTTPBody(const Headers &headers, alloc_slice &body, size_t maxSize) {
         int64_t contentLength = headers.getInt("Content-Length"_sl, -1);
-        if (contentLength >= 0) {
+        if (headers["Transfer-Encoding"_sl].caseEquivalent("chunked"_sl)) {
+            return readChunkedHTTPBody(body, maxSize);
+        } else if (contentLength >= 0) {
             // Read exactly Content-Length bytes:
+            if (uint64_t(contentLength) > maxSize) {
+                setError(WebSocketDomain, 413, "HTTP body too large"_sl);
+                return false;
+            }
             if (contentLength > 0) {
                 body.resize(size_t(contentLength));
                 if (readExactly((void*)body.buf, (size_t)contentLength) < contentLength) {
@@ -395,7 +433,7 @@ namespace litecore { namespace net {
             }
         } else {
             // No Content-Length, so read till EOF:
-            body.resize(1024);
+            body.resize(min(size_t(1024), maxSize));
             size_t length = 0;
             while (true) {
                 ssize_t n = read((void*)&body[length], body.size - length);
@@ -405,8 +443,14 @@ namespace litecore { namespace net {
                 } else if (n == 0)
                     break;
                 length += n;
-                if (length == body.size)
-                    body.resize(2 * body.size);
+                if (length == body.size) {
+                    if (length >= maxSize) {
+                        setError(WebSocketDomain, 413, "HTTP body too large"_sl);
+                        body.reset();
+                        return false;
+                    }
+                    body.resize(min(2 * body.size, maxSize));
+                }
             }
             body.resize(length);
         }
@@ -414,6 +458,55 @@ namespace litecore { namespace net {
     }
 
 
+    // Reads a body with chunked transfer encoding: each chunk is preceded by a line containing
+    // its size in hex, and a zero-size chunk ends the body, followed by optional trailers.
+    // <https://tools.ietf.org/html/rfc7230#section-4.1>
+    bool TCPSocket::readChunkedHTTPBody(alloc_slice &body, size_t maxSize) {
+        body.resize(min(size_t(1024), maxSize));
+        size_t length = 0;
+        while (true) {
+            alloc_slice line = readToDelimiter("\r\n"_sl);
+            if (!line)
+                break;
+            string sizeStr(line);
+            char *end;
+            errno = 0;
+            unsigned long long chunkSize = strtoull(sizeStr.c_str(), &end, 16);
+            if (end == sizeStr.c_str() || (*end != '\r' && *end != ';') || errno == ERANGE
+                    || !isxdigit((unsigned char)sizeStr[0])) {    // (strtoull allows "-" and " ")
+                setError(WebSocketDomain, 400, "Invalid HTTP chunk header"_sl);
+                break;
+            }
+            // Compare without adding, so a huge chunkSize can't wrap around:
+            if (chunkSize > kMaxHTTPChunkSize || chunkSize > maxSize - length) {
+                setError(WebSocketDomain, 413, "HTTP body too large"_sl);
+                break;
+            }
+
+            if (chunkSize == 0) {
+                // Skip any trailers, up to the empty line that ends the body:
+                do {
+                    line = readToDelimiter("\r\n"_sl);
+                } while (line.size > 2);
+                if (!line)
+                    break;
+                body.resize(length);
+                return true;
+            }
+
+            if (length + chunkSize > body.size)
+                body.resize(min(max(2 * body.size, size_t(length + chunkSize)), maxSize));
+            char crlf[2];
+            if (readExactly((void*)&body[length], chunkSize) < ssize_t(chunkSize)
+                    || readExactly(crlf, 2) < 2)
+                break;
+            length += chunkSize;
+        }
+        body.reset();
+        return false;
+    }
+
+
 #pragma mark - NONBLOCKING / SELECT:
 
 
@@ -9,6 +9,7 @@
 #include "Address.hh"
 #include "HTTPTypes.hh"
 #include "fleece/Fleece.hh"
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <vector>
@@ -82,12 +83,32 @@ namespace litecore::net {
                                             bool includeDelimiter =true,
                                             size_t maxSize =kMaxDelimitedReadSize) MUST_USE_RESULT;
 
+        /// The largest chunk accepted in a body with chunked transfer encoding.
+        static constexpr size_t kMaxHTTPChunkSize = 16 * 1024 * 1024;
+
         /// Reads an HTTP body, given the headers.
-        /// If there's a Content-Length header, reads that many bytes, otherwise reads till EOF.
-        bool readHTTPBody(const websocket::Headers &headers, fleece::alloc_slice &body) MUST_USE_RESULT;
+        /// If there's a Content-Length header, reads that many bytes; if the body is chunked,
+        /// reads and reassembles the chunks; otherwise reads till EOF.
+        /// If the body is larger than \ref maxSize, fails with error {WebSocket, 413}; a
+        /// malformed chunk header fails with {WebSocket, 400}.
+        bool readHTTPBody(const websocket::Headers &headers, fleece::alloc_slice &body,
+                          size_t maxSize =SIZE_MAX) MUST_USE_RESULT;
 
         bool atReadEOF() const                          {return _eofOnRead;}
 
+        /// True if data has been read from the socket but not yet consumed, i.e. the next read
+        /// will return immediately.
+        bool hasBufferedInput() const                   {return _unreadLen > 0;}
+        size_t bufferedInputSize() const                {return _unreadLen;}
+
+        /// True if the data that's been read but not yet consumed contains \ref delimiter.
+        bool bufferedInputContains(slice delimiter) const;
+
+        /// In non-blocking mode, reads whatever data has arrived, without waiting for more, and
+        /// keeps it to be returned by later reads. Stops once \ref maxSize bytes are buffered.
+        /// Reaching EOF is not an error (check \ref atReadEOF); returns false on error.
+        bool bufferAvailableInput(size_t maxSize =kMaxDelimitedReadSize) MUST_USE_RESULT;
+
         //-------- WRITING:
 
         /// Writes to the socket and returns the number of bytes written:
@@ -125,6 +146,7 @@ namespace litecore::net {
         void checkStreamError();
         bool checkSocketFailure();
         ssize_t _read(void *dst, size_t byteCount) MUST_USE_RESULT;
+        bool readChunkedHTTPBody(fleece::alloc_slice &body, size_t maxSize) MUST_USE_RESULT;
         void pushUnread(slice);
         int fileDescriptor();
 
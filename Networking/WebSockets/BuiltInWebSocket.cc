@@ -62,7 +62,6 @@ namespace litecore { namespace websocket {
                                        Role role,
                                        const Parameters &parameters)
     :WebSocketImpl(url, role, true, parameters)
-    ,_readBuffer(kReadBufferSize)
     {
         TCPSocket::initialize();
     }
@@ -80,8 +79,9 @@ namespace litecore { namespace websocket {
 
     // server constructor
     BuiltInWebSocket::BuiltInWebSocket(const URL &url,
-                                       unique_ptr<net::ResponderSocket> socket)
-    :BuiltInWebSocket(url, Role::Server, Parameters())
+                                       unique_ptr<net::ResponderSocket> socket,
+                                       slice acceptedProtocol)
+    :BuiltInWebSocket(url, Role::Server, Parameters{alloc_slice(acceptedProtocol), 0, {}})
     {
         _socket = move(socket);
     }
@@ -93,11 +93,18 @@ namespace litecore { namespace websocket {
 
 
     void BuiltInWebSocket::connect() {
-        // Spawn a thread to connect and run the read loop:
         WebSocketImpl::connect();
         _selfRetain = this; // Keep myself alive until disconnect
-        _connectThread = thread(bind(&BuiltInWebSocket::_bgConnect, this));
-        _connectThread.detach();
+        if (_socket) {
+            // Server side: the socket is already open, so there's no need for a thread. Start I/O
+            // from the Poller thread, as soon as the socket is writeable (i.e. right away.)
+            _socket->setNonBlocking(true);
+            _socket->onWriteable([=] { startIO(); });
+        } else {
+            // Client side: spawn a thread to make the (blocking) connection:
+            _connectThread = thread(bind(&BuiltInWebSocket::_bgConnect, this));
+            _connectThread.detach();
+        }
     }
 
 
@@ -117,28 +124,32 @@ namespace litecore { namespace websocket {
 #pragma mark - CONNECTING:
 
 
-    // This runs on its own thread.
+    // This runs on its own thread, which exits once the connection is open.
     void BuiltInWebSocket::_bgConnect() {
         Retained<BuiltInWebSocket> temporarySelfRetain = this;
         setThreadName();
 
-        if (!_socket) {
-            try {
-                // Connect:
-                auto socket = _connectLoop();
-                _database = nullptr;
-                if (!socket) {
-                    _selfRetain = nullptr;
-                    return;
-                }
-
-                _socket = move(socket);
-            } catch (const std::exception &x) {
-                closeWithException(x, "while connecting");
+        try {
+            // Connect:
+            auto socket = _connectLoop();
+            _database = nullptr;
+            if (!socket) {
+                _selfRetain = nullptr;
                 return;
             }
+
+            _socket = move(socket);
+        } catch (const std::exception &x) {
+            closeWithException(x, "while connecting");
+            return;
         }
 
+        startIO();
+    }
+
+
+    // Called once the socket is connected; from here on, all I/O happens on the Poller thread.
+    void BuiltInWebSocket::startIO() {
         _socket->setNonBlocking(true);
         _socket->onDisconnect([&] {
             logVerbose("socket disconnected");
@@ -377,7 +388,13 @@ namespace litecore { namespace websocket {
                 return;
             }
 
-            ssize_t n = _socket->read((void*)_readBuffer.buf, min(_readBuffer.size,
+            // This only runs on the Poller thread, so all sockets can share one buffer.
+            // (onReceive copies whatever it needs to keep.)
+            static thread_local alloc_slice sReadBuffer;
+            if (!sReadBuffer)
+                sReadBuffer = alloc_slice(kReadBufferSize);
+
+            ssize_t n = _socket->read((void*)sReadBuffer.buf, min(sReadBuffer.size,
                                                                   _curReadCapacity.load()));
             logDebug("Received %zd bytes from socket", n);
             if (_usuallyFalse(n < 0)) {
@@ -397,7 +414,7 @@ namespace litecore { namespace websocket {
             }
 
             // Pass data to WebSocket parser:
-            onReceive(slice(_readBuffer.buf, n));
+            onReceive(slice(sReadBuffer.buf, n));
         } catch (const exception &x) {
             closeWithException(x, "during I/O");
         }
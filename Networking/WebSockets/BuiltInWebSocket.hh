@@ -27,7 +27,10 @@ namespace litecore::crypto {
 
 namespace litecore { namespace websocket {
 
-    /** WebSocket implementation using TCPSocket. */
+    /** WebSocket implementation using TCPSocket.
+        All I/O is non-blocking and driven by the shared Poller thread; a client socket uses a
+        temporary thread only to connect (and do the TLS handshake), and a server socket uses
+        none at all. */
     class BuiltInWebSocket final : public WebSocketImpl, public net::HTTPLogic::CookieProvider {
     public:
         /** This must be called once, for c4Replicator to use BuiltInWebSocket by default. */
@@ -39,9 +42,11 @@ namespace litecore { namespace websocket {
                          C4Database *database);
 
         /** Server-side constructor; takes an already-connected socket that's been through the
-            HTTP WebSocket handshake and is ready to send/receive frames. */
+            HTTP WebSocket handshake and is ready to send/receive frames, and the subprotocol
+            the handshake accepted (which BLIP needs, to choose its codec.) */
         BuiltInWebSocket(const URL &url,
-                         std::unique_ptr<net::ResponderSocket>);
+                         std::unique_ptr<net::ResponderSocket>,
+                         fleece::slice acceptedProtocol);
 
         /** Starts the TCP connection for a client socket. */
         virtual void connect() override;
@@ -62,6 +67,7 @@ namespace litecore { namespace websocket {
     private:
         BuiltInWebSocket(const URL&, Role, const Parameters &);
         void _bgConnect();
+        void startIO();
         void setThreadName();
         bool configureClientCert(fleece::Dict auth);
         bool configureProxy(net::HTTPLogic&, fleece::Dict proxyOpt);
@@ -79,7 +85,7 @@ namespace litecore { namespace websocket {
         // backpressure to the peer.
         static constexpr size_t kReadCapacity = 64 * 1024;
 
-        // Size of the buffer allocated for reading from the socket.
+        // Size of the buffer used for reading from the socket. (It's shared by all sockets.)
         static constexpr size_t kReadBufferSize = 32 * 1024;
 
         Retained<C4Database> _database;                     // The database (used only for cookies)
@@ -93,7 +99,6 @@ namespace litecore { namespace websocket {
         std::mutex _outboxMutex;                            // Locking for outbox
 
         std::atomic<size_t> _curReadCapacity {kReadCapacity}; // # bytes I can read from socket
-        fleece::alloc_slice _readBuffer;                    // Buffer used by readFromSocket().
     };
 
 } }
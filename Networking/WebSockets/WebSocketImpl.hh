@@ -67,6 +67,12 @@ namespace litecore { namespace websocket {
         void onWriteComplete(size_t);
 
         const Parameters& parameters() const         {return _parameters;}
+
+        // On a server, the webSocketProtocols parameter is the protocol that was accepted:
+        virtual fleece::slice acceptedProtocol() const override {
+            return role() == Role::Server ? fleece::slice(_parameters.webSocketProtocols)
+                                          : fleece::nullslice;
+        }
         const fleece::AllocedDict& options() const   {return _parameters.options;}
     protected:
         // Timeout for WebSocket connection (until HTTP response received)
@@ -141,6 +141,10 @@ namespace litecore { namespace websocket {
             return std::string(role() == Role::Server ? "<-" : "->") + (std::string)url();
         }
 
+        /** On a server, the subprotocol it accepted in the HTTP handshake (the value of the
+            response's Sec-WebSocket-Protocol header), if the WebSocket knows it; else null. */
+        virtual fleece::slice acceptedProtocol() const  {return fleece::nullslice;}
+
         /** Assigns the Delegate and opens the WebSocket. */
         void connect(Delegate *delegate);
 
@@ -138,9 +138,38 @@ namespace litecore { namespace REST {
 #pragma mark - DOCUMENT HANDLERS:
 
 
-    void RESTListener::handleGetAllDocs(RequestResponse &rq, C4Database *db) {
+    // Reads a CouchDB-style key parameter, which should be a JSON string, though a bare docID is
+    // accepted too. Returns false if the value is JSON but not a string.
+    static bool keyQuery(RequestResponse &rq, const char *param, alloc_slice &outKey) {
+        string value = rq.query(param);
+        if (value.empty())
+            return true;
+        if (value[0] != '"') {
+            outKey = alloc_slice(value);
+            return true;
+        }
+        Doc doc = Doc::fromJSON(value);
+        slice key = doc.root().asString();
+        if (!key)
+            return false;
+        outKey = alloc_slice(key);
+        return true;
+    }
+
+
+    // The database is only locked while this much JSON is generated; it's then sent unlocked:
+    static constexpr size_t kAllDocsBatchSize = 32 * 1024;
+
+    // Unlike other database handlers, this one isn't registered with addDBHandler, because it
+    // streams its response: it only locks the database while generating each batch of rows,
+    // not while sending them, so a slow client doesn't hold up other requests.
+    void RESTListener::handleGetAllDocs(RequestResponse &rq) {
+        Retained<C4Database> db = databaseFor(rq);
+        if (!db)
+            return;
+
         // Apply options:
-        C4EnumeratorOptions options;
+        C4EnumeratorOptions options = kC4DefaultEnumeratorOptions;
         options.flags = kC4IncludeNonConflicted;
         if (rq.boolQuery("descending"))
             options.flags |= kC4Descending;
@@ -149,41 +178,81 @@ namespace litecore { namespace REST {
             options.flags |= kC4IncludeBodies;
         int64_t skip = rq.intQuery("skip", 0);
         int64_t limit = rq.intQuery("limit", INT64_MAX);
-        // TODO: Implement startkey, endkey, etc.
-
-        // Create enumerator:
-        C4DocEnumerator e(db, options);
-
-        // Enumerate, building JSON:
-        auto &json = rq.jsonEncoder();
-        json.beginDict();
-        json.writeKey("rows"_sl);
-        json.beginArray();
-        while (e.next()) {
-            if (skip-- > 0)
-                continue;
-            else if (limit-- <= 0)
-                break;
-            C4DocumentInfo info = e.documentInfo();
-            json.beginDict();
-            json.writeKey("key"_sl);
-            json.writeString(info.docID);
-            json.writeKey("id"_sl);
-            json.writeString(info.docID);
-            json.writeKey("value"_sl);
-            json.beginDict();
-            json.writeKey("rev"_sl);
-            json.writeString(info.revID);
-            json.endDict();
-
-            if (includeDocs) {
-                json.writeKey("doc"_sl);
-                json.writeRaw(e.getDocument()->bodyAsJSON());
+        alloc_slice startKey, endKey;
+        if (!keyQuery(rq, "startkey", startKey) || !keyQuery(rq, "endkey", endKey))
+            return rq.respondWithStatus(HTTPStatus::BadRequest, "Invalid startkey or endkey");
+        options.startKey = startKey;
+        options.endKey = endKey;
+        if (!rq.boolQuery("inclusive_end", true))
+            options.flags |= kC4ExclusiveEndKey;
+        // Let the enumerator stop after the last row, instead of reading the rest of the db:
+        if (skip >= 0 && limit >= 0 && limit < INT64_MAX - skip)
+            options.limit = uint64_t(skip + limit);
+
+        // Create enumerator. It may only be used, or freed, while the database is locked:
+        unique_ptr<C4DocEnumerator> e;
+        withDatabaseLocked(db, [&] {
+            e = make_unique<C4DocEnumerator>(db, options);
+        });
+
+        // Enumerate, streaming the JSON to the client as it's generated. Each row is encoded
+        // separately so the whole response never has to be in memory:
+        rq.setHeader("Content-Type", "application/json");
+        rq.setChunked();
+        rq.write("{\"rows\":[");
+        JSONEncoder json;
+        string batch;
+        bool first = true, more = true;
+        try {
+            while (more) {
+                withDatabaseLocked(db, [&] {
+                    while (batch.size() < kAllDocsBatchSize) {
+                        if (limit <= 0 || !e->next()) {
+                            more = false;
+                            e.reset();
+                            break;
+                        } else if (skip-- > 0) {
+                            continue;
+                        }
+                        --limit;
+                        C4DocumentInfo info = e->documentInfo();
+                        json.beginDict();
+                        json.writeKey("key"_sl);
+                        json.writeString(info.docID);
+                        json.writeKey("id"_sl);
+                        json.writeString(info.docID);
+                        json.writeKey("value"_sl);
+                        json.beginDict();
+                        json.writeKey("rev"_sl);
+                        json.writeString(info.revID);
+                        json.endDict();
+
+                        if (includeDocs) {
+                            json.writeKey("doc"_sl);
+                            json.writeRaw(e->getDocument()->bodyAsJSON());
+                        }
+                        json.endDict();
+
+                        if (!first)
+                            batch += ',';
+                        first = false;
+                        alloc_slice row = json.finish();
+                        batch.append((const char*)row.buf, row.size);
+                        json.reset();
+                    }
+                });
+                rq.write(batch);
+                batch.clear();
+                if (rq.writeFailed())
+                    break;
             }
-            json.endDict();
+        } catch (...) {
+            withDatabaseLocked(db, [&] {e.reset();});
+            throw;
         }
-        json.endArray();
-        json.endDict();
+        if (e)
+            withDatabaseLocked(db, [&] {e.reset();});
+        rq.write("]}");
     }
 
 
@@ -237,11 +306,39 @@ namespace litecore { namespace REST {
                                  C4Database *db,
                                  fleece::JSONEncoder& json,
                                  C4Error *outError) noexcept
+    {
+        try {
+            C4Database::Transaction t(db);
+            DocEdit edit;
+            if (!prepareEdit(body, move(docID), revIDQuery, deleting, newEdits,
+                             db->getFleeceSharedKeys(), edit)
+                    || !saveEdit(edit, newEdits, db, json)) {
+                *outError = edit.error;
+                return false;
+            }
+            t.commit();
+            return true;
+        } catch (...) {
+            *outError = C4Error::fromCurrentException();
+            return false;
+        }
+    }
+
+
+    // Validates a document update and encodes its body as Fleece using the given SharedKeys.
+    // Doesn't access the database, so it can be called without holding its lock.
+    bool RESTListener::prepareEdit(Dict body,
+                                   string docID,
+                                   const string &revIDQuery,
+                                   bool deleting,
+                                   bool newEdits,
+                                   FLSharedKeys sk,
+                                   DocEdit &edit) noexcept
     {
         try {
             if (!deleting && !body) {
                 c4error_return(WebSocketDomain, (int)HTTPStatus::BadRequest,
-                               C4STR("body must be a JSON object"), outError);
+                               C4STR("body must be a JSON object"), &edit.error);
                 return false;
             }
 
@@ -252,7 +349,7 @@ namespace litecore { namespace REST {
                     revID = slice(revIDQuery);
                 } else if (revID != slice(revIDQuery)) {
                     c4error_return(WebSocketDomain, (int)HTTPStatus::BadRequest,
-                                   C4STR("\"_rev\" conflicts with ?rev"), outError);
+                                   C4STR("\"_rev\" conflicts with ?rev"), &edit.error);
                     return false;
                 }
             }
@@ -262,7 +359,7 @@ namespace litecore { namespace REST {
                 if (docID.empty() && revID) {
                     // Can't specify revID on a POST
                     c4error_return(WebSocketDomain, (int)HTTPStatus::BadRequest,
-                                   C4STR("Missing \"_id\""), outError);
+                                   C4STR("Missing \"_id\""), &edit.error);
                     return false;
                 }
             }
@@ -270,41 +367,51 @@ namespace litecore { namespace REST {
             if (!newEdits && (!revID || docID.empty())) {
                 c4error_return(WebSocketDomain, (int)HTTPStatus::BadRequest,
                     C4STR("Both \"_id\" and \"_rev\" must be given when \"new_edits\" is false"),
-                    outError);
+                    &edit.error);
                 return false;
             }
 
             if (body["_deleted"_sl].asBool())
                 deleting = true;
 
-            Retained<C4Document> doc;
-            {
-                C4Database::Transaction t(db);
-
-                // Encode body as Fleece (and strip _id and _rev):
-                alloc_slice encodedBody;
-                if (body)
-                    encodedBody = doc->encodeStrippingOldMetaProperties(body, db->getFleeceSharedKeys());
-
-                // Save the revision:
-                C4Slice history[1] = {revID};
-                C4DocPutRequest put = {};
-                put.allocedBody = {(void*)encodedBody.buf, encodedBody.size};
-                if (!docID.empty())
-                    put.docID = slice(docID);
-                put.revFlags = (deleting ? kRevDeleted : 0);
-                put.existingRevision = !newEdits;
-                put.allowConflict = false;
-                put.history = history;
-                put.historyCount = revID ? 1 : 0;
-                put.save = true;
-
-                doc = db->putDocument(put, nullptr, outError);
-                if (!doc)
-                    return false;
-                t.commit();
-            }
-            revID = slice(doc->selectedRev().revID);
+            // Encode body as Fleece (and strip _id and _rev):
+            if (body)
+                edit.body = C4Document::encodeStrippingOldMetaProperties(body, sk);
+            edit.docID = move(docID);
+            edit.revID = revID;
+            edit.deleting = deleting;
+            return true;
+        } catch (...) {
+            edit.error = C4Error::fromCurrentException();
+            return false;
+        }
+    }
+
+
+    // Saves a prepared document update and writes its result to `json`.
+    // Must be called in a transaction, with the edit's body encoded with the database's keys.
+    bool RESTListener::saveEdit(DocEdit &edit,
+                                bool newEdits,
+                                C4Database *db,
+                                fleece::JSONEncoder& json) noexcept
+    {
+        try {
+            // Save the revision:
+            C4Slice history[1] = {edit.revID};
+            C4DocPutRequest put = {};
+            put.allocedBody = {(void*)edit.body.buf, edit.body.size};
+            if (!edit.docID.empty())
+                put.docID = slice(edit.docID);
+            put.revFlags = (edit.deleting ? kRevDeleted : 0);
+            put.existingRevision = !newEdits;
+            put.allowConflict = false;
+            put.history = history;
+            put.historyCount = edit.revID ? 1 : 0;
+            put.save = true;
+
+            Retained<C4Document> doc = db->putDocument(put, nullptr, &edit.error);
+            if (!doc)
+                return false;
 
             json.writeKey("ok"_sl);
             json.writeBool(true);
@@ -314,7 +421,7 @@ namespace litecore { namespace REST {
             json.writeString(doc->selectedRev().revID);
             return true;
         } catch (...) {
-            *outError = C4Error::fromCurrentException();
+            edit.error = C4Error::fromCurrentException();
             return false;
         }
     }
@@ -347,7 +454,33 @@ namespace litecore { namespace REST {
     }
 
 
-    void RESTListener::handleBulkDocs(RequestResponse &rq, C4Database *db) {
+    // Adds the keys that were added to `tempKeys` (a copy of the database's SharedKeys made when
+    // it had `initialCount` keys) to the database's SharedKeys, so that they have the same
+    // numbers, and data encoded with `tempKeys` can be stored as-is. Returns false if that isn't
+    // possible because the database's keys have changed in the meantime.
+    // Must be called in a transaction.
+    static bool adoptSharedKeys(C4Database *db, FLSharedKeys tempKeys, unsigned initialCount) {
+        FLSharedKeys dbKeys = db->getFleeceSharedKeys();
+        if (FLSharedKeys_Count(dbKeys) != initialCount)
+            return false;
+        unsigned count = FLSharedKeys_Count(tempKeys);
+        for (unsigned key = initialCount; key < count; ++key) {
+            slice str = FLSharedKeys_Decode(tempKeys, int(key));
+            if (FLSharedKeys_Encode(dbKeys, str, true) != int(key))
+                return false;
+        }
+        return true;
+    }
+
+
+    // Unlike other database handlers, this one isn't registered with addDBHandler, because it
+    // parses and encodes the documents (in parallel) before locking the database. Then only
+    // the saving happens while it's locked, in a single transaction.
+    void RESTListener::handleBulkDocs(RequestResponse &rq) {
+        Retained<C4Database> db = databaseFor(rq);
+        if (!db)
+            return;
+
         Dict body = rq.bodyAsJSON().asDict();
         Array docs = body["docs"].asArray();
         if (!docs)
@@ -357,21 +490,49 @@ namespace litecore { namespace REST {
         Value v = body["new_edits"];
         bool newEdits = v ? v.asBool() : true;
 
-        C4Database::Transaction t(db);
+        // Encode the docs against a copy of the database's SharedKeys, like DBAccess does for
+        // incoming revisions, since the real ones can only be updated in a transaction:
+        SharedKeys tempKeys;
+        unsigned initialKeyCount = 0;
+        withDatabaseLocked(db, [&] {
+            SharedKeys dbKeys = db->getFleeceSharedKeys();
+            tempKeys = SharedKeys::create(dbKeys.stateData());
+            initialKeyCount = dbKeys.count();
+        });
+
+        vector<DocEdit> edits(docs.count());
+        _server->forEachInParallel(edits.size(), [&](size_t i) {
+            prepareEdit(docs[uint32_t(i)].asDict(), "", "", false, newEdits, tempKeys, edits[i]);
+        });
+
+        withDatabaseLocked(db, [&] {
+            C4Database::Transaction t(db);
+
+            if (!adoptSharedKeys(db, tempKeys, initialKeyCount)) {
+                // Another writer added keys meanwhile, so the bodies have to be re-encoded:
+                SharedEncoder enc(db->sharedFleeceEncoder());
+                for (auto &edit : edits) {
+                    if (edit.body) {
+                        Doc doc(edit.body, kFLTrusted, tempKeys);
+                        enc.writeValue(doc.root());
+                        edit.body = enc.finish();
+                        enc.reset();
+                    }
+                }
+            }
 
-        auto &json = rq.jsonEncoder();
-        json.beginArray();
-        for (Array::iterator i(docs); i; ++i) {
-            json.beginDict();
-            Dict doc = i.value().asDict();
-            C4Error error;
-            if (!modifyDoc(doc, "", "", false, newEdits, db, json, &error))
-                rq.writeErrorJSON(error);
-            json.endDict();
-        }
-        json.endArray();
+            auto &json = rq.jsonEncoder();
+            json.beginArray();
+            for (auto &edit : edits) {
+                json.beginDict();
+                if (edit.error.code != 0 || !saveEdit(edit, newEdits, db, json))
+                    rq.writeErrorJSON(edit.error);
+                json.endDict();
+            }
+            json.endArray();
 
-        t.commit();
+            t.commit();
+        });
     }
 
 } }
@@ -85,8 +85,8 @@ namespace litecore { namespace REST {
             addDBHandler(Method::POST,  "/[^_][^/]*|/[^_][^/]*/",    &RESTListener::handleModifyDoc);
 
             // Database-level special handlers:
-            addDBHandler(Method::GET,   "/[^_][^/]*/_all_docs",  &RESTListener::handleGetAllDocs);
-            addDBHandler(Method::POST,  "/[^_][^/]*/_bulk_docs", &RESTListener::handleBulkDocs);
+            addHandler  (Method::GET,   "/[^_][^/]*/_all_docs",  &RESTListener::handleGetAllDocs);
+            addHandler  (Method::POST,  "/[^_][^/]*/_bulk_docs", &RESTListener::handleBulkDocs);
 
             // Document:
             addDBHandler(Method::GET,   "/[^_][^/]*/[^_].*",      &RESTListener::handleGetDoc);
@@ -292,19 +292,23 @@ namespace litecore { namespace REST {
     void RESTListener::addDBHandler(Method method, const char *uri, DBHandlerMethod handler) {
         _server->addHandler(method, uri, [this,handler](RequestResponse &rq) {
             Retained<C4Database> db = databaseFor(rq);
-            if (db) {
-                db->lockClientMutex();
-                try {
-                    (this->*handler)(rq, db);
-                } catch (...) {
-                    db->unlockClientMutex();
-                    throw;
-                }
-                db->unlockClientMutex();
-            }
+            if (db)
+                withDatabaseLocked(db, [&] {(this->*handler)(rq, db);});
         });
     }
 
+
+    void RESTListener::withDatabaseLocked(C4Database *db, function_ref<void()> fn) {
+        db->lockClientMutex();
+        try {
+            fn();
+        } catch (...) {
+            db->unlockClientMutex();
+            throw;
+        }
+        db->unlockClientMutex();
+    }
+
     
     Retained<C4Database> RESTListener::databaseFor(RequestResponse &rq) {
         string dbName = rq.path(0);
@@ -102,6 +102,9 @@ namespace litecore { namespace REST {
 
         void addHandler(net::Method, const char *uri, HandlerMethod);
         void addDBHandler(net::Method, const char *uri, DBHandlerMethod);
+
+        /** Calls `fn` while holding the database's client mutex, as DB handlers are called. */
+        static void withDatabaseLocked(C4Database*, fleece::function_ref<void()> fn);
         
         std::vector<net::Address> _addresses(C4Database *dbOrNull =nullptr,
                                             C4ListenerAPIs api = kC4RESTAPI) const;
@@ -121,10 +124,19 @@ namespace litecore { namespace REST {
         void handleCreateDatabase(RequestResponse&);
         void handleDeleteDatabase(RequestResponse&, C4Database*);
 
-        void handleGetAllDocs(RequestResponse&, C4Database*);
+        void handleGetAllDocs(RequestResponse&);
         void handleGetDoc(RequestResponse&, C4Database*);
         void handleModifyDoc(RequestResponse&, C4Database*);
-        void handleBulkDocs(RequestResponse&, C4Database*);
+        void handleBulkDocs(RequestResponse&);
+
+        /** A document update from a request, validated and encoded, ready to be saved. */
+        struct DocEdit {
+            std::string docID;
+            fleece::alloc_slice revID;
+            fleece::alloc_slice body;       // Fleece-encoded, without _id, _rev, etc.
+            bool deleting {false};
+            C4Error error {};               // Set if the update is invalid
+        };
 
         bool modifyDoc(fleece::Dict body,
                        std::string docID,
@@ -135,6 +147,19 @@ namespace litecore { namespace REST {
                        fleece::JSONEncoder& json,
                        C4Error *outError) noexcept;
 
+        bool prepareEdit(fleece::Dict body,
+                         std::string docID,
+                         const std::string &revIDQuery,
+                         bool deleting,
+                         bool newEdits,
+                         FLSharedKeys,
+                         DocEdit &edit) noexcept;
+
+        bool saveEdit(DocEdit &edit,
+                      bool newEdits,
+                      C4Database *db,
+                      fleece::JSONEncoder& json) noexcept;
+
         std::unique_ptr<FilePath> _directory;
         const bool _allowCreateDB, _allowDeleteDB;
         Retained<crypto::Identity> _identity;
@@ -73,6 +73,15 @@ namespace litecore { namespace REST {
         if (!HTTPLogic::parseHeaders(in, _headers))
             return false;
 
+        // HTTP/1.1 connections are persistent by default; HTTP/1.0 ones only on request.
+        // <https://tools.ietf.org/html/rfc7230#section-6.3>
+        slice connection = header("Connection");
+        _http10 = (version == "HTTP/1.0"_sl);
+        if (_http10)
+            _keepAlive = connection.caseEquivalent("keep-alive"_sl);
+        else
+            _keepAlive = !connection.caseEquivalent("close"_sl);
+
         _method = method;
         return true;
     }
@@ -129,14 +138,29 @@ namespace litecore { namespace REST {
     {
         auto request = _socket->readToDelimiter("\r\n\r\n"_sl);
         if (!request) {
-            handleSocketError();
+            if (_socket->atReadEOF())
+                LogVerbose(kC4Cpp_DefaultLog, "Client closed connection");    // Normal end of a keep-alive connection
+            else
+                handleSocketError();
             return;
         }
         if (!readFromHTTP(request))
             return;
-        if (_method == Method::POST || _method == Method::PUT) {
-            if (!_socket->readHTTPBody(_headers, _body)) {
+        // Other methods' bodies are read too if they're declared, so they aren't mistaken for
+        // the next request on a keep-alive connection:
+        if (_method == Method::POST || _method == Method::PUT
+                || header("Content-Length") || header("Transfer-Encoding")) {
+            if (!_socket->readHTTPBody(_headers, _body, kMaxRequestBodySize)) {
                 handleSocketError();
+                C4Error err = _socket->error();
+                if (err.domain == WebSocketDomain && (err.code == 400 || err.code == 413)) {
+                    // Malformed or oversized body: tell the client, then close the connection,
+                    // since the rest of the body is still unread:
+                    respondWithStatus(HTTPStatus(err.code));
+                    _keepAlive = false;
+                    finish();
+                }
+                _method = Method::None;     // so the request isn't dispatched
                 return;
             }
         }
@@ -160,7 +184,7 @@ namespace litecore { namespace REST {
             if (defaultMessage)
                 _statusMessage = defaultMessage;
         }
-        string statusLine = format("HTTP/1.0 %d %s\r\n", static_cast<int>(_status), _statusMessage.c_str());
+        string statusLine = format("HTTP/1.1 %d %s\r\n", static_cast<int>(_status), _statusMessage.c_str());
         _responseHeaderWriter.write(statusLine);
         _sentStatus = true;
 
@@ -201,6 +225,22 @@ namespace litecore { namespace REST {
 
 
     void RequestResponse::respondWithStatus(HTTPStatus status, const char *message) {
+        if (_chunked) {
+            if (_endedHeaders) {
+                // Part of the response has already gone out, so it's too late to report an
+                // error; abort it so the client doesn't mistake it for a complete response:
+                Warn("Aborting streamed response after error: %d %s",
+                     int(status), (message ? message : ""));
+                _keepAlive = false;
+                _finished = true;
+                return;
+            }
+            // Nothing's been sent yet, so start over with a regular response:
+            _chunked = false;
+            _sentStatus = _sentConnection = false;
+            _responseHeaderWriter.reset();
+            _responseWriter.reset();
+        }
         setStatus(status, message);
         uncacheable();
 
@@ -274,6 +314,8 @@ namespace litecore { namespace REST {
     void RequestResponse::setHeader(const char *header, const char *value) {
         sendStatus();
         Assert(!_endedHeaders);
+        if (slice(header).caseEquivalent("Connection"_sl))
+            _sentConnection = true;
         _responseHeaderWriter.write(slice(header));
         _responseHeaderWriter.write(": "_sl);
         _responseHeaderWriter.write(slice(value));
@@ -290,6 +332,7 @@ namespace litecore { namespace REST {
     void RequestResponse::setContentLength(uint64_t length) {
         sendStatus();
         Assert(_contentLength < 0, "Content-Length has already been set");
+        Assert(!_chunked);
         Log("Content-Length: %" PRIu64, length);
         _contentLength = (int64_t)length;
         char len[20];
@@ -301,6 +344,8 @@ namespace litecore { namespace REST {
     void RequestResponse::sendHeaders() {
         if (_jsonEncoder)
             setHeader("Content-Type", "application/json");
+        if (!_sentConnection)
+            setHeader("Connection", keepAlive() ? "keep-alive" : "close");
         _responseHeaderWriter.write("\r\n"_sl);
         if (_socket->write_n(_responseHeaderWriter.finish()) < 0)
             handleSocketError();
@@ -311,6 +356,10 @@ namespace litecore { namespace REST {
 #pragma mark - RESPONSE BODY:
 
 
+    // In chunked mode, written data is sent once this much has accumulated:
+    static constexpr size_t kChunkSize = 32 * 1024;
+
+
     void RequestResponse::uncacheable() {
         setHeader("Cache-Control", "no-cache, no-store, must-revalidate, private, max-age=0");
         setHeader("Pragma", "no-cache");
@@ -318,9 +367,57 @@ namespace litecore { namespace REST {
     }
 
 
+    void RequestResponse::setChunked() {
+        Assert(_contentLength < 0, "Content-Length has already been set");
+        Assert(_responseWriter.length() == 0 && !_jsonEncoder);
+        if (!_chunked) {
+            if (_http10)
+                _keepAlive = false;     // The body will end when the connection closes
+            else
+                setHeader("Transfer-Encoding", "chunked");
+            _chunked = true;
+        }
+    }
+
+
     void RequestResponse::write(slice content) {
         Assert(!_finished);
         _responseWriter.write(content);
+        if (_chunked && _responseWriter.length() >= kChunkSize)
+            flush();
+    }
+
+
+    void RequestResponse::flush() {
+        Assert(!_finished);
+        if (!_chunked)
+            return;
+        if (!_endedHeaders)
+            sendHeaders();
+        alloc_slice data = _responseWriter.finish();
+        if (data.size > 0)
+            sendChunk(data);
+    }
+
+
+    void RequestResponse::sendChunk(slice data) {
+        if (writeFailed())
+            return;
+        if (_http10) {
+            // No chunk framing; the data is sent as-is:
+            if (_socket->write_n(data) < 0)
+                handleSocketError();
+            return;
+        }
+        string header = format("%zx\r\n", data.size);
+        if (_socket->write_n(slice(header)) < 0 || _socket->write_n(data) < 0
+                                               || _socket->write_n("\r\n"_sl) < 0)
+            handleSocketError();
+    }
+
+
+    bool RequestResponse::writeFailed() const {
+        return !_socket || _socket->error().code != 0;
     }
 
 
@@ -353,6 +450,13 @@ namespace litecore { namespace REST {
             write(json);
         }
 
+        if (_chunked) {
+            flush();
+            sendChunk(nullslice);        // A zero-length chunk ends the body
+            _finished = true;
+            return;
+        }
+
         alloc_slice responseData = _responseWriter.finish();
         if (_contentLength < 0)
             setContentLength(responseData.size);
@@ -378,6 +482,7 @@ namespace litecore { namespace REST {
 
     void RequestResponse::sendWebSocketResponse(const string &protocol) {
         string nonce(header("Sec-WebSocket-Key"));
+        _keepAlive = false;         // The socket now belongs to the WebSocket
         setStatus(HTTPStatus::Upgraded, "Upgraded");
         setHeader("Connection", "Upgrade");
         setHeader("Upgrade", "websocket");
@@ -396,10 +501,17 @@ namespace litecore { namespace REST {
 
     unique_ptr<ResponderSocket> RequestResponse::extractSocket() {
         finish();
+        if (_socket && _status == HTTPStatus::Upgraded)
+            _socket->setTimeout(0);     // The WebSocket does its own I/O; undo the Server's timeout
         return move(_socket);
     }
 
 
+    bool RequestResponse::keepAlive() const {
+        return _keepAlive && _socket && _socket->error().code == 0 && !_socket->atReadEOF();
+    }
+
+
     string RequestResponse::peerAddress() {
         return _socket->peerAddress();
     }
@@ -53,6 +53,10 @@ namespace litecore { namespace REST {
         int64_t intQuery(const char *param, int64_t defaultValue =0) const;
         bool boolQuery(const char *param, bool defaultValue =false) const;
 
+        /// True if the client wants the connection kept open after the response
+        /// (the default in HTTP/1.1, unless it sent "Connection: close".)
+        bool keepAlive() const                  {return _keepAlive;}
+
     protected:
         friend class Server;
         
@@ -65,12 +69,17 @@ namespace litecore { namespace REST {
         Method _method {Method::None};
         std::string _path;
         std::string _queries;
+        bool _keepAlive {false};
+        bool _http10 {false};                   // Is the request HTTP/1.0?
     };
 
 
     /** Incoming HTTP request (inherited from Request), plus setters for the response. */
     class RequestResponse : public Request {
     public:
+        /// The largest request body the server will read; larger ones get a 413 response.
+        static constexpr size_t kMaxRequestBodySize = 64 * 1024 * 1024;
+
         // Response status:
 
         void respondWithStatus(HTTPStatus, const char *message =nullptr);
@@ -97,6 +106,20 @@ namespace litecore { namespace REST {
         void setContentLength(uint64_t length);
         void uncacheable();
 
+        /// Sends the body with chunked transfer encoding, so it's streamed to the client as it's
+        /// written instead of being buffered until \ref finish. Must be called before any body
+        /// is written; headers can't be set after the first chunk is sent.
+        /// HTTP/1.0 doesn't support chunked encoding, so for an HTTP/1.0 request the body is
+        /// streamed as-is, and its end is marked by closing the connection.
+        void setChunked();
+
+        /// In chunked mode, sends whatever has been written so far. (Happens automatically
+        /// whenever enough data has been written.)
+        void flush();
+
+        /// True if writing the response to the socket has failed, i.e. the client is gone.
+        bool writeFailed() const;
+
         void write(fleece::slice);
         void write(const char *content)                     {write(fleece::slice(content));}
         void printf(const char *format, ...) __printflike(2, 3);
@@ -119,12 +142,16 @@ namespace litecore { namespace REST {
 
         std::unique_ptr<net::ResponderSocket> extractSocket();
 
+        /// True if the connection can be reused for another request after this one finishes.
+        bool keepAlive() const;
+
         std::string peerAddress();
 
     protected:
         RequestResponse(Server *server, std::unique_ptr<net::ResponderSocket>);
         void sendStatus();
         void sendHeaders();
+        void sendChunk(fleece::slice);
         void handleSocketError();
 
     private:
@@ -142,7 +169,9 @@ namespace litecore { namespace REST {
 
         fleece::Writer _responseHeaderWriter;
         bool _endedHeaders {false};                 // True after headers are ended
+        bool _sentConnection {false};               // Set a 'Connection:' header yet?
         int64_t _contentLength {-1};                // Content-Length, once it's set
+        bool _chunked {false};                      // Using chunked transfer encoding?
 
         fleece::Writer _responseWriter;             // Output stream for response body
         std::unique_ptr<fleece::JSONEncoder> _jsonEncoder;  // Used for writing JSON to response
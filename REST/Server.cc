@@ -28,6 +28,9 @@
 #include "c4ExceptionUtils.hh"
 #include "c4ListenerInternal.hh"
 #include "PlatformCompat.hh"
+#include "ThreadUtil.hh"
+#include <algorithm>
+#include <condition_variable>
 #include <mutex>
 
 // TODO: Remove these pragmas when doc-comments in sockpp are fixed
@@ -44,6 +47,23 @@ namespace litecore { namespace REST {
     using namespace litecore::net;
     using namespace sockpp;
 
+
+    // Minimum number of threads that handle requests:
+    static constexpr unsigned kMinWorkerThreads = 4;
+
+    // Timeout for socket I/O while reading a request body or writing a response. (The request
+    // headers are read by the Poller, without blocking a worker.)
+    static constexpr double kRequestIOTimeoutSecs = 30.0;
+
+    // Timeout for socket I/O during the TLS handshake, which blocks a worker:
+    static constexpr double kTLSHandshakeTimeoutSecs = 10.0;
+
+    // How long a connection may wait for a complete request before it's closed:
+    static constexpr auto kKeepAliveTimeout = std::chrono::seconds(30);
+
+    // Maximum number of connections waiting for a request; beyond that they're closed:
+    static constexpr size_t kMaxIdleSockets = 256;
+
     static bool isAnyAddress(const sock_address_any& addr) {
         if(addr.family() == AF_INET) {
             return ((const inet_address&)addr).address() == 0;
@@ -62,6 +82,7 @@ namespace litecore { namespace REST {
     }
 
     Server::Server()
+    :_idleTimer([this] {closeIdleSockets(false);})
     {
         if (!ListenerLog)
             ListenerLog = c4log_getDomain("Listener", true);
@@ -138,6 +159,7 @@ namespace litecore { namespace REST {
             error::_throw(error::POSIX, _acceptor->last_error());
         _acceptor->set_non_blocking();
         c4log(ListenerLog, kC4LogInfo,"Server listening on port %d", this->port());
+        startWorkers();
         awaitConnection();
     }
 
@@ -155,6 +177,95 @@ namespace litecore { namespace REST {
         _acceptor->close();
         _acceptor.reset();
         _rules.clear();
+        if (_workQueue)
+            _workQueue->close();      // Workers will exit after finishing their current tasks
+        closeIdleSockets(true);
+    }
+
+
+    void Server::startWorkers() {
+        // The threads only reference the queue, not the Server, so they can outlive it; each
+        // task retains the Server while it runs.
+        _workQueue = make_shared<actor::Channel<Task>>();
+        _workerCount = max(kMinWorkerThreads, thread::hardware_concurrency());
+        for (unsigned i = 0; i < _workerCount; ++i) {
+            thread([queue = _workQueue] {
+                SetThreadName("CBL REST worker");
+                while (Task task = queue->pop()) {
+                    try {
+                        task();
+                    } catch (const std::exception &x) {
+                        c4log(ListenerLog, kC4LogWarning,
+                              "Caught C++ exception handling connection: %s", x.what());
+                    }
+                }
+            }).detach();
+        }
+    }
+
+
+    void Server::enqueue(Task task) {
+        _workQueue->push(move(task));
+    }
+
+
+    void Server::forEachInParallel(size_t count, function_ref<void(size_t)> fn) {
+        static constexpr size_t kMinPerThread = 16;
+        size_t nHelpers = 0;
+        if (_workQueue)
+            nHelpers = min(size_t(_workerCount), count / kMinPerThread);
+        if (nHelpers <= 1) {
+            for (size_t i = 0; i < count; ++i)
+                fn(i);
+            return;
+        }
+
+        // Items are claimed by index, so a helper task that starts late (even after this method
+        // has returned) finds nothing left to claim and never calls `fn`. The state is shared so
+        // that such a task doesn't touch this stack frame.
+        struct State {
+            size_t const count;
+            function_ref<void(size_t)> const fn;
+            atomic<size_t> next {0};
+            mutex mut;
+            condition_variable cond;
+            unsigned active {0};
+            exception_ptr error;
+
+            State(size_t c, function_ref<void(size_t)> f) :count(c), fn(f) { }
+
+            void run() {
+                try {
+                    for (size_t i; (i = next++) < count; )
+                        fn(i);
+                } catch (...) {
+                    next = count;
+                    lock_guard<mutex> lock(mut);
+                    if (!error)
+                        error = current_exception();
+                }
+            }
+        };
+        auto state = make_shared<State>(count, fn);
+
+        for (size_t h = 1; h < nHelpers; ++h) {
+            enqueue([state] {
+                {
+                    lock_guard<mutex> lock(state->mut);
+                    ++state->active;
+                }
+                state->run();
+                lock_guard<mutex> lock(state->mut);
+                if (--state->active == 0)
+                    state->cond.notify_all();
+            });
+        }
+        state->run();
+
+        unique_lock<mutex> lock(state->mut);
+        state->cond.wait(lock, [&] {return state->active == 0;});
+        if (state->error)
+            rethrow_exception(state->error);
     }
 
 
@@ -186,12 +297,18 @@ namespace litecore { namespace REST {
             }
             if (sock) {
                 sock.set_non_blocking(false);
-                // We are in the poller thread and go handle the client connection in a new thead to avoid
-                // blocking the polling thread.
-                thread handleThread([selfRetain = Retained<Server>{this}, sock = move(sock), this]() mutable {
-                    this->handleConnection(move(sock));
-                });
-                handleThread.detach();
+                auto responder = make_unique<ResponderSocket>(_tlsContext);
+                if (!responder->acceptSocket(move(sock))) {
+                    c4log(ListenerLog, kC4LogError, "Error accepting incoming connection: %s",
+                          responder->error().description().c_str());
+                } else if (_tlsContext) {
+                    // The handshake blocks, so it's done on a worker, but not until the client
+                    // has sent something:
+                    parkSocket(move(responder), true);
+                } else {
+                    connectionOpened(*responder);
+                    awaitRequest(move(responder));
+                }
             }
         } catch (const std::exception &x) {
             c4log(ListenerLog, kC4LogWarning, "Caught C++ exception accepting connection: %s", x.what());
@@ -201,27 +318,176 @@ namespace litecore { namespace REST {
     }
 
 
-    void Server::handleConnection(sockpp::stream_socket &&sock) {
-        auto responder = make_unique<ResponderSocket>(_tlsContext);
-        if (!responder->acceptSocket(move(sock)) || (_tlsContext && !responder->wrapTLS())) {
+    // Performs the TLS handshake on a new connection. Runs on a worker thread.
+    void Server::handshakeTLS(unique_ptr<ResponderSocket> responder) {
+        responder->setTimeout(kTLSHandshakeTimeoutSecs);
+        if (!responder->wrapTLS()) {
             c4log(ListenerLog, kC4LogError, "Error accepting incoming connection: %s",
                   responder->error().description().c_str());
             return;
         }
+        connectionOpened(*responder);
+        awaitRequest(move(responder));
+    }
+
+
+    void Server::connectionOpened(ResponderSocket &responder) {
         if (c4log_willLog(ListenerLog, kC4LogVerbose)) {
-            auto cert = responder->peerTLSCertificate();
+            auto cert = responder.peerTLSCertificate();
             if (cert)
                 c4log(ListenerLog, kC4LogVerbose, "Accepted connection from %s with TLS cert %s",
-                      responder->peerAddress().c_str(), cert->subjectPublicKey()->digestString().c_str());
+                      responder.peerAddress().c_str(), cert->subjectPublicKey()->digestString().c_str());
             else
                 c4log(ListenerLog, kC4LogVerbose, "Accepted connection from %s",
-                      responder->peerAddress().c_str());
+                      responder.peerAddress().c_str());
+        }
+
+        ++_connectionCount;
+        responder.onClose([selfRetain = Retained<Server>{this}] {
+            --selfRetain->_connectionCount;
+        });
+    }
+
+
+    // Reads whatever part of the next request the client has sent, without blocking, and tells
+    // whether the request headers are complete. (The body, if any, is read by the worker.)
+    Server::HeaderState Server::readRequestHeaders(ResponderSocket &socket) {
+        if (!socket.setNonBlocking(true) || !socket.bufferAvailableInput())
+            return HeaderState::Closed;
+        if (socket.bufferedInputContains("\r\n\r\n"_sl)
+                || socket.bufferedInputSize() >= TCPSocket::kMaxDelimitedReadSize) {
+            // (Oversized headers are left for RequestResponse to reject.)
+            return socket.setNonBlocking(false) ? HeaderState::Complete : HeaderState::Closed;
+        }
+        if (socket.atReadEOF()) {
+            if (socket.hasBufferedInput())
+                c4log(ListenerLog, kC4LogVerbose, "Client closed connection mid-request");
+            return HeaderState::Closed;
+        }
+        return HeaderState::Incomplete;
+    }
+
+
+    // Reads one request from the socket and dispatches it. Then, if the connection is to be kept
+    // alive, waits for the next request. Runs on a worker thread.
+    void Server::handleRequest(unique_ptr<ResponderSocket> socket) {
+        socket->setTimeout(kRequestIOTimeoutSecs);
+        RequestResponse rq(this, move(socket));
+        if (!rq.isValid())
+            return;         // (Bad request, or the client closed the connection)
+        dispatchRequest(&rq);
+        rq.finish();
+        if (rq.keepAlive()) {
+            if (auto sock = rq.extractSocket(); sock)
+                awaitRequest(move(sock));
+        }
+    }
+
+
+    // Hands the socket to a worker once a complete request has arrived. Until then it's parked,
+    // and the Poller reads the request headers as they arrive.
+    void Server::awaitRequest(unique_ptr<ResponderSocket> socket) {
+        switch (readRequestHeaders(*socket)) {
+            case HeaderState::Complete: {
+                auto sockp = make_shared<unique_ptr<ResponderSocket>>(move(socket));
+                enqueue([selfRetain = Retained<Server>{this}, sockp, this] {
+                    handleRequest(move(*sockp));
+                });
+                break;
+            }
+            case HeaderState::Incomplete:
+                parkSocket(move(socket), false);
+                break;
+            case HeaderState::Closed:
+                break;
         }
-        RequestResponse rq(this, move(responder));
-        if (rq.isValid()) {
-            dispatchRequest(&rq);
-            rq.finish();
+    }
+
+
+    // Keeps a socket until the Poller says it's readable, or it times out.
+    void Server::parkSocket(unique_ptr<ResponderSocket> socket, bool needsHandshake) {
+        lock_guard<mutex> lock(_idleMutex);
+        if (!_workQueue || _idleSockets.size() >= kMaxIdleSockets) {
+            c4log(ListenerLog, kC4LogVerbose, "Too many idle connections; closing this one");
+            return;
         }
+        uint64_t id = ++_nextIdleID;
+        ResponderSocket *sock = socket.get();
+        _idleSockets.emplace(id, IdleSocket{move(socket), clock::now(), needsHandshake});
+        if (_idleSockets.size() == 1)
+            _idleTimer.fireAfter(kKeepAliveTimeout);
+        sock->onReadable([selfRetain = Retained<Server>{this}, id] {
+            selfRetain->resumeIdleSocket(id);
+        });
+    }
+
+
+    // Called on the Poller thread when a parked socket becomes readable (or is closed.)
+    void Server::resumeIdleSocket(uint64_t id) {
+        unique_ptr<ResponderSocket> socket;
+        bool needsHandshake;
+        {
+            lock_guard<mutex> lock(_idleMutex);
+            auto i = _idleSockets.find(id);
+            if (i == _idleSockets.end())
+                return;         // It timed out, or the server stopped
+            IdleSocket &idle = i->second;
+            needsHandshake = idle.needsHandshake;
+            if (!needsHandshake) {
+                HeaderState state = readRequestHeaders(*idle.socket);
+                if (state == HeaderState::Incomplete) {
+                    // Keep waiting for the rest of the headers, but only till the idle timeout,
+                    // which still counts from when the socket was parked:
+                    idle.socket->onReadable([selfRetain = Retained<Server>{this}, id] {
+                        selfRetain->resumeIdleSocket(id);
+                    });
+                    return;
+                }
+                if (state == HeaderState::Closed) {
+                    socket = move(idle.socket);     // (closes after the mutex is unlocked)
+                    _idleSockets.erase(i);
+                    return;
+                }
+            }
+            socket = move(idle.socket);
+            _idleSockets.erase(i);
+        }
+        auto sockp = make_shared<unique_ptr<ResponderSocket>>(move(socket));
+        if (needsHandshake) {
+            enqueue([selfRetain = Retained<Server>{this}, sockp, this] {
+                handshakeTLS(move(*sockp));
+            });
+        } else {
+            enqueue([selfRetain = Retained<Server>{this}, sockp, this] {
+                handleRequest(move(*sockp));
+            });
+        }
+    }
+
+
+    // Closes idle keep-alive sockets: all of them, or just the ones that have timed out.
+    void Server::closeIdleSockets(bool all) {
+        vector<unique_ptr<ResponderSocket>> closing;
+        {
+            lock_guard<mutex> lock(_idleMutex);
+            auto now = clock::now();
+            for (auto i = _idleSockets.begin(); i != _idleSockets.end();) {
+                if (all || now - i->second.since >= kKeepAliveTimeout) {
+                    i->second.socket->cancelCallbacks();
+                    closing.push_back(move(i->second.socket));
+                    i = _idleSockets.erase(i);
+                } else {
+                    ++i;
+                }
+            }
+            if (!all && !_idleSockets.empty())
+                _idleTimer.fireAfter(kKeepAliveTimeout / 2);
+        }
+        if (all)
+            _idleTimer.stop();      // (not under the lock, since it may wait for the callback)
+        if (!closing.empty())
+            c4log(ListenerLog, kC4LogVerbose, "Closed %zu idle connections", closing.size());
+        // The sockets close as `closing` goes out of scope.
     }
 
 
@@ -269,23 +535,29 @@ namespace litecore { namespace REST {
             }
         }
 
-        lock_guard<mutex> lock(_mutex);
-
-        ++_connectionCount;
-        Retained<Server> retainedSelf = this;
-        rq->onClose([=] { --retainedSelf->_connectionCount; });
-
         try {
+            // Look up the handler, but don't hold the mutex while it runs, so requests on other
+            // connections can be handled concurrently:
             string pathStr(rq->path());
-            auto rule = findRule(method, pathStr);
-            if (rule) {
-                c4log(ListenerLog, kC4LogInfo, "Matched rule %s for path %s", rule->pattern.c_str(), pathStr.c_str());
-                rule->handler(*rq);
-            } else if (nullptr == (rule = findRule(Methods::ALL, pathStr))) {
-                c4log(ListenerLog, kC4LogInfo, "No rule matched path %s", pathStr.c_str());
+            Handler handler;
+            bool pathMatched = false;
+            {
+                lock_guard<mutex> lock(_mutex);
+                if (auto rule = findRule(method, pathStr); rule) {
+                    c4log(ListenerLog, kC4LogInfo, "Matched rule %s for path %s", rule->pattern.c_str(), pathStr.c_str());
+                    handler = rule->handler;
+                } else if (nullptr == (rule = findRule(Methods::ALL, pathStr))) {
+                    c4log(ListenerLog, kC4LogInfo, "No rule matched path %s", pathStr.c_str());
+                } else {
+                    c4log(ListenerLog, kC4LogInfo, "Wrong method for rule %s for path %s", rule->pattern.c_str(), pathStr.c_str());
+                    pathMatched = true;
+                }
+            }
+            if (handler) {
+                handler(*rq);
+            } else if (!pathMatched) {
                 rq->respondWithStatus(HTTPStatus::NotFound, "Not found");
             } else {
-                c4log(ListenerLog, kC4LogInfo, "Wrong method for rule %s for path %s", rule->pattern.c_str(), pathStr.c_str());
                 if (method == Method::UPGRADE)
                     rq->respondWithStatus(HTTPStatus::Forbidden, "No upgrade available");
                 else
@@ -20,31 +20,40 @@
 #include "RefCounted.hh"
 #include "InstanceCounted.hh"
 #include "Request.hh"
+#include "Channel.hh"
+#include "Timer.hh"
+#include "function_ref.hh"
 #include "c4Base.h"
 #include <atomic>
+#include <chrono>
 #include <map>
 #include <mutex>
 #include <functional>
 #include <memory>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 #include <regex>
 
 namespace sockpp {
     class acceptor;
     class inet_address;
-    class stream_socket;
 }
 namespace litecore::crypto {
     struct Identity;
 }
 namespace litecore::net {
+    class ResponderSocket;
     class TLSContext;
 }
 
 namespace litecore { namespace REST {
 
-    /** HTTP server with configurable URI handlers. */
+    /** HTTP server with configurable URI handlers.
+        Requests are handled by a fixed pool of worker threads. Connections are kept alive
+        between requests (HTTP/1.1 persistent connections.) The Poller reads each request's
+        headers as they arrive, so a connection only ties up a worker once it has sent a
+        complete request; one that takes too long to do so is closed. */
     class Server final : public fleece::RefCounted, public fleece::InstanceCountedIn<Server> {
     public:
         Server();
@@ -82,6 +91,12 @@ namespace litecore { namespace REST {
 
         int connectionCount()                           {return _connectionCount;}
 
+        /** Calls `fn` on the numbers [0..count), spread across idle worker threads. The calling
+            thread takes part too, and does whatever the workers don't get to, so it's safe to
+            call from a handler even when every worker is busy. Returns when all calls are done;
+            if any call throws, the exception is rethrown here. */
+        void forEachInParallel(size_t count, fleece::function_ref<void(size_t)> fn);
+
     protected:
         struct URIRule {
             net::Methods methods;
@@ -96,9 +111,30 @@ namespace litecore { namespace REST {
         void dispatchRequest(RequestResponse*);
 
     private:
+        using clock = std::chrono::steady_clock;
+        using Task = std::function<void()>;
+
+        // A connection waiting for (the rest of) its next request:
+        struct IdleSocket {
+            std::unique_ptr<net::ResponderSocket> socket;
+            clock::time_point since;
+            bool needsHandshake;        // New TLS connection, waiting for the client's hello
+        };
+
+        enum class HeaderState {Incomplete, Complete, Closed};
+
+        void startWorkers();
+        void enqueue(Task);
         void awaitConnection();
         void acceptConnection();
-        void handleConnection(sockpp::stream_socket&&);
+        void handshakeTLS(std::unique_ptr<net::ResponderSocket>);
+        void connectionOpened(net::ResponderSocket&);
+        static HeaderState readRequestHeaders(net::ResponderSocket&);
+        void handleRequest(std::unique_ptr<net::ResponderSocket>);
+        void awaitRequest(std::unique_ptr<net::ResponderSocket>);
+        void parkSocket(std::unique_ptr<net::ResponderSocket>, bool needsHandshake);
+        void resumeIdleSocket(uint64_t id);
+        void closeIdleSockets(bool all);
 
         fleece::Retained<crypto::Identity> _identity;
         fleece::Retained<net::TLSContext> _tlsContext;
@@ -109,6 +145,13 @@ namespace litecore { namespace REST {
         uint16_t _port;
         std::atomic<int> _connectionCount {0};
         Authenticator _authenticator;
+        std::shared_ptr<actor::Channel<Task>> _workQueue;   // Feeds the worker threads
+        unsigned _workerCount {0};
+
+        std::mutex _idleMutex;
+        std::unordered_map<uint64_t, IdleSocket> _idleSockets; // Keep-alive sockets, by ID
+        uint64_t _nextIdleID {0};
+        actor::Timer _idleTimer;                            // Closes timed-out idle sockets
     };
 
 } }
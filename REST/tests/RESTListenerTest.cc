@@ -25,7 +25,13 @@
 #include "NetworkInterfaces.hh"
 #include "fleece/Mutable.hh"
 #include "ReplicatorAPITest.hh"
+#include "StringUtil.hh"
+#include "TCPSocket.hh"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <optional>
+#include <thread>
 
 using namespace litecore;
 using namespace litecore::net;
@@ -174,6 +180,41 @@ public:
         return false;
     }
 
+    // Opens a persistent connection to the listener, for sending multiple raw HTTP/1.1 requests.
+    // (The database must already be shared. Doesn't use Catch assertions, so it's thread-safe.)
+    unique_ptr<ClientSocket> openConnection() {
+        auto socket = make_unique<ClientSocket>();
+        Address addr("http"_sl, slice(requestHostname), c4listener_getPort(listener()), "/"_sl);
+        if (!socket->connect(addr))
+            return nullptr;
+        return socket;
+    }
+
+    // Sends a GET request on an open connection and reads the response; returns the status.
+    static int rawGET(ClientSocket &socket, const string &uri, string &outHeaders, string &outBody) {
+        string rq = "GET " + uri + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        if (socket.write_n(slice(rq)) < 0)
+            return -1;
+        return readResponse(socket, outHeaders, outBody);
+    }
+
+    // Reads an HTTP response with a Content-Length; returns the status, or -1 on error.
+    static int readResponse(ClientSocket &socket, string &outHeaders, string &outBody) {
+        alloc_slice headers = socket.readToDelimiter("\r\n\r\n"_sl);
+        if (!headers)
+            return -1;
+        outHeaders = string(headers);
+        int status = stoi(outHeaders.substr(9, 3));                 // "HTTP/1.1 200 ..."
+        auto lenPos = outHeaders.find("Content-Length: ");
+        if (lenPos == string::npos)
+            return -1;
+        size_t length = stoul(outHeaders.substr(lenPos + 16));
+        outBody.resize(length);
+        if (length > 0 && socket.readExactly(&outBody[0], length) < ssize_t(length))
+            return -1;
+        return status;
+    }
+
     void testRootLevel() {
         auto r = request("GET", "/", HTTPStatus::OK);
         auto body = r->bodyAsJSON().asDict();
@@ -510,6 +551,61 @@ TEST_CASE_METHOD(C4RESTTest, "REST _all_docs", "[REST][Listener][C]") {
 }
 
 
+TEST_CASE_METHOD(C4RESTTest, "REST _all_docs ranges", "[REST][Listener][C]") {
+    {
+        TransactionHelper t(db);
+        for (int i = 1; i <= 100; ++i) {
+            char docID[20], json[40];
+            sprintf(docID, "doc-%03d", i);
+            sprintf(json, "{\"n\":%d}", i);
+            createFleeceRev(db, slice(docID), kRevID, slice(json));
+        }
+    }
+
+    auto getKeys = [&](const string &query) {
+        auto r = request("GET", "/db/_all_docs?" + query, HTTPStatus::OK);
+        vector<string> keys;
+        for (Array::iterator i(r->bodyAsJSON().asDict()["rows"].asArray()); i; ++i)
+            keys.push_back(string(i->asDict()["key"].asString()));
+        return keys;
+    };
+
+    auto keys = getKeys("startkey=\"doc-010\"&endkey=\"doc-013\"");
+    CHECK(keys == (vector<string>{"doc-010", "doc-011", "doc-012", "doc-013"}));
+    keys = getKeys("startkey=doc-098");
+    CHECK(keys == (vector<string>{"doc-098", "doc-099", "doc-100"}));
+    keys = getKeys("endkey=doc-002");
+    CHECK(keys == (vector<string>{"doc-001", "doc-002"}));
+    keys = getKeys("descending=true&startkey=\"doc-050\"&limit=3");
+    CHECK(keys == (vector<string>{"doc-050", "doc-049", "doc-048"}));
+    keys = getKeys("startkey=\"doc-020\"&skip=1&limit=2");
+    CHECK(keys == (vector<string>{"doc-021", "doc-022"}));
+
+    // The response is streamed with chunked encoding:
+    auto r = request("GET", "/db/_all_docs?include_docs=true", HTTPStatus::OK);
+    CHECK(r->header("Transfer-Encoding") == "chunked"_sl);
+    Array rows = r->bodyAsJSON().asDict()["rows"].asArray();
+    REQUIRE(rows.count() == 100);
+    CHECK(rows[99].asDict()["doc"].asDict()["n"].asInt() == 100);
+
+    // ...except to an HTTP/1.0 client, which gets a body that ends when the connection closes:
+    {
+        auto socket = openConnection();
+        REQUIRE(socket);
+        string rq = "GET /db/_all_docs HTTP/1.0\r\nConnection: keep-alive\r\n\r\n";
+        REQUIRE(socket->write_n(slice(rq)) > 0);
+        string headers(socket->readToDelimiter("\r\n\r\n"_sl));
+        CHECK(headers.find("Transfer-Encoding") == string::npos);
+        CHECK(headers.find("Connection: close") != string::npos);
+        alloc_slice body;
+        REQUIRE(socket->readHTTPBody({}, body));
+        CHECK(Doc::fromJSON(body).root().asDict()["rows"].asArray().count() == 100);
+    }
+
+    request("GET", "/db/_all_docs?startkey=\"doc-", HTTPStatus::BadRequest);
+}
+
+
 TEST_CASE_METHOD(C4RESTTest, "REST _bulk_docs", "[REST][Listener][C]") {
     unique_ptr<Response> r;
     r = request("POST", "/db/_bulk_docs",
@@ -543,6 +639,152 @@ TEST_CASE_METHOD(C4RESTTest, "REST _bulk_docs", "[REST][Listener][C]") {
 }
 
 
+TEST_CASE_METHOD(C4RESTTest, "REST _bulk_docs many", "[REST][Listener][C]") {
+    // Enough docs to be encoded on several threads, with property names the database hasn't
+    // seen yet, so the new shared keys have to be added when they're saved:
+    static constexpr int kNumDocs = 500;
+    string json = "{\"docs\":[";
+    for (int i = 0; i < kNumDocs; ++i) {
+        if (i > 0)
+            json += ",";
+        json += format("{\"_id\":\"doc-%03d\",\"prop%d\":%d,\"common\":true}", i, i % 50, i);
+    }
+    json += "]}";
+    auto r = request("POST", "/db/_bulk_docs",
+                     {{"Content-Type", "application/json"}},
+                     slice(json), HTTPStatus::OK);
+    Array body = r->bodyAsJSON().asArray();
+    REQUIRE(body.count() == kNumDocs);
+    for (Array::iterator i(body); i; ++i)
+        CHECK(i->asDict()["ok"].asBool());
+
+    CHECK(c4db_getDocumentCount(db) == kNumDocs);
+    for (int i = 0; i < kNumDocs; i += 37) {
+        string docID = format("doc-%03d", i);
+        C4Document *doc = c4db_getDoc(db, slice(docID), true, kDocGetCurrentRev, ERROR_INFO());
+        REQUIRE(doc);
+        Dict props = c4doc_getProperties(doc);
+        CHECK(props[slice(format("prop%d", i % 50))].asInt() == i);
+        CHECK(props["common"].asBool());
+        CHECK(!props["_id"]);
+        c4doc_release(doc);
+    }
+}
+
+
+#pragma mark - KEEP-ALIVE:
+
+
+TEST_CASE_METHOD(C4RESTTest, "REST keep-alive", "[REST][Listener][C]") {
+    share(db, "db"_sl);
+    auto socket = openConnection();
+    REQUIRE(socket);
+    string headers, body;
+    for (int i = 0; i < 5; ++i) {
+        CHECK(rawGET(*socket, "/", headers, body) == 200);
+        CHECK(headers.find("Connection: keep-alive") != string::npos);
+        CHECK(body.find("\"couchdb\":\"Welcome\"") != string::npos);
+        CHECK(rawGET(*socket, "/_foo", headers, body) == 404);
+    }
+    unsigned connections;
+    c4listener_getConnectionStatus(listener(), &connections, nullptr);
+    CHECK(connections == 1);
+
+    // Pipelined requests, all sent before reading any response:
+    string rq = "GET /db HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    REQUIRE(socket->write_n(slice(rq + rq + rq)) > 0);
+    for (int i = 0; i < 3; ++i) {
+        CHECK(readResponse(*socket, headers, body) == 200);
+        CHECK(body.find("\"db_name\":\"db\"") != string::npos);
+    }
+
+    // "Connection: close" makes the server close the connection after responding:
+    rq = "GET / HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    REQUIRE(socket->write_n(slice(rq)) > 0);
+    headers = string(socket->readToDelimiter("\r\n\r\n"_sl));
+    CHECK(headers.find("Connection: close") != string::npos);
+    alloc_slice rest;
+    CHECK(socket->readHTTPBody({}, rest));           // No Content-Length, so reads to EOF
+    CHECK(socket->atReadEOF());
+}
+
+
+TEST_CASE_METHOD(C4RESTTest, "REST chunked request body", "[REST][Listener][C]") {
+    share(db, "db"_sl);
+    string headers, body;
+    auto post = [&](const string &chunks) {
+        auto socket = openConnection();
+        REQUIRE(socket);
+        string rq = "POST /db HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/json\r\n"
+                    "Transfer-Encoding: chunked\r\n\r\n" + chunks;
+        REQUIRE(socket->write_n(slice(rq)) > 0);
+        return readResponse(*socket, headers, body);
+    };
+
+    SECTION("Valid") {
+        CHECK(post("5\r\n{\"a\":\r\n3\r\n17}\r\n0\r\n\r\n") == 201);
+    }
+    SECTION("Oversized chunk") {
+        char sizeLine[32];
+        sprintf(sizeLine, "%zx\r\n", TCPSocket::kMaxHTTPChunkSize + 1);
+        CHECK(post(sizeLine) == 413);
+    }
+    SECTION("Wrapping chunk size") {
+        // A 1-byte chunk followed by one whose size would wrap around when added to it:
+        CHECK(post("1\r\n{\r\nffffffffffffffff\r\n") == 413);
+    }
+    SECTION("Non-hex chunk size") {
+        CHECK(post("zz\r\n{}\r\n0\r\n\r\n") == 400);
+        CHECK(post("-1\r\n{}\r\n0\r\n\r\n") == 400);
+    }
+}
+
+
+TEST_CASE_METHOD(C4RESTTest, "REST keep-alive load", "[REST][Listener][C][Perf][.slow]") {
+    // Each client thread sends requests on its own persistent connection, as fast as it can.
+    static constexpr int kClients = 16, kRequestsPerClient = 2000;
+    share(db, "db"_sl);
+    vector<vector<double>> latencies(kClients);
+    atomic<int> failures {0};
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> clients;
+    for (int c = 0; c < kClients; ++c) {
+        clients.emplace_back([&, c] {
+            auto socket = openConnection();
+            if (!socket) {
+                ++failures;
+                return;
+            }
+            string headers, body;
+            auto &lat = latencies[c];
+            lat.reserve(kRequestsPerClient);
+            for (int i = 0; i < kRequestsPerClient; ++i) {
+                auto t0 = chrono::steady_clock::now();
+                if (rawGET(*socket, (i % 2) ? "/db" : "/", headers, body) != 200) {
+                    ++failures;
+                    return;
+                }
+                lat.push_back(chrono::duration<double,milli>(chrono::steady_clock::now() - t0).count());
+            }
+        });
+    }
+    for (auto &t : clients)
+        t.join();
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    CHECK(failures == 0);
+
+    vector<double> all;
+    for (auto &lat : latencies)
+        all.insert(all.end(), lat.begin(), lat.end());
+    REQUIRE(!all.empty());
+    sort(all.begin(), all.end());
+    C4Log("%zu requests on %d connections in %.3f sec: %.0f req/sec; latency p50 = %.3fms, p99 = %.3fms",
+          all.size(), kClients, elapsed, all.size() / elapsed,
+          all[all.size() / 2], all[all.size() * 99 / 100]);
+}
+
+
 #pragma mark - HTTP AUTH:
 
 
@@ -0,0 +1,106 @@
+//
+// AdaptiveTuning.cc
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "AdaptiveTuning.hh"
+#include <algorithm>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace litecore { namespace repl {
+
+    AdaptiveWindow::AdaptiveWindow(const Tuning &floor)
+    :_floorRevs(floor.maxRevsInFlight)
+    ,_floorBytes(floor.maxRevBytesAwaitingReply)
+    ,_revs(floor.maxRevsInFlight)
+    ,_bytes(double(floor.maxRevBytesAwaitingReply))
+    { }
+
+
+    void AdaptiveWindow::addSample(duration rtt, uint64_t bytes, clock::time_point now) {
+        if (rtt <= duration::zero())
+            rtt = duration(1);
+        if (_srtt == duration::zero()) {
+            _srtt = rtt;
+            _intervalStart = now;
+        } else {
+            _srtt += (rtt - _srtt) / 8;
+        }
+        // Windowed minimum, so a route change that raises the base RTT is eventually noticed:
+        if (_minRTT == duration::zero() || rtt <= _minRTT || now - _minRTTStamp > kMinRTTWindow) {
+            _minRTT = rtt;
+            _minRTTStamp = now;
+        }
+        _intervalBytes += bytes;
+        if (++_intervalRevs >= kSamplesPerUpdate)
+            update(now);
+    }
+
+
+    void AdaptiveWindow::update(clock::time_point now) {
+        double elapsed = std::chrono::duration<double>(now - _intervalStart).count();
+        if (elapsed > 0) {
+            double rate = _intervalBytes / elapsed;
+            _ackRate = (_ackRate == 0) ? rate : (0.75 * _ackRate + 0.25 * rate);
+        }
+        double avgRevSize = double(_intervalBytes) / _intervalRevs;
+
+        if (_srtt < _minRTT + _minRTT / 2) {
+            // RTT isn't inflating, so the peer and network can absorb more:
+            _revs *= 1.25;
+            _bytes *= 1.25;
+        } else if (_ackRate > 0) {
+            // Queueing delay is building up; size the windows to 2×BDP:
+            double bdp = _ackRate * std::chrono::duration<double>(_minRTT).count();
+            _bytes = 2 * bdp;
+            _revs = (avgRevSize > 0) ? (2 * bdp / avgRevSize) : _revs;
+        }
+        clamp();
+
+        _intervalStart = now;
+        _intervalBytes = 0;
+        _intervalRevs = 0;
+    }
+
+
+    void AdaptiveWindow::addTransientError() {
+        _revs /= 2;
+        _bytes /= 2;
+        clamp();
+    }
+
+
+    void AdaptiveWindow::clamp() {
+        _revs  = std::clamp(_revs, double(_floorRevs),
+                            double(max(_floorRevs, tuning::kAdaptiveMaxRevsInFlight)));
+        _bytes = std::clamp(_bytes, double(_floorBytes),
+                            double(max(_floorBytes, uint64_t(tuning::kAdaptiveMaxRevBytesAwaitingReply))));
+    }
+
+
+    bool AdaptiveWindow::apply(Tuning &t) const {
+        auto revs = unsigned(_revs);
+        auto bytes = unsigned(_bytes);
+        if (revs == t.maxRevsInFlight && bytes == t.maxRevBytesAwaitingReply)
+            return false;
+        t.maxRevsInFlight = revs;
+        t.maxRevBytesAwaitingReply = bytes;
+        return true;
+    }
+
+} }
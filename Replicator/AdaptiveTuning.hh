@@ -0,0 +1,74 @@
+//
+// AdaptiveTuning.hh
+//
+// Copyright © 2021 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "ReplicatorTuning.hh"
+#include <chrono>
+#include <stdint.h>
+
+namespace litecore { namespace repl {
+
+    /** Sizes the Pusher's in-flight windows (`maxRevsInFlight`, `maxRevBytesAwaitingReply`)
+        from the observed round-trip time of `rev` messages, in the spirit of BBR:
+        - While the smoothed RTT stays close to the minimum RTT, the peer isn't queueing, so
+          the windows grow geometrically.
+        - Once the RTT inflates, the windows are set to twice the measured bandwidth-delay
+          product (delivery rate × minimum RTT).
+        - A transient error from the peer halves the windows.
+        The windows never shrink below the configured tuning, nor grow past the
+        `kAdaptiveMax...` limits. Not thread-safe; owned by the Pusher. */
+    class AdaptiveWindow {
+    public:
+        using clock = std::chrono::steady_clock;
+        using duration = clock::duration;
+
+        explicit AdaptiveWindow(const Tuning &floor);
+
+        /** Records a `rev` whose reply arrived `rtt` after it finished sending. */
+        void addSample(duration rtt, uint64_t bytes, clock::time_point now =clock::now());
+
+        /** Records a transient failure reported by the peer (e.g. 503.) */
+        void addTransientError();
+
+        /** Copies the current windows into `tuning`. Returns true if they changed. */
+        bool apply(Tuning &tuning) const;
+
+        duration smoothedRTT() const            {return _srtt;}
+        duration minRTT() const                 {return _minRTT;}
+
+    private:
+        void update(clock::time_point now);
+        void clamp();
+
+        static constexpr unsigned kSamplesPerUpdate = 8;
+        static constexpr auto kMinRTTWindow = std::chrono::seconds(10);
+
+        unsigned const      _floorRevs;
+        uint64_t const      _floorBytes;
+        double              _revs;                  // Current windows (fractional for growth)
+        double              _bytes;
+        duration            _srtt {};               // EWMA of RTT, gain 1/8
+        duration            _minRTT {};             // Min RTT seen in current window
+        clock::time_point   _minRTTStamp;           // When _minRTT was measured
+        clock::time_point   _intervalStart;         // Start of current delivery-rate interval
+        uint64_t            _intervalBytes {0};     // Bytes acked in current interval
+        unsigned            _intervalRevs {0};      // Revs acked in current interval
+        double              _ackRate {0};           // EWMA of acked bytes/sec
+    };
+
+} }
@@ -37,11 +37,12 @@ namespace litecore { namespace repl {
     using namespace fleece;
 
 
-    DBAccess::DBAccess(C4Database* db, bool disableBlobSupport)
+    DBAccess::DBAccess(C4Database* db, bool disableBlobSupport, bool deferIndexing)
     :access_lock(move(db))
     ,Logging(SyncLog)
     ,_blobStore(&db->getBlobStore())
     ,_disableBlobSupport(disableBlobSupport)
+    ,_deferIndexing(deferIndexing)
     ,_revsToMarkSynced(bind(&DBAccess::markRevsSyncedNow, this),
                        bind(&DBAccess::markRevsSyncedLater, this),
                        tuning::kInsertionDelay)
@@ -59,7 +60,15 @@ namespace litecore { namespace repl {
                 if (!_insertionDB) {
                     Retained<C4Database> idb;
                     try {
-                        idb = db->openAgain();
+                        if (_deferIndexing) {
+                            // Let indexes be updated at commit instead of by a trigger per row.
+                            // (See kC4ReplicatorOptionDeferIndexing for the cost.)
+                            C4Database::Config config = db->getConfiguration();
+                            config.flags |= kC4DB_DeferIndexing;
+                            idb = C4Database::openNamed(db->getName(), config);
+                        } else {
+                            idb = db->openAgain();
+                        }
                     } catch (const exception &x) {
                         C4Error error = C4Error::fromException(x);
                         logError("Couldn't open new db connection: %s", error.description().c_str());
@@ -296,15 +305,45 @@ namespace litecore { namespace repl {
     }
 
 
-    alloc_slice DBAccess::reEncodeForDatabase(Doc doc) {
-        bool reEncode;
+    // Returns true if any Dict in the tree has an integer (shared) key >= `keyCount`.
+    static bool usesSharedKeysFrom(Value value, unsigned keyCount) {
+        if (Dict dict = value.asDict(); dict) {
+            for (Dict::iterator i(dict); i; ++i) {
+                Value key = i.key();
+                if (key.isInteger() && key.asUnsigned() >= keyCount)
+                    return true;
+                if (usesSharedKeysFrom(i.value(), keyCount))
+                    return true;
+            }
+        } else if (Array array = value.asArray(); array) {
+            for (Array::iterator i(array); i; ++i) {
+                if (usesSharedKeysFrom(i.value(), keyCount))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+
+    bool DBAccess::usesNewSharedKeys(const Doc &doc) {
+        unsigned keyCount;
         {
             lock_guard<mutex> lock(_tempSharedKeysMutex);
-            reEncode = doc.sharedKeys() != _tempSharedKeys
-                        || _tempSharedKeys.count() > _tempSharedKeysInitialCount;
+            if (doc.sharedKeys() != _tempSharedKeys)
+                return true;    // Encoded with an older snapshot, so can't tell
+            keyCount = _tempSharedKeysInitialCount;
+            if (_tempSharedKeys.count() <= keyCount)
+                return false;   // Nobody has added any keys to the snapshot
         }
-        if (reEncode) {
+        // Keys were added to the snapshot, but maybe not by this doc; check which ones it uses:
+        return usesSharedKeysFrom(doc.root(), keyCount);
+    }
+
+
+    alloc_slice DBAccess::reEncodeForDatabase(Doc doc, bool usesNewKeys) {
+        if (usesNewKeys) {
             // Re-encode with database's current sharedKeys:
+            _tempSharedKeysStale = true;
             return insertionDB().useLocked<alloc_slice>([&](C4Database* idb) {
                 SharedEncoder enc(idb->sharedFleeceEncoder());
                 enc.writeValue(doc.root());
@@ -313,7 +352,7 @@ namespace litecore { namespace repl {
                 return data;
             });
         } else {
-            // _tempSharedKeys is still compatible with database's sharedKeys, so no re-encoding.
+            // The doc only uses keys the database's sharedKeys already has, so no re-encoding.
             // But we do need to copy the data, because the data in doc is tagged with the temp
             // sharedKeys, and the database needs to tag the inserted data with its own.
             return alloc_slice(doc.data());
@@ -321,6 +360,12 @@ namespace litecore { namespace repl {
     }
 
 
+    void DBAccess::insertionsCommitted() {
+        if (_tempSharedKeysStale.exchange(false))
+            updateTempSharedKeys();
+    }
+
+
     Doc DBAccess::applyDelta(C4Document *doc,
                              slice deltaJSON,
                              bool useDBSharedKeys)
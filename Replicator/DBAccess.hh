@@ -44,7 +44,7 @@ namespace litecore { namespace repl {
         using alloc_slice = fleece::alloc_slice;
         using Dict = fleece::Dict;
 
-        DBAccess(C4Database* db, bool disableBlobSupport);
+        DBAccess(C4Database* db, bool disableBlobSupport, bool deferIndexing =false);
         ~DBAccess();
 
         /** Looks up the remote DB identifier of this replication. */
@@ -123,15 +123,26 @@ namespace litecore { namespace repl {
 
         //////// INSERTION:
 
-        /** Encodes JSON to Fleece. Uses a temporary SharedKeys, because the database's
-            SharedKeys can only be encoded with during a transaction, and the caller (IncomingRev)
-            isn't in a transaction. */
+        /** Encodes JSON to Fleece. Uses a snapshot of the database's SharedKeys, because the
+            database's own SharedKeys can only be encoded with during a transaction, and the
+            caller (IncomingRev) isn't in a transaction. */
         fleece::Doc tempEncodeJSON(slice jsonBody, FLError *err);
 
-        /** Takes a document produced by tempEncodeJSON and re-encodes it if necessary with the
-            database's real SharedKeys, so it's suitable for saving. This can only be called
-            inside a transaction. */
-        alloc_slice reEncodeForDatabase(fleece::Doc);
+        /** Returns true if a document encoded with the SharedKeys snapshot (by tempEncodeJSON,
+            or by re-encoding one of its docs) uses keys that the database didn't have when the
+            snapshot was taken. Only such docs need to be re-encoded before saving.
+            Call this before the transaction, since it may have to scan the whole doc. */
+        bool usesNewSharedKeys(const fleece::Doc&);
+
+        /** Takes a document produced by tempEncodeJSON and returns data suitable for saving.
+            If `usesNewKeys` is true (see \ref usesNewSharedKeys) it re-encodes it with the
+            database's real SharedKeys, which can only be done inside a transaction; otherwise
+            the data is just copied. */
+        alloc_slice reEncodeForDatabase(fleece::Doc, bool usesNewKeys);
+
+        /** Call after committing a transaction that inserted revisions. If any had to be
+            re-encoded, the database now has new keys, so this takes a new snapshot of them. */
+        void insertionsCommitted();
 
         /** A separate C4Database instance used for insertions, to avoid blocking the main
             C4Database. */
@@ -170,9 +181,11 @@ namespace litecore { namespace repl {
         fleece::SharedKeys _tempSharedKeys;                 // Keys used in tempEncodeJSON()
         std::mutex _tempSharedKeysMutex;                    // Mutex for replacing _tempSharedKeys
         unsigned _tempSharedKeysInitialCount {0};           // Count when copied from db's keys
+        std::atomic<bool> _tempSharedKeysStale {false};     // Set when db may have new keys
         C4RemoteID _remoteDBID {0};                         // ID # of remote DB in revision store
         alloc_slice _remotePeerID;                          // peerID of remote peer
         bool const _disableBlobSupport;                     // Does replicator support blobs?
+        bool const _deferIndexing;                          // Open _insertionDB w/DeferIndexing?
         actor::Batcher<ReplicatedRev> _revsToMarkSynced;    // Pending revs to be marked as synced
         actor::Timer _timer;                                // Implements Batcher delay
         std::optional<AccessLockedDB> _insertionDB;         // DB handle to use for insertions
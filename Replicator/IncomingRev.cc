@@ -204,9 +204,9 @@ namespace litecore { namespace repl {
             return;
         }
 
-        // Note: fleeceDoc is _not_ yet suitable for inserting into the
-        // database because it doesn't use the same SharedKeys, but it lets us look at the doc
-        // metadata and blobs.
+        // Note: fleeceDoc may not yet be suitable for inserting into the database, because it's
+        // encoded with a snapshot of its SharedKeys, but it lets us look at the doc metadata and
+        // blobs.
         Dict root = fleeceDoc.asDict();
 
         // SG sends a fake revision with a "_removed":true property, to indicate that the doc is
@@ -251,6 +251,7 @@ namespace litecore { namespace repl {
         }
 
         _rev->doc = fleeceDoc;
+        _rev->docUsesNewKeys = _db->usesNewSharedKeys(fleeceDoc);
 
         // Check for blobs, and queue up requests for any I don't have yet:
         if (_mayContainBlobs) {
@@ -41,9 +41,13 @@ namespace litecore { namespace repl {
     Inserter::Inserter(Replicator *repl)
     :Worker(repl, "Insert")
     ,_revsToInsert(this, "revsToInsert", &Inserter::_insertRevisionsNow,
-                   tuning::kInsertionDelay, tuning::kInsertionBatchSize)
+                   _tuning.insertionDelay, _tuning.insertionBatchSize)
     {
         _passive = _options.pull <= kC4Passive;
+        if (_tuning.adaptiveBatching)
+            _revsToInsert.setAdaptive(_tuning.insertionTargetTime,
+                                      tuning::kMinAdaptiveInsertionBatchSize,
+                                      tuning::kMaxAdaptiveInsertionBatchSize);
     }
 
 
@@ -69,32 +73,38 @@ namespace litecore { namespace repl {
             // of them apply to the docs we're updating:
             _db->markRevsSyncedNow();
 
+            // Consecutive revs are put with a single putDocuments call, so that new docs are
+            // saved in a batch. A purge ends the run, since it may apply to a doc in it.
+            vector<RevToInsert*> run;
+            vector<C4Error> runErrors;
+            auto insertRun = [&] {
+                insertRevisionsNow(run, runErrors);
+                for (size_t i = 0; i < run.size(); ++i)
+                    finishedInserting(run[i], runErrors[i]);
+                run.clear();
+            };
+
             for (RevToInsert *rev : *revs) {
-                C4Error docErr;
-                bool docSaved = insertRevisionNow(rev, &docErr);
-                rev->trimBody();                // don't need body any more
-                if (docSaved) {
-                    rev->owner->revisionProvisionallyInserted();
+                if (rev->flags & kRevPurged) {
+                    insertRun();
+                    C4Error docErr = {};
+                    purgeRevisionNow(rev, &docErr);
+                    finishedInserting(rev, docErr);
                 } else {
-                    // Notify owner of a rev that failed:
-                    string desc = docErr.description();
-                    warn("Failed to insert '%.*s' #%.*s : %s",
-                         SPLAT(rev->docID), SPLAT(rev->revID), desc.c_str());
-                    rev->error = docErr;
-                    if (docErr == C4Error{LiteCoreDomain, kC4ErrorDeltaBaseUnknown}
-                            || docErr == C4Error{LiteCoreDomain, kC4ErrorCorruptDelta})
-                        rev->errorIsTransient = true;
-                    rev->owner->revisionInserted();     // Tell the IncomingRev
+                    run.push_back(rev);
                 }
             }
+            insertRun();
 
             Stopwatch stCommit;
             transaction.commit();
-            commitTime = st.elapsed();
+            commitTime = stCommit.elapsed();
         } catch (...) {
             transactionErr = C4Error::fromCurrentException();
             warn("Transaction failed!");
         }
+        if (!transactionErr)
+            _db->insertionsCommitted();
 
         // Notify owners of all revs that didn't already fail:
         for (auto &rev : *revs) {
@@ -104,36 +114,83 @@ namespace litecore { namespace repl {
             }
         }
 
+        double t = st.elapsed();
+        _revsToInsert.batchProcessed(revs->size(), chrono::duration_cast<actor::Timer::duration>(
+                                                                chrono::duration<double>(t)));
+        if (Retained<Replicator> repl = replicatorIfAny())
+            repl->setInsertionStats(_revsToInsert.stats());
+
         if (transactionErr) {
             gotError(transactionErr);
         } else {
-            double t = st.elapsed();
             logInfo("Inserted %3zu revs in %6.2fms (%5.0f/sec) of which %4.1f%% was commit",
                     revs->size(), t*1000, revs->size()/t, commitTime/t*100);
         }
     }
 
 
-    // Inserts one revision. Returns only C4Errors, never throws exceptions.
-    bool Inserter::insertRevisionNow(RevToInsert *rev, C4Error *outError) {
+    // Updates a revision after inserting it, and notifies its owner if it failed.
+    void Inserter::finishedInserting(RevToInsert *rev, C4Error docErr) {
+        rev->trimBody();                // don't need body any more
+        if (!docErr) {
+            rev->owner->revisionProvisionallyInserted();
+        } else {
+            // Notify owner of a rev that failed:
+            string desc = docErr.description();
+            warn("Failed to insert '%.*s' #%.*s : %s",
+                 SPLAT(rev->docID), SPLAT(rev->revID), desc.c_str());
+            rev->error = docErr;
+            if (docErr == C4Error{LiteCoreDomain, kC4ErrorDeltaBaseUnknown}
+                    || docErr == C4Error{LiteCoreDomain, kC4ErrorCorruptDelta})
+                rev->errorIsTransient = true;
+            rev->owner->revisionInserted();     // Tell the IncomingRev
+        }
+    }
+
+
+    // Purges the doc of a revision the server says is no longer accessible, i.e. it's been
+    // removed from all channels the client has access to. Returns only C4Errors, never throws.
+    bool Inserter::purgeRevisionNow(RevToInsert *rev, C4Error *outError) {
         try {
-            if (rev->flags & kRevPurged) {
-                // Server says the document is no longer accessible, i.e. it's been
-                // removed from all channels the client has access to. Purge it.
-                if (_db->insertionDB().useLocked()->purgeDocument(rev->docID))
-                    logVerbose("    {'%.*s' removed (purged)}", SPLAT(rev->docID));
-                return true;
-
-            } else {
-                // Set up the "put" parameter block:
-                vector<C4String> history = rev->history();
+            if (_db->insertionDB().useLocked()->purgeDocument(rev->docID))
+                logVerbose("    {'%.*s' removed (purged)}", SPLAT(rev->docID));
+            return true;
+        } catch (...) {
+            *outError = C4Error::fromCurrentException();
+            return false;
+        }
+    }
+
+
+    // Inserts revisions (not purges) with one putDocuments call. On return, `outErrors` has an
+    // entry for each rev, which is nonzero if it failed. Returns only C4Errors, never throws.
+    void Inserter::insertRevisionsNow(const vector<RevToInsert*> &revs,
+                                      vector<C4Error> &outErrors)
+    {
+        outErrors.assign(revs.size(), C4Error{});
+        if (revs.empty())
+            return;
+
+        // Set up the "put" parameter blocks. The histories and bodies they point to have to
+        // stay alive until the put.
+        vector<C4DocPutRequest> puts;
+        vector<vector<C4String>> histories;
+        vector<alloc_slice> bodies;
+        vector<size_t> putIndex;            // index in `revs` of each put
+        puts.reserve(revs.size());
+        histories.reserve(revs.size());
+        bodies.reserve(revs.size());
+        for (size_t i = 0; i < revs.size(); ++i) {
+            RevToInsert *rev = revs[i];
+            try {
+                histories.push_back(rev->history());
                 C4DocPutRequest put = {};
                 put.docID = rev->docID;
                 put.revFlags = rev->flags;
                 put.existingRevision = true;
                 put.allowConflict = !rev->noConflicts;
-                put.history = history.data();
-                put.historyCount = history.size();
+                put.history = histories.back().data();
+                put.historyCount = histories.back().size();
                 put.remoteDBID = _db->remoteDBID();
                 put.save = true;
 
@@ -156,36 +213,53 @@ namespace litecore { namespace repl {
                     put.revFlags |= kRevKeepBody;
                 } else {
                     // If not a delta, encode doc body using database's real sharedKeys:
-                    bodyForDB = _db->reEncodeForDatabase(rev->doc);
+                    bodyForDB = _db->reEncodeForDatabase(rev->doc, rev->docUsesNewKeys);
                     rev->doc = nullptr;
                     // Preserve rev body as the source of a future delta I may push back:
                     if (bodyForDB.size >= tuning::kMinBodySizeForDelta
                         && !_options.disableDeltaSupport())
                         put.revFlags |= kRevKeepBody;
                 }
-                put.allocedBody = {(void*)bodyForDB.buf, bodyForDB.size};
-
-                // The save!!
-                auto doc = _db->insertionDB().useLocked()->putDocument(put, nullptr, outError);
-                if (!doc)
-                    return false;
-                logVerbose("    {'%.*s' #%.*s <- %.*s} seq %" PRIu64,
-                           SPLAT(rev->docID), SPLAT(rev->revID), SPLAT(rev->historyBuf),
-                           doc->selectedRev().sequence);
-                rev->sequence = doc->selectedRev().sequence;
-                if (doc->selectedRev().flags & kRevIsConflict) {
-                    // Note that rev was inserted but caused a conflict:
-                    logInfo("Created conflict with '%.*s' #%.*s",
-                            SPLAT(rev->docID), SPLAT(rev->revID));
-                    rev->flags |= kRevIsConflict;
-                    rev->isWarning = true;
-                    DebugAssert(put.allowConflict);
-                }
-                return true;
+                bodies.push_back(move(bodyForDB));
+                put.allocedBody = {(void*)bodies.back().buf, bodies.back().size};
+                puts.push_back(put);
+                putIndex.push_back(i);
+            } catch (...) {
+                outErrors[i] = C4Error::fromCurrentException();
             }
+        }
+
+        // The save!!
+        vector<C4Error> putErrors;
+        vector<Retained<C4Document>> docs;
+        try {
+            docs = _db->insertionDB().useLocked()->putDocuments(puts, putErrors);
         } catch (...) {
-            *outError = C4Error::fromCurrentException();
-            return false;
+            C4Error err = C4Error::fromCurrentException();
+            for (size_t i : putIndex)
+                outErrors[i] = err;
+            return;
+        }
+
+        for (size_t p = 0; p < puts.size(); ++p) {
+            RevToInsert *rev = revs[putIndex[p]];
+            C4Document *doc = docs[p];
+            if (!doc) {
+                outErrors[putIndex[p]] = putErrors[p];
+                continue;
+            }
+            logVerbose("    {'%.*s' #%.*s <- %.*s} seq %" PRIu64,
+                       SPLAT(rev->docID), SPLAT(rev->revID), SPLAT(rev->historyBuf),
+                       doc->selectedRev().sequence);
+            rev->sequence = doc->selectedRev().sequence;
+            if (doc->selectedRev().flags & kRevIsConflict) {
+                // Note that rev was inserted but caused a conflict:
+                logInfo("Created conflict with '%.*s' #%.*s",
+                        SPLAT(rev->docID), SPLAT(rev->revID));
+                rev->flags |= kRevIsConflict;
+                rev->isWarning = true;
+                DebugAssert(puts[p].allowConflict);
+            }
         }
     }
 
@@ -33,7 +33,9 @@ namespace litecore { namespace repl {
 
     private:
         void _insertRevisionsNow(int gen);
-        bool insertRevisionNow(RevToInsert* NONNULL, C4Error*);
+        void insertRevisionsNow(const std::vector<RevToInsert*>&, std::vector<C4Error> &outErrors);
+        bool purgeRevisionNow(RevToInsert* NONNULL, C4Error*);
+        void finishedInserting(RevToInsert* NONNULL, C4Error);
         C4SliceResult applyDeltaCallback(C4Document *doc NONNULL,
                                          C4Slice deltaJSON,
                                          C4Error *outError);
@@ -50,7 +50,7 @@ namespace litecore { namespace repl {
         _passive = _options.pull <= kC4Passive;
         registerHandler("rev",              &Puller::handleRev);
         registerHandler("norev",            &Puller::handleNoRev);
-        _spareIncomingRevs.reserve(tuning::kMaxActiveIncomingRevs);
+        _spareIncomingRevs.reserve(_tuning.maxActiveIncomingRevs);
         _skipDeleted = _options.skipDeleted();
         if (!passive() && _options.noIncomingConflicts())
             warn("noIncomingConflicts mode is not compatible with active pull replications!");
@@ -70,7 +70,7 @@ namespace litecore { namespace repl {
             msg["since"_sl] = sinceStr;
         if (_options.pull == kC4Continuous)
             msg["continuous"_sl] = "true"_sl;
-        msg["batch"_sl] = tuning::kChangesBatchSize;
+        msg["batch"_sl] = _tuning.changesBatchSize;
         msg["versioning"] = _db->usingVersionVectors() ? "version-vectors" : "rev-trees";
         if (_skipDeleted)
             msg["activeOnly"_sl] = "true"_sl;
@@ -162,8 +162,8 @@ namespace litecore { namespace repl {
 
     // Received an incoming "rev" message, which contains a revision body to insert
     void Puller::handleRev(Retained<MessageIn> msg) {
-        if (_activeIncomingRevs < tuning::kMaxActiveIncomingRevs
-                && _unfinishedIncomingRevs < tuning::kMaxIncomingRevs) {
+        if (_activeIncomingRevs < _tuning.maxActiveIncomingRevs
+                && _unfinishedIncomingRevs < _tuning.maxIncomingRevs) {
             startIncomingRev(msg);
         } else {
             logDebug("Delaying handling 'rev' message for '%.*s' [%zu waiting]",
@@ -220,8 +220,8 @@ namespace litecore { namespace repl {
     }
 
     void Puller::maybeStartIncomingRevs() {
-        while (connected() && _activeIncomingRevs < tuning::kMaxActiveIncomingRevs
-               && _unfinishedIncomingRevs < tuning::kMaxIncomingRevs
+        while (connected() && _activeIncomingRevs < _tuning.maxActiveIncomingRevs
+               && _unfinishedIncomingRevs < _tuning.maxIncomingRevs
                && !_waitingRevMessages.empty()) {
             auto msg = _waitingRevMessages.front();
             _waitingRevMessages.pop_front();
@@ -266,7 +266,7 @@ namespace litecore { namespace repl {
         }
         decrement(_unfinishedIncomingRevs, (unsigned)revs->size());
 
-        ssize_t capacity = tuning::kMaxIncomingRevs - _spareIncomingRevs.size();
+        ssize_t capacity = _tuning.maxIncomingRevs - _spareIncomingRevs.size();
         if (capacity > 0)
             _spareIncomingRevs.insert(_spareIncomingRevs.end(),
                                       revs->begin(),
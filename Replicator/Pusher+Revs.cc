@@ -34,19 +34,19 @@ using namespace litecore::blip;
 namespace litecore::repl {
 
     void Pusher::maybeSendMoreRevs() {
-        while (_revisionsInFlight < tuning::kMaxRevsInFlight
-                   && _revisionBytesAwaitingReply <= tuning::kMaxRevBytesAwaitingReply
+        while (_revisionsInFlight < _tuning.maxRevsInFlight
+                   && _revisionBytesAwaitingReply <= _tuning.maxRevBytesAwaitingReply
                    && !_revQueue.empty()) {
             Retained<RevToSend> first = move(_revQueue.front());
             _revQueue.pop_front();
             sendRevision(first);
-            if (_revQueue.size() == tuning::kMaxRevsQueued - 1)
+            if (_revQueue.size() == _tuning.maxRevsQueued - 1)
                 maybeGetMoreChanges();          // I may now be eligible to send more changes
         }
 //        if (!_revQueue.empty())
 //            logVerbose("Throttling sending revs; _revisionsInFlight=%u/%u, _revisionBytesAwaitingReply=%llu/%u",
-//                       _revisionsInFlight, tuning::kMaxRevsInFlight,
-//                       _revisionBytesAwaitingReply, tuning::kMaxRevBytesAwaitingReply);
+//                       _revisionsInFlight, _tuning.maxRevsInFlight,
+//                       _revisionBytesAwaitingReply, _tuning.maxRevBytesAwaitingReply);
     }
 
 
@@ -57,7 +57,7 @@ namespace litecore::repl {
 
         logVerbose("Sending rev '%.*s' #%.*s (seq #%" PRIu64 ") [%d/%d]",
                    SPLAT(request->docID), SPLAT(request->revID), request->sequence,
-                   _revisionsInFlight, tuning::kMaxRevsInFlight);
+                   _revisionsInFlight, _tuning.maxRevsInFlight);
 
         // Get the document & revision:
         C4Error c4err = {};
@@ -176,6 +176,8 @@ namespace litecore::repl {
                          SPLAT(rev->docID), SPLAT(rev->revID), rev->sequence);
                 decrement(_revisionsInFlight);
                 increment(_revisionBytesAwaitingReply, progress.bytesSent);
+                if (_adaptiveWindow)
+                    rev->sentTime = chrono::steady_clock::now();
                 maybeSendMoreRevs();
                 break;
             case MessageProgress::kComplete: {
@@ -187,6 +189,9 @@ namespace litecore::repl {
                     logVerbose("Completed rev %.*s #%.*s (seq #%" PRIu64 ")",
                                SPLAT(rev->docID), SPLAT(rev->revID), rev->sequence);
                     finishedDocument(rev);
+                    if (_adaptiveWindow)
+                        _adaptiveWindow->addSample(chrono::steady_clock::now() - rev->sentTime,
+                                                   progress.bytesSent);
                 } else {
                     // Handle an error received from the peer:
                     auto err = progress.reply->getError();
@@ -194,6 +199,8 @@ namespace litecore::repl {
 
                     if (c4err.mayBeTransient()) {
                         completed = false;
+                        if (_adaptiveWindow)
+                            _adaptiveWindow->addTransientError();
                     } else if (c4err == C4Error{WebSocketDomain, 403}) {
                         // CBL-123: Retry HTTP forbidden once
                         if (rev->retryCount++ == 0) {
@@ -220,6 +227,9 @@ namespace litecore::repl {
                     // If this is a permanent failure, like a validation error or conflict,
                     // then I've completed my duty to push it.
                 }
+                if (_adaptiveWindow && _adaptiveWindow->apply(_tuning))
+                    logVerbose("Adaptive tuning: maxRevsInFlight=%u, maxRevBytesAwaitingReply=%u",
+                               _tuning.maxRevsInFlight, _tuning.maxRevBytesAwaitingReply);
                 doneWithRev(rev, completed, synced);
                 switch (retry) {
                     case kRetryNow:   retryRevs({rev}, true); break;
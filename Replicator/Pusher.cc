@@ -54,6 +54,8 @@ namespace litecore { namespace repl {
             _proposeChanges = true;
             _proposeChangesKnown = true;
         }
+        if (_tuning.adaptive)
+            _adaptiveWindow = std::make_unique<AdaptiveWindow>(_tuning);
         registerHandler("subChanges",      &Pusher::handleSubChanges);
         registerHandler("getAttachment",   &Pusher::handleGetAttachment);
         registerHandler("proveAttachment", &Pusher::handleProveAttachment);
@@ -123,11 +125,11 @@ namespace litecore { namespace repl {
     // Request another batch of changes from the db, if there aren't too many in progress
     void Pusher::_maybeGetMoreChanges() {
         if ((!_caughtUp || !_continuousCaughtUp)
-                     && _changeListsInFlight < (_caughtUp ? 1 : tuning::kMaxChangeListsInFlight)
-                     && _revQueue.size() < tuning::kMaxRevsQueued
+                     && _changeListsInFlight < (_caughtUp ? 1 : _tuning.maxChangeListsInFlight)
+                     && _revQueue.size() < _tuning.maxRevsQueued
                      && connected()) {
             _continuousCaughtUp = true;
-            gotChanges(_changesFeed.getMoreChanges(tuning::kDefaultChangeBatchSize));
+            gotChanges(_changesFeed.getMoreChanges(_tuning.changeBatchSize));
         }
     }
 
@@ -21,6 +21,7 @@
 #include "ChangesFeed.hh"
 #include "Replicator.hh" // for BlobProgress
 #include "ReplicatorTypes.hh"
+#include "AdaptiveTuning.hh"
 #include "fleece/slice.hh"
 #include <deque>
 #include <unordered_map>
@@ -117,6 +118,7 @@ namespace litecore { namespace repl {
         unsigned _blobsInFlight {0};              // # of blobs being sent
         std::deque<Retained<RevToSend>> _revQueue;// Revs to send to peer but not sent yet
         RevToSendList _revsToRetry;               // Revs that failed with a transient error
+        std::unique_ptr<AdaptiveWindow> _adaptiveWindow; // Sizes rev windows (adaptive tuning)
         string _myPeerID;
     };
     
@@ -18,100 +18,145 @@
 
 #pragma once
 #include "RemoteSequence.hh"
+#include <algorithm>
 #include <map>
 #include <utility>
+#include <vector>
 
 namespace litecore { namespace repl {
 
     /** A set of opaque remote sequence IDs, representing server-side database sequences.
-        This is used by the replicator to keep track of which revisions are being pulled. */
+        This is used by the replicator to keep track of which revisions are being pulled.
+
+        \note Sequences are stored in a vector, in the order they were added, with removed ones
+        marked as such until they reach the front and can be discarded. Lookups are a binary
+        search as long as sequences arrive in increasing order, which is the normal case for a
+        changes feed; if one arrives out of order, the set falls back to a map index. */
     class RemoteSequenceSet {
     public:
         RemoteSequenceSet()                     =default;
 
         /** Empties the set. */
         void clear(RemoteSequence since) {
-            _sequences.clear();
-            _nextOrder = 0;
-            _lastAdded = since;
-            _first = _sequences.end();
+            _entries.clear();
+            _index.clear();
+            _start = 0;
+            _base = 0;
+            _count = 0;
+            _sorted = true;
+            _since = std::move(since);
         }
 
         bool empty() const {
-            return _sequences.empty();
+            return _count == 0;
         }
 
         size_t size() const {
-            return _sequences.size();
+            return _count;
         }
 
         /** Returns the sequence before the earliest one still in the set. */
         RemoteSequence since() {
-            return (_first != _sequences.end()) ? _first->second.prevSequence : _lastAdded;
+            return _since;
         }
 
         /** Adds a sequence to the set. */
         void add(RemoteSequence s, uint64_t bodySize) {
-            bool wasEmpty = empty();
-            auto p = _sequences.insert({s, {_nextOrder++, _lastAdded, bodySize}});
-            _lastAdded = std::move(s);
-            if (wasEmpty)
-                _first = p.first;
+            if (_sorted && !_entries.empty() && !(_entries.back().sequence < s)) {
+                if (find(s))
+                    return;                     // already present
+                buildIndex();
+            }
+            if (!_sorted && !_index.emplace(s, _base + _entries.size()).second)
+                return;                         // already present
+            _entries.push_back({std::move(s), bodySize, false});
+            ++_count;
         }
 
         /** Removes the sequence if it's in the set. Returns true if it was the earliest. */
         void remove(const RemoteSequence &s, bool &wasEarliest, uint64_t &outBodySize) {
-            auto i = _sequences.find(s);
-            if (i == _sequences.end()) {
+            entry *e = find(s);
+            if (!e) {
                 outBodySize = 0;
                 wasEarliest = false;
                 return;
             }
-            outBodySize = i->second.bodySize;
-            wasEarliest = (i == _first);
-            if (wasEarliest) {
-                size_t minOrder = i->second.order;
-                _sequences.erase(i);
-                findFirst(minOrder + 1);
-            } else {
-                _sequences.erase(i);
-            }
+            outBodySize = e->bodySize;
+            wasEarliest = (e == &_entries[_start]);
+            e->removed = true;
+            --_count;
+            if (!_sorted)
+                _index.erase(s);
+            if (wasEarliest)
+                popRemoved();
         }
 
         uint64_t bodySizeOfSequence(const RemoteSequence &s) {
-            auto i = _sequences.find(s);
-            return (i == _sequences.end()) ? 0 : i->second.bodySize;
+            entry *e = find(s);
+            return e ? e->bodySize : 0;
         }
 
     private:
+        struct entry {
+            RemoteSequence sequence;
+            uint64_t bodySize;              // Approx doc size, for client's use
+            bool removed;                   // True if removed but not yet discarded
+        };
 
-        // Updates _first to point to the earliest entry in _sequences
-        void findFirst(size_t minOrderInSet) {
-            sequenceMap::iterator first = _sequences.end();
-            size_t minOrderSoFar = SIZE_MAX;
-            // OPT: Slow linear scan. Keep a secondary collection sorted by order?
-            for (auto i = _sequences.begin(); i != _sequences.end(); ++i) {
-                if (i->second.order < minOrderSoFar) {
-                    minOrderSoFar = i->second.order;
-                    first = i;
-                    if (minOrderSoFar == minOrderInSet)
-                        break;  // we know we've found the minimum
-                }
+        // Returns the live entry with the given sequence, or nullptr.
+        entry* find(const RemoteSequence &s) {
+            entry *e;
+            if (_sorted) {
+                auto i = std::lower_bound(_entries.begin() + _start, _entries.end(), s,
+                                          [](const entry &e, const RemoteSequence &s) {
+                                              return e.sequence < s;
+                                          });
+                if (i == _entries.end() || i->sequence != s)
+                    return nullptr;
+                e = &*i;
+            } else {
+                auto i = _index.find(s);
+                if (i == _index.end())
+                    return nullptr;
+                e = &_entries[i->second - _base];
             }
-            _first = first;
+            return e->removed ? nullptr : e;
         }
 
-        struct value {
-            size_t order;                   // Chronological order in which this sequence was added
-            RemoteSequence prevSequence;    // The previously-added sequence
-            uint64_t bodySize;              // Approx doc size, for client's use
-        };
-        using sequenceMap = std::map<RemoteSequence, value>;
+        // Switches from binary search to the map index, when a sequence arrives out of order.
+        void buildIndex() {
+            for (size_t i = _start; i < _entries.size(); ++i) {
+                if (!_entries[i].removed)
+                    _index.emplace(_entries[i].sequence, _base + i);
+            }
+            _sorted = false;
+        }
+
+        // Discards removed entries from the front, updating `_since`, and occasionally
+        // compacts the vector.
+        void popRemoved() {
+            while (_start < _entries.size() && _entries[_start].removed)
+                _since = std::move(_entries[_start++].sequence);
+            if (_start == _entries.size()) {
+                _base += _start;
+                _entries.clear();
+                _start = 0;
+            } else if (_start >= kMinCompaction && _start >= _entries.size() / 2) {
+                _base += _start;
+                _entries.erase(_entries.begin(), _entries.begin() + _start);
+                _start = 0;
+            }
+        }
+
+        static constexpr size_t kMinCompaction = 256;
 
-        sequenceMap _sequences;             // Maps sequence to {order, previous seq}
-        size_t _nextOrder {0};              // Order to assign to the next insertion
-        RemoteSequence _lastAdded;          // The last sequence added
-        sequenceMap::iterator _first {};    // Points to the earliest sequence still in _sequences
+        std::vector<entry> _entries;                // Sequences, in the order they were added
+        std::map<RemoteSequence, size_t> _index;    // Maps sequence -> _base + index, if !_sorted
+        size_t _start {0};                          // Index of the earliest live entry
+        size_t _base {0};                           // Number of entries discarded from the front
+        size_t _count {0};                          // Number of live entries
+        bool _sorted {true};                        // Are _entries in increasing order?
+        RemoteSequence _since;                      // The sequence before the earliest live one
     };
 
 } }
@@ -32,6 +32,7 @@
 #include "Logging.hh"
 #include "Headers.hh"
 #include "BLIP.hh"
+#include "Codec.hh"
 #include "Address.hh"
 #include "Instrumentation.hh"
 
@@ -60,6 +61,15 @@ namespace litecore { namespace repl {
     std::string Replicator::ProtocolName() {
         stringstream result;
         delimiter delim(",");
+        // Offer the faster codecs first, if they're built in. Peers that don't recognize those
+        // protocols will choose one of the plain ones, which use deflate:
+        for (auto codec : {CodecType::Zstd, CodecType::LZ4}) {
+            if (codecAvailable(codec)) {
+                string prefix = Connection::protocolName(codec);
+                for (auto &name : kCompatProtocols)
+                    result << delim << prefix << name.substr(strlen(Connection::kWSProtocolName));
+            }
+        }
         for (auto &name : kCompatProtocols)
             result << delim << name;
         return result.str();
@@ -73,7 +83,8 @@ namespace litecore { namespace repl {
     :Worker(new Connection(webSocket, options.properties, *this),
             nullptr,
             options,
-            make_shared<DBAccess>(db, options.properties["disable_blob_support"_sl].asBool()),
+            make_shared<DBAccess>(db, options.properties["disable_blob_support"_sl].asBool(),
+                                  options.properties[kC4ReplicatorOptionDeferIndexing].asBool()),
             "Repl")
     ,_delegate(&delegate)
     ,_connectionState(connection().state())
@@ -673,6 +684,54 @@ namespace litecore { namespace repl {
     }
 
 
+#pragma mark - BATCH STATS:
+
+
+    void Replicator::setInsertionStats(const actor::BatcherStats &stats) {
+        lock_guard<mutex> lock(_statsMutex);
+        _insertionStats = stats;
+    }
+
+
+    static void writeBatcherStats(Encoder &enc, const actor::BatcherStats &stats) {
+        auto ms = [](actor::Timer::duration d) {
+            return chrono::duration<double, milli>(d).count();
+        };
+        double batches = double(max(stats.batches, uint64_t(1)));
+        enc.beginDict();
+        enc.writeKey("batches"_sl);         enc.writeUInt(stats.batches);
+        enc.writeKey("items"_sl);           enc.writeUInt(stats.items);
+        enc.writeKey("capacity"_sl);        enc.writeUInt(stats.capacity);
+        enc.writeKey("latencyMS"_sl);       enc.writeDouble(ms(stats.latency));
+        enc.writeKey("avgWaitMS"_sl);       enc.writeDouble(ms(stats.totalWait) / batches);
+        enc.writeKey("maxWaitMS"_sl);       enc.writeDouble(ms(stats.maxWait));
+        enc.writeKey("avgProcessingMS"_sl); enc.writeDouble(ms(stats.totalProcessing) / batches);
+        enc.writeKey("sizeHistogram"_sl);
+        enc.beginArray();
+        for (uint64_t n : stats.sizeHistogram)
+            enc.writeUInt(n);
+        enc.endArray();
+        enc.endDict();
+    }
+
+
+    alloc_slice Replicator::batchStats() const {
+        actor::BatcherStats insertion;
+        {
+            lock_guard<mutex> lock(_statsMutex);
+            insertion = _insertionStats;
+        }
+        Encoder enc;
+        enc.beginDict();
+        enc.writeKey("insertion"_sl);
+        writeBatcherStats(enc, insertion);
+        enc.writeKey("docsEnded"_sl);
+        writeBatcherStats(enc, _docsEnded.stats());
+        enc.endDict();
+        return enc.finish();
+    }
+
+
 #pragma mark - PEER CHECKPOINT ACCESS:
 
 
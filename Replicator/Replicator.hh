@@ -105,6 +105,14 @@ namespace litecore { namespace repl {
         /** Checks if the document with the given ID has any pending revisions to push */
         bool isDocumentPending(slice docID);
 
+        /** Returns statistics about the batches of revisions inserted into the database and of
+            ended documents, as a Fleece-encoded dict. Thread-safe. */
+        alloc_slice batchStats() const;
+
+        /** Called by the Inserter after each batch, to update the stats returned by
+            \ref batchStats. */
+        void setInsertionStats(const actor::BatcherStats &stats);
+
         Checkpointer& checkpointer()            {return _checkpointer;}
 
         void endedDocument(ReplicatedRev *d NONNULL);
@@ -188,6 +196,8 @@ namespace litecore { namespace repl {
         ActivityLevel     _lastDelegateCallLevel {};   // Activity level I last reported to delegate
         bool              _waitingToCallDelegate {};   // Is an async call to reportStatus pending?
         ReplicatedRevBatcher _docsEnded;               // Recently-completed revs
+        mutable std::mutex _statsMutex;                // Protects _insertionStats
+        actor::BatcherStats _insertionStats;           // Inserter's latest batch stats
 
         Checkpointer      _checkpointer;               // Object that manages checkpoints
         bool              _hadLocalCheckpoint {};      // True if local checkpoint pre-existed
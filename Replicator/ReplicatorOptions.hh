@@ -18,6 +18,7 @@
 
 #pragma once
 #include "c4ReplicatorTypes.h"
+#include "ReplicatorTuning.hh"
 #include "fleece/Fleece.hh"
 
 namespace litecore { namespace repl {
@@ -97,6 +98,11 @@ namespace litecore { namespace repl {
             return boolProperty(kC4ReplicatorOptionAutoPurge);
         }
 
+        /** Returns the tuning values: the preset named by the 'tuningProfile' option, with any
+            values in the 'tuning' dict overriding it. Throws InvalidParameter on an unknown
+            profile name. */
+        Tuning tuning() const;
+
         /** Returns a string that uniquely identifies the remote database; by default its URL,
             or the 'remoteUniqueID' option if that's present (for P2P dbs without stable URLs.) */
         fleece::slice remoteDBIDString(fleece::slice remoteURL) const {
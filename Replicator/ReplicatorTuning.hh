@@ -43,6 +43,12 @@ namespace litecore { namespace repl {
            if the queue size hasn't reached kInsertionBatchSize yet. */
         constexpr auto kInsertionDelay = 20ms;
 
+        /* With adaptive batching, the insertion batch size is adjusted so that inserting and
+           committing a full batch takes about this long. It stays within the limits below. */
+        constexpr auto kInsertionTargetTime = 50ms;
+        constexpr size_t kMinAdaptiveInsertionBatchSize = 10;
+        constexpr size_t kMaxAdaptiveInsertionBatchSize = 2000;
+
         /* Minimum document body size that will be considered for delta compression.
             (This is the size of the Fleece encoding, which is usually smaller than the JSON.)
            This is not declared `constexpr`, so that the delta-sync unit tests can change it. */
@@ -107,6 +113,78 @@ namespace litecore { namespace repl {
 
         /* How long to wait between delegate calls when only the progress % has changed. */
         constexpr auto kMinDelegateCallInterval = 200ms;
+
+
+        //// Adaptive tuning:
+
+        /* Upper limits the Pusher's in-flight windows may grow to in adaptive mode. */
+        constexpr unsigned kAdaptiveMaxRevsInFlight = 200;
+        constexpr unsigned kAdaptiveMaxRevBytesAwaitingReply = 32*1024*1024;
     }
 
+
+    /** The per-replicator values of the tunable constants above. A default-constructed
+        instance has the same values as the constants; the presets trade memory usage and
+        latency against throughput for particular kinds of network.
+        Configured with the `tuningProfile`, `tuning` and `adaptiveTuning` replicator options. */
+    struct Tuning {
+        size_t                      insertionBatchSize      = tuning::kInsertionBatchSize;
+        std::chrono::milliseconds   insertionDelay          = tuning::kInsertionDelay;
+        unsigned                    changesBatchSize        = tuning::kChangesBatchSize;
+        unsigned                    maxRevsBeingRequested   = tuning::kMaxRevsBeingRequested;
+        unsigned                    maxIncomingRevs         = tuning::kMaxIncomingRevs;
+        unsigned                    maxActiveIncomingRevs   = tuning::kMaxActiveIncomingRevs;
+        unsigned                    maxChangeListsInFlight  = tuning::kMaxChangeListsInFlight;
+        unsigned                    maxRevsQueued           = tuning::kMaxRevsQueued;
+        unsigned                    maxRevsInFlight         = tuning::kMaxRevsInFlight;
+        unsigned                    maxRevBytesAwaitingReply= tuning::kMaxRevBytesAwaitingReply;
+        unsigned                    changeBatchSize         = tuning::kDefaultChangeBatchSize;
+        std::chrono::milliseconds   insertionTargetTime     = tuning::kInsertionTargetTime;
+        bool                        adaptive                = false;  ///< Grow windows from RTT
+        bool                        adaptiveBatching        = false;  ///< Size inserts from timing
+
+        /** Peer-to-peer on a fast local network: round trips are cheap, so flush inserts
+            sooner instead of waiting to build large batches. */
+        static Tuning lowLatencyLAN() {
+            Tuning t;
+            t.insertionDelay = std::chrono::milliseconds(5);
+            t.maxRevsInFlight = 20;
+            return t;
+        }
+
+        /** High bandwidth-delay-product links: keep many more revs and bytes in flight so the
+            pipe stays full across long round trips. Uses more memory. */
+        static Tuning highBDPWAN() {
+            Tuning t;
+            t.insertionBatchSize = 500;
+            t.insertionDelay = std::chrono::milliseconds(50);
+            t.changesBatchSize = 500;
+            t.maxRevsBeingRequested = 500;
+            t.maxIncomingRevs = 500;
+            t.maxActiveIncomingRevs = 200;
+            t.maxChangeListsInFlight = 10;
+            t.maxRevsQueued = 2000;
+            t.maxRevsInFlight = 50;
+            t.maxRevBytesAwaitingReply = 16*1024*1024;
+            t.changeBatchSize = 500;
+            return t;
+        }
+
+        /** Small devices: bounds the number of revision bodies held in memory at once. */
+        static Tuning memoryConstrained() {
+            Tuning t;
+            t.insertionBatchSize = 50;
+            t.changesBatchSize = 100;
+            t.maxRevsBeingRequested = 50;
+            t.maxIncomingRevs = 50;
+            t.maxActiveIncomingRevs = 25;
+            t.maxChangeListsInFlight = 2;
+            t.maxRevsQueued = 100;
+            t.maxRevsInFlight = 5;
+            t.maxRevBytesAwaitingReply = 512*1024;
+            t.changeBatchSize = 100;
+            return t;
+        }
+    };
+
 } }
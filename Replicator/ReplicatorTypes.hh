@@ -21,6 +21,7 @@
 #include "fleece/Fleece.hh"
 #include "c4Base.hh"
 #include "c4BlobStore.hh"
+#include <chrono>
 #include <memory>
 #include <vector>
 
@@ -67,6 +68,7 @@ namespace litecore { namespace repl {
         bool            legacyAttachments {false};  // Add _attachments property when sending
         bool            deltaOK {false};            // Can send a delta
         int8_t          retryCount {0};             // Number of times this revision has been retried
+        std::chrono::steady_clock::time_point sentTime; // When 'rev' finished sending (adaptive)
 
         RevToSend(const C4DocumentInfo &info);
 
@@ -91,6 +93,7 @@ namespace litecore { namespace repl {
     public:
         alloc_slice             historyBuf;             // Revision history (comma-delimited revIDs)
         fleece::Doc             doc;
+        bool                    docUsesNewKeys {true};  // Must re-encode doc before saving
         const bool              noConflicts {false};    // Server is in no-conflicts mode
         RevocationMode          revocationMode = RevocationMode::kNone;
         Retained<IncomingRev>   owner;                  // Object that's processing this rev
@@ -80,6 +80,55 @@ namespace litecore { namespace repl {
     }
 
 
+    Tuning Options::tuning() const {
+        Tuning t;
+        slice profile = properties[kC4ReplicatorOptionTuningProfile].asString();
+        if (!profile || profile == slice(kC4TuningProfileDefault))
+            ;
+        else if (profile == slice(kC4TuningProfileLAN))
+            t = Tuning::lowLatencyLAN();
+        else if (profile == slice(kC4TuningProfileWAN))
+            t = Tuning::highBDPWAN();
+        else if (profile == slice(kC4TuningProfileLowMemory))
+            t = Tuning::memoryConstrained();
+        else
+            error::_throw(error::InvalidParameter, "Unknown replicator tuning profile '%.*s'",
+                          SPLAT(profile));
+
+        Dict overrides = dictProperty(kC4ReplicatorOptionTuning);
+        auto overrideValue = [&](const char *key, auto &field) {
+            Value v = overrides[key];
+            if (!v)
+                return;
+            if (!v.isInteger() || v.asInt() <= 0)
+                error::_throw(error::InvalidParameter,
+                              "Replicator tuning value '%s' must be a positive integer", key);
+            field = (std::remove_reference_t<decltype(field)>)v.asUnsigned();
+        };
+        if (overrides) {
+            overrideValue("insertionBatchSize",       t.insertionBatchSize);
+            overrideValue("changesBatchSize",         t.changesBatchSize);
+            overrideValue("maxRevsBeingRequested",    t.maxRevsBeingRequested);
+            overrideValue("maxIncomingRevs",          t.maxIncomingRevs);
+            overrideValue("maxActiveIncomingRevs",    t.maxActiveIncomingRevs);
+            overrideValue("maxChangeListsInFlight",   t.maxChangeListsInFlight);
+            overrideValue("maxRevsQueued",            t.maxRevsQueued);
+            overrideValue("maxRevsInFlight",          t.maxRevsInFlight);
+            overrideValue("maxRevBytesAwaitingReply", t.maxRevBytesAwaitingReply);
+            overrideValue("changeBatchSize",          t.changeBatchSize);
+            unsigned delayMS = unsigned(t.insertionDelay.count());
+            overrideValue("insertionDelayMS",         delayMS);
+            t.insertionDelay = chrono::milliseconds(delayMS);
+            unsigned targetMS = unsigned(t.insertionTargetTime.count());
+            overrideValue("insertionTargetMS",        targetMS);
+            t.insertionTargetTime = chrono::milliseconds(targetMS);
+        }
+        t.adaptive = boolProperty(kC4ReplicatorOptionAdaptiveTuning);
+        t.adaptiveBatching = boolProperty(kC4ReplicatorOptionAdaptiveBatching);
+        return t;
+    }
+
+
     Worker::Worker(blip::Connection *connection,
                    Worker *parent,
                    const Options &options,
@@ -90,6 +139,7 @@ namespace litecore { namespace repl {
     ,_connection(connection)
     ,_parent(parent)
     ,_options(options)
+    ,_tuning(options.tuning())
     ,_db(dbAccess)
     ,_progressNotificationLevel(options.progressLevel())
     ,_status{(connection->state() >= Connection::kConnected) ? kC4Idle : kC4Connecting}
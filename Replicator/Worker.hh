@@ -148,6 +148,7 @@ namespace litecore { namespace repl {
         int pendingResponseCount() const        {return _pendingResponseCount;}
 
         Options _options;
+        Tuning _tuning;                                 // From _options.tuning()
         Retained<Worker> _parent;
         std::shared_ptr<DBAccess> _db;
         uint8_t _important {1};
@@ -22,7 +22,15 @@ namespace litecore {
                              WebSocket *openSocket NONNULL)
         :C4ReplicatorImpl(db, params)
         ,_openSocket(openSocket)
-        { }
+        {
+            // The BLIP connection takes its codec from the protocol the listener accepted, so
+            // it must be known; better to find out now than when the replicator starts:
+            if (!openSocket->acceptedProtocol()
+                    && !_options.properties[kC4SocketOptionWSProtocols].asString())
+                C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
+                               "An incoming replicator needs the accepted WebSocket protocol, "
+                               "as the '" kC4SocketOptionWSProtocols "' option");
+        }
 
         
         virtual alloc_slice URL() const noexcept override {
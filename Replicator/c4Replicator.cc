@@ -100,6 +100,10 @@ bool C4Replicator::isDocumentPending(slice docID) const {
     return asInternal(this)->isDocumentPending(docID);
 }
 
+alloc_slice C4Replicator::getStats() const {
+    return asInternal(this)->batchStats();
+}
+
 #ifdef COUCHBASE_ENTERPRISE
 C4Cert* C4Replicator::getPeerTLSCertificate() const {
     return asInternal(this)->getPeerTLSCertificate();
@@ -203,6 +203,15 @@ namespace litecore {
             return PendingDocuments(this).pendingDocumentIDs();
         }
 
+        alloc_slice batchStats() const {
+            Retained<Replicator> replicator;
+            {
+                LOCK(_mutex);
+                replicator = _replicator;
+            }
+            return replicator ? replicator->batchStats() : alloc_slice();
+        }
+
         void setProgressLevel(C4ReplicatorProgressLevel level) noexcept override {
             _progressLevel = level;
             if(_replicator) {
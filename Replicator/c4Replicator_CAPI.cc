@@ -160,6 +160,14 @@ C4SliceResult c4repl_getPendingDocIDs(C4Replicator* repl, C4Error* outErr) noexc
 }
 
 
+C4SliceResult c4repl_getStats(C4Replicator *repl) noexcept {
+    try {
+        return C4SliceResult( repl->getStats() );
+    } catchAndWarn()
+    return {};
+}
+
+
 bool c4repl_isDocumentPending(C4Replicator* repl, C4Slice docID, C4Error* outErr) noexcept {
     try {
         return repl->isDocumentPending(docID);
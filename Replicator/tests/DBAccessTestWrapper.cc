@@ -19,6 +19,7 @@
 #include "DBAccessTestWrapper.hh"
 #include "DBAccess.hh"
 #include "c4DocEnumerator.hh"
+#include "Error.hh"
 
 using namespace std;
 using namespace litecore::repl;
@@ -32,3 +33,35 @@ C4DocEnumerator* DBAccessTestWrapper::unresolvedDocsEnumerator(C4Database *db) {
 unsigned DBAccessTestWrapper::numDeltasApplied() {
     return DBAccess::gNumDeltasApplied;
 }
+
+
+size_t DBAccessTestWrapper::encodeIncomingRevs(C4Database *db,
+                                               const vector<fleece::alloc_slice> &jsonBodies,
+                                               size_t batchSize,
+                                               bool forceReEncode)
+{
+    std::shared_ptr<DBAccess> acc = make_shared<DBAccess>(db, false);
+    size_t reEncoded = 0;
+    for (size_t start = 0; start < jsonBodies.size(); start += batchSize) {
+        size_t end = min(start + batchSize, jsonBodies.size());
+        vector<pair<fleece::Doc,bool>> docs;
+        for (size_t i = start; i < end; ++i) {
+            FLError err;
+            fleece::Doc doc = acc->tempEncodeJSON(jsonBodies[i], &err);
+            Assert(doc);
+            docs.emplace_back(doc, forceReEncode || acc->usesNewSharedKeys(doc));
+        }
+        {
+            DBAccess::Transaction t(acc->insertionDB());
+            for (auto &[doc, usesNewKeys] : docs) {
+                fleece::alloc_slice body = acc->reEncodeForDatabase(doc, usesNewKeys);
+                Assert(body);
+                if (usesNewKeys)
+                    ++reEncoded;
+            }
+            t.commit();
+        }
+        acc->insertionsCommitted();
+    }
+    return reEncoded;
+}
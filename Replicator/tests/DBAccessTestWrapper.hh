@@ -6,11 +6,22 @@
 
 #pragma once
 #include "c4DocEnumerator.h"
+#include "fleece/slice.hh"
 #include <memory>
+#include <vector>
 
 struct DBAccessTestWrapper {
 
     static C4DocEnumerator* unresolvedDocsEnumerator(C4Database*);
 
     static unsigned numDeltasApplied();
+
+    /** Encodes JSON bodies the way the Puller does: each is encoded with tempEncodeJSON, then in
+        batches, prepared for saving with reEncodeForDatabase in a transaction that's committed.
+        Returns the number of bodies that had to be re-encoded. If `forceReEncode` is true, all
+        of them are, as they were before incoming revs were encoded in a single pass. */
+    static size_t encodeIncomingRevs(C4Database*,
+                                     const std::vector<fleece::alloc_slice> &jsonBodies,
+                                     size_t batchSize,
+                                     bool forceReEncode =false);
 };
@@ -8,6 +8,8 @@
 
 #include "ReplicatorLoopbackTest.hh"
 #include "Worker.hh"
+#include "AdaptiveTuning.hh"
+#include "Codec.hh"
 #include "DBAccessTestWrapper.hh"
 #include "Timer.hh"
 #include "c4Database.hh"
@@ -16,6 +18,7 @@
 #include "betterassert.hh"
 #include "fleece/Mutable.hh"
 #include "PlatformCompat.hh"
+#include "varint.hh"
 #include <chrono>
 
 using namespace litecore::actor;
@@ -226,6 +229,297 @@ TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push large database", "[Push]") {
 }
 
 
+TEST_CASE("Replicator tuning options", "[Push]") {
+    Replicator::Options opts = Replicator::Options::pushing();
+    auto t = opts.tuning();
+    CHECK(t.maxRevsInFlight == tuning::kMaxRevsInFlight);
+    CHECK(t.insertionDelay == tuning::kInsertionDelay);
+    CHECK(!t.adaptive);
+
+    opts.setProperty(C4STR(kC4ReplicatorOptionTuningProfile), C4STR(kC4TuningProfileWAN));
+    opts.setProperty(C4STR(kC4ReplicatorOptionAdaptiveTuning), true);
+    t = opts.tuning();
+    CHECK(t.maxRevsInFlight == Tuning::highBDPWAN().maxRevsInFlight);
+    CHECK(t.maxRevBytesAwaitingReply == Tuning::highBDPWAN().maxRevBytesAwaitingReply);
+    CHECK(t.adaptive);
+
+    opts.setProperty(C4STR(kC4ReplicatorOptionTuningProfile), "dialup"_sl);
+    ExpectException(error::LiteCore, error::InvalidParameter, [&]{
+        (void)opts.tuning();
+    });
+}
+
+
+TEST_CASE("Adaptive tuning window", "[Push]") {
+    using namespace std::chrono;
+    Tuning floor;
+    AdaptiveWindow window(floor);
+    auto now = AdaptiveWindow::clock::now();
+
+    // Steady RTT: windows grow until they hit the ceiling.
+    for (int i = 0; i < 1000; ++i)
+        window.addSample(10ms, 10000, now += 1ms);
+    Tuning t = floor;
+    CHECK(window.apply(t));
+    CHECK(t.maxRevsInFlight == tuning::kAdaptiveMaxRevsInFlight);
+
+    // Inflated RTT: windows shrink toward 2×BDP, but never below the configured values.
+    for (int i = 0; i < 1000; ++i)
+        window.addSample(100ms, 100, now += 10ms);
+    window.apply(t);
+    CHECK(t.maxRevsInFlight < tuning::kAdaptiveMaxRevsInFlight);
+    CHECK(t.maxRevsInFlight >= floor.maxRevsInFlight);
+    CHECK(t.maxRevBytesAwaitingReply >= floor.maxRevBytesAwaitingReply);
+
+    for (int i = 0; i < 20; ++i)
+        window.addTransientError();
+    window.apply(t);
+    CHECK(t.maxRevsInFlight == floor.maxRevsInFlight);
+    CHECK(t.maxRevBytesAwaitingReply == floor.maxRevBytesAwaitingReply);
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push large database adaptive tuning", "[Push]") {
+    importJSONLines(sFixturesDir + "iTunesMusicLibrary.json");
+    _expectedDocumentCount = 12189;
+    auto pushOpts = Replicator::Options::pushing(kC4OneShot);
+    pushOpts.setProperty(C4STR(kC4ReplicatorOptionTuningProfile), C4STR(kC4TuningProfileWAN));
+    pushOpts.setProperty(C4STR(kC4ReplicatorOptionAdaptiveTuning), true);
+    runReplicators(pushOpts, Replicator::Options::passive());
+    compareDatabases();
+    validateCheckpoints(db, db2, "{\"local\":12189}");
+}
+
+
+#pragma mark - BLIP CODECS:
+
+
+// Builds BLIP "rev" message payloads (varint properties length, properties, JSON body) from a
+// JSON-lines file, approximating the traffic of a push replication.
+static vector<alloc_slice> revMessages(slice jsonLines) {
+    vector<alloc_slice> messages;
+    slice_istream in(jsonLines);
+    unsigned seq = 0;
+    while (in.size > 0) {
+        slice body = in.readToDelimiterOrEnd("\n"_sl);
+        if (body.size == 0)
+            continue;
+        ++seq;
+        string props;
+        auto addProperty = [&](const string &name, const string &value) {
+            props += name;  props.push_back('\0');
+            props += value; props.push_back('\0');
+        };
+        addProperty("Profile", "rev");
+        addProperty("id", stringprintf("doc-%06u", seq));
+        addProperty("rev", stringprintf("1-%08x%08x", seq * 2654435761u, seq));
+        addProperty("sequence", to_string(seq));
+        uint8_t len[kMaxVarintLen32];
+        string payload((const char*)len, PutUVarInt(len, props.size()));
+        payload += props;
+        payload.append((const char*)body.buf, body.size);
+        messages.emplace_back(payload);
+    }
+    return messages;
+}
+
+
+// Encodes a message into frames the way MessageOut does: each frame is flushed, has the codec's
+// flush trailer removed, and ends with a checksum.
+static void encodeFrames(blip::Codec &codec, slice message, size_t frameSize,
+                         vector<alloc_slice> &frames)
+{
+    vector<uint8_t> buf(frameSize);
+    slice_istream in(message);
+    while (in.size > 0) {
+        slice_ostream dst(buf.data(), frameSize);
+        slice_ostream frame(dst.next(), frameSize - blip::Codec::kChecksumSize);
+        do {
+            codec.write(in, frame, blip::Codec::Mode::SyncFlush);
+        } while (in.size > 0 && frame.capacity() >= 1024);
+        REQUIRE(codec.unflushedBytes() == 0);
+        slice trailer = codec.flushTrailer();
+        if (trailer.size > 0) {
+            REQUIRE(frame.output().hasSuffix(trailer));
+            frame.retreat(trailer.size);
+        }
+        dst.advanceTo(frame.next());
+        codec.writeChecksum(dst);
+        frames.emplace_back(dst.output());
+    }
+}
+
+
+// Decodes frames the way MessageIn does, verifying each frame's checksum.
+static string decodeFrames(blip::Codec &codec, const vector<alloc_slice> &frames) {
+    string result;
+    uint8_t buffer[4096];
+    for (auto &f : frames) {
+        string frame(f);
+        uint8_t checksum[blip::Codec::kChecksumSize];
+        memcpy(checksum, &frame[frame.size() - sizeof(checksum)], sizeof(checksum));
+        if (slice trailer = codec.flushTrailer(); trailer.size > 0)
+            memcpy(&frame[frame.size() - sizeof(checksum)], trailer.buf, trailer.size);
+        else
+            frame.resize(frame.size() - sizeof(checksum));
+        slice_istream in(frame.data(), frame.size());
+        while (in.size > 0 || codec.unflushedBytes() > 0) {
+            slice_ostream out(buffer, sizeof(buffer));
+            codec.write(in, out, blip::Codec::Mode::SyncFlush);
+            result.append((const char*)buffer, out.bytesWritten());
+        }
+        slice_istream checksumIn(checksum, sizeof(checksum));
+        codec.readAndVerifyChecksum(checksumIn);
+    }
+    return result;
+}
+
+
+static constexpr blip::CodecType kAllCodecs[] = {
+    blip::CodecType::Deflate, blip::CodecType::LZ4, blip::CodecType::Zstd};
+
+
+TEST_CASE("BLIP codec negotiation", "[Push]") {
+    using namespace blip;
+    CHECK(Connection::protocolName(CodecType::Deflate) == "BLIP_3");
+    CHECK(Connection::protocolName(CodecType::Zstd) == "BLIP_3.zstd");
+    CHECK(Connection::codecForProtocol(nullslice) == CodecType::Deflate);
+    CHECK(Connection::codecForProtocol("BLIP_3+CBMobile_3"_sl) == CodecType::Deflate);
+    CHECK(Connection::codecForProtocol("BLIP_3.snappy+CBMobile_3"_sl) == CodecType::Deflate);
+
+    string offered = Replicator::ProtocolName();
+    // The plain protocols must still be offered, for peers that don't know the codecs:
+    CHECK(hasSuffix(offered, "BLIP_3+CBMobile_3,BLIP_3+CBMobile_2"));
+    for (auto codec : {CodecType::LZ4, CodecType::Zstd}) {
+        string protocol = Connection::protocolName(codec) + "+CBMobile_3";
+        CHECK((offered.find(protocol) != string::npos) == codecAvailable(codec));
+        CHECK(Connection::codecForProtocol(slice(protocol))
+                == (codecAvailable(codec) ? codec : CodecType::Deflate));
+    }
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "BLIP codec round trip", "[Push]") {
+    alloc_slice json = readFile(sFixturesDir + "names_100.json");
+    auto messages = revMessages(json);
+    REQUIRE(messages.size() == 100);
+    size_t frameSize = GENERATE(4096, 16384);
+    for (auto codecType : kAllCodecs) {
+        if (!blip::codecAvailable(codecType))
+            continue;
+        INFO("Codec " << blip::codecName(codecType) << ", frame size " << frameSize);
+        auto encoder = blip::newEncoder(codecType);
+        auto decoder = blip::newDecoder(codecType);
+        for (auto &message : messages) {
+            vector<alloc_slice> frames;
+            encodeFrames(*encoder, message, frameSize, frames);
+            CHECK(decodeFrames(*decoder, frames) == string(message));
+        }
+    }
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push large database with BLIP codecs", "[Push]") {
+    auto codec = blip::CodecType::Deflate;
+    SECTION("Deflate") { }
+    SECTION("LZ4")     {codec = blip::CodecType::LZ4;}
+    SECTION("Zstd")    {codec = blip::CodecType::Zstd;}
+    if (!blip::codecAvailable(codec)) {
+        WARN("Codec " << blip::codecName(codec) << " not built in; skipping");
+        return;
+    }
+
+    importJSONLines(sFixturesDir + "iTunesMusicLibrary.json");
+    _expectedDocumentCount = 12189;
+    // Both sides derive the codec from the accepted protocol: the server from its options,
+    // the client from the response header. No codec option is needed.
+    _acceptedProtocol = blip::Connection::protocolName(codec) + "+CBMobile_3";
+    runPushReplication();
+    compareDatabases();
+    validateCheckpoints(db, db2, "{\"local\":12189}");
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "BLIP codec mismatch", "[Push]") {
+    auto codec = blip::codecAvailable(blip::CodecType::Zstd) ? blip::CodecType::Zstd
+                                                             : blip::CodecType::LZ4;
+    if (!blip::codecAvailable(codec)) {
+        WARN("No codecs besides deflate are built in; skipping");
+        return;
+    }
+    _acceptedProtocol = blip::Connection::protocolName(codec) + "+CBMobile_3";
+    ExpectingExceptions x;
+
+    SECTION("Server") {
+        // A server whose required codec disagrees with the protocol it accepted can't start:
+        auto serverOpts = Replicator::Options::passive();
+        serverOpts.setProperty(C4STR(kC4SocketOptionWSProtocols), slice(_acceptedProtocol));
+        serverOpts.setProperty(C4STR(kC4ReplicatorCodec), "deflate"_sl);
+        c4::ref<C4Database> dbServer = c4db_openAgain(db2, nullptr);
+        Retained<WebSocket> socket = new LoopbackWebSocket(alloc_slice("ws://cli/"_sl),
+                                                           Role::Server, kLatency);
+        CHECK_THROWS_AS(new Replicator(dbServer, socket, *this, serverOpts), litecore::error);
+    }
+    SECTION("Client") {
+        // A client that requires a different codec than the server accepted fails the handshake:
+        createRev("doc"_sl, kRevID, kFleeceBody);
+        auto clientOpts = Replicator::Options::pushing(kC4OneShot);
+        clientOpts.setProperty(C4STR(kC4ReplicatorCodec), "deflate"_sl);
+        _expectedError = {WebSocketDomain, kWebSocketCloseProtocolError};
+        _ignoreLackOfDocErrors = true;
+        runReplicators(clientOpts, Replicator::Options::passive());
+    }
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "BLIP server needs accepted protocol", "[Push]") {
+    // A server that isn't told which protocol it accepted can't know the client's codec:
+    ExpectingExceptions x;
+    c4::ref<C4Database> dbServer = c4db_openAgain(db2, nullptr);
+    Retained<WebSocket> socket = new LoopbackWebSocket(alloc_slice("ws://cli/"_sl),
+                                                       Role::Server, kLatency);
+    CHECK_THROWS_AS(new Replicator(dbServer, socket, *this, Replicator::Options::passive()),
+                    litecore::error);
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "BLIP codec benchmark", "[Perf][.slow]") {
+    alloc_slice json = readFile(sFixturesDir + "iTunesMusicLibrary.json");
+    auto messages = revMessages(json);
+    size_t totalSize = 0;
+    for (auto &message : messages)
+        totalSize += message.size;
+    const double megabytes = totalSize / 1.0e6;
+
+    for (auto codecType : kAllCodecs) {
+        if (!blip::codecAvailable(codecType))
+            continue;
+        auto encoder = blip::newEncoder(codecType);
+        auto decoder = blip::newDecoder(codecType);
+
+        vector<alloc_slice> frames;
+        Stopwatch st;
+        for (auto &message : messages)
+            encodeFrames(*encoder, message, 16384, frames);
+        double encodeTime = st.elapsed();
+
+        size_t compressedSize = 0;
+        for (auto &frame : frames)
+            compressedSize += frame.size;
+
+        st.reset();
+        size_t decodedSize = decodeFrames(*decoder, frames).size();
+        double decodeTime = st.elapsed();
+        CHECK(decodedSize == totalSize);
+
+        Log("%-8s: %.1fMB -> %.1fMB (%.1f%%); compress %.1f MB/s, decompress %.1f MB/s",
+            blip::codecName(codecType), megabytes, compressedSize / 1.0e6,
+            compressedSize * 100.0 / totalSize,
+            megabytes / encodeTime, megabytes / decodeTime);
+    }
+}
+
+
 TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push large database no-conflicts", "[Push][NoConflicts]") {
     auto serverOpts = Replicator::Options::passive().setNoIncomingConflicts();
 
@@ -263,6 +557,77 @@ TEST_CASE_METHOD(ReplicatorLoopbackTest, "Pull Small Non-Empty DB", "[Pull]") {
 }
 
 
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Pull with adaptive batching", "[Pull]") {
+    importJSONLines(sFixturesDir + "iTunesMusicLibrary.json");
+    _expectedDocumentCount = 12189;
+    auto pullOpts = Replicator::Options::pulling(kC4OneShot);
+    pullOpts.setProperty(C4STR(kC4ReplicatorOptionAdaptiveBatching), true);
+    runReplicators(Replicator::Options::passive(), pullOpts);
+    compareDatabases();
+    validateCheckpoints(db2, db, "{\"remote\":12189}");
+
+    Doc stats(_replClient->batchStats());
+    Dict insertion = stats.asDict()["insertion"].asDict();
+    REQUIRE(insertion);
+    Log("Insertion stats: %s", insertion.toJSONString().c_str());
+    CHECK(insertion["items"].asUnsigned() == 12189);
+    auto batches = insertion["batches"].asUnsigned();
+    CHECK(batches > 0);
+    auto capacity = insertion["capacity"].asUnsigned();
+    CHECK(capacity >= tuning::kMinAdaptiveInsertionBatchSize);
+    CHECK(capacity <= tuning::kMaxAdaptiveInsertionBatchSize);
+    uint64_t histogramTotal = 0;
+    for (Array::iterator i(insertion["sizeHistogram"].asArray()); i; ++i)
+        histogramTotal += i->asUnsigned();
+    CHECK(histogramTotal == batches);
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Incoming revs reuse database SharedKeys", "[Pull]") {
+    vector<alloc_slice> bodies;
+    readFileByLines(sFixturesDir + "names_100.json", [&](FLSlice line) {
+        bodies.emplace_back(line);
+        return true;
+    });
+    REQUIRE(bodies.size() == 100);
+
+    // The database starts with no keys, so the first batch has to be re-encoded. After it's
+    // committed the snapshot is updated, so later docs with the same keys don't need to be:
+    size_t reEncoded = DBAccessTestWrapper::encodeIncomingRevs(db2, bodies, 10);
+    CHECK(reEncoded >= 10);
+    CHECK(reEncoded < 50);
+
+    // Now the database has all the keys:
+    CHECK(DBAccessTestWrapper::encodeIncomingRevs(db2, bodies, 10) == 0);
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Incoming rev encoding benchmark", "[Pull][Perf][.slow]") {
+    vector<alloc_slice> bodies;
+    readFileByLines(sFixturesDir + "iTunesMusicLibrary.json", [&](FLSlice line) {
+        bodies.emplace_back(line);
+        return true;
+    });
+    const double n = bodies.size();
+
+    // Re-encoding every rev, as before, vs. only the ones that add keys to the database:
+    Stopwatch st;
+    size_t twoPass = DBAccessTestWrapper::encodeIncomingRevs(db, bodies,
+                                                             tuning::kInsertionBatchSize, true);
+    double twoPassTime = st.elapsed();
+    st.reset();
+    size_t singlePass = DBAccessTestWrapper::encodeIncomingRevs(db2, bodies,
+                                                                tuning::kInsertionBatchSize);
+    double singlePassTime = st.elapsed();
+
+    CHECK(twoPass == bodies.size());
+    CHECK(singlePass < twoPass);
+    Log("Encoding %.0f revs: two-pass %.2fus/rev, single-pass %.2fus/rev (%zu re-encoded); "
+        "saved %.2fus/rev", n, twoPassTime / n * 1e6, singlePassTime / n * 1e6, singlePass,
+        (twoPassTime - singlePassTime) / n * 1e6);
+}
+
+
 TEST_CASE_METHOD(ReplicatorLoopbackTest, "Incremental Pull", "[Pull]") {
     importJSONLines(sFixturesDir + "names_100.json");
     _expectedDocumentCount = 100;
@@ -102,6 +102,11 @@ public:
             std::swap(_clientProgressLevel, _serverProgressLevel);
         }
 
+        // A listener has to tell the passive replicator which protocol it accepted:
+        opts2.setProperty(C4STR(kC4SocketOptionWSProtocols),
+                          slice(_acceptedProtocol.empty() ? kCompatProtocols[0]
+                                                          : _acceptedProtocol));
+
         // Create client (active) and server (passive) replicators:
         _replClient = new Replicator(dbClient,
                                      new LoopbackWebSocket(alloc_slice("ws://srv/"_sl), Role::Client, kLatency),
@@ -118,6 +123,8 @@ public:
         // Response headers:
         Headers headers;
         headers.add("Set-Cookie"_sl, "flavor=chocolate-chip"_sl);
+        if (!_acceptedProtocol.empty())
+            headers.add("Sec-WebSocket-Protocol"_sl, slice(_acceptedProtocol));
 
         // Bind the replicators' WebSockets and start them:
         LoopbackWebSocket::bind(_replClient->webSocket(), _replServer->webSocket(), headers);
@@ -595,6 +602,7 @@ public:
     unsigned _blobPushProgressCallbacks {0}, _blobPullProgressCallbacks {0};
     Replicator::BlobProgress _lastBlobPushProgress {}, _lastBlobPullProgress {};
     std::function<void(ReplicatedRev*)> _conflictHandler;
+    std::string _acceptedProtocol;      // Sec-WebSocket-Protocol the 'server' responds with
     bool _conflictHandlerRunning {false};
 };
 
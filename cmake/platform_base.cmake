@@ -36,6 +36,8 @@ function(set_litecore_source_base)
         LiteCore/BlobStore/BlobStreams.cc
         LiteCore/BlobStore/Stream.cc
         LiteCore/Database/BackgroundDB.cc
+        LiteCore/Database/BlobCollector.cc
+        LiteCore/Database/BlobReferences.cc
         LiteCore/Database/DatabaseImpl.cc
         LiteCore/Database/DatabaseImpl+Upgrade.cc
         LiteCore/Database/Housekeeper.cc
@@ -55,6 +57,7 @@ function(set_litecore_source_base)
         LiteCore/Query/SQLiteFleeceEach.cc
         LiteCore/Query/SQLiteFleeceFunctions.cc
         LiteCore/Query/SQLiteFleeceUtil.cc
+        LiteCore/Query/SQLiteFTS5Functions.cc
         LiteCore/Query/SQLiteFTSRankFunction.cc
         LiteCore/Query/SQLiteKeyStore+ArrayIndexes.cc
         LiteCore/Query/SQLiteKeyStore+FTSIndexes.cc
@@ -87,6 +90,7 @@ function(set_litecore_source_base)
         vendor/SQLiteCpp/src/Exception.cpp
         vendor/SQLiteCpp/src/Statement.cpp
         vendor/SQLiteCpp/src/Transaction.cpp
+        Replicator/AdaptiveTuning.cc
         Replicator/c4Replicator.cc
         Replicator/c4Replicator_CAPI.cc
         Replicator/c4Socket.cc
@@ -115,6 +119,8 @@ function(set_litecore_source_base)
         LiteCore/Support/FilePath.cc
         LiteCore/Support/LogDecoder.cc
         LiteCore/Support/LogEncoder.cc
+        LiteCore/Support/LogRingBuffer.cc
+        LiteCore/Support/PipelinedWriteStream.cc
         LiteCore/Support/PlatformIO.cc
         LiteCore/Support/StringUtil.cc
         LiteCore/Support/ThreadUtil.cc